@@ -3,74 +3,15 @@
 #include "headers/Environment.hpp"
 #include "headers/LoxFunction.hpp"
 #include "headers/Loxpp.hpp"
+#include "headers/Operators.hpp"
 #include "headers/ReturnException.hpp"
 #include "headers/RuntimeError.hpp"
+#include "headers/Trace.hpp"
 #include <iostream>
 #include <memory>
+#include <tuple>
 #include <utility>
 
-bool AstInterpreter::isEqual(const std::shared_ptr<void> &left, const std::shared_ptr<void> &right,
-                             TokenInfo::Type leftType, TokenInfo::Type rightType)
-{
-    if (left == nullptr && right == nullptr)
-        return true;
-
-    // If bools, check if they are equal
-    if (leftType != rightType)
-        return false;
-
-    // If both are numbers, check if they are equal
-    if (leftType == TokenInfo::Type::NUMBER)
-        return *static_cast<double *>(left.get()) == *static_cast<double *>(right.get());
-
-    // If both are strings, check if they are equal
-    if (leftType == TokenInfo::Type::STRING)
-        return *static_cast<std::string *>(left.get()) == *static_cast<std::string *>(right.get());
-
-    return false;
-}
-
-bool AstInterpreter::isTruthy(const std::shared_ptr<void> &value, TokenInfo::Type type)
-{
-    if (type == TokenInfo::Type::NIL)
-        return false;
-
-    // If it's a number, check if it's not equal to 0
-    if (type == TokenInfo::Type::NUMBER)
-        return *static_cast<double *>(value.get()) != 0;
-
-    // If it's a string, check if it's not empty
-    else if (type == TokenInfo::Type::STRING)
-        return !static_cast<std::string *>(value.get())->empty();
-
-    // If's a boolean holding false value
-    else if (type == TokenInfo::Type::FALSE)
-        return false;
-
-    return true;
-}
-
-void AstInterpreter::checkNumberOperand(const Token &op, TokenInfo::Type rightType)
-{
-    if (rightType == TokenInfo::Type::NUMBER)
-        return;
-
-    throw RuntimeError(op, "Operand must be a number.");
-}
-
-void AstInterpreter::checkNumberOperands(const Token &op, TokenInfo::Type leftType, TokenInfo::Type rightType)
-{
-    if (leftType == TokenInfo::Type::NUMBER && rightType == TokenInfo::Type::NUMBER)
-        return;
-
-    throw RuntimeError(op, "Operands must be numbers.");
-}
-
-void AstInterpreter::setInterpretResult(const std::unique_ptr<Expr> &expr)
-{
-    expr->accept(*this);
-}
-
 void AstInterpreter::setInterpretResult(const std::vector<std::unique_ptr<Stmt>> &statements)
 {
     try
@@ -114,7 +55,7 @@ void AstInterpreter::executeBlock(const std::vector<std::unique_ptr<Stmt>> &stat
     catch (ReturnException &ret)
     {
         this->environment = previous;
-        throw ReturnException(ret.value, ret.type);
+        throw; // as is, it may be a tail call
     }
     catch (RuntimeError &err)
     {
@@ -122,261 +63,109 @@ void AstInterpreter::executeBlock(const std::vector<std::unique_ptr<Stmt>> &stat
     }
 }
 
-bool AstInterpreter::evaluate(const std::unique_ptr<Expr> &expr)
+Value AstInterpreter::evaluate(const std::unique_ptr<Expr> &expr)
+{
+    // Figure out what kind of expression we got and compute its value
+    return expr->accept(*this);
+}
+
+bool AstInterpreter::evaluateReported(const std::unique_ptr<Expr> &expr, Value &value)
 {
     try
     {
-        setInterpretResult(expr);
+        value = evaluate(expr);
         return true;
     }
     catch (RuntimeError &error)
     {
         Loxpp::runtimeError(error);
+        value = {nullptr, TokenInfo::Type::NIL};
         return false;
     }
 }
 
-std::shared_ptr<void> &AstInterpreter::getResult()
-{
-    return result;
-}
-
-TokenInfo::Type AstInterpreter::getResultType()
+// Simplest interpretable expression
+Value AstInterpreter::visitLiteralExpr(const Literal &expr)
 {
-    return type;
+    if (expr.type == TokenInfo::Type::NIL)
+        return {nullptr, TokenInfo::Type::NIL};
+    return {expr.value, expr.type};
 }
 
-// Simplest interpretable expression
-void AstInterpreter::setResult(std::shared_ptr<void> &toSet, std::shared_ptr<void> &toGet, TokenInfo::Type type)
+// Grouping expression
+Value AstInterpreter::visitGroupingExpr(const Grouping &expr)
 {
-    switch (type)
+    switch (expr.temporary)
     {
-    case TokenInfo::Type::FUN: // TODO: Class
-    case TokenInfo::Type::NUMBER:
-    case TokenInfo::Type::STRING:
-    case TokenInfo::Type::TRUE:
-    case TokenInfo::Type::FALSE: {
-        toSet = toGet;
-        break;
+    case Grouping::Temporary::REUSE: {
+        // Loop-invariant: computed on first use in this run of the loop. A runtime error leaves it uninitialized, so
+        // the next use fails the same way.
+        Value &binding = environment->lookup(expr.name, expr.cache);
+        if (binding.second != TokenInfo::Type::UNINITIALIZED)
+            return binding;
+        Value value = evaluate(expr.expression);
+        environment->lookup(expr.name, expr.cache) = value;
+        return value;
     }
-    case TokenInfo::Type::NIL: {
-        toSet = std::shared_ptr<void>(nullptr);
-        break;
+    case Grouping::Temporary::STORE: {
+        Value value = evaluate(expr.expression);
+        environment->defineVar(std::string(expr.name.getLexeme()), value.first, value.second);
+        return value;
     }
+    case Grouping::Temporary::LOAD:
+        return environment->lookup(expr.name, expr.cache);
+    default:
+        // Grouping expression is just a wrapper around another expression.
+        // Simply interpret the expression inside the grouping expression
+        return evaluate(expr.expression);
     }
 }
 
-void AstInterpreter::visitLiteralExpr(const Literal &expr)
-{
-    type = expr.type;
-    auto val = expr.value;
-    setResult(result, val, type);
-}
-
-// Grouping expression
-void AstInterpreter::visitGroupingExpr(const Grouping &expr)
-{
-    // Grouping expression is just a wrapper around another expression.
-    // Simply interpret the expression inside the grouping expression
-    setInterpretResult(expr.expression);
-}
-
-void AstInterpreter::visitVariableExpr(const Variable &expr)
+Value AstInterpreter::visitVariableExpr(const Variable &expr)
 {
     // Get the value of the variable from the environment
-    std::pair<std::shared_ptr<void>, TokenInfo::Type> value =
-        environment->get(expr.name); // Can throw error if not defined
-
-    // Set the result to the value of the variable
-    type = value.second;
+    Value value = environment->get(expr.name); // Can throw error if not defined
 
-    if (type == TokenInfo::Type::UNINITIALIZED)
+    if (value.second == TokenInfo::Type::UNINITIALIZED)
         throw RuntimeError(expr.name, "Variable used before being initialized.");
 
-    setResult(result, value.first, type);
+    return value;
 }
 
-void AstInterpreter::visitAssignExpr(const Assign &expr)
+Value AstInterpreter::visitAssignExpr(const Assign &expr)
 {
     // Evaluate the right hand side of the assignment
-    setInterpretResult(expr.value);
+    Value value = evaluate(expr.value);
 
     // Set the value of the variable in the environment
-    environment->assign(expr.name, getResult(), getResultType());
+    environment->assign(expr.name, value.first, value.second);
+    return value;
 }
 // Unary expression
-void AstInterpreter::visitUnaryExpr(const Unary &expr)
+Value AstInterpreter::visitUnaryExpr(const Unary &expr)
 {
     // Interpret the right expression on which the unary operator is then applied
-    setInterpretResult(expr.right);
-    TokenInfo::Type rightType = getResultType();
-    std::shared_ptr<void> right;
-    setResult(right, getResult(), rightType);
-
-    switch (expr.op.getType())
-    {
-
-    case TokenInfo::Type::BANG: {
-        // Negate
-        bool newVal = !isTruthy(right, rightType);
-        type = newVal ? TokenInfo::Type::TRUE : TokenInfo::Type::FALSE;
-        std::shared_ptr<void> tempResult(new bool(newVal));
-        setResult(result, tempResult, type);
-        break;
-    }
-    case TokenInfo::Type::MINUS: {
-        checkNumberOperand(expr.op, rightType);
-        type = TokenInfo::Type::NUMBER;
-        setResult(result, right, rightType);
-        break;
-    }
-    }
+    Value right = evaluate(expr.right);
 
-    return;
+    Value value;
+    if (const char *error = Operators::unary(expr.op.getType(), right, value))
+        throw RuntimeError(expr.op, error);
+    return value;
 }
 
 // Binary expression
-void AstInterpreter::visitBinaryExpr(const Binary &expr)
+Value AstInterpreter::visitBinaryExpr(const Binary &expr)
 {
     // Get left evaluation
-    setInterpretResult(expr.left);
-    TokenInfo::Type leftType = getResultType();
-    std::shared_ptr<void> left;
-    setResult(left, getResult(), leftType);
+    Value left = evaluate(expr.left);
 
     // Get right evaluation
-    setInterpretResult(expr.right);
-    TokenInfo::Type rightType = getResultType();
-    std::shared_ptr<void> right;
-    setResult(right, getResult(), rightType);
-
-    // Switch operator
-    switch (expr.op.getType())
-    {
-
-    // Comparison operators
-    case TokenInfo::Type::GREATER: {
-        checkNumberOperands(expr.op, leftType, rightType);
-        bool newVal = *(static_cast<double *>(left.get())) > *(static_cast<double *>(right.get()));
-        type = newVal ? TokenInfo::Type::TRUE : TokenInfo::Type::FALSE;
-        std::shared_ptr<void> tempResult(new bool(newVal));
-        setResult(result, tempResult, type);
-        break;
-    }
-    case TokenInfo::Type::GREATER_EQUAL: {
-
-        checkNumberOperands(expr.op, leftType, rightType);
-        bool newVal = *(static_cast<double *>(left.get())) >= *(static_cast<double *>(right.get()));
-        type = newVal ? TokenInfo::Type::TRUE : TokenInfo::Type::FALSE;
-        std::shared_ptr<void> tempResult(new bool(newVal));
-        setResult(result, tempResult, type);
-        break;
-    }
-    case TokenInfo::Type::LESS: {
-        checkNumberOperands(expr.op, leftType, rightType);
-        bool newVal = *(static_cast<double *>(left.get())) < *(static_cast<double *>(right.get()));
-        type = newVal ? TokenInfo::Type::TRUE : TokenInfo::Type::FALSE;
-        std::shared_ptr<void> tempResult(new bool(newVal));
-        setResult(result, tempResult, type);
-        break;
-    }
-    case TokenInfo::Type::LESS_EQUAL: {
-        checkNumberOperands(expr.op, leftType, rightType);
-        bool newVal = *(static_cast<double *>(left.get())) <= *(static_cast<double *>(right.get()));
-        type = newVal ? TokenInfo::Type::TRUE : TokenInfo::Type::FALSE;
-        std::shared_ptr<void> tempResult(new bool(newVal));
-        setResult(result, tempResult, type);
-        break;
-    }
+    Value right = evaluate(expr.right);
 
-    case TokenInfo::Type::BANG_EQUAL: {
-        bool newVal = !isEqual(left, right, leftType, rightType);
-        type = newVal ? TokenInfo::Type::TRUE : TokenInfo::Type::FALSE;
-        std::shared_ptr<void> tempResult(new bool(newVal));
-        setResult(result, tempResult, type);
-        break;
-    }
-    case TokenInfo::Type::EQUAL_EQUAL: {
-        bool newVal = isEqual(left, right, leftType, rightType);
-        type = newVal ? TokenInfo::Type::TRUE : TokenInfo::Type::FALSE;
-        std::shared_ptr<void> tempResult(new bool(newVal));
-        setResult(result, tempResult, type);
-        break;
-    }
-
-    case TokenInfo::Type::MINUS: {
-        checkNumberOperands(expr.op, leftType, rightType);
-        type = TokenInfo::Type::NUMBER;
-        std::shared_ptr<void> tempResult(
-            new double(*static_cast<double *>(left.get()) - *static_cast<double *>(right.get())));
-        setResult(result, tempResult, type);
-        break;
-    }
-
-        // Since + can do add & string concat, the ++ is overLOADED.
-    case TokenInfo::Type::PLUS: {
-        // If both are numbers, add them
-        if (leftType == TokenInfo::Type::NUMBER && rightType == TokenInfo::Type::NUMBER)
-        {
-            type = TokenInfo::Type::NUMBER;
-            std::shared_ptr<void> tempResult(
-                new double(*static_cast<double *>(left.get()) + *static_cast<double *>(right.get())));
-            setResult(result, tempResult, type);
-        }
-
-        // Concatenate strings
-        else if (leftType == TokenInfo::Type::STRING && rightType == TokenInfo::Type::STRING)
-        {
-            type = TokenInfo::Type::STRING;
-            std::shared_ptr<void> tempResult(
-                new std::string(*static_cast<std::string *>(left.get()) + *static_cast<std::string *>(right.get())));
-            setResult(result, tempResult, type);
-        }
-        // Convert number to string and concat
-        else if (leftType == TokenInfo::Type::STRING && rightType == TokenInfo::Type::NUMBER)
-        {
-            type = TokenInfo::Type::STRING;
-            // Convert right to number
-            std::shared_ptr<void> tempResult(new std::string(*static_cast<std::string *>(left.get()) +
-                                                             std::to_string(*static_cast<double *>(right.get()))));
-            setResult(result, tempResult, type);
-        }
-        else if (leftType == TokenInfo::Type::NUMBER && rightType == TokenInfo::Type::STRING)
-        {
-            type = TokenInfo::Type::STRING;
-            // Convert left to number
-            std::shared_ptr<void> tempResult(new std::string(std::to_string(*static_cast<double *>(left.get())) +
-                                                             *static_cast<std::string *>(right.get())));
-            setResult(result, tempResult, type);
-        }
-        else
-            throw RuntimeError(expr.op, "Operands must be two numbers or two strings.");
-
-        break;
-    }
-
-    case TokenInfo::Type::SLASH: {
-        checkNumberOperands(expr.op, leftType, rightType);
-        type = TokenInfo::Type::NUMBER;
-        double rightVal = *static_cast<double *>(right.get());
-        if (rightVal == 0)
-            throw RuntimeError(expr.op, "Division by zero.");
-        std::shared_ptr<void> tempResult(new double(*static_cast<double *>(left.get()) / rightVal));
-        setResult(result, tempResult, type);
-        break;
-    }
-
-    case TokenInfo::Type::STAR: {
-        checkNumberOperands(expr.op, leftType, rightType);
-        type = TokenInfo::Type::NUMBER;
-        std::shared_ptr<void> tempResult(
-            new double(*static_cast<double *>(left.get()) * *static_cast<double *>(right.get())));
-        setResult(result, tempResult, type);
-        break;
-    }
-    }
-
-    return;
+    Value value;
+    if (const char *error = Operators::binary(expr.op.getType(), left, right, value))
+        throw RuntimeError(expr.op, error);
+    return value;
 }
 
 // Helper method to reduce code mess in visitCallExpr
@@ -386,75 +175,149 @@ bool AstInterpreter::isCallableType(TokenInfo::Type type)
 }
 
 // Call expression
-void AstInterpreter::visitCallExpr(const Call &expr)
+Value AstInterpreter::visitCallExpr(const Call &expr)
 {
-    setInterpretResult(expr.callee);              // will call visitCallExpr to ensure callee is of type Fun or Class
-    TokenInfo::Type calleeType = getResultType(); // Get the type of the callee (function or class)
+    std::shared_ptr<LoxFunction> callable;
+    std::shared_ptr<Environment> funcEnv;
+    Value value;
+    if (!prepareCall(expr, callable, funcEnv, value))
+        return value;
+
+    if (callStack.full(Loxpp::options.maxDepth))
+        throw RuntimeError(expr.paren, "Stack overflow.");
+    CallStack::Frame frame(callStack, {callable.get(), expr.paren.getOffset()});
+
+    // Hot numeric functions run as machine code, unless it bails out (see LoxFunction::runJit)
+    if (Loxpp::options.jit &&
+        callable->runJit(*funcEnv, int64_t(Loxpp::options.maxDepth) - int64_t(callStack.depth()), value))
+        return value;
+
+    // Call the function, its return value will be an expression
+    // (e.g. return 1 + 2; will return 3)
+    return callable->call(*this, funcEnv);
+}
+
+bool AstInterpreter::prepareCall(const Call &expr, std::shared_ptr<LoxFunction> &callable,
+                                 std::shared_ptr<Environment> &funcEnv, Value &value)
+{
+    Value callee;
+    auto lifted = liftedFunctions.end();
+    if (expr.liftedFunction.getLength() != 0)
+        lifted = liftedFunctions.find(expr.liftedFunction.getOffset());
+
+    if (lifted != liftedFunctions.end())
+        callee = {lifted->second, TokenInfo::Type::FUN};
+    else if (expr.calleeVariable != nullptr)
+    {
+        // Calling a function by name: same as visitVariableExpr, but usually without walking the environments
+        auto &binding = environment->lookup(expr.calleeVariable->name, expr.calleeCache);
+        if (binding.second == TokenInfo::Type::UNINITIALIZED)
+            throw RuntimeError(expr.calleeVariable->name, "Variable used before being initialized.");
+        callee = binding;
+    }
+    else
+        callee = evaluate(expr.callee); // will call visitCallExpr to ensure callee is of type Fun or Class
 
     // Check if callee is of a callable type (function or class)
-    if (!isCallableType(calleeType))
+    if (!isCallableType(callee.second))
         throw RuntimeError(expr.paren, "Can only call functions and classes.");
 
-    auto callable = std::static_pointer_cast<LoxFunction>(getResult());
+    callable = std::static_pointer_cast<LoxFunction>(callee.first);
+    if (expr.inlined != nullptr && callee.second == TokenInfo::Type::FUN &&
+        callable->declaration->name.getOffset() == expr.inlinedFunction.getOffset())
+    {
+        value = callInlined(expr, *callable);
+        return false;
+    }
+
+    funcEnv = callable->makeEnvironment();
 
-    // Evaluate argument expressions
-    std::vector<std::pair<std::shared_ptr<void>, TokenInfo::Type>> arguments;
-    for (const auto &arg : expr.arguments)
+    // Evaluate argument expressions straight into the parameter slots. Extra ones are still evaluated (for their
+    // errors and side effects) before the arity check.
+    size_t count = expr.arguments.size();
+    for (size_t i = 0; i < count; i++)
     {
-        setInterpretResult(arg);
-        arguments.push_back({getResult(), getResultType()});
+        Value argument = evaluate(expr.arguments[i]);
+        if (i < funcEnv->slotCount())
+            funcEnv->slot(i) = std::move(argument);
     }
 
-    if (arguments.size() != callable->arity())
+    if (count != callable->arity())
         throw RuntimeError(expr.paren, "Expected " + std::to_string(callable->arity()) + " arguments but got " +
-                                           std::to_string(arguments.size()) + ".");
+                                           std::to_string(count) + ".");
+    return true;
+}
 
-    // Call the function, its return value will be an expression
-    // (e.g. return 1 + 2; will return 3)
-    auto [returnValue, returnType] = callable->call(*this, arguments);
-    setResult(result, returnValue, returnType);
+Value AstInterpreter::callInlined(const Call &expr, LoxFunction &callable)
+{
+    // What the call would do, minus its environment and the ReturnException: the arity is known to match, the
+    // arguments go to the temporaries and the body can't call anything. An argument can, though, and that call may
+    // come back through this same call site (add(n, f(n - 1)) in f), so every argument is evaluated before any of
+    // the temporaries is written.
+    Value arguments[Call::MAX_INLINED_PARAMS];
+    size_t count = expr.arguments.size();
+    for (size_t i = 0; i < count; i++)
+        arguments[i] = evaluate(expr.arguments[i]);
+    for (size_t i = 0; i < count; i++)
+        callable.closure->defineHere(expr.inlinedParams[i], expr.inlinedCaches[i]) = std::move(arguments[i]);
+
+    if (callStack.full(Loxpp::options.maxDepth))
+        throw RuntimeError(expr.paren, "Stack overflow.");
+
+    // Like the return statement it came from, a runtime error is reported and the call gives nil
+    std::shared_ptr<Environment> previous = std::move(environment);
+    environment = callable.closure;
+    Value value;
+    evaluateReported(expr.inlined, value);
+    environment = std::move(previous);
+    return value;
 }
 
 void AstInterpreter::visitExpressionStmt(const Expression &stmt)
 {
-    evaluate(stmt.expression);
+    Value value;
+    evaluateReported(stmt.expression, value);
 };
 
-void AstInterpreter::visitLogicalExpr(const Logical &expr)
+Value AstInterpreter::visitLogicalExpr(const Logical &expr)
 {
 
     // Evaluate left side of the expression
-    evaluate(expr.left);
+    Value left;
+    evaluateReported(expr.left, left);
 
     if (expr.op.getType() == TokenInfo::Type::OR)
     {
-        if (isTruthy(getResult(), getResultType()))
+        if (Operators::isTruthy(left.first, left.second))
         {
             // If the left side is true, we don't need to evaluate right side
-            return;
+            return left;
         }
     }
     else
     {
-        if (!isTruthy(getResult(), getResultType()))
+        if (!Operators::isTruthy(left.first, left.second))
         {
             // If left side is false, we don't need to evaluate right side
-            return;
+            return left;
         }
     }
 
     // Evaluate right side of the expression
-    evaluate(expr.right);
+    Value right;
+    evaluateReported(expr.right, right);
+    return right;
 }
 
 void AstInterpreter::visitIfStmt(const If &stmt)
 {
 
     // Evaluate condition to some value
-    evaluate(stmt.condition);
+    Value condition;
+    evaluateReported(stmt.condition, condition);
 
     // If condition is true, execute then branch
-    if (isTruthy(getResult(), getResultType()))
+    if (Operators::isTruthy(condition.first, condition.second))
         execute(stmt.thenBranch);
     // Else, if there was an else branch, execute it
     else if (stmt.elseBranch != nullptr)
@@ -463,17 +326,29 @@ void AstInterpreter::visitIfStmt(const If &stmt)
 
 void AstInterpreter::visitWhileStmt(const While &stmt)
 {
+    for (const Token &temporary : stmt.temporaries)
+        environment->defineVar(std::string(temporary.getLexeme()), nullptr, TokenInfo::Type::UNINITIALIZED);
 
-    evaluate(stmt.condition);
+    Value condition;
+    evaluateReported(stmt.condition, condition);
     try
     {
-        while (isTruthy(getResult(), getResultType()))
+        while (Operators::isTruthy(condition.first, condition.second))
         {
+            // Once the loop is hot, it runs as a trace for as long as its guards hold
+            if (Loxpp::options.traces)
+            {
+                if (stmt.trace == nullptr)
+                    stmt.trace = std::make_shared<LoopTrace>();
+                if (stmt.trace->run(stmt, *environment))
+                    break;
+            }
+
             // Execute while loop body
             execute(stmt.body);
 
             // Run condition check again
-            evaluate(stmt.condition);
+            evaluateReported(stmt.condition, condition);
         }
     }
     catch (BreakError &e)
@@ -485,15 +360,31 @@ void AstInterpreter::visitWhileStmt(const While &stmt)
 
 void AstInterpreter::visitReturnStmt(const Return &stmt)
 {
-    std::shared_ptr<void> value = nullptr;
-    if (stmt.value != nullptr)
+    // A bare return; gives nil
+    Value value = {nullptr, TokenInfo::Type::NIL};
+    if (stmt.value != nullptr && stmt.value->kind == ExprKind::Call && Loxpp::options.tailCalls &&
+        callStack.depth() > 0)
     {
-        evaluate(stmt.value);
-        setResult(value, getResult(), getResultType());
+        // Tail call: everything up to running the function happens here, LoxFunction::call runs it in place of this
+        // one. Errors are reported like those of any returned expression.
+        std::shared_ptr<LoxFunction> callable;
+        std::shared_ptr<Environment> funcEnv;
+        try
+        {
+            if (prepareCall(static_cast<const Call &>(*stmt.value), callable, funcEnv, value))
+                throw ReturnException(callable, funcEnv);
+        }
+        catch (RuntimeError &error)
+        {
+            Loxpp::runtimeError(error);
+            value = {nullptr, TokenInfo::Type::NIL};
+        }
     }
+    else if (stmt.value != nullptr)
+        evaluateReported(stmt.value, value);
 
     // use exception to break out to a higher frame in the call stack
-    throw ReturnException(value, type);
+    throw ReturnException(value.first, value.second);
 }
 
 void AstInterpreter::visitBreakStmt(const Break &stmt)
@@ -503,9 +394,10 @@ void AstInterpreter::visitBreakStmt(const Break &stmt)
 
 void AstInterpreter::visitPrintStmt(const Print &stmt)
 {
-    bool successEval = evaluate(stmt.expression);
+    Value value;
+    bool successEval = evaluateReported(stmt.expression, value);
     if (successEval)
-        std::cout << stringifyResult(result, type) << "\n";
+        std::cout << Operators::stringify(value.first, value.second) << "\n";
 };
 
 void AstInterpreter::visitBlockStmt(const Block &stmt)
@@ -518,11 +410,29 @@ void AstInterpreter::visitBlockStmt(const Block &stmt)
 // Function declaration (not call)
 void AstInterpreter::visitFunctionStmt(const Function &stmt)
 {
+    if (stmt.lifted)
+    {
+        // Made once. Its closure only binds its name (for recursive calls) in front of the globals, the two keep
+        // each other alive for as long as the program runs anyway.
+        std::shared_ptr<LoxFunction> &function = liftedFunctions[stmt.name.getOffset()];
+        if (function == nullptr)
+        {
+            auto closure = std::make_shared<Environment>(globals);
+            std::unique_ptr<Function> funcDecl =
+                std::unique_ptr<Function>(static_cast<Function *>(stmt.clone().release()));
+            function = std::make_shared<LoxFunction>(funcDecl, closure);
+            closure->defineVar(std::string(stmt.name.getLexeme()), function, TokenInfo::Type::FUN);
+        }
+        if (stmt.bindsName)
+            environment->defineVar(std::string(stmt.name.getLexeme()), function, TokenInfo::Type::FUN);
+        return;
+    }
+
     // Copy stmt to a new var ptr.
     std::unique_ptr<Function> funcDecl = std::unique_ptr<Function>(static_cast<Function *>(stmt.clone().release()));
     std::shared_ptr<LoxFunction> function = std::make_shared<LoxFunction>(funcDecl, this->environment);
 
-    environment->defineVar(stmt.name.getLexeme(), function, TokenInfo::Type::FUN);
+    environment->defineVar(std::string(stmt.name.getLexeme()), function, TokenInfo::Type::FUN);
 }
 
 void AstInterpreter::visitVarStmt(const Var &stmt)
@@ -533,29 +443,8 @@ void AstInterpreter::visitVarStmt(const Var &stmt)
     if (stmt.initializer)
     {
         // initializer is an expression. E.g. var a = 5; initializer is literal expression '5'
-        setInterpretResult(stmt.initializer);
-        // Get evaluated value
-        value = getResult();
-        valtype = getResultType();
+        std::tie(value, valtype) = evaluate(stmt.initializer);
     }
 
-    environment->defineVar(stmt.name.getLexeme(), value, valtype);
-}
-
-std::string AstInterpreter::stringifyResult(const std::shared_ptr<void> &result, TokenInfo::Type type)
-{
-
-    if (type == TokenInfo::Type::NUMBER)
-        return std::to_string(*static_cast<double *>(result.get()));
-
-    if (type == TokenInfo::Type::STRING)
-        return *static_cast<std::string *>(result.get());
-
-    if (type == TokenInfo::Type::TRUE)
-        return "true";
-
-    if (type == TokenInfo::Type::FALSE)
-        return "false";
-
-    return "nil";
+    environment->defineVar(std::string(stmt.name.getLexeme()), value, valtype);
 }
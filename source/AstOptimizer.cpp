@@ -0,0 +1,1029 @@
+#include "headers/AstOptimizer.hpp"
+#include "headers/Loxpp.hpp"
+#include "headers/Operators.hpp"
+#include "headers/Source.hpp"
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <unordered_map>
+#include <unordered_set>
+
+void AstOptimizer::optimize(std::vector<std::unique_ptr<Stmt>> &statements)
+{
+    // A return at the top level only ends its own statement, the ones after it still run
+    std::vector<std::unique_ptr<Stmt>> kept;
+    for (auto &stmt : statements)
+    {
+        if (simplify(stmt))
+            kept.push_back(std::move(stmt));
+    }
+    statements = std::move(kept);
+
+    for (auto &stmt : statements)
+    {
+        if (stmt->kind == StmtKind::Function && static_cast<Function &>(*stmt).lazyBody == nullptr)
+            lift(static_cast<Function &>(*stmt));
+    }
+    if (Loxpp::options.inlineBudget > 0)
+        inlineCalls(statements);
+
+    for (auto &stmt : statements)
+    {
+        hoist(*stmt);
+        share(*stmt);
+    }
+}
+
+bool AstOptimizer::constant(const Expr &expr, Value &value)
+{
+    if (expr.kind != ExprKind::Literal)
+        return false;
+
+    // Same as AstInterpreter::visitLiteralExpr
+    const auto &literal = static_cast<const Literal &>(expr);
+    value = {literal.type == TokenInfo::Type::NIL ? nullptr : literal.value, literal.type};
+    return true;
+}
+
+static std::unique_ptr<Expr> literal(Value &value)
+{
+    return std::make_unique<Literal>(value.first, value.second);
+}
+
+/* -------------------- EXPRESSIONS -------------------- */
+
+void AstOptimizer::fold(std::unique_ptr<Expr> &expr)
+{
+    switch (expr->kind)
+    {
+    case ExprKind::Assign:
+        fold(static_cast<Assign &>(*expr).value);
+        break;
+
+    case ExprKind::Binary: {
+        auto &binary = static_cast<Binary &>(*expr);
+        fold(binary.left);
+        fold(binary.right);
+
+        Value left, right, value;
+        if (constant(*binary.left, left) && constant(*binary.right, right) &&
+            Operators::binary(binary.op.getType(), left, right, value) == nullptr)
+            expr = literal(value);
+        break;
+    }
+
+    case ExprKind::Call: {
+        auto &call = static_cast<Call &>(*expr);
+        fold(call.callee);
+        for (auto &argument : call.arguments)
+            fold(argument);
+        break;
+    }
+
+    case ExprKind::Grouping: {
+        auto &grouping = static_cast<Grouping &>(*expr);
+        fold(grouping.expression);
+        if (grouping.expression->kind == ExprKind::Literal)
+            expr = std::move(grouping.expression);
+        break;
+    }
+
+    case ExprKind::Logical: {
+        auto &logical = static_cast<Logical &>(*expr);
+        fold(logical.left);
+        fold(logical.right);
+
+        Value left, right;
+        if (!constant(*logical.left, left))
+            break;
+        bool truthy = Operators::isTruthy(left.first, left.second);
+        if (truthy == (logical.op.getType() == TokenInfo::Type::OR))
+            expr = literal(left);
+        else if (constant(*logical.right, right))
+            expr = literal(right);
+        break;
+    }
+
+    case ExprKind::Unary: {
+        auto &unary = static_cast<Unary &>(*expr);
+        fold(unary.right);
+
+        Value right, value;
+        if (constant(*unary.right, right) && Operators::unary(unary.op.getType(), right, value) == nullptr)
+            expr = literal(value);
+        break;
+    }
+
+    case ExprKind::Literal:
+    case ExprKind::Variable:
+        break;
+    }
+}
+
+/* -------------------- STATEMENTS -------------------- */
+
+bool AstOptimizer::simplify(std::unique_ptr<Stmt> &stmt)
+{
+    switch (stmt->kind)
+    {
+    case StmtKind::Block:
+        simplifyBlock(static_cast<Block &>(*stmt).statements);
+        return true;
+
+    case StmtKind::Break:
+        return true;
+
+    case StmtKind::Expression: {
+        auto &expression = static_cast<Expression &>(*stmt);
+        fold(expression.expression);
+        return expression.expression->kind != ExprKind::Literal;
+    }
+
+    case StmtKind::Function: {
+        auto &function = static_cast<Function &>(*stmt);
+        if (function.lazyBody == nullptr)
+            simplifyBlock(function.body);
+        return true;
+    }
+
+    case StmtKind::If: {
+        auto &ifStmt = static_cast<If &>(*stmt);
+        fold(ifStmt.condition);
+
+        Value condition;
+        if (constant(*ifStmt.condition, condition))
+        {
+            std::unique_ptr<Stmt> taken = Operators::isTruthy(condition.first, condition.second)
+                                              ? std::move(ifStmt.thenBranch)
+                                              : std::move(ifStmt.elseBranch);
+            if (taken == nullptr)
+                return false;
+            // A branch runs in the scope of the if, so it can take its place
+            stmt = std::move(taken);
+            return simplify(stmt);
+        }
+
+        simplifyBranch(ifStmt.thenBranch);
+        if (ifStmt.elseBranch != nullptr)
+            simplifyBranch(ifStmt.elseBranch);
+        return true;
+    }
+
+    case StmtKind::Print:
+        fold(static_cast<Print &>(*stmt).expression);
+        return true;
+
+    case StmtKind::Return: {
+        auto &returnStmt = static_cast<Return &>(*stmt);
+        if (returnStmt.value != nullptr)
+            fold(returnStmt.value);
+        return true;
+    }
+
+    case StmtKind::Var: {
+        auto &var = static_cast<Var &>(*stmt);
+        if (var.initializer != nullptr)
+            fold(var.initializer);
+        return true;
+    }
+
+    case StmtKind::While: {
+        auto &whileStmt = static_cast<While &>(*stmt);
+        fold(whileStmt.condition);
+
+        Value condition;
+        if (constant(*whileStmt.condition, condition) && !Operators::isTruthy(condition.first, condition.second))
+            return false;
+        simplifyBranch(whileStmt.body);
+        return true;
+    }
+    }
+    return true;
+}
+
+void AstOptimizer::simplifyBranch(std::unique_ptr<Stmt> &stmt)
+{
+    if (!simplify(stmt))
+        stmt = std::make_unique<Block>(std::vector<std::unique_ptr<Stmt>>());
+}
+
+void AstOptimizer::simplifyBlock(std::vector<std::unique_ptr<Stmt>> &statements)
+{
+    std::vector<std::unique_ptr<Stmt>> kept;
+    for (auto &stmt : statements)
+    {
+        if (!simplify(stmt))
+            continue;
+
+        // Nothing after a return or break runs
+        bool jumps = stmt->kind == StmtKind::Return || stmt->kind == StmtKind::Break;
+        kept.push_back(std::move(stmt));
+        if (jumps)
+            break;
+    }
+    statements = std::move(kept);
+}
+
+/* -------------------- TEMPORARIES -------------------- */
+
+namespace
+{
+// What running some code could change: the variables it assigns or declares, and whether it calls a function
+struct Effects
+{
+    std::unordered_set<std::string_view> names;
+    bool calls = false;
+};
+
+// Calls f on the operands of expr, in the order they are evaluated
+template <typename F> void forEachOperand(Expr &expr, F &&f)
+{
+    switch (expr.kind)
+    {
+    case ExprKind::Assign:
+        f(static_cast<Assign &>(expr).value);
+        break;
+    case ExprKind::Binary:
+        f(static_cast<Binary &>(expr).left);
+        f(static_cast<Binary &>(expr).right);
+        break;
+    case ExprKind::Call:
+        f(static_cast<Call &>(expr).callee);
+        for (auto &argument : static_cast<Call &>(expr).arguments)
+            f(argument);
+        break;
+    case ExprKind::Grouping:
+        f(static_cast<Grouping &>(expr).expression);
+        break;
+    case ExprKind::Logical:
+        f(static_cast<Logical &>(expr).left);
+        f(static_cast<Logical &>(expr).right);
+        break;
+    case ExprKind::Unary:
+        f(static_cast<Unary &>(expr).right);
+        break;
+    case ExprKind::Literal:
+    case ExprKind::Variable:
+        break;
+    }
+}
+
+// Calls f on stmt and the statements nested in it, before their own nested statements. Bodies of function
+// declarations are left out, they don't run where they are declared.
+template <typename F> void forEachStmt(Stmt &stmt, F &&f)
+{
+    f(stmt);
+    switch (stmt.kind)
+    {
+    case StmtKind::Block:
+        for (auto &nested : static_cast<Block &>(stmt).statements)
+            forEachStmt(*nested, f);
+        break;
+    case StmtKind::If:
+        forEachStmt(*static_cast<If &>(stmt).thenBranch, f);
+        if (static_cast<If &>(stmt).elseBranch != nullptr)
+            forEachStmt(*static_cast<If &>(stmt).elseBranch, f);
+        break;
+    case StmtKind::While:
+        forEachStmt(*static_cast<While &>(stmt).body, f);
+        break;
+    default:
+        break;
+    }
+}
+
+// Calls f on the expressions stmt itself evaluates
+template <typename F> void forEachExpr(Stmt &stmt, F &&f)
+{
+    switch (stmt.kind)
+    {
+    case StmtKind::Expression:
+        f(static_cast<Expression &>(stmt).expression);
+        break;
+    case StmtKind::If:
+        f(static_cast<If &>(stmt).condition);
+        break;
+    case StmtKind::Print:
+        f(static_cast<Print &>(stmt).expression);
+        break;
+    case StmtKind::Return:
+        if (static_cast<Return &>(stmt).value != nullptr)
+            f(static_cast<Return &>(stmt).value);
+        break;
+    case StmtKind::Var:
+        if (static_cast<Var &>(stmt).initializer != nullptr)
+            f(static_cast<Var &>(stmt).initializer);
+        break;
+    case StmtKind::While:
+        f(static_cast<While &>(stmt).condition);
+        break;
+    default:
+        break;
+    }
+}
+
+void scan(Expr &expr, Effects &effects)
+{
+    if (expr.kind == ExprKind::Assign)
+        effects.names.insert(static_cast<Assign &>(expr).name.getLexeme());
+    else if (expr.kind == ExprKind::Call)
+        effects.calls = true;
+    forEachOperand(expr, [&effects](std::unique_ptr<Expr> &operand) { scan(*operand, effects); });
+}
+
+void scan(Stmt &stmt, Effects &effects)
+{
+    forEachStmt(stmt, [&effects](Stmt &nested) {
+        if (nested.kind == StmtKind::Var)
+            effects.names.insert(static_cast<Var &>(nested).name.getLexeme());
+        else if (nested.kind == StmtKind::Function)
+            effects.names.insert(static_cast<Function &>(nested).name.getLexeme());
+        forEachExpr(nested, [&effects](std::unique_ptr<Expr> &expr) { scan(*expr, effects); });
+    });
+}
+
+// What is known about an expression: whether it only applies operators to literals and variables not in changed, and
+// if so its value number, equal for pure expressions that compute the same
+struct Pure
+{
+    bool pure = false;
+    bool operators = false;
+    bool variables = false;
+    uint32_t number = 0;
+};
+
+// Worked out once per node, from those of its operands, so looking at every node of a tree stays linear in its size
+struct Numbering
+{
+    const Effects &changed;
+    std::unordered_map<const Expr *, Pure> nodes;
+    // Value numbers by key: the operator and the numbers of the operands, the literal or the variable's name
+    std::unordered_map<std::string, uint32_t> numbers;
+};
+
+// The value number of pure expr, given those of its operands. Apart from analyze, so that only the few bytes of
+// analyze are on the native stack for every level of a deep expression.
+uint32_t number(const Expr &expr, uint32_t left, uint32_t right, Numbering &numbering)
+{
+    std::string key;
+    switch (expr.kind)
+    {
+    case ExprKind::Binary:
+        key = "(" + std::to_string(static_cast<int>(static_cast<const Binary &>(expr).op.getType())) + " " +
+              std::to_string(left) + " " + std::to_string(right) + ")";
+        break;
+    case ExprKind::Unary:
+        key = "(" + std::to_string(static_cast<int>(static_cast<const Unary &>(expr).op.getType())) + " " +
+              std::to_string(left) + ")";
+        break;
+    case ExprKind::Literal: {
+        // A literal true is a nullptr and a computed one isn't, they compare differently (see Operators::isEqual)
+        const auto &literal = static_cast<const Literal &>(expr);
+        key = "#" + std::to_string(static_cast<int>(literal.type));
+        if (literal.type == TokenInfo::Type::NIL || literal.value == nullptr)
+            break;
+        if (literal.type == TokenInfo::Type::NUMBER)
+            key += "n" + std::string(static_cast<const char *>(literal.value.get()), sizeof(double));
+        else if (literal.type == TokenInfo::Type::STRING)
+        {
+            const auto &string = *std::static_pointer_cast<std::string>(literal.value);
+            key += "s" + std::to_string(string.size()) + ":" + string;
+        }
+        else
+            key += "b";
+        break;
+    }
+    default:
+        key = std::string(static_cast<const Variable &>(expr).name.getLexeme());
+        break;
+    }
+    return numbering.numbers.emplace(std::move(key), numbering.numbers.size() + 1).first->second;
+}
+
+const Pure &analyze(const Expr &expr, Numbering &numbering)
+{
+    auto found = numbering.nodes.find(&expr);
+    if (found != numbering.nodes.end())
+        return found->second;
+
+    Pure info;
+    uint32_t left = 0;
+    uint32_t right = 0;
+    switch (expr.kind)
+    {
+    case ExprKind::Binary: {
+        const Pure &leftInfo = analyze(*static_cast<const Binary &>(expr).left, numbering);
+        const Pure &rightInfo = analyze(*static_cast<const Binary &>(expr).right, numbering);
+        info.pure = leftInfo.pure && rightInfo.pure;
+        info.operators = true;
+        info.variables = leftInfo.variables || rightInfo.variables;
+        left = leftInfo.number;
+        right = rightInfo.number;
+        break;
+    }
+    case ExprKind::Unary: {
+        const Pure &rightInfo = analyze(*static_cast<const Unary &>(expr).right, numbering);
+        info.pure = rightInfo.pure;
+        info.operators = true;
+        info.variables = rightInfo.variables;
+        left = rightInfo.number;
+        break;
+    }
+    case ExprKind::Grouping: {
+        const auto &grouping = static_cast<const Grouping &>(expr);
+        info = analyze(*grouping.expression, numbering);
+        info.pure &= grouping.temporary == Grouping::Temporary::NONE;
+        return numbering.nodes[&expr] = info;
+    }
+    case ExprKind::Literal:
+        info.pure = true;
+        break;
+    case ExprKind::Variable:
+        info.pure = numbering.changed.names.count(static_cast<const Variable &>(expr).name.getLexeme()) == 0;
+        info.variables = true;
+        break;
+    default:
+        // Calls and assignments, their operands are looked at on their own
+        return numbering.nodes[&expr] = info;
+    }
+
+    if (info.pure)
+        info.number = number(expr, left, right, numbering);
+    return numbering.nodes[&expr] = info;
+}
+
+// Pure and worth a temporary: operators left on literals alone are the ones that fail (see fold)
+bool keepable(const Expr &expr, Numbering &numbering)
+{
+    const Pure &info = analyze(expr, numbering);
+    return info.pure && info.operators && info.variables;
+}
+
+int line(const Expr &expr)
+{
+    switch (expr.kind)
+    {
+    case ExprKind::Binary:
+        return static_cast<const Binary &>(expr).op.getLine();
+    case ExprKind::Unary:
+        return static_cast<const Unary &>(expr).op.getLine();
+    case ExprKind::Grouping:
+        return line(*static_cast<const Grouping &>(expr).expression);
+    case ExprKind::Variable:
+        return static_cast<const Variable &>(expr).name.getLine();
+    default:
+        return 0;
+    }
+}
+
+// A new temporary for the value of expr, named $0, $1, ... so it can't clash with a variable of the script
+Token temporary(const Expr &expr)
+{
+    static unsigned count = 0;
+    std::string name = "$" + std::to_string(count++);
+    uint32_t offset = Source::addSynthetic(name, line(expr));
+    return Token(TokenInfo::Type::IDENTIFIER, offset, static_cast<uint32_t>(name.size()));
+}
+
+void wrap(std::unique_ptr<Expr> &expr, Grouping::Temporary use, const Token &name)
+{
+    auto grouping = std::make_unique<Grouping>(std::move(expr));
+    grouping->temporary = use;
+    grouping->name = name;
+    expr = std::move(grouping);
+}
+
+// Replace the largest loop-invariant expressions in expr with temporaries of loop, the same one for equal ones
+void hoistWithin(std::unique_ptr<Expr> &expr, Numbering &numbering, std::unordered_map<uint32_t, Token> &names,
+                 While &loop)
+{
+    if (keepable(*expr, numbering))
+    {
+        uint32_t number = analyze(*expr, numbering).number;
+        auto found = names.find(number);
+        if (found == names.end())
+        {
+            found = names.emplace(number, temporary(*expr)).first;
+            loop.temporaries.push_back(found->second);
+        }
+        wrap(expr, Grouping::Temporary::REUSE, found->second);
+        return;
+    }
+    forEachOperand(*expr, [&](std::unique_ptr<Expr> &operand) { hoistWithin(operand, numbering, names, loop); });
+}
+
+// Which expressions of a statement to compute once and where: the first one that runs for sure stores its value,
+// the ones after it load it. All by value number.
+struct Sharing
+{
+    Numbering &numbering;
+    std::unordered_map<uint32_t, unsigned> counts;
+    std::unordered_set<uint32_t> stored;
+    std::unordered_map<uint32_t, unsigned> loads;
+    std::vector<std::tuple<std::unique_ptr<Expr> *, uint32_t, bool>> uses;
+};
+
+void countWithin(std::unique_ptr<Expr> &expr, Sharing &sharing)
+{
+    if (keepable(*expr, sharing.numbering))
+        sharing.counts[analyze(*expr, sharing.numbering).number]++;
+    forEachOperand(*expr, [&sharing](std::unique_ptr<Expr> &operand) { countWithin(operand, sharing); });
+}
+
+// conditional: inside and or or, where the operand may not run and a runtime error doesn't end the statement
+void placeWithin(std::unique_ptr<Expr> &expr, Sharing &sharing, bool conditional)
+{
+    if (keepable(*expr, sharing.numbering))
+    {
+        uint32_t number = analyze(*expr, sharing.numbering).number;
+        if (sharing.counts[number] > 1)
+        {
+            if (sharing.stored.count(number) != 0)
+            {
+                sharing.loads[number]++;
+                sharing.uses.emplace_back(&expr, number, false);
+                return;
+            }
+            if (!conditional)
+            {
+                sharing.stored.insert(number);
+                sharing.uses.emplace_back(&expr, number, true);
+                return;
+            }
+        }
+    }
+
+    conditional |= expr->kind == ExprKind::Logical;
+    forEachOperand(*expr, [&](std::unique_ptr<Expr> &operand) { placeWithin(operand, sharing, conditional); });
+}
+} // namespace
+
+void AstOptimizer::hoist(Stmt &stmt)
+{
+    forEachStmt(stmt, [](Stmt &nested) {
+        if (nested.kind == StmtKind::While)
+            hoistLoop(static_cast<While &>(nested));
+        else if (nested.kind == StmtKind::Function && static_cast<Function &>(nested).lazyBody == nullptr)
+        {
+            for (auto &bodyStmt : static_cast<Function &>(nested).body)
+                hoist(*bodyStmt);
+        }
+    });
+}
+
+void AstOptimizer::hoistLoop(While &loop)
+{
+    Effects changed;
+    scan(*loop.condition, changed);
+    scan(*loop.body, changed);
+    if (changed.calls)
+        return;
+
+    Numbering numbering{changed, {}, {}};
+    std::unordered_map<uint32_t, Token> names;
+    hoistWithin(loop.condition, numbering, names, loop);
+    forEachStmt(*loop.body, [&](Stmt &nested) {
+        forEachExpr(nested, [&](std::unique_ptr<Expr> &expr) { hoistWithin(expr, numbering, names, loop); });
+    });
+}
+
+void AstOptimizer::share(Stmt &stmt)
+{
+    forEachStmt(stmt, [](Stmt &nested) {
+        if (nested.kind == StmtKind::Function && static_cast<Function &>(nested).lazyBody == nullptr)
+        {
+            for (auto &bodyStmt : static_cast<Function &>(nested).body)
+                share(*bodyStmt);
+        }
+        forEachExpr(nested, [](std::unique_ptr<Expr> &expr) { shareWithin(expr); });
+    });
+}
+
+void AstOptimizer::shareWithin(std::unique_ptr<Expr> &expr)
+{
+    Effects changed;
+    scan(*expr, changed);
+    if (changed.calls)
+        return;
+
+    Numbering numbering{changed, {}, {}};
+    Sharing sharing{numbering, {}, {}, {}, {}};
+    countWithin(expr, sharing);
+    placeWithin(expr, sharing, false);
+
+    std::unordered_map<uint32_t, Token> names;
+    for (auto &[slot, number, store] : sharing.uses)
+    {
+        // Stored but never loaded again
+        if (sharing.loads[number] == 0)
+            continue;
+        auto found = names.find(number);
+        if (found == names.end())
+            found = names.emplace(number, temporary(**slot)).first;
+        wrap(*slot, store ? Grouping::Temporary::STORE : Grouping::Temporary::LOAD, found->second);
+    }
+}
+
+/* -------------------- INLINING -------------------- */
+
+namespace
+{
+// Calls f on every expression in stmt and the statements nested in it, in function bodies too (unless they are
+// parsed on their first call)
+template <typename F> void forEachExprDeep(Stmt &stmt, F &&f)
+{
+    forEachStmt(stmt, [&f](Stmt &nested) {
+        if (nested.kind == StmtKind::Function && static_cast<Function &>(nested).lazyBody == nullptr)
+        {
+            for (auto &bodyStmt : static_cast<Function &>(nested).body)
+                forEachExprDeep(*bodyStmt, f);
+        }
+        forEachExpr(nested, f);
+    });
+}
+
+// Calls f on expr and every expression in it, operands first
+template <typename F> void forEachNode(std::unique_ptr<Expr> &expr, F &&f)
+{
+    forEachOperand(*expr, [&f](std::unique_ptr<Expr> &operand) { forEachNode(operand, f); });
+    f(expr);
+}
+
+// The expression a call of function can be replaced with, nullptr if there isn't one within budget: its body has to
+// be just a return of an expression that calls nothing (so the function isn't recursive either) and assigns nothing
+Expr *inlinable(Function &function, unsigned budget)
+{
+    if (function.lazyBody != nullptr || function.body.size() != 1 || function.body[0]->kind != StmtKind::Return)
+        return nullptr;
+    auto &value = static_cast<Return &>(*function.body[0]).value;
+    if (value == nullptr || function.params.size() > Call::MAX_INLINED_PARAMS)
+        return nullptr;
+
+    std::unordered_set<std::string_view> params;
+    for (const Token &param : function.params)
+    {
+        if (!params.insert(param.getLexeme()).second)
+            return nullptr;
+    }
+
+    unsigned size = 0;
+    bool simple = true;
+    forEachNode(value, [&](std::unique_ptr<Expr> &node) {
+        size++;
+        simple &= node->kind != ExprKind::Call && node->kind != ExprKind::Assign;
+    });
+    return simple && size <= budget ? value.get() : nullptr;
+}
+} // namespace
+
+void AstOptimizer::inlineCalls(std::vector<std::unique_ptr<Stmt>> &statements)
+{
+    // Only a function declared once at the top level and never assigned is known to be what its name calls. The
+    // interpreter still checks it at every call: a later script (or a function parsed on its first call) could
+    // assign it, a local variable could shadow it.
+    std::unordered_map<std::string_view, unsigned> declared;
+    for (auto &stmt : statements)
+    {
+        if (stmt->kind == StmtKind::Var)
+            declared[static_cast<Var &>(*stmt).name.getLexeme()]++;
+        else if (stmt->kind == StmtKind::Function)
+            declared[static_cast<Function &>(*stmt).name.getLexeme()]++;
+    }
+
+    std::unordered_set<std::string_view> assigned;
+    for (auto &stmt : statements)
+    {
+        forEachExprDeep(*stmt, [&assigned](std::unique_ptr<Expr> &expr) {
+            forEachNode(expr, [&assigned](std::unique_ptr<Expr> &node) {
+                if (node->kind == ExprKind::Assign)
+                    assigned.insert(static_cast<Assign &>(*node).name.getLexeme());
+            });
+        });
+    }
+
+    std::unordered_map<std::string_view, std::pair<Function *, Expr *>> functions;
+    for (auto &stmt : statements)
+    {
+        if (stmt->kind != StmtKind::Function)
+            continue;
+        auto &function = static_cast<Function &>(*stmt);
+        std::string_view name = function.name.getLexeme();
+        if (declared[name] != 1 || assigned.count(name) != 0)
+            continue;
+        if (Expr *value = inlinable(function, Loxpp::options.inlineBudget))
+            functions.emplace(name, std::make_pair(&function, value));
+    }
+    if (functions.empty())
+        return;
+
+    for (auto &stmt : statements)
+    {
+        forEachExprDeep(*stmt, [&functions](std::unique_ptr<Expr> &expr) {
+            forEachNode(expr, [&functions](std::unique_ptr<Expr> &node) {
+                if (node->kind != ExprKind::Call)
+                    return;
+                auto &call = static_cast<Call &>(*node);
+                if (call.calleeVariable == nullptr)
+                    return;
+                auto found = functions.find(call.calleeVariable->name.getLexeme());
+                if (found == functions.end() || found->second.first->params.size() != call.arguments.size())
+                    return;
+                const Function &function = *found->second.first;
+
+                // Parameters are renamed to temporaries of this call, so the arguments of a call nested in another
+                // one's arguments don't overwrite them
+                std::unordered_map<std::string_view, Token> renamed;
+                call.inlinedParams.clear();
+                for (const Token &param : function.params)
+                {
+                    call.inlinedParams.push_back(temporary(*call.callee));
+                    renamed.emplace(param.getLexeme(), call.inlinedParams.back());
+                }
+
+                call.inlined = found->second.second->clone();
+                forEachNode(call.inlined, [&renamed](std::unique_ptr<Expr> &inner) {
+                    if (inner->kind != ExprKind::Variable)
+                        return;
+                    auto param = renamed.find(static_cast<Variable &>(*inner).name.getLexeme());
+                    if (param != renamed.end())
+                        wrap(inner, Grouping::Temporary::LOAD, param->second);
+                });
+                call.inlinedFunction = function.name;
+                call.inlinedCaches.assign(function.params.size(), LookupCache());
+
+                if (Loxpp::options.inlineReport)
+                    std::cerr << "[line " << call.paren.getLine() << "] Inlined call to '"
+                              << std::string(function.name.getLexeme()) << "'.\n";
+            });
+        });
+    }
+}
+
+/* -------------------- LAMBDA LIFTING -------------------- */
+
+namespace
+{
+// The names some code declares (how often), uses and assigns
+struct Names
+{
+    std::unordered_map<std::string_view, unsigned> declared;
+    // In the order they are first used, with the token of that use
+    std::vector<Token> used;
+    std::unordered_set<std::string_view> seen;
+    std::unordered_set<std::string_view> assigned;
+    // Some function in it is parsed on its first call, so what it uses is unknown
+    bool lazy = false;
+
+    void use(const Token &name)
+    {
+        if (seen.insert(name.getLexeme()).second)
+            used.push_back(name);
+    }
+};
+
+void collect(Expr &expr, Names &names)
+{
+    if (expr.kind == ExprKind::Variable)
+        names.use(static_cast<Variable &>(expr).name);
+    else if (expr.kind == ExprKind::Assign)
+    {
+        names.use(static_cast<Assign &>(expr).name);
+        names.assigned.insert(static_cast<Assign &>(expr).name.getLexeme());
+    }
+    else if (expr.kind == ExprKind::Call && static_cast<Call &>(expr).liftedFunction.getLength() != 0)
+    {
+        // Finds its function without the name
+        for (auto &argument : static_cast<Call &>(expr).arguments)
+            collect(*argument, names);
+        return;
+    }
+    forEachOperand(expr, [&names](std::unique_ptr<Expr> &operand) { collect(*operand, names); });
+}
+
+void collect(Stmt &stmt, Names &names);
+
+// The parameters and body of function, not its name (that belongs to the scope it is declared in)
+void collect(Function &function, Names &names)
+{
+    names.lazy |= function.lazyBody != nullptr;
+    for (const Token &param : function.params)
+        names.declared[param.getLexeme()]++;
+    for (auto &bodyStmt : function.body)
+        collect(*bodyStmt, names);
+}
+
+void collect(Stmt &stmt, Names &names)
+{
+    forEachStmt(stmt, [&names](Stmt &nested) {
+        if (nested.kind == StmtKind::Var)
+            names.declared[static_cast<Var &>(nested).name.getLexeme()]++;
+        else if (nested.kind == StmtKind::Function)
+        {
+            names.declared[static_cast<Function &>(nested).name.getLexeme()]++;
+            collect(static_cast<Function &>(nested), names);
+        }
+        forEachExpr(nested, [&names](std::unique_ptr<Expr> &expr) { collect(*expr, names); });
+    });
+}
+
+// A function declared in the global function being lifted from, with the scopes it is declared in: the body of
+// the global function first, down to the block holding the declaration. index is where in each the next one (or
+// the declaration) is.
+struct Frame
+{
+    std::vector<std::unique_ptr<Stmt>> *statements;
+    size_t index;
+};
+
+struct Nested
+{
+    Function *function;
+    std::vector<Frame> frames;
+};
+
+void findNested(std::vector<std::unique_ptr<Stmt>> &statements, std::vector<Frame> &frames,
+                std::vector<Nested> &found);
+
+// Only blocks make scopes, and declarations can only be in their statements (or a function body)
+void findNested(Stmt &stmt, std::vector<Frame> &frames, std::vector<Nested> &found)
+{
+    switch (stmt.kind)
+    {
+    case StmtKind::Block:
+        findNested(static_cast<Block &>(stmt).statements, frames, found);
+        break;
+    case StmtKind::If:
+        findNested(*static_cast<If &>(stmt).thenBranch, frames, found);
+        if (static_cast<If &>(stmt).elseBranch != nullptr)
+            findNested(*static_cast<If &>(stmt).elseBranch, frames, found);
+        break;
+    case StmtKind::While:
+        findNested(*static_cast<While &>(stmt).body, frames, found);
+        break;
+    case StmtKind::Function:
+        found.push_back({&static_cast<Function &>(stmt), frames});
+        break;
+    default:
+        break;
+    }
+}
+
+void findNested(std::vector<std::unique_ptr<Stmt>> &statements, std::vector<Frame> &frames,
+                std::vector<Nested> &found)
+{
+    frames.push_back({&statements, 0});
+    for (size_t i = 0; i < statements.size(); i++)
+    {
+        frames.back().index = i;
+        findNested(*statements[i], frames, found);
+    }
+    frames.pop_back();
+}
+
+// Index of the first statement declaring name in statements, statements.size() if none does
+size_t declaration(const std::vector<std::unique_ptr<Stmt>> &statements, std::string_view name)
+{
+    for (size_t i = 0; i < statements.size(); i++)
+    {
+        const Stmt &stmt = *statements[i];
+        if ((stmt.kind == StmtKind::Var && static_cast<const Var &>(stmt).name.getLexeme() == name) ||
+            (stmt.kind == StmtKind::Function && static_cast<const Function &>(stmt).name.getLexeme() == name))
+            return i;
+    }
+    return statements.size();
+}
+} // namespace
+
+void AstOptimizer::lift(Function &outer)
+{
+    Names all;
+    collect(outer, all);
+    if (all.lazy)
+        return;
+
+    std::vector<Frame> frames;
+    std::vector<Nested> found;
+    findNested(outer.body, frames, found);
+
+    // Nothing a nested function assigns can change while another one runs
+    std::unordered_set<std::string_view> assignedInFunctions;
+    for (auto &nested : found)
+    {
+        Names names;
+        collect(*nested.function, names);
+        assignedInFunctions.insert(names.assigned.begin(), names.assigned.end());
+    }
+
+    // In the order they are declared: calls a lifted function makes to one before it pass what that one captures,
+    // which the later one then captures in turn
+    for (auto &[function, path] : found)
+    {
+        std::string_view self = function->name.getLexeme();
+        Names inner;
+        collect(*function, inner);
+        // Only declared here and never assigned, so its name always means it
+        if (inner.declared.count(self) != 0 || all.declared[self] != 1 || all.assigned.count(self) != 0)
+            continue;
+
+        // The enclosing function's variables it uses: each has to be declared before it in the scope it is found
+        // in (so it is there whenever the function runs) and not be assigned while it runs
+        std::vector<Token> captured;
+        bool liftable = true;
+        for (const Token &name : inner.used)
+        {
+            std::string_view lexeme = name.getLexeme();
+            bool own = lexeme == self;
+            for (const Token &param : function->params)
+                own |= param.getLexeme() == lexeme;
+            if (own)
+                continue;
+
+            size_t depth = path.size();
+            size_t at = 0;
+            while (depth > 0)
+            {
+                at = declaration(*path[depth - 1].statements, lexeme);
+                if (at < path[depth - 1].statements->size())
+                    break;
+                depth--;
+            }
+            bool param = false;
+            for (const Token &outerParam : outer.params)
+                param |= outerParam.getLexeme() == lexeme;
+            if (depth == 0 && !param)
+                continue; // A global
+            if (depth > 0 && at >= path[depth - 1].index)
+                liftable = false;
+
+            liftable &= assignedInFunctions.count(lexeme) == 0 && inner.declared.count(lexeme) == 0;
+            captured.push_back(name);
+        }
+        if (!liftable || captured.size() > MAX_CAPTURED)
+            continue;
+
+        // The uses of its name after it in its scope, and in itself. Before it only code in a function could find
+        // it, since that can run later.
+        Frame &scope = path.back();
+        Names before, after;
+        for (size_t i = 0; i < scope.index; i++)
+        {
+            forEachStmt(*(*scope.statements)[i], [&before](Stmt &nested) {
+                if (nested.kind == StmtKind::Function)
+                    collect(static_cast<Function &>(nested), before);
+            });
+        }
+        for (size_t i = scope.index + 1; i < scope.statements->size(); i++)
+        {
+            Stmt &stmt = *(*scope.statements)[i];
+            if (stmt.kind == StmtKind::Function)
+                collect(static_cast<Function &>(stmt), after);
+            else if (stmt.kind != StmtKind::Var)
+                collect(stmt, after);
+        }
+
+        std::vector<Call *> calls;
+        unsigned uses = 0;
+        auto find = [&](std::unique_ptr<Expr> &expr) {
+            forEachNode(expr, [&](std::unique_ptr<Expr> &node) {
+                if (node->kind == ExprKind::Variable && static_cast<Variable &>(*node).name.getLexeme() == self)
+                    uses++;
+                else if (node->kind == ExprKind::Call && static_cast<Call &>(*node).calleeVariable != nullptr &&
+                         static_cast<Call &>(*node).calleeVariable->name.getLexeme() == self &&
+                         static_cast<Call &>(*node).liftedFunction.getLength() == 0)
+                    calls.push_back(&static_cast<Call &>(*node));
+            });
+        };
+        for (size_t i = scope.index + 1; i < scope.statements->size(); i++)
+            forEachExprDeep(*(*scope.statements)[i], find);
+        for (auto &bodyStmt : function->body)
+            forEachExprDeep(*bodyStmt, find);
+
+        // Every use a call that can do without the name, then the name doesn't have to be bound at all. Calls
+        // pass what the function captures, as found where they are: nothing in between may declare it again.
+        bool onlyCalls = uses == calls.size() && before.seen.count(self) == 0 && !after.lazy;
+        for (Call *call : calls)
+            onlyCalls &= captured.empty() || call->arguments.size() == function->params.size();
+        for (const Token &name : captured)
+            onlyCalls &= after.declared.count(name.getLexeme()) == 0;
+        if (!captured.empty() && !onlyCalls)
+            continue;
+
+        function->lifted = true;
+        function->bindsName = !onlyCalls;
+        for (const Token &name : captured)
+            function->params.push_back(name);
+        if (!onlyCalls)
+            continue;
+        for (Call *call : calls)
+        {
+            call->liftedFunction = function->name;
+            for (const Token &name : captured)
+            {
+                // Read as it is, so a variable that isn't initialized yet only fails where the function reads it
+                call->arguments.push_back(std::make_unique<Variable>(name));
+                wrap(call->arguments.back(), Grouping::Temporary::LOAD, name);
+            }
+        }
+    }
+}
@@ -11,7 +11,7 @@ void AstPrinter::visitBinaryExpr(const Binary &expr)
 {
     // Call print again on the left and right expressions to recursively print them if they are also other types of
     // expressions. E.g. ( 2 + 3 ) + 4 where 2 + 3 is also a binary expression
-    result += "( " + expr.op.getLexeme() + " ";
+    result += "( " + std::string(expr.op.getLexeme()) + " ";
 
     // Left expression
     setPrintResult(expr.left);
@@ -29,7 +29,7 @@ void AstPrinter::visitBinaryExpr(const Binary &expr)
 
 void AstPrinter::visitUnaryExpr(const Unary &expr)
 {
-    result += "( " + expr.op.getLexeme() + " ";
+    result += "( " + std::string(expr.op.getLexeme()) + " ";
     setPrintResult(expr.right);
     result += " )";
 }
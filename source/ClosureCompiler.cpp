@@ -0,0 +1,601 @@
+#include "headers/ClosureCompiler.hpp"
+#include "headers/ClosureInterpreter.hpp"
+#include "headers/Loxpp.hpp"
+#include "headers/Operators.hpp"
+#include "headers/RuntimeError.hpp"
+#include <iostream>
+#include <utility>
+
+std::vector<StmtCode> ClosureCompiler::compileProgram(const std::vector<std::unique_ptr<Stmt>> &statements)
+{
+    ClosureCompiler compiler;
+    return compiler.compileList(statements);
+}
+
+std::vector<StmtCode> ClosureCompiler::compileBody(const Function &declaration,
+                                                   const std::vector<std::string_view> &params)
+{
+    // The body runs right in the environment of the call, which holds the parameters
+    ClosureCompiler compiler;
+    compiler.scopes.push_back({&params, {}});
+    return compiler.compileList(declaration.getBody());
+}
+
+static bool isOperator(const Expr &expr)
+{
+    return expr.kind == ExprKind::Binary || expr.kind == ExprKind::Unary || expr.kind == ExprKind::Grouping;
+}
+
+// Whether operators in expr are nested more than depth levels deep. Only walks the operators, without recursion.
+static bool deeperThan(const Expr &expr, int depth)
+{
+    std::vector<std::pair<const Expr *, int>> pending = {{&expr, 0}};
+    while (!pending.empty())
+    {
+        auto [node, level] = pending.back();
+        pending.pop_back();
+        if (!isOperator(*node))
+            continue;
+        if (level > depth)
+            return true;
+
+        switch (node->kind)
+        {
+        case ExprKind::Binary:
+            pending.push_back({static_cast<const Binary *>(node)->left.get(), level + 1});
+            pending.push_back({static_cast<const Binary *>(node)->right.get(), level + 1});
+            break;
+        case ExprKind::Unary:
+            pending.push_back({static_cast<const Unary *>(node)->right.get(), level + 1});
+            break;
+        default:
+            pending.push_back({static_cast<const Grouping *>(node)->expression.get(), level + 1});
+            break;
+        }
+    }
+    return false;
+}
+
+ExprCode ClosureCompiler::compile(const std::unique_ptr<Expr> &expr)
+{
+    if (expr == nullptr)
+        return nullptr;
+    if (isOperator(*expr) && deeperThan(*expr, MAX_OPERATOR_DEPTH))
+        return compileOperators(*expr);
+    return expr->accept(*this);
+}
+
+ExprCode ClosureCompiler::compileOperand(const std::unique_ptr<Expr> &expr)
+{
+    // Operators below a shallow one are shallow too, no need to measure them again
+    if (isOperator(*expr))
+        return expr->accept(*this);
+    return compile(expr);
+}
+
+ExprCode ClosureCompiler::compileOperators(const Expr &expr)
+{
+    // Pushes the value of operand if it is set, otherwise applies op to the value (or two) on top of the stack. op
+    // points into the tree, which stays alive in ClosureInterpreter::programs.
+    struct Step
+    {
+        ExprCode operand;
+        const Token *op;
+        bool binary;
+    };
+    std::vector<Step> steps;
+
+    // Steps are in the order the visitors would run them: left operand, right operand, then the operator. The right
+    // operand goes on the walk's stack under the left one, and the operator under both.
+    std::vector<std::pair<const Expr *, bool>> pending = {{&expr, false}};
+    while (!pending.empty())
+    {
+        auto [node, apply] = pending.back();
+        pending.pop_back();
+
+        switch (node->kind)
+        {
+        case ExprKind::Grouping:
+            pending.push_back({static_cast<const Grouping *>(node)->expression.get(), false});
+            break;
+
+        case ExprKind::Unary: {
+            auto unary = static_cast<const Unary *>(node);
+            if (apply)
+            {
+                steps.push_back({nullptr, &unary->op, false});
+                break;
+            }
+            pending.push_back({node, true});
+            pending.push_back({unary->right.get(), false});
+            break;
+        }
+
+        case ExprKind::Binary: {
+            auto binary = static_cast<const Binary *>(node);
+            if (apply)
+            {
+                steps.push_back({nullptr, &binary->op, true});
+                break;
+            }
+            pending.push_back({node, true});
+            pending.push_back({binary->right.get(), false});
+            pending.push_back({binary->left.get(), false});
+            break;
+        }
+
+        default:
+            steps.push_back({node->accept(*this), nullptr, false});
+            break;
+        }
+    }
+
+    return [steps = std::move(steps)](ClosureInterpreter &interpreter) {
+        std::vector<Value> values;
+        for (const Step &step : steps)
+        {
+            if (step.operand)
+            {
+                values.push_back(step.operand(interpreter));
+                continue;
+            }
+
+            Value value;
+            if (step.binary)
+            {
+                Value right = std::move(values.back());
+                values.pop_back();
+                if (const char *error = Operators::binary(step.op->getType(), values.back(), right, value))
+                    throw RuntimeError(*step.op, error);
+            }
+            else if (const char *error = Operators::unary(step.op->getType(), values.back(), value))
+                throw RuntimeError(*step.op, error);
+            values.back() = std::move(value);
+        }
+        return values.back();
+    };
+}
+
+StmtCode ClosureCompiler::compile(const std::unique_ptr<Stmt> &stmt)
+{
+    if (stmt == nullptr)
+        return nullptr;
+    return stmt->accept(*this);
+}
+
+std::vector<StmtCode> ClosureCompiler::compileList(const std::vector<std::unique_ptr<Stmt>> &statements)
+{
+    std::vector<StmtCode> code;
+    for (const auto &stmt : statements)
+        code.push_back(compile(stmt));
+    return code;
+}
+
+ClosureCompiler::Resolved ClosureCompiler::resolve(std::string_view name) const
+{
+    // Statements of a function run in order, so a name declared before this point in one of its environments is
+    // there when this code runs, and nothing in between can have declared it since.
+    for (size_t i = scopes.size(); i-- > 0;)
+    {
+        const Scope &scope = scopes[i];
+        int hops = static_cast<int>(scopes.size() - 1 - i);
+
+        // From the back, like Environment::findSlot. A var redeclaring a parameter replaces it in its slot.
+        if (scope.params != nullptr)
+        {
+            for (size_t slot = scope.params->size(); slot-- > 0;)
+            {
+                if ((*scope.params)[slot] == name)
+                    return {hops, static_cast<int>(slot)};
+            }
+        }
+
+        for (std::string_view declared : scope.names)
+        {
+            if (declared == name)
+                return {hops, -1};
+        }
+    }
+
+    return {};
+}
+
+void ClosureCompiler::declare(std::string_view name)
+{
+    // Globals are looked up by name anyway
+    if (!scopes.empty())
+        scopes.back().names.push_back(name);
+}
+
+Environment *ClosureCompiler::ancestor(Environment *env, int hops)
+{
+    for (; hops > 0; hops--)
+        env = env->enclosing.get();
+    return env;
+}
+
+/* -------------------- EXPRESSIONS -------------------- */
+
+// The code of subexpressions and statements is moved into the closures that run it, never copied: copying a
+// std::function copies everything it captured, so each level would copy the whole tree below it again.
+
+ExprCode ClosureCompiler::visitLiteralExpr(const Literal &expr)
+{
+    Value value = {expr.type == TokenInfo::Type::NIL ? nullptr : expr.value, expr.type};
+    return [value](ClosureInterpreter &) { return value; };
+}
+
+ExprCode ClosureCompiler::visitGroupingExpr(const Grouping &expr)
+{
+    // Nothing to do at run time, the grouping is the expression inside it
+    return compileOperand(expr.expression);
+}
+
+ExprCode ClosureCompiler::visitVariableExpr(const Variable &expr)
+{
+    Token name = expr.name;
+    Resolved resolved = resolve(name.getLexeme());
+
+    if (resolved.hops < 0)
+    {
+        return [name, cache = LookupCache()](ClosureInterpreter &interpreter) mutable -> Value {
+            Value &value = interpreter.environment->lookup(name, cache);
+            if (value.second == TokenInfo::Type::UNINITIALIZED)
+                throw RuntimeError(name, "Variable used before being initialized.");
+            return value;
+        };
+    }
+
+    if (resolved.slot >= 0)
+    {
+        return [name, resolved](ClosureInterpreter &interpreter) -> Value {
+            Value &value = ancestor(interpreter.environment.get(), resolved.hops)->slot(resolved.slot);
+            if (value.second == TokenInfo::Type::UNINITIALIZED)
+                throw RuntimeError(name, "Variable used before being initialized.");
+            return value;
+        };
+    }
+
+    std::string lexeme(name.getLexeme());
+    return [name, resolved, lexeme](ClosureInterpreter &interpreter) -> Value {
+        Value *value = ancestor(interpreter.environment.get(), resolved.hops)->findHere(lexeme);
+        if (value == nullptr)
+            throw RuntimeError(name, "Undefined variable '" + lexeme + "'.");
+        if (value->second == TokenInfo::Type::UNINITIALIZED)
+            throw RuntimeError(name, "Variable used before being initialized.");
+        return *value;
+    };
+}
+
+ExprCode ClosureCompiler::visitAssignExpr(const Assign &expr)
+{
+    Token name = expr.name;
+    ExprCode value = compile(expr.value);
+    Resolved resolved = resolve(name.getLexeme());
+
+    if (resolved.hops < 0)
+    {
+        return [name, value = std::move(value),
+                cache = LookupCache()](ClosureInterpreter &interpreter) mutable -> Value {
+            Value result = value(interpreter);
+            interpreter.environment->lookup(name, cache) = result;
+            return result;
+        };
+    }
+
+    if (resolved.slot >= 0)
+    {
+        return [value = std::move(value), resolved](ClosureInterpreter &interpreter) -> Value {
+            Value result = value(interpreter);
+            ancestor(interpreter.environment.get(), resolved.hops)->slot(resolved.slot) = result;
+            return result;
+        };
+    }
+
+    std::string lexeme(name.getLexeme());
+    return [name, value = std::move(value), resolved, lexeme](ClosureInterpreter &interpreter) -> Value {
+        Value result = value(interpreter);
+        Value *binding = ancestor(interpreter.environment.get(), resolved.hops)->findHere(lexeme);
+        if (binding == nullptr)
+            throw RuntimeError(name, "Undefined variable '" + lexeme + "'.");
+        *binding = result;
+        return result;
+    };
+}
+
+ExprCode ClosureCompiler::visitUnaryExpr(const Unary &expr)
+{
+    Token op = expr.op;
+    ExprCode right = compileOperand(expr.right);
+
+    switch (op.getType())
+    {
+    case TokenInfo::Type::BANG:
+        return [right = std::move(right)](ClosureInterpreter &interpreter) {
+            Value value = right(interpreter);
+            return Operators::boolean(!Operators::isTruthy(value.first, value.second));
+        };
+
+    default:
+        return [op, right = std::move(right)](ClosureInterpreter &interpreter) {
+            Value value;
+            if (const char *error = Operators::unary(op.getType(), right(interpreter), value))
+                throw RuntimeError(op, error);
+            return value;
+        };
+    }
+}
+
+// An operator with a fast path for two numbers. apply computes the value, or returns false to leave it (and its error,
+// e.g. division by zero) to Operators::binary, which also handles every other combination of operands.
+template <typename Apply> static ExprCode numberOperator(ExprCode left, ExprCode right, Token op, Apply apply)
+{
+    return [left = std::move(left), right = std::move(right), op, apply](ClosureInterpreter &interpreter) {
+        Value leftValue = left(interpreter);
+        Value rightValue = right(interpreter);
+
+        Value value;
+        if (leftValue.second == TokenInfo::Type::NUMBER && rightValue.second == TokenInfo::Type::NUMBER &&
+            apply(*static_cast<double *>(leftValue.first.get()), *static_cast<double *>(rightValue.first.get()), value))
+            return value;
+
+        if (const char *error = Operators::binary(op.getType(), leftValue, rightValue, value))
+            throw RuntimeError(op, error);
+        return value;
+    };
+}
+
+static Value number(double value)
+{
+    return {std::make_shared<double>(value), TokenInfo::Type::NUMBER};
+}
+
+ExprCode ClosureCompiler::visitBinaryExpr(const Binary &expr)
+{
+    Token op = expr.op;
+    ExprCode left = compileOperand(expr.left);
+    ExprCode right = compileOperand(expr.right);
+
+    switch (op.getType())
+    {
+    case TokenInfo::Type::PLUS:
+        return numberOperator(std::move(left), std::move(right), op, [](double a, double b, Value &value) {
+            value = number(a + b);
+            return true;
+        });
+    case TokenInfo::Type::MINUS:
+        return numberOperator(std::move(left), std::move(right), op, [](double a, double b, Value &value) {
+            value = number(a - b);
+            return true;
+        });
+    case TokenInfo::Type::STAR:
+        return numberOperator(std::move(left), std::move(right), op, [](double a, double b, Value &value) {
+            value = number(a * b);
+            return true;
+        });
+    case TokenInfo::Type::SLASH:
+        return numberOperator(std::move(left), std::move(right), op, [](double a, double b, Value &value) {
+            if (b == 0)
+                return false;
+            value = number(a / b);
+            return true;
+        });
+
+    case TokenInfo::Type::GREATER:
+        return numberOperator(std::move(left), std::move(right), op, [](double a, double b, Value &value) {
+            value = Operators::boolean(a > b);
+            return true;
+        });
+    case TokenInfo::Type::GREATER_EQUAL:
+        return numberOperator(std::move(left), std::move(right), op, [](double a, double b, Value &value) {
+            value = Operators::boolean(a >= b);
+            return true;
+        });
+    case TokenInfo::Type::LESS:
+        return numberOperator(std::move(left), std::move(right), op, [](double a, double b, Value &value) {
+            value = Operators::boolean(a < b);
+            return true;
+        });
+    case TokenInfo::Type::LESS_EQUAL:
+        return numberOperator(std::move(left), std::move(right), op, [](double a, double b, Value &value) {
+            value = Operators::boolean(a <= b);
+            return true;
+        });
+
+    case TokenInfo::Type::EQUAL_EQUAL:
+    case TokenInfo::Type::BANG_EQUAL: {
+        bool equal = op.getType() == TokenInfo::Type::EQUAL_EQUAL;
+        return [left = std::move(left), right = std::move(right), equal](ClosureInterpreter &interpreter) {
+            Value leftValue = left(interpreter);
+            Value rightValue = right(interpreter);
+            return Operators::boolean(
+                Operators::isEqual(leftValue.first, rightValue.first, leftValue.second, rightValue.second) == equal);
+        };
+    }
+
+    default:
+        return numberOperator(std::move(left), std::move(right), op, [](double, double, Value &) { return false; });
+    }
+}
+
+ExprCode ClosureCompiler::visitLogicalExpr(const Logical &expr)
+{
+    ExprCode left = compile(expr.left);
+    ExprCode right = compile(expr.right);
+    bool isOr = expr.op.getType() == TokenInfo::Type::OR;
+
+    return [left = std::move(left), right = std::move(right), isOr](ClosureInterpreter &interpreter) {
+        Value leftValue;
+        interpreter.evaluateReported(left, leftValue);
+
+        // Short circuit: "or" stops at the first truthy operand, "and" at the first falsy one
+        if (Operators::isTruthy(leftValue.first, leftValue.second) == isOr)
+            return leftValue;
+
+        Value rightValue;
+        interpreter.evaluateReported(right, rightValue);
+        return rightValue;
+    };
+}
+
+ExprCode ClosureCompiler::visitCallExpr(const Call &expr)
+{
+    Token paren = expr.paren;
+    ExprCode callee = compile(expr.callee);
+    std::vector<ExprCode> arguments;
+    for (const auto &argument : expr.arguments)
+        arguments.push_back(compile(argument));
+
+    return [paren, callee = std::move(callee), arguments = std::move(arguments)](ClosureInterpreter &interpreter) {
+        Value calleeValue = callee(interpreter);
+        if (calleeValue.second != TokenInfo::Type::FUN && calleeValue.second != TokenInfo::Type::CLASS)
+            throw RuntimeError(paren, "Can only call functions and classes.");
+
+        // Keep the callee alive until the call is done
+        auto function = std::static_pointer_cast<ClosureFunction>(calleeValue.first);
+        const CompiledFunction &code = *function->code;
+        auto funcEnv = std::make_shared<Environment>(function->closure, code.paramNames, code.paramBits);
+
+        // Evaluate argument expressions straight into the parameter slots. Extra ones are still evaluated (for their
+        // errors and side effects) before the arity check.
+        for (size_t i = 0; i < arguments.size(); i++)
+        {
+            Value argument = arguments[i](interpreter);
+            if (i < funcEnv->slotCount())
+                funcEnv->slot(i) = std::move(argument);
+        }
+
+        size_t arity = code.declaration->params.size();
+        if (arguments.size() != arity)
+            throw RuntimeError(paren, "Expected " + std::to_string(arity) + " arguments but got " +
+                                          std::to_string(arguments.size()) + ".");
+
+        if (interpreter.callStack.full(Loxpp::options.maxDepth))
+            throw RuntimeError(paren, "Stack overflow.");
+        CallStack::Frame frame(interpreter.callStack, {function.get(), paren.getOffset()});
+
+        return interpreter.call(*function, funcEnv);
+    };
+}
+
+/* -------------------- STATEMENTS -------------------- */
+
+StmtCode ClosureCompiler::visitExpressionStmt(const Expression &stmt)
+{
+    ExprCode expression = compile(stmt.expression);
+    return [expression = std::move(expression)](ClosureInterpreter &interpreter) {
+        Value value;
+        interpreter.evaluateReported(expression, value);
+        return Completion::NORMAL;
+    };
+}
+
+StmtCode ClosureCompiler::visitPrintStmt(const Print &stmt)
+{
+    ExprCode expression = compile(stmt.expression);
+    return [expression = std::move(expression)](ClosureInterpreter &interpreter) {
+        Value value;
+        if (interpreter.evaluateReported(expression, value))
+            std::cout << Operators::stringify(value.first, value.second) << "\n";
+        return Completion::NORMAL;
+    };
+}
+
+StmtCode ClosureCompiler::visitVarStmt(const Var &stmt)
+{
+    // Compiled before the name is declared, var a = a; reads the a from outside
+    ExprCode initializer = compile(stmt.initializer);
+    std::string name(stmt.name.getLexeme());
+    declare(stmt.name.getLexeme());
+
+    return [initializer = std::move(initializer), name](ClosureInterpreter &interpreter) {
+        Value value = {nullptr, TokenInfo::Type::UNINITIALIZED};
+        if (initializer)
+            value = initializer(interpreter);
+
+        interpreter.environment->defineVar(name, value.first, value.second);
+        return Completion::NORMAL;
+    };
+}
+
+StmtCode ClosureCompiler::visitBlockStmt(const Block &stmt)
+{
+    scopes.emplace_back();
+    std::vector<StmtCode> statements = compileList(stmt.statements);
+    scopes.pop_back();
+
+    return [statements = std::move(statements)](ClosureInterpreter &interpreter) {
+        return interpreter.executeBlock(statements, std::make_shared<Environment>(interpreter.environment));
+    };
+}
+
+StmtCode ClosureCompiler::visitIfStmt(const If &stmt)
+{
+    ExprCode condition = compile(stmt.condition);
+    StmtCode thenBranch = compile(stmt.thenBranch);
+    StmtCode elseBranch = compile(stmt.elseBranch);
+
+    return [condition = std::move(condition), thenBranch = std::move(thenBranch),
+            elseBranch = std::move(elseBranch)](ClosureInterpreter &interpreter) {
+        Value value;
+        interpreter.evaluateReported(condition, value);
+
+        if (Operators::isTruthy(value.first, value.second))
+            return thenBranch(interpreter);
+        if (elseBranch)
+            return elseBranch(interpreter);
+        return Completion::NORMAL;
+    };
+}
+
+StmtCode ClosureCompiler::visitWhileStmt(const While &stmt)
+{
+    ExprCode condition = compile(stmt.condition);
+    StmtCode body = compile(stmt.body);
+
+    return [condition = std::move(condition), body = std::move(body)](ClosureInterpreter &interpreter) {
+        Value value;
+        interpreter.evaluateReported(condition, value);
+        while (Operators::isTruthy(value.first, value.second))
+        {
+            Completion completion = body(interpreter);
+            if (completion == Completion::BREAK)
+                break;
+            if (completion == Completion::RETURN)
+                return completion;
+
+            interpreter.evaluateReported(condition, value);
+        }
+        return Completion::NORMAL;
+    };
+}
+
+StmtCode ClosureCompiler::visitBreakStmt(const Break &)
+{
+    return [](ClosureInterpreter &) { return Completion::BREAK; };
+}
+
+StmtCode ClosureCompiler::visitReturnStmt(const Return &stmt)
+{
+    ExprCode value = compile(stmt.value);
+    return [value = std::move(value)](ClosureInterpreter &interpreter) {
+        interpreter.returnValue = {nullptr, TokenInfo::Type::NIL};
+        if (value)
+            interpreter.evaluateReported(value, interpreter.returnValue);
+        return Completion::RETURN;
+    };
+}
+
+StmtCode ClosureCompiler::visitFunctionStmt(const Function &stmt)
+{
+    // The body is compiled on the first call, the declaration stays alive in ClosureInterpreter::programs
+    auto code = std::make_shared<CompiledFunction>(stmt);
+    std::string name(stmt.name.getLexeme());
+    declare(stmt.name.getLexeme());
+
+    return [code, name](ClosureInterpreter &interpreter) {
+        auto function = std::make_shared<ClosureFunction>(ClosureFunction{code, interpreter.environment});
+        interpreter.environment->defineVar(name, function, TokenInfo::Type::FUN);
+        return Completion::NORMAL;
+    };
+}
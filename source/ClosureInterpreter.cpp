@@ -0,0 +1,82 @@
+#include "headers/ClosureInterpreter.hpp"
+#include "headers/Loxpp.hpp"
+#include "headers/RuntimeError.hpp"
+
+CompiledFunction::CompiledFunction(const Function &declaration) : declaration(&declaration)
+{
+    auto names = std::make_shared<std::vector<std::string_view>>();
+    for (const Token &param : declaration.params)
+    {
+        names->push_back(param.getLexeme());
+        paramBits |= Environment::nameBit(names->back());
+    }
+    paramNames = std::move(names);
+}
+
+void ClosureInterpreter::interpret(std::vector<std::unique_ptr<Stmt>> statements)
+{
+    std::vector<StmtCode> code = ClosureCompiler::compileProgram(statements);
+    programs.push_back(std::move(statements));
+
+    try
+    {
+        for (const StmtCode &statement : code)
+            statement(*this);
+    }
+    catch (RuntimeError &error)
+    {
+        Loxpp::runtimeError(error);
+    }
+}
+
+bool ClosureInterpreter::evaluateReported(const ExprCode &expr, Value &value)
+{
+    try
+    {
+        value = expr(*this);
+        return true;
+    }
+    catch (RuntimeError &error)
+    {
+        Loxpp::runtimeError(error);
+        value = {nullptr, TokenInfo::Type::NIL};
+        return false;
+    }
+}
+
+Completion ClosureInterpreter::executeBlock(const std::vector<StmtCode> &statements,
+                                            const std::shared_ptr<Environment> &localEnv)
+{
+    std::shared_ptr<Environment> previous = environment;
+    environment = localEnv;
+
+    Completion completion = Completion::NORMAL;
+    try
+    {
+        for (size_t i = 0; i < statements.size() && completion == Completion::NORMAL; i++)
+            completion = statements[i](*this);
+    }
+    catch (RuntimeError &error)
+    {
+        // Like AstInterpreter::executeBlock, an error escaping a block only abandons the block.
+        completion = Completion::NORMAL;
+    }
+
+    environment = previous;
+    return completion;
+}
+
+Value ClosureInterpreter::call(const ClosureFunction &function, const std::shared_ptr<Environment> &funcEnv)
+{
+    CompiledFunction &code = *function.code;
+    if (!code.compiled)
+    {
+        code.body = ClosureCompiler::compileBody(*code.declaration, *code.paramNames);
+        code.compiled = true;
+    }
+
+    if (executeBlock(code.body, funcEnv) == Completion::RETURN)
+        return std::move(returnValue);
+
+    return {nullptr, TokenInfo::Type::NIL};
+}
@@ -0,0 +1,405 @@
+#include "headers/CppEmitter.hpp"
+#include "headers/Source.hpp"
+#include <cstdio>
+
+std::string CppEmitter::emit(const std::vector<std::unique_ptr<Stmt>> &statements, uint32_t base, unsigned maxDepth)
+{
+    CppEmitter emitter(base);
+
+    // Top-level statements, an error escaping one ends the program (see LoxRuntime::main)
+    std::ostringstream program;
+    emitter.out = &program;
+    emitter.env = emitter.name('e');
+    emitter.line("static void program(const LoxRuntime::Env &" + emitter.env + ")");
+    emitter.open();
+    for (const auto &stmt : statements)
+    {
+        emitter.statementEnd = emitter.name('s');
+        emitter.executeNested(stmt);
+        if (emitter.returnsAtTop)
+            emitter.line(emitter.statementEnd + ":;");
+        emitter.returnsAtTop = false;
+    }
+    emitter.close();
+
+    std::ostringstream file;
+    file << "// Generated by loxpp --emit-cpp. Build it against the Lox++ runtime (make runtime):\n"
+         << "// g++ -O2 -std=c++17 -I source/headers program.cpp build/lib/libloxrt.a -pthread\n"
+         << "#include \"LoxRuntime.hpp\"\n\n"
+         << "static const char *SOURCE = " << quote(Source::text(base)) << ";\n\n"
+         << emitter.constants.str() << "\n"
+         << emitter.prototypes.str() << "\n"
+         << emitter.functions.str() << program.str() << "\n"
+         << "int main()\n"
+         << "{\n"
+         << "    return LoxRuntime::main(SOURCE, " << maxDepth << ", program);\n"
+         << "}\n";
+    return file.str();
+}
+
+std::string CppEmitter::quote(const std::string &text)
+{
+    std::string quoted = "\"";
+    for (unsigned char c : text)
+    {
+        if (c == '"' || c == '\\')
+        {
+            quoted += '\\';
+            quoted += static_cast<char>(c);
+        }
+        else if (c == '\n')
+            quoted += "\\n\"\n    \""; // One line of the source per line of C++
+        else if (c < 0x20 || c >= 0x7F)
+        {
+            // Always three octal digits, so a digit following it can't be taken as part of it
+            char escape[5];
+            std::snprintf(escape, sizeof(escape), "\\%03o", c);
+            quoted += escape;
+        }
+        else
+            quoted += static_cast<char>(c);
+    }
+    return quoted + "\"";
+}
+
+std::string CppEmitter::name(char prefix)
+{
+    return prefix + std::to_string(nextName++);
+}
+
+std::string CppEmitter::token(const Token &token)
+{
+    // One constant per token, however often it is used
+    auto found = tokens.find(token.getOffset());
+    if (found != tokens.end())
+        return found->second;
+
+    std::string constant = name('t');
+    constants << "static const Token " << constant << "(TokenInfo::Type(" << static_cast<int>(token.getType())
+              << "), " << token.getOffset() - base << ", " << token.getLength() << ");\n";
+    tokens.emplace(token.getOffset(), constant);
+    return constant;
+}
+
+void CppEmitter::line(const std::string &text)
+{
+    *out << std::string(depth * 4, ' ') << text << "\n";
+}
+
+void CppEmitter::open()
+{
+    line("{");
+    depth++;
+}
+
+void CppEmitter::close()
+{
+    depth--;
+    line("}");
+}
+
+std::string CppEmitter::evaluate(const std::unique_ptr<Expr> &expr)
+{
+    return expr->accept(*this);
+}
+
+void CppEmitter::evaluateReported(const std::unique_ptr<Expr> &expr, const std::string &target)
+{
+    line("try");
+    open();
+    line(target + " = " + evaluate(expr) + ";");
+    close();
+    catchReported(target);
+}
+
+void CppEmitter::catchReported(const std::string &target)
+{
+    line("catch (RuntimeError &error)");
+    open();
+    line("LoxRuntime::report(error);");
+    if (!target.empty())
+        line(target + " = LoxRuntime::nil();");
+    close();
+}
+
+void CppEmitter::execute(const std::unique_ptr<Stmt> &stmt)
+{
+    stmt->accept(*this);
+}
+
+void CppEmitter::executeNested(const std::unique_ptr<Stmt> &stmt)
+{
+    open();
+    execute(stmt);
+    close();
+}
+
+/* -------------------- EXPRESSIONS -------------------- */
+
+std::string CppEmitter::visitLiteralExpr(const Literal &expr)
+{
+    std::string constant = name('k');
+    constants << "static const Value " << constant << " = {";
+
+    switch (expr.type)
+    {
+    case TokenInfo::Type::NUMBER: {
+        // Hexadecimal, so the double comes back bit for bit
+        char number[40];
+        std::snprintf(number, sizeof(number), "%a", *std::static_pointer_cast<double>(expr.value));
+        constants << "std::make_shared<double>(" << number << ")";
+        break;
+    }
+    case TokenInfo::Type::STRING:
+        constants << "std::make_shared<std::string>(" << quote(*std::static_pointer_cast<std::string>(expr.value))
+                  << ")";
+        break;
+    default:
+        // true / false / nil literals have no data, see Parser::primary
+        constants << "nullptr";
+        break;
+    }
+
+    constants << ", TokenInfo::Type(" << static_cast<int>(expr.type) << ")};\n";
+    return constant;
+}
+
+std::string CppEmitter::visitGroupingExpr(const Grouping &expr)
+{
+    return evaluate(expr.expression);
+}
+
+std::string CppEmitter::visitVariableExpr(const Variable &expr)
+{
+    std::string cache = name('c');
+    constants << "static LookupCache " << cache << ";\n";
+
+    std::string value = name('v');
+    line("Value " + value + " = LoxRuntime::get(" + env + ", " + token(expr.name) + ", " + cache + ");");
+    return value;
+}
+
+std::string CppEmitter::visitAssignExpr(const Assign &expr)
+{
+    std::string value = evaluate(expr.value);
+    line("LoxRuntime::assign(" + env + ", " + token(expr.name) + ", " + value + ");");
+    return value;
+}
+
+std::string CppEmitter::visitUnaryExpr(const Unary &expr)
+{
+    std::string right = evaluate(expr.right);
+    std::string value = name('v');
+    line("Value " + value + " = LoxRuntime::unary(" + token(expr.op) + ", " + right + ");");
+    return value;
+}
+
+std::string CppEmitter::visitBinaryExpr(const Binary &expr)
+{
+    std::string left = evaluate(expr.left);
+    std::string right = evaluate(expr.right);
+    std::string value = name('v');
+    line("Value " + value + " = LoxRuntime::binary(" + token(expr.op) + ", " + left + ", " + right + ");");
+    return value;
+}
+
+std::string CppEmitter::visitLogicalExpr(const Logical &expr)
+{
+    // Both operands are evaluated like AstInterpreter::visitLogicalExpr does, reporting their errors
+    std::string value = name('v');
+    line("Value " + value + " = LoxRuntime::nil();");
+    evaluateReported(expr.left, value);
+
+    if (expr.op.getType() == TokenInfo::Type::OR)
+        line("if (!LoxRuntime::isTruthy(" + value + "))");
+    else
+        line("if (LoxRuntime::isTruthy(" + value + "))");
+    open();
+    evaluateReported(expr.right, value);
+    close();
+    return value;
+}
+
+std::string CppEmitter::visitCallExpr(const Call &expr)
+{
+    std::string callee = evaluate(expr.callee);
+    std::string paren = token(expr.paren);
+
+    std::string funcEnv = name('e');
+    line("LoxRuntime::Env " + funcEnv + " = LoxRuntime::prepare(" + callee + ", " + paren + ");");
+    for (size_t i = 0; i < expr.arguments.size(); i++)
+    {
+        std::string argument = evaluate(expr.arguments[i]);
+        line("LoxRuntime::argument(" + funcEnv + ", " + std::to_string(i) + ", " + argument + ");");
+    }
+
+    std::string value = name('v');
+    line("Value " + value + " = LoxRuntime::call(" + callee + ", " + funcEnv + ", " +
+         std::to_string(expr.arguments.size()) + ", " + paren + ");");
+    return value;
+}
+
+/* -------------------- STATEMENTS -------------------- */
+
+void CppEmitter::visitExpressionStmt(const Expression &stmt)
+{
+    line("try");
+    open();
+    evaluate(stmt.expression);
+    close();
+    catchReported("");
+}
+
+void CppEmitter::visitPrintStmt(const Print &stmt)
+{
+    // Nothing is printed if the expression fails
+    line("try");
+    open();
+    line("LoxRuntime::print(" + evaluate(stmt.expression) + ");");
+    close();
+    catchReported("");
+}
+
+void CppEmitter::visitVarStmt(const Var &stmt)
+{
+    // Errors in the initializer propagate, like in AstInterpreter::visitVarStmt
+    std::string value = "Value(nullptr, TokenInfo::Type::UNINITIALIZED)";
+    if (stmt.initializer != nullptr)
+        value = evaluate(stmt.initializer);
+    line("LoxRuntime::define(" + env + ", " + token(stmt.name) + ", " + value + ");");
+}
+
+void CppEmitter::visitBlockStmt(const Block &stmt)
+{
+    // An error escaping a block only abandons the block (see AstInterpreter::executeBlock)
+    std::string outer = env;
+    env = name('e');
+
+    open();
+    line("LoxRuntime::Env " + env + " = std::make_shared<Environment>(" + outer + ");");
+    line("try");
+    open();
+    for (const auto &statement : stmt.statements)
+        execute(statement);
+    close();
+    line("catch (RuntimeError &)");
+    open();
+    close();
+    close();
+
+    env = outer;
+}
+
+void CppEmitter::visitIfStmt(const If &stmt)
+{
+    open();
+    std::string condition = name('v');
+    line("Value " + condition + " = LoxRuntime::nil();");
+    evaluateReported(stmt.condition, condition);
+
+    line("if (LoxRuntime::isTruthy(" + condition + "))");
+    executeNested(stmt.thenBranch);
+    if (stmt.elseBranch != nullptr)
+    {
+        line("else");
+        executeNested(stmt.elseBranch);
+    }
+    close();
+}
+
+void CppEmitter::visitWhileStmt(const While &stmt)
+{
+    // The condition is written once, at the top of an endless loop, so a Lox break is a C++ break
+    line("while (true)");
+    open();
+    std::string condition = name('v');
+    line("Value " + condition + " = LoxRuntime::nil();");
+    evaluateReported(stmt.condition, condition);
+    line("if (!LoxRuntime::isTruthy(" + condition + "))");
+    line("    break;");
+
+    loops++;
+    executeNested(stmt.body);
+    loops--;
+    close();
+}
+
+void CppEmitter::visitBreakStmt(const Break &)
+{
+    // A function declared in a loop may break without a loop of its own, that ends the call like in the
+    // ClosureInterpreter
+    if (loops > 0)
+        line("break;");
+    else if (inFunction)
+        line("return LoxRuntime::nil();");
+}
+
+void CppEmitter::visitReturnStmt(const Return &stmt)
+{
+    std::string value = name('v');
+    line("Value " + value + " = LoxRuntime::nil();");
+    if (stmt.value != nullptr)
+        evaluateReported(stmt.value, value);
+
+    // Outside of any function a return only ends the top-level statement it is in, like in the ClosureInterpreter
+    if (inFunction)
+        line("return " + value + ";");
+    else
+    {
+        line("goto " + statementEnd + ";");
+        returnsAtTop = true;
+    }
+}
+
+void CppEmitter::visitFunctionStmt(const Function &stmt)
+{
+    std::string function = name('f');
+    std::string params = name('p');
+
+    constants << "static const LoxRuntime::Params " << params
+              << " = std::make_shared<const std::vector<std::string_view>>(std::vector<std::string_view>{";
+    for (size_t i = 0; i < stmt.params.size(); i++)
+        constants << (i > 0 ? ", " : "") << quote(std::string(stmt.params[i].getLexeme()));
+    constants << "});\n";
+
+    line("LoxRuntime::defineFunction(" + env + ", " + token(stmt.name) + ", " + function + ", " + params + ");");
+
+    // The body is a C++ function of its own, written on the side
+    std::ostringstream body;
+    std::ostringstream *outerOut = out;
+    std::string outerEnv = env;
+    int outerDepth = depth;
+    int outerLoops = loops;
+    bool outerInFunction = inFunction;
+
+    out = &body;
+    env = name('e');
+    depth = 0;
+    loops = 0;
+    inFunction = true;
+
+    std::string signature = "static Value " + function + "(const LoxRuntime::Env &" + env + ")";
+    prototypes << signature << ";\n";
+
+    // Like LoxFunction::call: an error escaping the body makes the call return nil
+    line("// " + std::string(stmt.name.getLexeme()) + ", line " + std::to_string(stmt.name.getLine()));
+    line(signature);
+    open();
+    line("try");
+    open();
+    for (const auto &statement : stmt.getBody())
+        execute(statement);
+    close();
+    line("catch (RuntimeError &)");
+    open();
+    close();
+    line("return LoxRuntime::nil();");
+    close();
+    functions << body.str() << "\n";
+
+    out = outerOut;
+    env = outerEnv;
+    depth = outerDepth;
+    loops = outerLoops;
+    inFunction = outerInFunction;
+}
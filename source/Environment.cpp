@@ -1,40 +1,120 @@
 #include "headers/Environment.hpp"
 #include "headers/RuntimeError.hpp"
 
-std::pair<std::shared_ptr<void>, TokenInfo::Type> Environment::get(Token name)
+// 0 is never an id, it marks an empty LookupCache
+uint64_t Environment::nextId = 1;
+
+std::pair<std::shared_ptr<void>, TokenInfo::Type> Environment::get(const Token &name)
 {
+    std::string lexeme(name.getLexeme());
 
     // Don't use values[ ] because it will create a new entry if it doesn't exist.
-    if (values.find(name.getLexeme()) != values.end())
-        return values[name.getLexeme()];
+    if (auto *binding = find(lexeme))
+        return *binding;
+
+    throw RuntimeError(name, "Undefined variable '" + lexeme + "'.");
+}
+
+Value *Environment::findSlot(const std::string &name)
+{
+    // From the back, so of two parameters with the same name the last one wins, like it did when parameters were
+    // defined one by one
+    for (size_t i = slotCount(); i-- > 0;)
+    {
+        if ((*slotNames)[i] == name)
+            return &slot(i);
+    }
+    return nullptr;
+}
+
+Value *Environment::findHere(const std::string &name)
+{
+    // Parameters first, there are only a few and comparing them is cheaper than hashing the name
+    if (Value *param = findSlot(name))
+        return param;
 
-    // Check enclosing env recursively.
-    if (enclosing != nullptr)
-        return enclosing->get(name);
+    auto found = values.find(name);
+    return found != values.end() ? &found->second : nullptr;
+}
 
-    throw RuntimeError(name, "Undefined variable '" + name.getLexeme() + "'.");
+std::pair<std::shared_ptr<void>, TokenInfo::Type> *Environment::find(const std::string &name)
+{
+    for (Environment *env = this; env != nullptr; env = env->enclosing.get())
+    {
+        if (Value *binding = env->findHere(name))
+            return binding;
+    }
+
+    return nullptr;
+}
+
+std::pair<std::shared_ptr<void>, TokenInfo::Type> &Environment::lookup(const Token &name, LookupCache &cache)
+{
+    // Walk out as far as last time, as long as no environment on the way could have defined the name since
+    Environment *env = this;
+    unsigned hops = 0;
+    while (hops < cache.hops && (env->nameBits & cache.nameBit) == 0 && env->enclosing != nullptr)
+    {
+        env = env->enclosing.get();
+        hops++;
+    }
+    if (hops == cache.hops && env->id == cache.found)
+        return *cache.binding;
+
+    std::string lexeme(name.getLexeme());
+    hops = 0;
+    for (env = this; env != nullptr; env = env->enclosing.get(), hops++)
+    {
+        if (Value *binding = env->findHere(lexeme))
+        {
+            cache = {nameBit(lexeme), hops, env->id, binding};
+            return *binding;
+        }
+    }
+
+    throw RuntimeError(name, "Undefined variable '" + lexeme + "'.");
 }
 
 void Environment::defineVar(std::string name, std::shared_ptr<void> value, TokenInfo::Type type)
 {
+    // Redeclaring a parameter (var a; in fun f(a)) replaces it
+    if (Value *param = findSlot(name))
+    {
+        *param = std::make_pair(value, type);
+        return;
+    }
+
+    nameBits |= nameBit(name);
     values[name] = std::make_pair(value, type);
 }
 
-// Key difference: do not create a new var if it doesn't exist
-void Environment::assign(Token name, std::shared_ptr<void> &value, TokenInfo::Type type)
+std::pair<std::shared_ptr<void>, TokenInfo::Type> &Environment::defineHere(const Token &name, LookupCache &cache)
 {
-    if (values.find(name.getLexeme()) != values.end())
+    if (cache.hops == 0 && cache.found == id)
+        return *cache.binding;
+
+    std::string lexeme(name.getLexeme());
+    Value *binding = findHere(lexeme);
+    if (binding == nullptr)
     {
-        values[name.getLexeme()] = std::make_pair(value, type);
-        return;
+        nameBits |= nameBit(lexeme);
+        binding = &(values[lexeme] = {nullptr, TokenInfo::Type::NIL});
     }
+    cache = {nameBit(lexeme), 0, id, binding};
+    return *binding;
+}
+
+// Key difference: do not create a new var if it doesn't exist
+void Environment::assign(const Token &name, std::shared_ptr<void> &value, TokenInfo::Type type)
+{
+    std::string lexeme(name.getLexeme());
 
-    // Check enclosing env recursively.
-    if (enclosing != nullptr)
+    // Check enclosing envs too, but never create a new variable
+    if (auto *binding = find(lexeme))
     {
-        enclosing->assign(name, value, type);
+        *binding = std::make_pair(value, type);
         return;
     }
 
-    throw RuntimeError(name, "Undefined variable '" + name.getLexeme() + "'.");
+    throw RuntimeError(name, "Undefined variable '" + lexeme + "'.");
 }
@@ -0,0 +1,190 @@
+#include "headers/FlatAstBuilder.hpp"
+
+std::unique_ptr<FlatAst> FlatAstBuilder::build(const std::vector<std::unique_ptr<Stmt>> &statements)
+{
+    ast->program = lowerList(statements);
+    return std::move(ast);
+}
+
+FlatRef FlatAstBuilder::lower(const std::unique_ptr<Expr> &expr)
+{
+    if (expr == nullptr)
+        return FLAT_NONE;
+
+    return expr->accept(*this);
+}
+
+FlatRef FlatAstBuilder::lower(const std::unique_ptr<Stmt> &stmt)
+{
+    if (stmt == nullptr)
+        return FLAT_NONE;
+
+    return stmt->accept(*this);
+}
+
+FlatRange FlatAstBuilder::lowerList(const std::vector<std::unique_ptr<Expr>> &exprs)
+{
+    // Lower every element before appending any of them, nested lists would otherwise interleave
+    std::vector<FlatRef> refs;
+    for (const auto &expr : exprs)
+        refs.push_back(lower(expr));
+
+    FlatRange range = {static_cast<uint32_t>(ast->exprLists.size()), static_cast<uint32_t>(refs.size())};
+    ast->exprLists.append(refs.begin(), refs.end());
+    return range;
+}
+
+FlatRange FlatAstBuilder::lowerList(const std::vector<std::unique_ptr<Stmt>> &stmts)
+{
+    std::vector<FlatRef> refs;
+    for (const auto &stmt : stmts)
+        refs.push_back(lower(stmt));
+
+    FlatRange range = {static_cast<uint32_t>(ast->stmtLists.size()), static_cast<uint32_t>(refs.size())};
+    ast->stmtLists.append(refs.begin(), refs.end());
+    return range;
+}
+
+uint32_t FlatAstBuilder::intern(std::string_view name)
+{
+    auto found = nameIds.find(std::string(name));
+    if (found != nameIds.end())
+        return found->second;
+
+    uint32_t id = static_cast<uint32_t>(ast->names.size());
+    ast->names.push_back(addChars(name));
+    nameIds[std::string(name)] = id;
+    return id;
+}
+
+FlatRange FlatAstBuilder::addChars(std::string_view text)
+{
+    FlatRange range = {static_cast<uint32_t>(ast->chars.size()), static_cast<uint32_t>(text.length())};
+    ast->chars.append(text.begin(), text.end());
+    return range;
+}
+
+/* -------------------- EXPRESSIONS -------------------- */
+
+FlatRef FlatAstBuilder::visitAssignExpr(const Assign &expr)
+{
+    FlatRef value = lower(expr.value);
+    return ast->addAssign(intern(expr.name.getLexeme()), expr.name.getOffset(), value);
+}
+
+FlatRef FlatAstBuilder::visitBinaryExpr(const Binary &expr)
+{
+    FlatRef left = lower(expr.left);
+    FlatRef right = lower(expr.right);
+    return ast->addBinary(left, expr.op.getType(), expr.op.getOffset(), right);
+}
+
+FlatRef FlatAstBuilder::visitGroupingExpr(const Grouping &expr)
+{
+    return ast->addGrouping(lower(expr.expression));
+}
+
+FlatRef FlatAstBuilder::visitLiteralExpr(const Literal &expr)
+{
+    uint32_t constant = 0;
+
+    if (expr.type == TokenInfo::Type::NUMBER)
+    {
+        constant = static_cast<uint32_t>(ast->numbers.size());
+        ast->numbers.push_back(*std::static_pointer_cast<double>(expr.value));
+    }
+    else if (expr.type == TokenInfo::Type::STRING)
+    {
+        constant = static_cast<uint32_t>(ast->strings.size());
+        ast->strings.push_back(addChars(*std::static_pointer_cast<std::string>(expr.value)));
+    }
+
+    return ast->addLiteral(expr.type, constant);
+}
+
+FlatRef FlatAstBuilder::visitLogicalExpr(const Logical &expr)
+{
+    FlatRef left = lower(expr.left);
+    FlatRef right = lower(expr.right);
+    return ast->addLogical(left, expr.op.getType(), right);
+}
+
+FlatRef FlatAstBuilder::visitUnaryExpr(const Unary &expr)
+{
+    FlatRef right = lower(expr.right);
+    return ast->addUnary(expr.op.getType(), expr.op.getOffset(), right);
+}
+
+FlatRef FlatAstBuilder::visitVariableExpr(const Variable &expr)
+{
+    return ast->addVariable(intern(expr.name.getLexeme()), expr.name.getOffset());
+}
+
+FlatRef FlatAstBuilder::visitCallExpr(const Call &expr)
+{
+    FlatRef callee = lower(expr.callee);
+    FlatRange arguments = lowerList(expr.arguments);
+    return ast->addCall(callee, expr.paren.getOffset(), arguments);
+}
+
+/* -------------------- STATEMENTS -------------------- */
+
+FlatRef FlatAstBuilder::visitIfStmt(const If &stmt)
+{
+    FlatRef condition = lower(stmt.condition);
+    FlatRef thenBranch = lower(stmt.thenBranch);
+    FlatRef elseBranch = lower(stmt.elseBranch);
+    return ast->addIf(condition, thenBranch, elseBranch);
+}
+
+FlatRef FlatAstBuilder::visitWhileStmt(const While &stmt)
+{
+    FlatRef condition = lower(stmt.condition);
+    FlatRef body = lower(stmt.body);
+    return ast->addWhile(condition, body);
+}
+
+FlatRef FlatAstBuilder::visitBlockStmt(const Block &stmt)
+{
+    return ast->addBlock(lowerList(stmt.statements));
+}
+
+FlatRef FlatAstBuilder::visitBreakStmt(const Break &)
+{
+    return ast->addBreak();
+}
+
+FlatRef FlatAstBuilder::visitExpressionStmt(const Expression &stmt)
+{
+    return ast->addExpression(lower(stmt.expression));
+}
+
+FlatRef FlatAstBuilder::visitPrintStmt(const Print &stmt)
+{
+    return ast->addPrint(lower(stmt.expression));
+}
+
+FlatRef FlatAstBuilder::visitVarStmt(const Var &stmt)
+{
+    FlatRef initializer = lower(stmt.initializer);
+    return ast->addVar(intern(stmt.name.getLexeme()), stmt.name.getOffset(), initializer);
+}
+
+FlatRef FlatAstBuilder::visitFunctionStmt(const Function &stmt)
+{
+    std::vector<uint32_t> params;
+    for (const Token &param : stmt.params)
+        params.push_back(intern(param.getLexeme()));
+
+    FlatRange paramRange = {static_cast<uint32_t>(ast->nameLists.size()), static_cast<uint32_t>(params.size())};
+    ast->nameLists.append(params.begin(), params.end());
+
+    FlatRange body = lowerList(stmt.getBody());
+    return ast->addFunction(intern(stmt.name.getLexeme()), stmt.name.getOffset(), paramRange, body);
+}
+
+FlatRef FlatAstBuilder::visitReturnStmt(const Return &stmt)
+{
+    FlatRef value = lower(stmt.value);
+    return ast->addReturn(stmt.keyword.getOffset(), value);
+}
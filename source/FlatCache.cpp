@@ -0,0 +1,617 @@
+#include "headers/FlatCache.hpp"
+#include "headers/Source.hpp"
+#include "headers/TokenInfo.hpp"
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <initializer_list>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <type_traits>
+#include <unistd.h>
+#include <utility>
+#include <vector>
+
+// Start of every cache file, followed by the program (see FlatCache::write)
+struct CacheHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t base;
+    uint64_t hash;
+    uint64_t sourceLength;
+    // FlatCache::buildId() of the interpreter that wrote it and FlatCache::checksum() of everything after the header
+    uint64_t build;
+    uint64_t checksum;
+};
+
+// Start of a program in a file, followed by its scalars and then a table with a CacheColumn for each column.
+struct CacheProgram
+{
+    uint32_t scalarCount;
+    uint32_t columnCount;
+};
+
+// Where one column is in the file
+struct CacheColumn
+{
+    uint64_t offset;
+    uint64_t count;
+    uint32_t elementSize;
+    uint32_t padding;
+};
+
+static const char MAGIC[8] = "LOXFLAT";
+
+// Column data starts at multiples of this, so it can be used in place
+static const size_t ALIGNMENT = 8;
+
+static size_t align(size_t offset)
+{
+    return (offset + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+}
+
+uint64_t FlatCache::hash(const std::string &text, uint32_t base)
+{
+    // FNV-1a, with the format and the offset mixed in so either changing gives a different file
+    uint64_t h = 0xcbf29ce484222325ULL;
+    auto mix = [&h](uint8_t byte) {
+        h ^= byte;
+        h *= 0x100000001b3ULL;
+    };
+
+    for (char c : text)
+        mix(static_cast<uint8_t>(c));
+    for (int i = 0; i < 4; i++)
+    {
+        mix(static_cast<uint8_t>(FORMAT_VERSION >> (i * 8)));
+        mix(static_cast<uint8_t>(base >> (i * 8)));
+    }
+    return h;
+}
+
+std::string FlatCache::path(const std::string &dir, uint64_t key)
+{
+    char name[32];
+    std::snprintf(name, sizeof(name), "%016llx.flat", static_cast<unsigned long long>(key));
+    return dir + "/" + name;
+}
+
+uint64_t FlatCache::checksum(const char *bytes, size_t size)
+{
+    // FNV-1a a word at a time. Each step is a bijection of the running value, so a single damaged word always shows.
+    uint64_t h = 0xcbf29ce484222325ULL;
+    size_t i = 0;
+    for (; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t))
+    {
+        uint64_t word;
+        std::memcpy(&word, bytes + i, sizeof(word));
+        h = (h ^ word) * 0x100000001b3ULL;
+    }
+    for (; i < size; i++)
+        h = (h ^ static_cast<uint8_t>(bytes[i])) * 0x100000001b3ULL;
+    return h;
+}
+
+uint64_t FlatCache::buildId()
+{
+    // When this file was compiled and the size and modification time of the running binary. Relinking changes the
+    // latter, which covers changes elsewhere (e.g. to the token types) that FORMAT_VERSION doesn't know about.
+    static const uint64_t id = [] {
+        const char *stamp = __DATE__ " " __TIME__;
+        uint64_t h = checksum(stamp, std::strlen(stamp));
+
+        struct stat info;
+        if (stat("/proc/self/exe", &info) == 0)
+        {
+            uint64_t binary[] = {static_cast<uint64_t>(info.st_size), static_cast<uint64_t>(info.st_mtim.tv_sec),
+                                 static_cast<uint64_t>(info.st_mtim.tv_nsec)};
+            h ^= checksum(reinterpret_cast<const char *>(binary), sizeof(binary));
+        }
+        return h;
+    }();
+    return id;
+}
+
+std::shared_ptr<const void> FlatCache::map(const std::string &path, size_t &size)
+{
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return nullptr;
+
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size == 0)
+    {
+        close(fd);
+        return nullptr;
+    }
+    size = info.st_size;
+
+    // The mapping stays valid after the file is closed
+    void *address = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (address == MAP_FAILED)
+        return nullptr;
+
+    // Unmapped when the last FlatAst column pointing into it is gone
+    return std::shared_ptr<const void>(address, [size](const void *address) {
+        munmap(const_cast<void *>(address), size);
+    });
+}
+
+size_t FlatCache::write(std::vector<char> &bytes, FlatAst &ast)
+{
+    std::vector<uint32_t> scalars;
+    ast.forEachScalar([&scalars](uint32_t &scalar) { scalars.push_back(scalar); });
+
+    // Lay the columns out after the scalars and the column table
+    std::vector<CacheColumn> table;
+    ast.forEachColumn([&table](auto &column) {
+        table.push_back({0, column.size(), sizeof(*column.data()), 0});
+    });
+
+    size_t start = align(bytes.size());
+    size_t tableOffset = align(start + sizeof(CacheProgram) + scalars.size() * sizeof(uint32_t));
+    size_t offset = tableOffset + table.size() * sizeof(CacheColumn);
+    for (CacheColumn &entry : table)
+    {
+        offset = align(offset);
+        entry.offset = offset;
+        offset += entry.count * entry.elementSize;
+    }
+
+    CacheProgram program = {static_cast<uint32_t>(scalars.size()), static_cast<uint32_t>(table.size())};
+    bytes.resize(offset, 0);
+    std::memcpy(bytes.data() + start, &program, sizeof(program));
+    std::memcpy(bytes.data() + start + sizeof(program), scalars.data(), scalars.size() * sizeof(uint32_t));
+    std::memcpy(bytes.data() + tableOffset, table.data(), table.size() * sizeof(CacheColumn));
+    const CacheColumn *entry = table.data();
+    ast.forEachColumn([&bytes, &entry](auto &column) {
+        if (column.size() > 0)
+            std::memcpy(bytes.data() + entry->offset, column.data(), entry->count * entry->elementSize);
+        entry++;
+    });
+
+    return start;
+}
+
+// Checks a program read from a file before anything runs it: every column as long as its node count, every reference,
+// range, name, constant and source position in bounds, and no node inside itself. A damaged or foreign file could
+// otherwise send the interpreter outside the columns or around in circles.
+class FlatChecker
+{
+    static constexpr uint32_t EXPR_KINDS = 8;
+    static constexpr uint32_t STMT_KINDS = 9;
+
+    // A node to visit, or to leave once everything under it was visited
+    struct Visit
+    {
+        bool stmt;
+        FlatRef ref;
+        bool leave;
+    };
+
+    const FlatAst &ast;
+    // Source positions must be in [start, end]
+    uint32_t start;
+    uint32_t end;
+    // Node count of every expression kind and then every statement kind, and the index of each kind's first node
+    // among the tracked ones
+    uint32_t counts[EXPR_KINDS + STMT_KINDS];
+    size_t firsts[EXPR_KINDS + STMT_KINDS];
+    size_t tracked = 0;
+
+    // Breaks have no columns, so nothing bounds their count by the size of the file. There is nothing in them to
+    // check either and they can't be in a cycle, so they are left out of the walk.
+    static bool untracked(bool stmt, FlatRef ref)
+    {
+        return stmt && FlatAst::stmtKind(ref) == FlatStmt::Break;
+    }
+
+    size_t kind(bool stmt, FlatRef ref) const
+    {
+        return (stmt ? EXPR_KINDS : 0) + (ref >> 28);
+    }
+
+    // An optional child: FLAT_NONE or an existing node of the right sort
+    bool reference(bool stmt, FlatRef ref) const
+    {
+        if (ref == FLAT_NONE)
+            return true;
+        return (ref >> 28) < (stmt ? STMT_KINDS : EXPR_KINDS) && FlatAst::row(ref) < counts[kind(stmt, ref)];
+    }
+
+    static bool inside(FlatRange range, size_t size)
+    {
+        return range.first <= size && range.count <= size - range.first;
+    }
+
+    bool position(uint32_t offset) const
+    {
+        return offset >= start && offset <= end;
+    }
+
+    bool name(uint32_t name) const
+    {
+        return name < ast.names.size();
+    }
+
+    // The fields of a node that aren't references
+    bool fields(bool stmt, FlatRef ref) const
+    {
+        uint32_t row = FlatAst::row(ref);
+        if (!stmt)
+        {
+            switch (FlatAst::exprKind(ref))
+            {
+            case FlatExpr::Assign:
+                return name(ast.assignExprs.name[row]) && position(ast.assignExprs.namePos[row]);
+            case FlatExpr::Binary:
+                return position(ast.binaryExprs.opPos[row]);
+            case FlatExpr::Call:
+                return position(ast.callExprs.parenPos[row]) &&
+                       inside(ast.callExprs.arguments[row], ast.exprLists.size());
+            case FlatExpr::Literal:
+                switch (static_cast<TokenInfo::Type>(ast.literalExprs.type[row]))
+                {
+                case TokenInfo::Type::NUMBER:
+                    return ast.literalExprs.value[row] < ast.numbers.size();
+                case TokenInfo::Type::STRING:
+                    return ast.literalExprs.value[row] < ast.strings.size();
+                case TokenInfo::Type::TRUE:
+                case TokenInfo::Type::FALSE:
+                case TokenInfo::Type::NIL:
+                    return true;
+                default:
+                    return false;
+                }
+            case FlatExpr::Unary:
+                return position(ast.unaryExprs.opPos[row]);
+            case FlatExpr::Variable:
+                return name(ast.variableExprs.name[row]) && position(ast.variableExprs.namePos[row]);
+            default:
+                return true;
+            }
+        }
+
+        switch (FlatAst::stmtKind(ref))
+        {
+        case FlatStmt::Block:
+            return inside(ast.blockStmts.statements[row], ast.stmtLists.size());
+        case FlatStmt::Function: {
+            FlatRange params = ast.functionStmts.params[row];
+            if (!name(ast.functionStmts.name[row]) || !position(ast.functionStmts.namePos[row]) ||
+                !inside(params, ast.nameLists.size()) || !inside(ast.functionStmts.body[row], ast.stmtLists.size()))
+                return false;
+            for (uint32_t i = 0; i < params.count; i++)
+            {
+                if (!name(ast.nameLists[params.first + i]))
+                    return false;
+            }
+            return true;
+        }
+        case FlatStmt::Return:
+            return position(ast.returnStmts.keywordPos[row]);
+        case FlatStmt::Var:
+            return name(ast.varStmts.name[row]) && position(ast.varStmts.namePos[row]);
+        default:
+            return true;
+        }
+    }
+
+    // Call f(stmt, ref) on every child of a node whose fields are valid
+    template <typename F> void children(bool stmt, FlatRef ref, F &&f) const
+    {
+        uint32_t row = FlatAst::row(ref);
+        auto exprs = [&](FlatRange range) {
+            for (uint32_t i = 0; i < range.count; i++)
+                f(false, ast.exprLists[range.first + i]);
+        };
+        auto stmts = [&](FlatRange range) {
+            for (uint32_t i = 0; i < range.count; i++)
+                f(true, ast.stmtLists[range.first + i]);
+        };
+
+        if (!stmt)
+        {
+            switch (FlatAst::exprKind(ref))
+            {
+            case FlatExpr::Assign:
+                f(false, ast.assignExprs.value[row]);
+                break;
+            case FlatExpr::Binary:
+                f(false, ast.binaryExprs.left[row]);
+                f(false, ast.binaryExprs.right[row]);
+                break;
+            case FlatExpr::Call:
+                f(false, ast.callExprs.callee[row]);
+                exprs(ast.callExprs.arguments[row]);
+                break;
+            case FlatExpr::Grouping:
+                f(false, ast.groupingExprs.expression[row]);
+                break;
+            case FlatExpr::Logical:
+                f(false, ast.logicalExprs.left[row]);
+                f(false, ast.logicalExprs.right[row]);
+                break;
+            case FlatExpr::Unary:
+                f(false, ast.unaryExprs.right[row]);
+                break;
+            default:
+                break;
+            }
+            return;
+        }
+
+        switch (FlatAst::stmtKind(ref))
+        {
+        case FlatStmt::Block:
+            stmts(ast.blockStmts.statements[row]);
+            break;
+        case FlatStmt::Expression:
+            f(false, ast.expressionStmts.expression[row]);
+            break;
+        case FlatStmt::Function:
+            stmts(ast.functionStmts.body[row]);
+            break;
+        case FlatStmt::If:
+            f(false, ast.ifStmts.condition[row]);
+            f(true, ast.ifStmts.thenBranch[row]);
+            f(true, ast.ifStmts.elseBranch[row]);
+            break;
+        case FlatStmt::Print:
+            f(false, ast.printStmts.expression[row]);
+            break;
+        case FlatStmt::Return:
+            f(false, ast.returnStmts.value[row]);
+            break;
+        case FlatStmt::Var:
+            f(false, ast.varStmts.initializer[row]);
+            break;
+        case FlatStmt::While:
+            f(false, ast.whileStmts.condition[row]);
+            f(true, ast.whileStmts.body[row]);
+            break;
+        default:
+            break;
+        }
+    }
+
+    bool columns() const
+    {
+        auto rows = [](uint32_t count, std::initializer_list<size_t> sizes) {
+            for (size_t size : sizes)
+            {
+                if (size != count)
+                    return false;
+            }
+            return true;
+        };
+
+        return rows(ast.assignExprs.count,
+                    {ast.assignExprs.name.size(), ast.assignExprs.namePos.size(), ast.assignExprs.value.size()}) &&
+               rows(ast.binaryExprs.count, {ast.binaryExprs.left.size(), ast.binaryExprs.op.size(),
+                                            ast.binaryExprs.opPos.size(), ast.binaryExprs.right.size()}) &&
+               rows(ast.callExprs.count,
+                    {ast.callExprs.callee.size(), ast.callExprs.parenPos.size(), ast.callExprs.arguments.size()}) &&
+               rows(ast.groupingExprs.count, {ast.groupingExprs.expression.size()}) &&
+               rows(ast.literalExprs.count, {ast.literalExprs.type.size(), ast.literalExprs.value.size()}) &&
+               rows(ast.logicalExprs.count,
+                    {ast.logicalExprs.left.size(), ast.logicalExprs.op.size(), ast.logicalExprs.right.size()}) &&
+               rows(ast.unaryExprs.count,
+                    {ast.unaryExprs.op.size(), ast.unaryExprs.opPos.size(), ast.unaryExprs.right.size()}) &&
+               rows(ast.variableExprs.count, {ast.variableExprs.name.size(), ast.variableExprs.namePos.size()}) &&
+               rows(ast.blockStmts.count, {ast.blockStmts.statements.size()}) &&
+               rows(ast.expressionStmts.count, {ast.expressionStmts.expression.size()}) &&
+               rows(ast.functionStmts.count, {ast.functionStmts.name.size(), ast.functionStmts.namePos.size(),
+                                              ast.functionStmts.params.size(), ast.functionStmts.body.size()}) &&
+               rows(ast.ifStmts.count,
+                    {ast.ifStmts.condition.size(), ast.ifStmts.thenBranch.size(), ast.ifStmts.elseBranch.size()}) &&
+               rows(ast.printStmts.count, {ast.printStmts.expression.size()}) &&
+               rows(ast.returnStmts.count, {ast.returnStmts.keywordPos.size(), ast.returnStmts.value.size()}) &&
+               rows(ast.varStmts.count,
+                    {ast.varStmts.name.size(), ast.varStmts.namePos.size(), ast.varStmts.initializer.size()}) &&
+               rows(ast.whileStmts.count, {ast.whileStmts.condition.size(), ast.whileStmts.body.size()});
+    }
+
+  public:
+    FlatChecker(const FlatAst &ast, uint32_t start, uint32_t end)
+        : ast(ast), start(start), end(end),
+          counts{ast.assignExprs.count, ast.binaryExprs.count, ast.callExprs.count, ast.groupingExprs.count,
+                 ast.literalExprs.count, ast.logicalExprs.count, ast.unaryExprs.count, ast.variableExprs.count,
+                 ast.blockStmts.count, ast.breakStmts.count, ast.expressionStmts.count, ast.functionStmts.count,
+                 ast.ifStmts.count, ast.printStmts.count, ast.returnStmts.count, ast.varStmts.count,
+                 ast.whileStmts.count}
+    {
+        for (uint32_t i = 0; i < EXPR_KINDS + STMT_KINDS; i++)
+        {
+            firsts[i] = tracked;
+            if (i != EXPR_KINDS + static_cast<uint32_t>(FlatStmt::Break))
+                tracked += counts[i];
+        }
+    }
+
+    bool check() const
+    {
+        if (!columns() || !inside(ast.program, ast.stmtLists.size()))
+            return false;
+        for (const FlatRange &text : ast.names)
+        {
+            if (!inside(text, ast.chars.size()))
+                return false;
+        }
+        for (const FlatRange &text : ast.strings)
+        {
+            if (!inside(text, ast.chars.size()))
+                return false;
+        }
+        for (FlatRef ref : ast.exprLists)
+        {
+            if (!reference(false, ref))
+                return false;
+        }
+        for (FlatRef ref : ast.stmtLists)
+        {
+            if (!reference(true, ref))
+                return false;
+        }
+
+        // Depth first from every node, without recursing: a child that is still being visited is a cycle. Nodes
+        // reached twice without one are fine (the interpreter doesn't mind sharing), they are only checked once.
+        enum State : uint8_t
+        {
+            UNSEEN,
+            OPEN,
+            DONE
+        };
+        std::vector<uint8_t> states(tracked, UNSEEN);
+        std::vector<Visit> pending;
+        for (uint32_t k = 0; k < EXPR_KINDS + STMT_KINDS; k++)
+        {
+            bool stmt = k >= EXPR_KINDS;
+            uint8_t nodeKind = static_cast<uint8_t>(stmt ? k - EXPR_KINDS : k);
+            if (untracked(stmt, FlatAst::makeRef(nodeKind, 0)))
+                continue;
+            for (uint32_t row = 0; row < counts[k]; row++)
+            {
+                pending.push_back({stmt, FlatAst::makeRef(nodeKind, row), false});
+                while (!pending.empty())
+                {
+                    Visit visit = pending.back();
+                    pending.pop_back();
+                    uint8_t &state = states[firsts[kind(visit.stmt, visit.ref)] + FlatAst::row(visit.ref)];
+                    if (visit.leave)
+                    {
+                        state = DONE;
+                        continue;
+                    }
+                    if (state == OPEN)
+                        return false;
+                    if (state == DONE)
+                        continue;
+                    if (!fields(visit.stmt, visit.ref))
+                        return false;
+
+                    state = OPEN;
+                    pending.push_back({visit.stmt, visit.ref, true});
+                    bool valid = true;
+                    children(visit.stmt, visit.ref, [&](bool stmt, FlatRef child) {
+                        if (!reference(stmt, child))
+                            valid = false;
+                        else if (child != FLAT_NONE && !untracked(stmt, child))
+                            pending.push_back({stmt, child, false});
+                    });
+                    if (!valid)
+                        return false;
+                }
+            }
+        }
+        return true;
+    }
+};
+
+std::unique_ptr<FlatAst> FlatCache::view(const char *bytes, size_t size, size_t offset, uint32_t start, uint32_t end)
+{
+    auto ast = std::make_unique<FlatAst>();
+    uint32_t scalarCount = 0;
+    uint32_t columnCount = 0;
+    ast->forEachScalar([&scalarCount](uint32_t &) { scalarCount++; });
+    ast->forEachColumn([&columnCount](auto &) { columnCount++; });
+
+    // A file written with other columns is not usable
+    if (offset % ALIGNMENT != 0 || offset > size || size - offset < sizeof(CacheProgram))
+        return nullptr;
+    const CacheProgram *program = reinterpret_cast<const CacheProgram *>(bytes + offset);
+    if (program->scalarCount != scalarCount || program->columnCount != columnCount)
+        return nullptr;
+
+    size_t scalarsOffset = offset + sizeof(CacheProgram);
+    size_t tableOffset = align(scalarsOffset + scalarCount * sizeof(uint32_t));
+    if (tableOffset + columnCount * sizeof(CacheColumn) > size)
+        return nullptr;
+
+    const uint32_t *scalars = reinterpret_cast<const uint32_t *>(bytes + scalarsOffset);
+    ast->forEachScalar([&scalars](uint32_t &scalar) { scalar = *scalars++; });
+
+    const CacheColumn *table = reinterpret_cast<const CacheColumn *>(bytes + tableOffset);
+    bool valid = true;
+    ast->forEachColumn([&](auto &column) {
+        using T = typename std::remove_reference_t<decltype(column)>::value_type;
+        const CacheColumn &entry = *table++;
+        if (entry.elementSize != sizeof(T) || entry.offset % ALIGNMENT != 0 || entry.offset > size ||
+            entry.count > (size - entry.offset) / sizeof(T))
+        {
+            valid = false;
+            return;
+        }
+        column.view(reinterpret_cast<const T *>(bytes + entry.offset), entry.count);
+    });
+    if (!valid || !FlatChecker(*ast, start, end).check())
+        return nullptr;
+
+    return ast;
+}
+
+std::unique_ptr<FlatAst> FlatCache::load(const std::string &dir, uint32_t base)
+{
+    const std::string &text = Source::text(base);
+    uint64_t key = hash(text, base);
+
+    size_t size = 0;
+    std::shared_ptr<const void> mapping = map(path(dir, key), size);
+    if (!mapping || size < sizeof(CacheHeader))
+        return nullptr;
+    const char *bytes = static_cast<const char *>(mapping.get());
+
+    // Anything that doesn't match is a miss, the caller scans and parses as usual and writes a fresh file. That
+    // includes files written by another build of the interpreter and damaged ones.
+    const CacheHeader *header = reinterpret_cast<const CacheHeader *>(bytes);
+    if (std::memcmp(header->magic, MAGIC, sizeof(MAGIC)) != 0 || header->version != FORMAT_VERSION ||
+        header->base != base || header->hash != key || header->sourceLength != text.length() ||
+        header->build != buildId() ||
+        header->checksum != checksum(bytes + sizeof(CacheHeader), size - sizeof(CacheHeader)))
+        return nullptr;
+
+    std::unique_ptr<FlatAst> ast =
+        view(bytes, size, align(sizeof(CacheHeader)), base, base + static_cast<uint32_t>(text.length()));
+    if (ast)
+        ast->storage = std::move(mapping);
+    return ast;
+}
+
+void FlatCache::save(const std::string &dir, uint32_t base, FlatAst &ast)
+{
+    const std::string &text = Source::text(base);
+
+    CacheHeader header = {};
+    std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = FORMAT_VERSION;
+    header.base = base;
+    header.hash = hash(text, base);
+    header.sourceLength = text.length();
+    header.build = buildId();
+
+    std::vector<char> bytes(sizeof(header));
+    write(bytes, ast);
+    header.checksum = checksum(bytes.data() + sizeof(header), bytes.size() - sizeof(header));
+    std::memcpy(bytes.data(), &header, sizeof(header));
+
+    mkdir(dir.c_str(), 0755);
+    writeFile(path(dir, header.hash), bytes);
+}
+
+bool FlatCache::writeFile(const std::string &path, const std::vector<char> &bytes)
+{
+    // Write next to the real file and rename it into place, so another run never maps a half written file
+    std::string temporary = path + "." + std::to_string(getpid()) + ".tmp";
+    std::ofstream file(temporary, std::ios::binary);
+    file.write(bytes.data(), bytes.size());
+    file.close();
+    if (!file || std::rename(temporary.c_str(), path.c_str()) != 0)
+    {
+        std::remove(temporary.c_str());
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,371 @@
+#include "headers/FlatInterpreter.hpp"
+#include "headers/Loxpp.hpp"
+#include "headers/Operators.hpp"
+#include <iostream>
+
+// Length of an operator lexeme, the rest of the error token is read back from the source.
+static uint32_t opLength(TokenInfo::Type op)
+{
+    switch (op)
+    {
+    case TokenInfo::Type::BANG_EQUAL:
+    case TokenInfo::Type::EQUAL_EQUAL:
+    case TokenInfo::Type::GREATER_EQUAL:
+    case TokenInfo::Type::LESS_EQUAL:
+        return 2;
+    default:
+        return 1;
+    }
+}
+
+void FlatInterpreter::interpret(std::unique_ptr<FlatAst> ast)
+{
+    program = load(std::move(ast));
+
+    const FlatRange &statements = program->ast->program;
+    try
+    {
+        for (uint32_t i = 0; i < statements.count; i++)
+            execute(program->ast->stmtLists[statements.first + i]);
+    }
+    catch (RuntimeError &error)
+    {
+        Loxpp::runtimeError(error);
+    }
+}
+
+const FlatProgram *FlatInterpreter::load(std::unique_ptr<FlatAst> ast)
+{
+    auto loaded = std::make_unique<FlatProgram>();
+
+    // Materialize constants and names once
+    for (const FlatRange &name : ast->names)
+        loaded->names.push_back(ast->text(name));
+    for (double number : ast->numbers)
+        loaded->numbers.push_back(std::make_shared<double>(number));
+    for (const FlatRange &str : ast->strings)
+        loaded->strings.push_back(std::make_shared<std::string>(ast->text(str)));
+
+    loaded->ast = std::move(ast);
+    programs.push_back(std::move(loaded));
+    return programs.back().get();
+}
+
+RuntimeError FlatInterpreter::error(uint32_t pos, uint32_t length, const std::string &message) const
+{
+    return RuntimeError(Token(TokenInfo::Type::IDENTIFIER, pos, length), message);
+}
+
+bool FlatInterpreter::evaluateReported(FlatRef expr, Value &value)
+{
+    try
+    {
+        value = evaluate(expr);
+        return true;
+    }
+    catch (RuntimeError &error)
+    {
+        Loxpp::runtimeError(error);
+        value = {nullptr, TokenInfo::Type::NIL};
+        return false;
+    }
+}
+
+Value FlatInterpreter::evaluate(FlatRef expr)
+{
+    const FlatAst &ast = *program->ast;
+    uint32_t row = FlatAst::row(expr);
+
+    switch (FlatAst::exprKind(expr))
+    {
+    case FlatExpr::Literal: {
+        auto type = static_cast<TokenInfo::Type>(ast.literalExprs.type[row]);
+        if (type == TokenInfo::Type::NUMBER)
+            return {program->numbers[ast.literalExprs.value[row]], type};
+        if (type == TokenInfo::Type::STRING)
+            return {program->strings[ast.literalExprs.value[row]], type};
+        return {nullptr, type};
+    }
+
+    case FlatExpr::Grouping:
+    case FlatExpr::Unary:
+    case FlatExpr::Binary:
+        return evaluateOperators(expr);
+
+    case FlatExpr::Variable: {
+        const std::string &name = program->names[ast.variableExprs.name[row]];
+        auto *binding = environment->find(name);
+
+        if (binding == nullptr)
+            throw error(ast.variableExprs.namePos[row], name.length(), "Undefined variable '" + name + "'.");
+        if (binding->second == TokenInfo::Type::UNINITIALIZED)
+            throw error(ast.variableExprs.namePos[row], name.length(), "Variable used before being initialized.");
+
+        return *binding;
+    }
+
+    case FlatExpr::Assign: {
+        Value value = evaluate(ast.assignExprs.value[row]);
+
+        const std::string &name = program->names[ast.assignExprs.name[row]];
+        auto *binding = environment->find(name);
+        if (binding == nullptr)
+            throw error(ast.assignExprs.namePos[row], name.length(), "Undefined variable '" + name + "'.");
+
+        *binding = value;
+        return value;
+    }
+
+    case FlatExpr::Logical: {
+        Value left;
+        evaluateReported(ast.logicalExprs.left[row], left);
+
+        // Short circuit: "or" stops at the first truthy operand, "and" at the first falsy one
+        bool truthy = Operators::isTruthy(left.first, left.second);
+        if (static_cast<TokenInfo::Type>(ast.logicalExprs.op[row]) == TokenInfo::Type::OR ? truthy : !truthy)
+            return left;
+
+        Value right;
+        evaluateReported(ast.logicalExprs.right[row], right);
+        return right;
+    }
+
+    case FlatExpr::Call: {
+        Value callee = evaluate(ast.callExprs.callee[row]);
+        uint32_t parenPos = ast.callExprs.parenPos[row];
+
+        if (callee.second != TokenInfo::Type::FUN && callee.second != TokenInfo::Type::CLASS)
+            throw error(parenPos, 1, "Can only call functions and classes.");
+
+        // Keep the callee alive and the program it came from
+        auto function = std::static_pointer_cast<FlatFunction>(callee.first);
+        const FlatProgram *caller = program;
+
+        const FlatRange &args = ast.callExprs.arguments[row];
+        std::vector<Value> arguments;
+        for (uint32_t i = 0; i < args.count; i++)
+            arguments.push_back(evaluate(ast.exprLists[args.first + i]));
+
+        uint32_t arity = function->program->ast->functionStmts.params[function->declaration].count;
+        if (arguments.size() != arity)
+            throw error(parenPos, 1,
+                        "Expected " + std::to_string(arity) + " arguments but got " +
+                            std::to_string(arguments.size()) + ".");
+
+        if (callStack.full(Loxpp::options.maxDepth))
+            throw error(parenPos, 1, "Stack overflow.");
+        CallStack::Frame frame(callStack, {function.get(), parenPos});
+
+        program = function->program;
+        Value value = call(*function, arguments);
+        program = caller;
+        return value;
+    }
+    }
+
+    return {nullptr, TokenInfo::Type::NIL};
+}
+
+Value FlatInterpreter::evaluateOperators(FlatRef expr)
+{
+    const FlatAst &ast = *program->ast;
+
+    // Drop whatever this run left on the stacks, also when an operator or an operand throws.
+    struct Restore
+    {
+        FlatInterpreter &interpreter;
+        size_t pending;
+        size_t operands;
+
+        ~Restore()
+        {
+            interpreter.pendingOperators.resize(pending);
+            interpreter.operands.resize(operands);
+        }
+    } restore = {*this, pendingOperators.size(), operands.size()};
+
+    // Operands are evaluated left to right before their operator is applied, as if by recursion: the right operand
+    // goes on the stack under the left one, and the operator under both.
+    pendingOperators.push_back({expr, false});
+    while (pendingOperators.size() > restore.pending)
+    {
+        PendingOperator pending = pendingOperators.back();
+        pendingOperators.pop_back();
+        uint32_t row = FlatAst::row(pending.expr);
+
+        switch (FlatAst::exprKind(pending.expr))
+        {
+        case FlatExpr::Grouping:
+            pendingOperators.push_back({ast.groupingExprs.expression[row], false});
+            break;
+
+        case FlatExpr::Unary: {
+            if (!pending.apply)
+            {
+                pendingOperators.push_back({pending.expr, true});
+                pendingOperators.push_back({ast.unaryExprs.right[row], false});
+                break;
+            }
+
+            auto op = static_cast<TokenInfo::Type>(ast.unaryExprs.op[row]);
+            Value value;
+            if (const char *message = Operators::unary(op, operands.back(), value))
+                throw error(ast.unaryExprs.opPos[row], opLength(op), message);
+            operands.back() = std::move(value);
+            break;
+        }
+
+        case FlatExpr::Binary: {
+            if (!pending.apply)
+            {
+                pendingOperators.push_back({pending.expr, true});
+                pendingOperators.push_back({ast.binaryExprs.right[row], false});
+                pendingOperators.push_back({ast.binaryExprs.left[row], false});
+                break;
+            }
+
+            auto op = static_cast<TokenInfo::Type>(ast.binaryExprs.op[row]);
+            Value right = std::move(operands.back());
+            operands.pop_back();
+            Value value;
+            if (const char *message = Operators::binary(op, operands.back(), right, value))
+                throw error(ast.binaryExprs.opPos[row], opLength(op), message);
+            operands.back() = std::move(value);
+            break;
+        }
+
+        default:
+            operands.push_back(evaluate(pending.expr));
+            break;
+        }
+    }
+
+    Value value = std::move(operands.back());
+    operands.pop_back();
+    return value;
+}
+
+Value FlatInterpreter::call(const FlatFunction &function, std::vector<Value> &arguments)
+{
+    const FlatFunctionStmt &declarations = program->ast->functionStmts;
+
+    // Make closure (the env that was active during function definition) the environment of the function execution
+    auto funcEnv = std::make_shared<Environment>(function.closure);
+
+    const FlatRange &params = declarations.params[function.declaration];
+    for (uint32_t i = 0; i < params.count; i++)
+    {
+        const std::string &name = program->names[program->ast->nameLists[params.first + i]];
+        funcEnv->defineVar(name, arguments[i].first, arguments[i].second);
+    }
+
+    if (executeBlock(declarations.body[function.declaration], funcEnv) == Completion::RETURN)
+        return std::move(returnValue);
+
+    return {nullptr, TokenInfo::Type::NIL};
+}
+
+FlatInterpreter::Completion FlatInterpreter::executeBlock(FlatRange statements,
+                                                          const std::shared_ptr<Environment> &localEnv)
+{
+    std::shared_ptr<Environment> previous = environment;
+    environment = localEnv;
+
+    Completion completion = Completion::NORMAL;
+    try
+    {
+        for (uint32_t i = 0; i < statements.count && completion == Completion::NORMAL; i++)
+            completion = execute(program->ast->stmtLists[statements.first + i]);
+    }
+    catch (RuntimeError &error)
+    {
+        // Like AstInterpreter::executeBlock, an error escaping a block only abandons the block.
+        completion = Completion::NORMAL;
+    }
+
+    environment = previous;
+    return completion;
+}
+
+FlatInterpreter::Completion FlatInterpreter::execute(FlatRef stmt)
+{
+    if (stmt == FLAT_NONE)
+        return Completion::NORMAL;
+
+    const FlatAst &ast = *program->ast;
+    uint32_t row = FlatAst::row(stmt);
+
+    switch (FlatAst::stmtKind(stmt))
+    {
+    case FlatStmt::Expression: {
+        Value value;
+        evaluateReported(ast.expressionStmts.expression[row], value);
+        return Completion::NORMAL;
+    }
+
+    case FlatStmt::Print: {
+        Value value;
+        if (evaluateReported(ast.printStmts.expression[row], value))
+            std::cout << Operators::stringify(value.first, value.second) << "\n";
+        return Completion::NORMAL;
+    }
+
+    case FlatStmt::Var: {
+        Value value = {nullptr, TokenInfo::Type::UNINITIALIZED};
+        if (ast.varStmts.initializer[row] != FLAT_NONE)
+            value = evaluate(ast.varStmts.initializer[row]);
+
+        environment->defineVar(program->names[ast.varStmts.name[row]], value.first, value.second);
+        return Completion::NORMAL;
+    }
+
+    case FlatStmt::Block:
+        return executeBlock(ast.blockStmts.statements[row], std::make_shared<Environment>(environment));
+
+    case FlatStmt::If: {
+        Value condition;
+        evaluateReported(ast.ifStmts.condition[row], condition);
+
+        if (Operators::isTruthy(condition.first, condition.second))
+            return execute(ast.ifStmts.thenBranch[row]);
+        return execute(ast.ifStmts.elseBranch[row]);
+    }
+
+    case FlatStmt::While: {
+        FlatRef conditionExpr = ast.whileStmts.condition[row];
+        FlatRef body = ast.whileStmts.body[row];
+
+        Value condition;
+        evaluateReported(conditionExpr, condition);
+        while (Operators::isTruthy(condition.first, condition.second))
+        {
+            Completion completion = execute(body);
+            if (completion == Completion::BREAK)
+                break;
+            if (completion == Completion::RETURN)
+                return completion;
+
+            evaluateReported(conditionExpr, condition);
+        }
+        return Completion::NORMAL;
+    }
+
+    case FlatStmt::Break:
+        return Completion::BREAK;
+
+    case FlatStmt::Return: {
+        returnValue = {nullptr, TokenInfo::Type::NIL};
+        if (ast.returnStmts.value[row] != FLAT_NONE)
+            evaluateReported(ast.returnStmts.value[row], returnValue);
+        return Completion::RETURN;
+    }
+
+    case FlatStmt::Function: {
+        auto function = std::make_shared<FlatFunction>(FlatFunction{program, row, environment});
+        environment->defineVar(program->names[ast.functionStmts.name[row]], function, TokenInfo::Type::FUN);
+        return Completion::NORMAL;
+    }
+    }
+
+    return Completion::NORMAL;
+}
@@ -0,0 +1,382 @@
+#include "headers/FlatSnapshot.hpp"
+#include "headers/FlatCache.hpp"
+#include "headers/Source.hpp"
+#include <cstring>
+#include <deque>
+#include <unordered_map>
+
+// Start of an image. The offsets are where each table starts in the file.
+struct SnapshotHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t sourceCount;
+    uint32_t lineCount;
+    uint32_t programCount;
+    uint32_t environmentCount;
+    uint32_t functionCount;
+    uint32_t variableCount;
+    uint32_t padding;
+    uint64_t sources;
+    uint64_t lines;
+    uint64_t programs;
+    uint64_t environments;
+    uint64_t functions;
+    uint64_t variables;
+    uint64_t chars;
+    uint64_t charCount;
+    // FlatCache::buildId() of the interpreter that wrote it and FlatCache::checksum() of everything after the header
+    uint64_t build;
+    uint64_t checksum;
+};
+
+// A source, its text is in chars
+struct SnapshotSource
+{
+    uint64_t text;
+    uint32_t length;
+    uint32_t start;
+};
+
+// An entry of the Source line table
+struct SnapshotLine
+{
+    uint32_t offset;
+    int32_t line;
+};
+
+// Environment 0 is the globals. Its variables are a run in the variable table.
+struct SnapshotEnvironment
+{
+    uint32_t enclosing;
+    uint32_t firstVariable;
+    uint32_t variableCount;
+    uint32_t padding;
+};
+
+// A FlatFunction. Functions are shared, so a function stored in several variables is restored as one.
+struct SnapshotFunction
+{
+    uint32_t program;
+    uint32_t declaration;
+    uint32_t closure;
+    uint32_t padding;
+};
+
+// A variable and its value. Names and strings are in chars.
+struct SnapshotVariable
+{
+    uint64_t name;
+    uint32_t nameLength;
+    uint32_t type;
+    // NUMBER: the number. STRING: text and length. FUN: index of the function. TRUE / FALSE: index is 1 if the value
+    // is boxed, which literals are not (Operators::isEqual tells them apart).
+    double number;
+    uint64_t text;
+    uint32_t length;
+    uint32_t index;
+};
+
+static const char MAGIC[8] = "LOXSNAP";
+static const uint32_t NONE = 0xFFFFFFFF;
+
+// Append a table at the next 8-byte boundary and return where it starts
+template <typename T> static uint64_t append(std::vector<char> &bytes, const std::vector<T> &table)
+{
+    size_t offset = (bytes.size() + 7) & ~size_t(7);
+    bytes.resize(offset + table.size() * sizeof(T), 0);
+    if (!table.empty())
+        std::memcpy(bytes.data() + offset, table.data(), table.size() * sizeof(T));
+    return offset;
+}
+
+// The table of count entries at offset, or nullptr if it isn't in the file
+template <typename T> static const T *table(const char *bytes, size_t size, uint64_t offset, uint32_t count)
+{
+    if (offset % alignof(T) != 0 || offset > size || count > (size - offset) / sizeof(T))
+        return nullptr;
+    return reinterpret_cast<const T *>(bytes + offset);
+}
+
+// Whether following enclosing from any of the count environments reaches NONE, one pass over them
+static bool chainsEnd(const SnapshotEnvironment *environments, uint32_t count)
+{
+    enum State : uint8_t
+    {
+        UNSEEN,
+        OPEN,
+        DONE
+    };
+    std::vector<uint8_t> states(count, UNSEEN);
+    std::vector<uint32_t> chain;
+    for (uint32_t i = 0; i < count; i++)
+    {
+        uint32_t at = i;
+        while (at != NONE && states[at] == UNSEEN)
+        {
+            states[at] = OPEN;
+            chain.push_back(at);
+            at = environments[at].enclosing;
+        }
+        // Came back to an environment on this chain
+        if (at != NONE && states[at] == OPEN)
+            return false;
+        for (uint32_t environment : chain)
+            states[environment] = DONE;
+        chain.clear();
+    }
+    return true;
+}
+
+bool FlatSnapshot::save(const std::string &path, FlatInterpreter &interpreter)
+{
+    std::vector<char> bytes(sizeof(SnapshotHeader), 0);
+    std::string chars;
+
+    std::vector<SnapshotSource> sources;
+    for (size_t i = 0; i < Source::chunks.size(); i++)
+    {
+        const std::string &text = *Source::chunks[i];
+        sources.push_back({chars.size(), static_cast<uint32_t>(text.length()), Source::chunkStarts[i]});
+        chars += text;
+    }
+
+    std::vector<SnapshotLine> lines;
+    for (const auto &[offset, line] : Source::lines)
+        lines.push_back({offset, line});
+
+    std::vector<uint64_t> programs;
+    std::unordered_map<const FlatProgram *, uint32_t> programIndex;
+    for (auto &program : interpreter.programs)
+    {
+        programIndex[program.get()] = programs.size();
+        programs.push_back(FlatCache::write(bytes, *program->ast));
+    }
+
+    // Number environments and functions as they are found, walking out from the globals
+    std::vector<SnapshotEnvironment> environments;
+    std::vector<SnapshotFunction> functions;
+    std::vector<SnapshotVariable> variables;
+    std::unordered_map<const Environment *, uint32_t> environmentIndex;
+    std::unordered_map<const FlatFunction *, uint32_t> functionIndex;
+    std::deque<const Environment *> pending;
+
+    auto environmentOf = [&](const Environment *environment) {
+        if (environment == nullptr)
+            return NONE;
+        auto [found, added] = environmentIndex.emplace(environment, environmentIndex.size());
+        if (added)
+            pending.push_back(environment);
+        return found->second;
+    };
+    auto functionOf = [&](const FlatFunction *function) {
+        auto [found, added] = functionIndex.emplace(function, functions.size());
+        if (added)
+            functions.push_back({programIndex.at(function->program), function->declaration,
+                                 environmentOf(function->closure.get()), 0});
+        return found->second;
+    };
+
+    environmentOf(interpreter.globals.get());
+    while (!pending.empty())
+    {
+        const Environment *environment = pending.front();
+        pending.pop_front();
+
+        SnapshotEnvironment saved = {environmentOf(environment->enclosing.get()),
+                                     static_cast<uint32_t>(variables.size()),
+                                     static_cast<uint32_t>(environment->values.size()), 0};
+        for (const auto &[name, value] : environment->values)
+        {
+            SnapshotVariable variable = {};
+            variable.name = chars.size();
+            variable.nameLength = name.length();
+            variable.type = static_cast<uint32_t>(value.second);
+            chars += name;
+
+            switch (value.second)
+            {
+            case TokenInfo::Type::NUMBER:
+                variable.number = *static_cast<double *>(value.first.get());
+                break;
+            case TokenInfo::Type::STRING: {
+                const std::string &text = *static_cast<std::string *>(value.first.get());
+                variable.text = chars.size();
+                variable.length = text.length();
+                chars += text;
+                break;
+            }
+            case TokenInfo::Type::FUN:
+                variable.index = functionOf(static_cast<FlatFunction *>(value.first.get()));
+                break;
+            case TokenInfo::Type::TRUE:
+            case TokenInfo::Type::FALSE:
+                variable.index = value.first != nullptr;
+                break;
+            default:
+                break;
+            }
+            variables.push_back(variable);
+        }
+        environments.push_back(saved);
+    }
+
+    SnapshotHeader header = {};
+    std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = FORMAT_VERSION;
+    header.sourceCount = sources.size();
+    header.lineCount = lines.size();
+    header.programCount = programs.size();
+    header.environmentCount = environments.size();
+    header.functionCount = functions.size();
+    header.variableCount = variables.size();
+    header.sources = append(bytes, sources);
+    header.lines = append(bytes, lines);
+    header.programs = append(bytes, programs);
+    header.environments = append(bytes, environments);
+    header.functions = append(bytes, functions);
+    header.variables = append(bytes, variables);
+    header.chars = append(bytes, std::vector<char>(chars.begin(), chars.end()));
+    header.charCount = chars.size();
+    header.build = FlatCache::buildId();
+    header.checksum = FlatCache::checksum(bytes.data() + sizeof(header), bytes.size() - sizeof(header));
+    std::memcpy(bytes.data(), &header, sizeof(header));
+
+    return FlatCache::writeFile(path, bytes);
+}
+
+bool FlatSnapshot::load(const std::string &path, FlatInterpreter &interpreter)
+{
+    size_t size = 0;
+    std::shared_ptr<const void> mapping = FlatCache::map(path, size);
+    if (!mapping || size < sizeof(SnapshotHeader))
+        return false;
+    const char *bytes = static_cast<const char *>(mapping.get());
+
+    const SnapshotHeader *header = reinterpret_cast<const SnapshotHeader *>(bytes);
+    // Another build may number tokens or lower programs differently, and a damaged image can't be trusted
+    if (std::memcmp(header->magic, MAGIC, sizeof(MAGIC)) != 0 || header->version != FORMAT_VERSION ||
+        header->build != FlatCache::buildId() ||
+        header->checksum != FlatCache::checksum(bytes + sizeof(SnapshotHeader), size - sizeof(SnapshotHeader)))
+        return false;
+
+    auto *sources = table<SnapshotSource>(bytes, size, header->sources, header->sourceCount);
+    auto *lines = table<SnapshotLine>(bytes, size, header->lines, header->lineCount);
+    auto *programs = table<uint64_t>(bytes, size, header->programs, header->programCount);
+    auto *environments = table<SnapshotEnvironment>(bytes, size, header->environments, header->environmentCount);
+    auto *functions = table<SnapshotFunction>(bytes, size, header->functions, header->functionCount);
+    auto *variables = table<SnapshotVariable>(bytes, size, header->variables, header->variableCount);
+    const char *chars = bytes + header->chars;
+    if (!sources || !lines || !programs || !environments || !functions || !variables || header->chars > size ||
+        header->charCount > size - header->chars || header->environmentCount == 0)
+        return false;
+
+    // Offsets in the programs are only right if the sources go back where they were
+    if (Source::size != 0 || !interpreter.programs.empty())
+        return false;
+    auto inChars = [header](uint64_t offset, uint32_t length) {
+        return offset <= header->charCount && length <= header->charCount - offset;
+    };
+
+    for (uint32_t i = 0; i < header->sourceCount; i++)
+    {
+        if (!inChars(sources[i].text, sources[i].length) ||
+            Source::append(std::string(chars + sources[i].text, sources[i].length)) != sources[i].start)
+            return false;
+    }
+    Source::lines.reserve(header->lineCount);
+    for (uint32_t i = 0; i < header->lineCount; i++)
+        Source::lines.push_back({lines[i].offset, lines[i].line});
+
+    std::vector<const FlatProgram *> loaded;
+    for (uint32_t i = 0; i < header->programCount; i++)
+    {
+        std::unique_ptr<FlatAst> ast = FlatCache::view(bytes, size, programs[i], 0, Source::size);
+        if (!ast)
+            return false;
+        ast->storage = mapping;
+        loaded.push_back(interpreter.load(std::move(ast)));
+    }
+
+    // Create every environment first, then link them up, so they can refer to each other in any order
+    std::vector<std::shared_ptr<Environment>> restored(header->environmentCount);
+    restored[0] = interpreter.globals;
+    for (uint32_t i = 1; i < header->environmentCount; i++)
+        restored[i] = std::make_shared<Environment>();
+    for (uint32_t i = 0; i < header->environmentCount; i++)
+    {
+        uint32_t enclosing = environments[i].enclosing;
+        if (enclosing != NONE && enclosing >= header->environmentCount)
+            return false;
+    }
+    // Every chain of enclosing environments has to end, the globals at the end of it. A loop would make lookups of
+    // undefined names spin forever.
+    if (environments[0].enclosing != NONE || !chainsEnd(environments, header->environmentCount))
+        return false;
+    for (uint32_t i = 0; i < header->environmentCount; i++)
+    {
+        uint32_t enclosing = environments[i].enclosing;
+        restored[i]->enclosing = enclosing == NONE ? nullptr : restored[enclosing];
+    }
+
+    std::vector<std::shared_ptr<FlatFunction>> restoredFunctions;
+    restoredFunctions.reserve(header->functionCount);
+    for (uint32_t i = 0; i < header->functionCount; i++)
+    {
+        const SnapshotFunction &function = functions[i];
+        if (function.program >= loaded.size() || function.closure >= header->environmentCount ||
+            function.declaration >= loaded[function.program]->ast->functionStmts.count)
+            return false;
+        restoredFunctions.push_back(std::make_shared<FlatFunction>(
+            FlatFunction{loaded[function.program], function.declaration, restored[function.closure]}));
+    }
+
+    for (uint32_t i = 0; i < header->environmentCount; i++)
+    {
+        const SnapshotEnvironment &environment = environments[i];
+        if (environment.firstVariable > header->variableCount ||
+            environment.variableCount > header->variableCount - environment.firstVariable)
+            return false;
+
+        for (uint32_t j = 0; j < environment.variableCount; j++)
+        {
+            const SnapshotVariable &variable = variables[environment.firstVariable + j];
+            auto type = static_cast<TokenInfo::Type>(variable.type);
+            if (!inChars(variable.name, variable.nameLength))
+                return false;
+
+            std::shared_ptr<void> value;
+            switch (type)
+            {
+            case TokenInfo::Type::NUMBER:
+                value = std::make_shared<double>(variable.number);
+                break;
+            case TokenInfo::Type::STRING:
+                if (!inChars(variable.text, variable.length))
+                    return false;
+                value = std::make_shared<std::string>(chars + variable.text, variable.length);
+                break;
+            case TokenInfo::Type::FUN:
+                if (variable.index >= restoredFunctions.size())
+                    return false;
+                value = restoredFunctions[variable.index];
+                break;
+            case TokenInfo::Type::TRUE:
+            case TokenInfo::Type::FALSE:
+                if (variable.index)
+                    value = std::make_shared<bool>(type == TokenInfo::Type::TRUE);
+                break;
+            case TokenInfo::Type::NIL:
+            case TokenInfo::Type::UNINITIALIZED:
+                break;
+            // No other type has a value the interpreter can hold
+            default:
+                return false;
+            }
+
+            restored[i]->defineVar(std::string(chars + variable.name, variable.nameLength), std::move(value), type);
+        }
+    }
+
+    return true;
+}
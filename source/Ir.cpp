@@ -0,0 +1,247 @@
+#include "headers/Ir.hpp"
+#include "headers/CppEmitter.hpp"
+#include "headers/Operators.hpp"
+#include <algorithm>
+
+bool IrInstruction::canFail() const
+{
+    switch (op)
+    {
+    case LOAD:
+    case STORE:
+    case CHECK_INIT:
+    case CHECK_CALLABLE:
+    case CALL:
+        return true;
+    case UNARY:
+        return type == TokenInfo::Type::MINUS;
+    case BINARY:
+        return type != TokenInfo::Type::EQUAL_EQUAL && type != TokenInfo::Type::BANG_EQUAL;
+    default:
+        return false;
+    }
+}
+
+bool IrInstruction::hasEffect() const
+{
+    switch (op)
+    {
+    case STORE:
+    case DEFINE:
+    case CALL:
+    case PRINT:
+    case REPORT:
+        return true;
+    default:
+        return false;
+    }
+}
+
+uint32_t IrFunction::addBlock()
+{
+    blocks.emplace_back();
+    return static_cast<uint32_t>(blocks.size() - 1);
+}
+
+uint32_t IrFunction::add(uint32_t block, IrInstruction instruction)
+{
+    instruction.block = block;
+    values.push_back(std::move(instruction));
+    uint32_t value = static_cast<uint32_t>(values.size() - 1);
+    blocks[block].code.push_back(value);
+    return value;
+}
+
+void IrFunction::addEdge(uint32_t from, uint32_t to)
+{
+    blocks[to].predecessors.push_back(from);
+}
+
+void IrFunction::removeEdge(uint32_t from, uint32_t to)
+{
+    std::vector<uint32_t> &predecessors = blocks[to].predecessors;
+    auto edge = std::find(predecessors.begin(), predecessors.end(), from);
+    if (edge == predecessors.end())
+        return;
+
+    size_t index = edge - predecessors.begin();
+    predecessors.erase(edge);
+    for (uint32_t value : blocks[to].code)
+    {
+        if (values[value].op == IrInstruction::PHI)
+            values[value].operands.erase(values[value].operands.begin() + index);
+    }
+}
+
+std::vector<uint32_t> IrFunction::edges(uint32_t block) const
+{
+    std::vector<uint32_t> targets = blocks[block].successors;
+    if (blocks[block].unwind != IrBlock::NONE)
+        targets.push_back(blocks[block].unwind);
+    return targets;
+}
+
+void IrFunction::removeUnreachable()
+{
+    std::vector<bool> reachable(blocks.size());
+    std::vector<uint32_t> work = {0};
+    reachable[0] = true;
+    while (!work.empty())
+    {
+        uint32_t block = work.back();
+        work.pop_back();
+        for (uint32_t next : edges(block))
+        {
+            if (!reachable[next])
+            {
+                reachable[next] = true;
+                work.push_back(next);
+            }
+        }
+    }
+
+    for (uint32_t block = 0; block < blocks.size(); block++)
+    {
+        if (reachable[block] || blocks[block].removed)
+            continue;
+        for (uint32_t next : edges(block))
+            removeEdge(block, next);
+        for (uint32_t value : blocks[block].code)
+            values[value].removed = true;
+        blocks[block] = IrBlock();
+        blocks[block].removed = true;
+    }
+}
+
+/* -------------------- PRINTING -------------------- */
+
+static const char *opName(IrInstruction::Op op)
+{
+    switch (op)
+    {
+    case IrInstruction::CONSTANT:
+        return "constant";
+    case IrInstruction::ARGUMENT:
+        return "argument";
+    case IrInstruction::CLOSURE_ENV:
+        return "closure_env";
+    case IrInstruction::PHI:
+        return "phi";
+    case IrInstruction::COPY:
+        return "copy";
+    case IrInstruction::NEW_ENV:
+        return "new_env";
+    case IrInstruction::LOAD:
+        return "load";
+    case IrInstruction::STORE:
+        return "store";
+    case IrInstruction::DEFINE:
+        return "define";
+    case IrInstruction::CHECK_INIT:
+        return "check_init";
+    case IrInstruction::UNARY:
+        return "unary";
+    case IrInstruction::BINARY:
+        return "binary";
+    case IrInstruction::CHECK_CALLABLE:
+        return "check_callable";
+    case IrInstruction::CALL:
+        return "call";
+    case IrInstruction::CLOSURE:
+        return "closure";
+    case IrInstruction::PRINT:
+        return "print";
+    case IrInstruction::REPORT:
+        return "report";
+    }
+    return "?";
+}
+
+void IrFunction::print(std::ostream &out) const
+{
+    out << "function " << name << "(" << arity << ")\n";
+    for (uint32_t b = 0; b < blocks.size(); b++)
+    {
+        const IrBlock &block = blocks[b];
+        if (block.removed)
+            continue;
+
+        out << "b" << b << ":";
+        if (!block.predecessors.empty())
+        {
+            out << " <-";
+            for (uint32_t predecessor : block.predecessors)
+                out << " b" << predecessor;
+        }
+        out << "\n";
+
+        for (uint32_t v : block.code)
+        {
+            const IrInstruction &in = values[v];
+            out << "    v" << v << " = " << opName(in.op);
+            switch (in.op)
+            {
+            case IrInstruction::CONSTANT:
+                if (in.constant.second == TokenInfo::Type::STRING)
+                    out << " " << CppEmitter::quote(*std::static_pointer_cast<std::string>(in.constant.first));
+                else if (in.constant.second == TokenInfo::Type::UNINITIALIZED)
+                    out << " uninitialized";
+                else
+                    out << " " << Operators::stringify(in.constant.first, in.constant.second);
+                break;
+            case IrInstruction::ARGUMENT:
+                out << " " << in.index;
+                break;
+            case IrInstruction::UNARY:
+            case IrInstruction::BINARY:
+                out << " " << in.token.getLexeme();
+                break;
+            case IrInstruction::LOAD:
+            case IrInstruction::STORE:
+            case IrInstruction::DEFINE:
+                out << " '" << in.token.getLexeme() << "'";
+                break;
+            case IrInstruction::CLOSURE:
+                out << " " << in.function->name;
+                break;
+            default:
+                break;
+            }
+            for (uint32_t operand : in.operands)
+                out << " v" << operand;
+            out << "\n";
+        }
+
+        switch (block.end)
+        {
+        case IrBlock::End::JUMP:
+            out << "    jump b" << block.successors[0];
+            break;
+        case IrBlock::End::BRANCH:
+            out << "    branch v" << block.value << " b" << block.successors[0] << " b" << block.successors[1];
+            break;
+        case IrBlock::End::RETURN:
+            out << "    return v" << block.value;
+            break;
+        case IrBlock::End::HALT:
+            out << "    halt";
+            break;
+        case IrBlock::End::UNREACHABLE:
+            out << "    unreachable";
+            break;
+        }
+        if (block.unwind != IrBlock::NONE)
+            out << " unwind b" << block.unwind;
+        out << "\n";
+    }
+}
+
+void IrProgram::print(std::ostream &out) const
+{
+    for (size_t i = 0; i < functions.size(); i++)
+    {
+        if (i > 0)
+            out << "\n";
+        functions[i]->print(out);
+    }
+}
@@ -0,0 +1,733 @@
+#include "headers/IrBuilder.hpp"
+
+std::unique_ptr<IrProgram> IrBuilder::build(const std::vector<std::unique_ptr<Stmt>> &statements)
+{
+    auto program = std::make_unique<IrProgram>();
+    program->functions.push_back(std::make_unique<IrFunction>());
+    IrFunction &script = *program->functions.back();
+    script.name = "script";
+
+    IrBuilder builder(*program, script, true);
+    for (const auto &statement : statements)
+        builder.capture(*statement);
+    builder.newBlock();
+    builder.seal(0);
+    builder.scopes.push_back({{}, builder.emit(IrInstruction::CLOSURE_ENV)});
+
+    // A runtime error escaping a top-level statement is reported and ends the script
+    uint32_t halt = builder.newBlock();
+    builder.handlers.push_back(halt);
+    for (const auto &statement : statements)
+    {
+        builder.statementEnd = builder.newBlock();
+        builder.execute(statement);
+        builder.jump(builder.statementEnd);
+        builder.seal(builder.statementEnd);
+        builder.current = builder.statementEnd;
+    }
+    builder.ret(builder.constant({nullptr, TokenInfo::Type::NIL}));
+
+    builder.seal(halt);
+    builder.current = halt;
+    builder.emit(IrInstruction::REPORT);
+    script.blocks[halt].end = IrBlock::End::HALT;
+
+    script.removeUnreachable();
+    return program;
+}
+
+const IrFunction *IrBuilder::buildFunction(IrProgram &program, const Function &declaration)
+{
+    program.functions.push_back(std::make_unique<IrFunction>());
+    IrFunction &function = *program.functions.back();
+    function.name = std::string(declaration.name.getLexeme());
+    function.arity = declaration.params.size();
+
+    const std::vector<std::unique_ptr<Stmt>> &body = declaration.getBody();
+    IrBuilder builder(program, function, false);
+    for (const auto &statement : body)
+        builder.capture(*statement);
+    builder.newBlock();
+    builder.seal(0);
+    builder.scopes.push_back({{}, builder.emit(IrInstruction::CLOSURE_ENV)});
+
+    // Like LoxFunction::call, a runtime error escaping the body makes the call return nil
+    uint32_t returnNil = builder.newBlock();
+    builder.handlers.push_back(returnNil);
+
+    // Parameters and the declarations of the body share one environment
+    builder.enterScope(body, declaration.params);
+    for (uint32_t i = 0; i < declaration.params.size(); i++)
+    {
+        IrInstruction argument{IrInstruction::ARGUMENT};
+        argument.index = i;
+        builder.declare(declaration.params[i], builder.emit(std::move(argument)), true);
+    }
+    for (const auto &statement : body)
+        builder.execute(statement);
+    builder.ret(builder.constant({nullptr, TokenInfo::Type::NIL}));
+
+    builder.seal(returnNil);
+    builder.current = returnNil;
+    builder.ret(builder.constant({nullptr, TokenInfo::Type::NIL}));
+
+    function.removeUnreachable();
+    return &function;
+}
+
+/* -------------------- NAMES -------------------- */
+
+void IrBuilder::mention(const Expr &expr, std::unordered_set<std::string_view> &names)
+{
+    switch (expr.kind)
+    {
+    case ExprKind::Assign: {
+        const auto &assign = static_cast<const Assign &>(expr);
+        names.insert(assign.name.getLexeme());
+        mention(*assign.value, names);
+        break;
+    }
+    case ExprKind::Binary:
+        mention(*static_cast<const Binary &>(expr).left, names);
+        mention(*static_cast<const Binary &>(expr).right, names);
+        break;
+    case ExprKind::Call: {
+        const auto &call = static_cast<const Call &>(expr);
+        mention(*call.callee, names);
+        for (const auto &argument : call.arguments)
+            mention(*argument, names);
+        break;
+    }
+    case ExprKind::Grouping:
+        mention(*static_cast<const Grouping &>(expr).expression, names);
+        break;
+    case ExprKind::Literal:
+        break;
+    case ExprKind::Logical:
+        mention(*static_cast<const Logical &>(expr).left, names);
+        mention(*static_cast<const Logical &>(expr).right, names);
+        break;
+    case ExprKind::Unary:
+        mention(*static_cast<const Unary &>(expr).right, names);
+        break;
+    case ExprKind::Variable:
+        names.insert(static_cast<const Variable &>(expr).name.getLexeme());
+        break;
+    }
+}
+
+void IrBuilder::mention(const Stmt &stmt, std::unordered_set<std::string_view> &names)
+{
+    switch (stmt.kind)
+    {
+    case StmtKind::Block:
+        for (const auto &statement : static_cast<const Block &>(stmt).statements)
+            mention(*statement, names);
+        break;
+    case StmtKind::Break:
+        break;
+    case StmtKind::Expression:
+        mention(*static_cast<const Expression &>(stmt).expression, names);
+        break;
+    case StmtKind::Function: {
+        const auto &function = static_cast<const Function &>(stmt);
+        names.insert(function.name.getLexeme());
+        for (const auto &statement : function.getBody())
+            mention(*statement, names);
+        break;
+    }
+    case StmtKind::If: {
+        const auto &ifStmt = static_cast<const If &>(stmt);
+        mention(*ifStmt.condition, names);
+        mention(*ifStmt.thenBranch, names);
+        if (ifStmt.elseBranch != nullptr)
+            mention(*ifStmt.elseBranch, names);
+        break;
+    }
+    case StmtKind::Print:
+        mention(*static_cast<const Print &>(stmt).expression, names);
+        break;
+    case StmtKind::Return:
+        if (static_cast<const Return &>(stmt).value != nullptr)
+            mention(*static_cast<const Return &>(stmt).value, names);
+        break;
+    case StmtKind::Var: {
+        const auto &var = static_cast<const Var &>(stmt);
+        names.insert(var.name.getLexeme());
+        if (var.initializer != nullptr)
+            mention(*var.initializer, names);
+        break;
+    }
+    case StmtKind::While:
+        mention(*static_cast<const While &>(stmt).condition, names);
+        mention(*static_cast<const While &>(stmt).body, names);
+        break;
+    }
+}
+
+void IrBuilder::capture(const Stmt &stmt)
+{
+    // Every name in a nested function might refer to one of ours (through its closure)
+    switch (stmt.kind)
+    {
+    case StmtKind::Function:
+        mention(stmt, captured);
+        break;
+    case StmtKind::Block:
+        for (const auto &statement : static_cast<const Block &>(stmt).statements)
+            capture(*statement);
+        break;
+    case StmtKind::If:
+        capture(*static_cast<const If &>(stmt).thenBranch);
+        if (static_cast<const If &>(stmt).elseBranch != nullptr)
+            capture(*static_cast<const If &>(stmt).elseBranch);
+        break;
+    case StmtKind::While:
+        capture(*static_cast<const While &>(stmt).body);
+        break;
+    default:
+        break;
+    }
+}
+
+uint32_t IrBuilder::env() const
+{
+    return scopes.back().env;
+}
+
+bool IrBuilder::promoted(std::string_view name) const
+{
+    return !(topLevel && scopes.size() == 1) && captured.count(name) == 0;
+}
+
+const IrBuilder::Local *IrBuilder::find(std::string_view name) const
+{
+    for (size_t i = scopes.size(); i-- > 0;)
+    {
+        const std::vector<Local> &locals = scopes[i].locals;
+        for (size_t j = locals.size(); j-- > 0;)
+        {
+            if (locals[j].name == name)
+                return &locals[j];
+        }
+    }
+    return nullptr;
+}
+
+void IrBuilder::enterScope(const std::vector<std::unique_ptr<Stmt>> &statements, const std::vector<Token> &params)
+{
+    // Only a scope declaring something that has to stay in an environment gets one of its own
+    bool needsEnv = false;
+    for (const Token &param : params)
+        needsEnv |= !promoted(param.getLexeme());
+    for (const auto &statement : statements)
+    {
+        if (statement->kind == StmtKind::Var)
+            needsEnv |= !promoted(static_cast<const Var &>(*statement).name.getLexeme());
+        else if (statement->kind == StmtKind::Function)
+            needsEnv |= !promoted(static_cast<const Function &>(*statement).name.getLexeme());
+    }
+
+    uint32_t outer = env();
+    scopes.push_back({{}, needsEnv ? emit(IrInstruction::NEW_ENV, {outer}) : outer});
+}
+
+void IrBuilder::declare(const Token &name, uint32_t value, bool initialized)
+{
+    if (!promoted(name.getLexeme()))
+    {
+        IrInstruction define{IrInstruction::DEFINE};
+        define.operands = {env(), value};
+        define.token = name;
+        emit(std::move(define));
+        return;
+    }
+
+    uint32_t id = nextLocal++;
+    scopes.back().locals.push_back({name.getLexeme(), id, initialized});
+    write(id, current, value);
+}
+
+/* -------------------- BLOCKS -------------------- */
+
+uint32_t IrBuilder::newBlock()
+{
+    definitions.emplace_back();
+    incompletePhis.emplace_back();
+    sealed.push_back(false);
+    return function.addBlock();
+}
+
+void IrBuilder::seal(uint32_t block)
+{
+    std::vector<std::pair<uint32_t, uint32_t>> phis = std::move(incompletePhis[block]);
+    incompletePhis[block].clear();
+    for (const auto &[local, phi] : phis)
+        addPhiOperands(local, phi);
+    sealed[block] = true;
+}
+
+void IrBuilder::startUnreachable()
+{
+    current = newBlock();
+    seal(current);
+}
+
+uint32_t IrBuilder::emit(IrInstruction::Op op, std::vector<uint32_t> operands)
+{
+    IrInstruction instruction{op};
+    instruction.operands = std::move(operands);
+    return emit(std::move(instruction));
+}
+
+uint32_t IrBuilder::emit(IrInstruction instruction)
+{
+    bool canFail = instruction.canFail();
+    uint32_t value = function.add(current, std::move(instruction));
+    if (!canFail)
+        return value;
+
+    // The instruction ends the block: on to the next one, or to the handler if it fails
+    function.blocks[current].unwind = handlers.back();
+    function.addEdge(current, handlers.back());
+    uint32_t next = newBlock();
+    jump(next);
+    seal(next);
+    current = next;
+    return value;
+}
+
+uint32_t IrBuilder::constant(Value value)
+{
+    IrInstruction instruction{IrInstruction::CONSTANT};
+    instruction.constant = std::move(value);
+    return emit(std::move(instruction));
+}
+
+void IrBuilder::jump(uint32_t to)
+{
+    IrBlock &block = function.blocks[current];
+    block.end = IrBlock::End::JUMP;
+    block.successors = {to};
+    function.addEdge(current, to);
+}
+
+void IrBuilder::branch(uint32_t condition, uint32_t ifTruthy, uint32_t ifFalsy)
+{
+    IrBlock &block = function.blocks[current];
+    block.end = IrBlock::End::BRANCH;
+    block.value = condition;
+    block.successors = {ifTruthy, ifFalsy};
+    function.addEdge(current, ifTruthy);
+    function.addEdge(current, ifFalsy);
+}
+
+void IrBuilder::ret(uint32_t value)
+{
+    IrBlock &block = function.blocks[current];
+    block.end = IrBlock::End::RETURN;
+    block.value = value;
+}
+
+uint32_t IrBuilder::merge(uint32_t join, const std::vector<std::pair<uint32_t, uint32_t>> &incoming)
+{
+    IrInstruction phi{IrInstruction::PHI};
+    for (uint32_t predecessor : function.blocks[join].predecessors)
+    {
+        for (const auto &[block, value] : incoming)
+        {
+            if (block == predecessor)
+            {
+                phi.operands.push_back(value);
+                break;
+            }
+        }
+    }
+
+    bool same = true;
+    for (uint32_t operand : phi.operands)
+        same &= operand == phi.operands[0];
+    if (same)
+        return phi.operands[0];
+
+    phi.block = join;
+    function.values.push_back(std::move(phi));
+    uint32_t value = static_cast<uint32_t>(function.values.size() - 1);
+    std::vector<uint32_t> &code = function.blocks[join].code;
+    code.insert(code.begin(), value);
+    return value;
+}
+
+/* -------------------- SSA CONSTRUCTION -------------------- */
+
+void IrBuilder::write(uint32_t local, uint32_t block, uint32_t value)
+{
+    definitions[block][local] = value;
+}
+
+uint32_t IrBuilder::read(uint32_t local, uint32_t block)
+{
+    auto definition = definitions[block].find(local);
+    if (definition != definitions[block].end())
+        return definition->second;
+    return readRecursive(local, block);
+}
+
+uint32_t IrBuilder::readRecursive(uint32_t local, uint32_t block)
+{
+    uint32_t value;
+    const std::vector<uint32_t> &predecessors = function.blocks[block].predecessors;
+    if (!sealed[block])
+    {
+        value = addPhi(block);
+        incompletePhis[block].push_back({local, value});
+    }
+    else if (predecessors.size() == 1)
+        value = read(local, predecessors[0]);
+    else if (predecessors.empty())
+    {
+        // Unreachable code: any value will do
+        value = addPhi(block);
+        function.values[value].op = IrInstruction::CONSTANT;
+        function.values[value].constant = {nullptr, TokenInfo::Type::NIL};
+    }
+    else
+    {
+        // Break cycles (loops) with a phi without operands first
+        value = addPhi(block);
+        write(local, block, value);
+        value = addPhiOperands(local, value);
+    }
+    write(local, block, value);
+    return value;
+}
+
+uint32_t IrBuilder::addPhi(uint32_t block)
+{
+    IrInstruction phi{IrInstruction::PHI};
+    phi.block = block;
+    function.values.push_back(std::move(phi));
+    uint32_t value = static_cast<uint32_t>(function.values.size() - 1);
+    std::vector<uint32_t> &code = function.blocks[block].code;
+    code.insert(code.begin(), value);
+    return value;
+}
+
+uint32_t IrBuilder::addPhiOperands(uint32_t local, uint32_t phi)
+{
+    // Reading can add values (and move the vector), so no references across it
+    std::vector<uint32_t> predecessors = function.blocks[function.values[phi].block].predecessors;
+    for (uint32_t predecessor : predecessors)
+    {
+        uint32_t operand = read(local, predecessor);
+        function.values[phi].operands.push_back(operand);
+    }
+    return tryRemoveTrivialPhi(phi);
+}
+
+uint32_t IrBuilder::tryRemoveTrivialPhi(uint32_t phi)
+{
+    IrInstruction &instruction = function.values[phi];
+    uint32_t same = IrBlock::NONE;
+    for (uint32_t operand : instruction.operands)
+    {
+        if (operand == same || operand == phi)
+            continue;
+        if (same != IrBlock::NONE)
+            return phi;
+        same = operand;
+    }
+
+    // A phi merging one value is a copy of it (the optimizer propagates it to the uses)
+    if (same == IrBlock::NONE)
+    {
+        instruction.op = IrInstruction::CONSTANT;
+        instruction.constant = {nullptr, TokenInfo::Type::NIL};
+        instruction.operands.clear();
+        return phi;
+    }
+    instruction.op = IrInstruction::COPY;
+    instruction.operands = {same};
+    return phi;
+}
+
+/* -------------------- EXPRESSIONS -------------------- */
+
+uint32_t IrBuilder::evaluate(const std::unique_ptr<Expr> &expr)
+{
+    return expr->accept(*this);
+}
+
+uint32_t IrBuilder::evaluateReported(const std::unique_ptr<Expr> &expr)
+{
+    uint32_t handler = newBlock();
+    handlers.push_back(handler);
+    uint32_t value = evaluate(expr);
+    handlers.pop_back();
+    seal(handler);
+
+    // Nothing in it can fail
+    if (function.blocks[handler].predecessors.empty())
+    {
+        function.blocks[handler].removed = true;
+        return value;
+    }
+
+    uint32_t join = newBlock();
+    uint32_t evaluated = current;
+    jump(join);
+
+    current = handler;
+    emit(IrInstruction::REPORT);
+    uint32_t nil = constant({nullptr, TokenInfo::Type::NIL});
+    jump(join);
+
+    seal(join);
+    uint32_t reported = current;
+    current = join;
+    return merge(join, {{evaluated, value}, {reported, nil}});
+}
+
+uint32_t IrBuilder::visitLiteralExpr(const Literal &expr)
+{
+    if (expr.type == TokenInfo::Type::NIL)
+        return constant({nullptr, TokenInfo::Type::NIL});
+    return constant({expr.value, expr.type});
+}
+
+uint32_t IrBuilder::visitGroupingExpr(const Grouping &expr)
+{
+    return evaluate(expr.expression);
+}
+
+uint32_t IrBuilder::visitVariableExpr(const Variable &expr)
+{
+    IrInstruction instruction{IrInstruction::LOAD};
+    instruction.token = expr.name;
+    if (const Local *local = find(expr.name.getLexeme()))
+    {
+        uint32_t value = read(local->id, current);
+        if (local->initialized)
+            return value;
+        instruction.op = IrInstruction::CHECK_INIT;
+        instruction.operands = {value};
+    }
+    else
+        instruction.operands = {env()};
+    return emit(std::move(instruction));
+}
+
+uint32_t IrBuilder::visitAssignExpr(const Assign &expr)
+{
+    uint32_t value = evaluate(expr.value);
+    if (const Local *local = find(expr.name.getLexeme()))
+    {
+        write(local->id, current, value);
+        return value;
+    }
+
+    IrInstruction store{IrInstruction::STORE};
+    store.operands = {env(), value};
+    store.token = expr.name;
+    emit(std::move(store));
+    return value;
+}
+
+uint32_t IrBuilder::visitUnaryExpr(const Unary &expr)
+{
+    IrInstruction unary{IrInstruction::UNARY};
+    unary.operands = {evaluate(expr.right)};
+    unary.type = expr.op.getType();
+    unary.token = expr.op;
+    return emit(std::move(unary));
+}
+
+uint32_t IrBuilder::visitBinaryExpr(const Binary &expr)
+{
+    IrInstruction binary{IrInstruction::BINARY};
+    uint32_t left = evaluate(expr.left);
+    binary.operands = {left, evaluate(expr.right)};
+    binary.type = expr.op.getType();
+    binary.token = expr.op;
+    return emit(std::move(binary));
+}
+
+uint32_t IrBuilder::visitLogicalExpr(const Logical &expr)
+{
+    // Both operands are evaluated like AstInterpreter::visitLogicalExpr does, reporting their errors
+    uint32_t left = evaluateReported(expr.left);
+    uint32_t right = newBlock();
+    uint32_t join = newBlock();
+    if (expr.op.getType() == TokenInfo::Type::OR)
+        branch(left, join, right);
+    else
+        branch(left, right, join);
+    uint32_t shortCircuit = current;
+
+    seal(right);
+    current = right;
+    uint32_t value = evaluateReported(expr.right);
+    jump(join);
+    uint32_t evaluated = current;
+
+    seal(join);
+    current = join;
+    return merge(join, {{shortCircuit, left}, {evaluated, value}});
+}
+
+uint32_t IrBuilder::visitCallExpr(const Call &expr)
+{
+    IrInstruction check{IrInstruction::CHECK_CALLABLE};
+    check.operands = {evaluate(expr.callee)};
+    check.token = expr.paren;
+
+    IrInstruction call{IrInstruction::CALL};
+    call.operands = {emit(std::move(check))};
+    for (const auto &argument : expr.arguments)
+    {
+        uint32_t value = evaluate(argument);
+        call.operands.push_back(value);
+    }
+    call.token = expr.paren;
+    return emit(std::move(call));
+}
+
+/* -------------------- STATEMENTS -------------------- */
+
+void IrBuilder::execute(const std::unique_ptr<Stmt> &stmt)
+{
+    stmt->accept(*this);
+}
+
+void IrBuilder::visitExpressionStmt(const Expression &stmt)
+{
+    evaluateReported(stmt.expression);
+}
+
+void IrBuilder::visitPrintStmt(const Print &stmt)
+{
+    // Only printed if it evaluated without error
+    uint32_t handler = newBlock();
+    handlers.push_back(handler);
+    uint32_t value = evaluate(stmt.expression);
+    handlers.pop_back();
+    seal(handler);
+    emit(IrInstruction::PRINT, {value});
+
+    if (function.blocks[handler].predecessors.empty())
+    {
+        function.blocks[handler].removed = true;
+        return;
+    }
+
+    uint32_t join = newBlock();
+    jump(join);
+    current = handler;
+    emit(IrInstruction::REPORT);
+    jump(join);
+    seal(join);
+    current = join;
+}
+
+void IrBuilder::visitVarStmt(const Var &stmt)
+{
+    // Evaluated before the name is declared, var a = a; reads the a from outside
+    uint32_t value = stmt.initializer != nullptr ? evaluate(stmt.initializer)
+                                                 : constant({nullptr, TokenInfo::Type::UNINITIALIZED});
+    declare(stmt.name, value, stmt.initializer != nullptr);
+}
+
+void IrBuilder::visitBlockStmt(const Block &stmt)
+{
+    // Like AstInterpreter::executeBlock, an error escaping the block only abandons the block
+    uint32_t exit = newBlock();
+    handlers.push_back(exit);
+    enterScope(stmt.statements);
+    for (const auto &statement : stmt.statements)
+        execute(statement);
+    scopes.pop_back();
+    handlers.pop_back();
+
+    jump(exit);
+    seal(exit);
+    current = exit;
+}
+
+void IrBuilder::visitIfStmt(const If &stmt)
+{
+    uint32_t condition = evaluateReported(stmt.condition);
+    uint32_t thenBlock = newBlock();
+    uint32_t after = newBlock();
+    uint32_t elseBlock = stmt.elseBranch != nullptr ? newBlock() : after;
+    branch(condition, thenBlock, elseBlock);
+
+    seal(thenBlock);
+    current = thenBlock;
+    execute(stmt.thenBranch);
+    jump(after);
+
+    if (stmt.elseBranch != nullptr)
+    {
+        seal(elseBlock);
+        current = elseBlock;
+        execute(stmt.elseBranch);
+        jump(after);
+    }
+
+    seal(after);
+    current = after;
+}
+
+void IrBuilder::visitWhileStmt(const While &stmt)
+{
+    // The header isn't sealed before the body, which jumps back to it
+    uint32_t header = newBlock();
+    jump(header);
+    current = header;
+    uint32_t condition = evaluateReported(stmt.condition);
+
+    uint32_t body = newBlock();
+    uint32_t exit = newBlock();
+    branch(condition, body, exit);
+
+    seal(body);
+    current = body;
+    loopExits.push_back(exit);
+    execute(stmt.body);
+    loopExits.pop_back();
+    jump(header);
+
+    seal(header);
+    seal(exit);
+    current = exit;
+}
+
+void IrBuilder::visitBreakStmt(const Break &)
+{
+    // Outside of loops, break ends the call (or the top-level statement) like in the ClosureInterpreter
+    if (!loopExits.empty())
+        jump(loopExits.back());
+    else if (topLevel)
+        jump(statementEnd);
+    else
+        ret(constant({nullptr, TokenInfo::Type::NIL}));
+    startUnreachable();
+}
+
+void IrBuilder::visitReturnStmt(const Return &stmt)
+{
+    uint32_t value = stmt.value != nullptr ? evaluateReported(stmt.value) : constant({nullptr, TokenInfo::Type::NIL});
+    if (topLevel)
+        jump(statementEnd);
+    else
+        ret(value);
+    startUnreachable();
+}
+
+void IrBuilder::visitFunctionStmt(const Function &stmt)
+{
+    IrInstruction closure{IrInstruction::CLOSURE};
+    closure.operands = {env()};
+    closure.function = buildFunction(program, stmt);
+    declare(stmt.name, emit(std::move(closure)), true);
+}
@@ -0,0 +1,191 @@
+#include "headers/IrInterpreter.hpp"
+#include "headers/IrBuilder.hpp"
+#include "headers/IrOptimizer.hpp"
+#include "headers/Loxpp.hpp"
+#include "headers/Operators.hpp"
+#include "headers/RuntimeError.hpp"
+#include <iostream>
+#include <optional>
+
+void IrInterpreter::interpret(const std::vector<std::unique_ptr<Stmt>> &statements)
+{
+    std::unique_ptr<IrProgram> program = IrBuilder::build(statements);
+    if (Loxpp::options.irOptimize)
+        IrOptimizer::optimize(*program);
+
+    if (Loxpp::options.dumpIr)
+    {
+        program->print(std::cout);
+        return;
+    }
+
+    programs.push_back(std::move(program));
+    run(*programs.back()->functions[0], globals, {});
+}
+
+// Environments are kept in registers like values, type-erased the same way
+static Environment *environment(const Value &value)
+{
+    return static_cast<Environment *>(value.first.get());
+}
+
+Value IrInterpreter::run(const IrFunction &function, const std::shared_ptr<Environment> &closure,
+                         const std::vector<Value> &arguments)
+{
+    std::vector<Value> regs(function.values.size());
+    std::vector<Value> phis;
+    std::optional<RuntimeError> error;
+
+    uint32_t block = 0;
+    uint32_t from = IrBlock::NONE;
+    while (true)
+    {
+        const IrBlock &current = function.blocks[block];
+
+        // Phis read the registers as they were at the end of the predecessor, so they are all read before any is set
+        if (from != IrBlock::NONE)
+        {
+            size_t edge = 0;
+            while (current.predecessors[edge] != from)
+                edge++;
+            phis.clear();
+            for (uint32_t v : current.code)
+            {
+                if (function.values[v].op == IrInstruction::PHI)
+                    phis.push_back(regs[function.values[v].operands[edge]]);
+            }
+            size_t next = 0;
+            for (uint32_t v : current.code)
+            {
+                if (function.values[v].op == IrInstruction::PHI)
+                    regs[v] = std::move(phis[next++]);
+            }
+        }
+
+        try
+        {
+            for (uint32_t v : current.code)
+            {
+                const IrInstruction &in = function.values[v];
+                const std::vector<uint32_t> &ops = in.operands;
+                switch (in.op)
+                {
+                case IrInstruction::CONSTANT:
+                    regs[v] = in.constant;
+                    break;
+                case IrInstruction::ARGUMENT:
+                    regs[v] = arguments[in.index];
+                    break;
+                case IrInstruction::CLOSURE_ENV:
+                    regs[v] = {closure, TokenInfo::Type::NIL};
+                    break;
+                case IrInstruction::PHI:
+                    break;
+                case IrInstruction::COPY:
+                    regs[v] = regs[ops[0]];
+                    break;
+                case IrInstruction::NEW_ENV:
+                    regs[v] = {std::make_shared<Environment>(std::static_pointer_cast<Environment>(regs[ops[0]].first)),
+                               TokenInfo::Type::NIL};
+                    break;
+
+                case IrInstruction::LOAD: {
+                    Value &binding = environment(regs[ops[0]])->lookup(in.token, in.cache);
+                    if (binding.second == TokenInfo::Type::UNINITIALIZED)
+                        throw RuntimeError(in.token, "Variable used before being initialized.");
+                    regs[v] = binding;
+                    break;
+                }
+                case IrInstruction::STORE: {
+                    Value value = regs[ops[1]];
+                    environment(regs[ops[0]])->assign(in.token, value.first, value.second);
+                    regs[v] = std::move(value);
+                    break;
+                }
+                case IrInstruction::DEFINE:
+                    environment(regs[ops[0]])
+                        ->defineVar(std::string(in.token.getLexeme()), regs[ops[1]].first, regs[ops[1]].second);
+                    break;
+                case IrInstruction::CHECK_INIT:
+                    if (regs[ops[0]].second == TokenInfo::Type::UNINITIALIZED)
+                        throw RuntimeError(in.token, "Variable used before being initialized.");
+                    regs[v] = regs[ops[0]];
+                    break;
+
+                case IrInstruction::UNARY:
+                    if (const char *message = Operators::unary(in.type, regs[ops[0]], regs[v]))
+                        throw RuntimeError(in.token, message);
+                    break;
+                case IrInstruction::BINARY:
+                    if (const char *message = Operators::binary(in.type, regs[ops[0]], regs[ops[1]], regs[v]))
+                        throw RuntimeError(in.token, message);
+                    break;
+
+                case IrInstruction::CHECK_CALLABLE:
+                    if (regs[ops[0]].second != TokenInfo::Type::FUN && regs[ops[0]].second != TokenInfo::Type::CLASS)
+                        throw RuntimeError(in.token, "Can only call functions and classes.");
+                    regs[v] = regs[ops[0]];
+                    break;
+                case IrInstruction::CALL: {
+                    // Keep the callee alive until the call is done
+                    auto callee = std::static_pointer_cast<IrClosure>(regs[ops[0]].first);
+                    size_t count = ops.size() - 1;
+                    if (count != callee->function->arity)
+                        throw RuntimeError(in.token, "Expected " + std::to_string(callee->function->arity) +
+                                                         " arguments but got " + std::to_string(count) + ".");
+
+                    if (callStack.full(Loxpp::options.maxDepth))
+                        throw RuntimeError(in.token, "Stack overflow.");
+                    CallStack::Frame frame(callStack, {callee.get(), in.token.getOffset()});
+
+                    std::vector<Value> values;
+                    values.reserve(count);
+                    for (size_t i = 1; i < ops.size(); i++)
+                        values.push_back(regs[ops[i]]);
+                    regs[v] = run(*callee->function, callee->closure, values);
+                    break;
+                }
+                case IrInstruction::CLOSURE:
+                    regs[v] = {std::make_shared<IrClosure>(IrClosure{
+                                   in.function, std::static_pointer_cast<Environment>(regs[ops[0]].first)}),
+                               TokenInfo::Type::FUN};
+                    break;
+
+                case IrInstruction::PRINT:
+                    std::cout << Operators::stringify(regs[ops[0]].first, regs[ops[0]].second) << "\n";
+                    break;
+                case IrInstruction::REPORT:
+                    Loxpp::runtimeError(*error);
+                    break;
+                }
+            }
+        }
+        catch (RuntimeError &thrown)
+        {
+            // Only the last instruction of a block can fail, its block says where the error goes
+            if (current.unwind == IrBlock::NONE)
+                throw;
+            error.emplace(thrown);
+            from = block;
+            block = current.unwind;
+            continue;
+        }
+
+        from = block;
+        switch (current.end)
+        {
+        case IrBlock::End::JUMP:
+            block = current.successors[0];
+            break;
+        case IrBlock::End::BRANCH:
+            block = Operators::isTruthy(regs[current.value].first, regs[current.value].second) ? current.successors[0]
+                                                                                                : current.successors[1];
+            break;
+        case IrBlock::End::RETURN:
+            return regs[current.value];
+        case IrBlock::End::HALT:
+        case IrBlock::End::UNREACHABLE:
+            return {nullptr, TokenInfo::Type::NIL};
+        }
+    }
+}
@@ -0,0 +1,744 @@
+#include "headers/IrOptimizer.hpp"
+#include "headers/Operators.hpp"
+#include <algorithm>
+#include <cstring>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+void IrOptimizer::optimize(IrProgram &program)
+{
+    for (const auto &function : program.functions)
+        optimize(*function);
+}
+
+void IrOptimizer::optimize(IrFunction &function)
+{
+    propagateConstants(function);
+    propagateCopies(function);
+    numberValues(function);
+    propagateCopies(function);
+    eliminateDeadCode(function);
+    mergeBlocks(function);
+    propagateCopies(function);
+    eliminateDeadCode(function);
+}
+
+/* -------------------- HELPERS -------------------- */
+
+// Whether value is the last instruction of its block and an error in it goes somewhere
+static bool failing(const IrFunction &function, uint32_t value)
+{
+    const IrInstruction &instruction = function.values[value];
+    const IrBlock &block = function.blocks[instruction.block];
+    return block.unwind != IrBlock::NONE && block.code.back() == value && instruction.canFail();
+}
+
+static void dropUnwind(IrFunction &function, uint32_t block)
+{
+    if (function.blocks[block].unwind == IrBlock::NONE)
+        return;
+    function.removeEdge(block, function.blocks[block].unwind);
+    function.blocks[block].unwind = IrBlock::NONE;
+}
+
+static void makeCopy(IrFunction &function, uint32_t value, uint32_t of)
+{
+    IrInstruction &instruction = function.values[value];
+    bool wasFailing = failing(function, value);
+    instruction.op = IrInstruction::COPY;
+    instruction.operands = {of};
+    if (wasFailing)
+        dropUnwind(function, instruction.block);
+}
+
+// Same data and the same kind of pointer: a literal true is a nullptr, a computed one isn't (see Operators::isEqual)
+static bool sameConstant(const Value &left, const Value &right)
+{
+    if (left.second != right.second || (left.first == nullptr) != (right.first == nullptr))
+        return false;
+    if (left.first == nullptr)
+        return true;
+
+    switch (left.second)
+    {
+    case TokenInfo::Type::NUMBER:
+        // Bit for bit, so 0 and -0 (which print differently) stay apart
+        return std::memcmp(left.first.get(), right.first.get(), sizeof(double)) == 0;
+    case TokenInfo::Type::STRING:
+        return *static_cast<std::string *>(left.first.get()) == *static_cast<std::string *>(right.first.get());
+    case TokenInfo::Type::TRUE:
+    case TokenInfo::Type::FALSE:
+        return true;
+    default:
+        return left.first == right.first;
+    }
+}
+
+/* -------------------- CONSTANT PROPAGATION -------------------- */
+
+namespace
+{
+struct Lattice
+{
+    enum Level : uint8_t
+    {
+        UNKNOWN, // Not computed yet, or never computed because it always fails
+        CONSTANT,
+        VARYING,
+    };
+    Level level = UNKNOWN;
+    Value value;
+};
+
+class ConstantPropagation
+{
+    IrFunction &function;
+    std::vector<Lattice> lattice;
+    std::vector<bool> reachable;
+    std::set<std::pair<uint32_t, uint32_t>> executable;
+    std::vector<std::pair<uint32_t, uint32_t>> flowWork;
+    std::vector<uint32_t> ssaWork;
+    // Instructions using a value, and blocks branching on it
+    std::vector<std::vector<uint32_t>> users;
+    std::vector<std::vector<uint32_t>> branches;
+
+  public:
+    explicit ConstantPropagation(IrFunction &function)
+        : function(function), lattice(function.values.size()), reachable(function.blocks.size()),
+          users(function.values.size()), branches(function.values.size())
+    {
+        for (uint32_t b = 0; b < function.blocks.size(); b++)
+        {
+            const IrBlock &block = function.blocks[b];
+            if (block.removed)
+                continue;
+            for (uint32_t v : block.code)
+            {
+                for (uint32_t operand : function.values[v].operands)
+                    users[operand].push_back(v);
+            }
+            if (block.end == IrBlock::End::BRANCH)
+                branches[block.value].push_back(b);
+        }
+    }
+
+    // Whether the last instruction of a block can succeed and whether it can fail, as far as is known yet
+    std::pair<bool, bool> outcome(uint32_t block) const
+    {
+        const IrBlock &current = function.blocks[block];
+        if (current.unwind == IrBlock::NONE)
+            return {true, false};
+
+        uint32_t last = current.code.back();
+        const IrInstruction &instruction = function.values[last];
+        switch (instruction.op)
+        {
+        case IrInstruction::UNARY:
+        case IrInstruction::BINARY:
+        case IrInstruction::CHECK_INIT:
+        case IrInstruction::CHECK_CALLABLE: {
+            bool constant = true;
+            for (uint32_t operand : instruction.operands)
+            {
+                if (lattice[operand].level == Lattice::UNKNOWN)
+                    return {false, false};
+                constant &= lattice[operand].level == Lattice::CONSTANT;
+            }
+            if (constant)
+                return {lattice[last].level == Lattice::CONSTANT, lattice[last].level != Lattice::CONSTANT};
+            return {true, true};
+        }
+        default:
+            return {true, true};
+        }
+    }
+
+    void markEdge(uint32_t from, uint32_t to)
+    {
+        if (executable.insert({from, to}).second)
+            flowWork.push_back({from, to});
+    }
+
+    void visitEnd(uint32_t block)
+    {
+        const IrBlock &current = function.blocks[block];
+        auto [succeeds, fails] = outcome(block);
+        if (fails)
+            markEdge(block, current.unwind);
+        if (!succeeds)
+            return;
+
+        switch (current.end)
+        {
+        case IrBlock::End::JUMP:
+            markEdge(block, current.successors[0]);
+            break;
+        case IrBlock::End::BRANCH: {
+            const Lattice &condition = lattice[current.value];
+            if (condition.level == Lattice::VARYING)
+            {
+                markEdge(block, current.successors[0]);
+                markEdge(block, current.successors[1]);
+            }
+            else if (condition.level == Lattice::CONSTANT)
+            {
+                bool truthy = Operators::isTruthy(condition.value.first, condition.value.second);
+                markEdge(block, current.successors[truthy ? 0 : 1]);
+            }
+            break;
+        }
+        default:
+            break;
+        }
+    }
+
+    Lattice evaluate(uint32_t value) const
+    {
+        const IrInstruction &instruction = function.values[value];
+        const std::vector<uint32_t> &operands = instruction.operands;
+        Lattice result;
+
+        switch (instruction.op)
+        {
+        case IrInstruction::CONSTANT:
+            result = {Lattice::CONSTANT, instruction.constant};
+            break;
+
+        case IrInstruction::PHI: {
+            // Meet of the operands coming in through executable edges
+            const IrBlock &block = function.blocks[instruction.block];
+            for (size_t i = 0; i < operands.size(); i++)
+            {
+                if (executable.count({block.predecessors[i], instruction.block}) == 0)
+                    continue;
+                const Lattice &operand = lattice[operands[i]];
+                if (operand.level == Lattice::UNKNOWN)
+                    continue;
+                if (operand.level == Lattice::VARYING ||
+                    (result.level == Lattice::CONSTANT && !sameConstant(result.value, operand.value)))
+                    return {Lattice::VARYING, {}};
+                result = operand;
+            }
+            break;
+        }
+
+        case IrInstruction::COPY:
+            result = lattice[operands[0]];
+            break;
+
+        case IrInstruction::CHECK_INIT:
+        case IrInstruction::CHECK_CALLABLE:
+        case IrInstruction::UNARY:
+        case IrInstruction::BINARY: {
+            for (uint32_t operand : operands)
+            {
+                if (lattice[operand].level == Lattice::VARYING)
+                    return {Lattice::VARYING, {}};
+            }
+            for (uint32_t operand : operands)
+            {
+                if (lattice[operand].level == Lattice::UNKNOWN)
+                    return result;
+            }
+
+            // Every operand is a constant, so it computes the same every time (or always fails and stays unknown)
+            const Value &first = lattice[operands[0]].value;
+            if (instruction.op == IrInstruction::CHECK_INIT)
+            {
+                if (first.second != TokenInfo::Type::UNINITIALIZED)
+                    result = {Lattice::CONSTANT, first};
+            }
+            else if (instruction.op == IrInstruction::UNARY)
+            {
+                Value folded;
+                if (Operators::unary(instruction.type, first, folded) == nullptr)
+                    result = {Lattice::CONSTANT, folded};
+            }
+            else if (instruction.op == IrInstruction::BINARY)
+            {
+                Value folded;
+                if (Operators::binary(instruction.type, first, lattice[operands[1]].value, folded) == nullptr)
+                    result = {Lattice::CONSTANT, folded};
+            }
+            // A constant is never a function, CHECK_CALLABLE of one always fails
+            break;
+        }
+
+        default:
+            result.level = Lattice::VARYING;
+            break;
+        }
+        return result;
+    }
+
+    void visit(uint32_t value)
+    {
+        const IrInstruction &instruction = function.values[value];
+        if (!reachable[instruction.block])
+            return;
+
+        Lattice result = evaluate(value);
+        Lattice &old = lattice[value];
+        if (result.level == old.level &&
+            (result.level != Lattice::CONSTANT || sameConstant(result.value, old.value)))
+            return;
+        // Only ever goes down: a second constant means varying
+        if (old.level == Lattice::CONSTANT && result.level == Lattice::CONSTANT)
+            result = {Lattice::VARYING, {}};
+        if (result.level < old.level)
+            return;
+        old = result;
+
+        for (uint32_t user : users[value])
+            ssaWork.push_back(user);
+        for (uint32_t block : branches[value])
+        {
+            if (reachable[block])
+                visitEnd(block);
+        }
+        const IrBlock &block = function.blocks[instruction.block];
+        if (block.unwind != IrBlock::NONE && block.code.back() == value)
+            visitEnd(instruction.block);
+    }
+
+    void solve()
+    {
+        reachable[0] = true;
+        for (uint32_t v : function.blocks[0].code)
+            visit(v);
+        visitEnd(0);
+
+        while (!flowWork.empty() || !ssaWork.empty())
+        {
+            while (!flowWork.empty())
+            {
+                auto [from, to] = flowWork.back();
+                flowWork.pop_back();
+                bool first = !reachable[to];
+                reachable[to] = true;
+
+                const IrBlock &block = function.blocks[to];
+                for (uint32_t v : block.code)
+                {
+                    if (first || function.values[v].op == IrInstruction::PHI)
+                        visit(v);
+                }
+                if (first)
+                    visitEnd(to);
+            }
+            while (!ssaWork.empty())
+            {
+                uint32_t value = ssaWork.back();
+                ssaWork.pop_back();
+                visit(value);
+            }
+        }
+    }
+
+    void rewrite()
+    {
+        for (uint32_t b = 0; b < function.blocks.size(); b++)
+        {
+            IrBlock &block = function.blocks[b];
+            if (block.removed || !reachable[b])
+                continue;
+
+            auto [succeeds, fails] = outcome(b);
+            if (!fails)
+                dropUnwind(function, b);
+            if (!succeeds)
+            {
+                for (uint32_t successor : block.successors)
+                    function.removeEdge(b, successor);
+                block.successors.clear();
+                block.end = IrBlock::End::UNREACHABLE;
+            }
+
+            const Lattice &condition = lattice[block.value];
+            if (block.end == IrBlock::End::BRANCH && condition.level == Lattice::CONSTANT)
+            {
+                bool truthy = Operators::isTruthy(condition.value.first, condition.value.second);
+                function.removeEdge(b, block.successors[truthy ? 1 : 0]);
+                block.successors = {block.successors[truthy ? 0 : 1]};
+                block.end = IrBlock::End::JUMP;
+            }
+
+            for (uint32_t v : block.code)
+            {
+                IrInstruction &instruction = function.values[v];
+                if (lattice[v].level != Lattice::CONSTANT || instruction.op == IrInstruction::CONSTANT)
+                    continue;
+                if (instruction.hasEffect())
+                    continue;
+                instruction.op = IrInstruction::CONSTANT;
+                instruction.constant = lattice[v].value;
+                instruction.operands.clear();
+            }
+        }
+        function.removeUnreachable();
+    }
+};
+} // namespace
+
+void IrOptimizer::propagateConstants(IrFunction &function)
+{
+    ConstantPropagation propagation(function);
+    propagation.solve();
+    propagation.rewrite();
+}
+
+/* -------------------- COPY PROPAGATION -------------------- */
+
+void IrOptimizer::propagateCopies(IrFunction &function)
+{
+    std::vector<IrInstruction> &values = function.values;
+    auto resolve = [&values](uint32_t value) {
+        for (size_t steps = 0; values[value].op == IrInstruction::COPY && steps < values.size(); steps++)
+            value = values[value].operands[0];
+        return value;
+    };
+
+    // Which values may be an uninitialized var: the constant, and whatever phis and copies pass it on
+    std::vector<bool> uninitialized(values.size());
+    for (bool changed = true; changed;)
+    {
+        changed = false;
+        for (uint32_t v = 0; v < values.size(); v++)
+        {
+            const IrInstruction &instruction = values[v];
+            if (instruction.removed || uninitialized[v])
+                continue;
+            bool result = false;
+            if (instruction.op == IrInstruction::CONSTANT)
+                result = instruction.constant.second == TokenInfo::Type::UNINITIALIZED;
+            else if (instruction.op == IrInstruction::PHI || instruction.op == IrInstruction::COPY)
+            {
+                for (uint32_t operand : instruction.operands)
+                    result |= uninitialized[operand];
+            }
+            if (result)
+                uninitialized[v] = changed = true;
+        }
+    }
+
+    for (bool changed = true; changed;)
+    {
+        changed = false;
+        for (uint32_t v = 0; v < values.size(); v++)
+        {
+            IrInstruction &instruction = values[v];
+            if (instruction.removed)
+                continue;
+
+            if (instruction.op == IrInstruction::PHI)
+            {
+                uint32_t same = IrBlock::NONE;
+                bool trivial = true;
+                for (uint32_t operand : instruction.operands)
+                {
+                    operand = resolve(operand);
+                    if (operand == v || operand == same)
+                        continue;
+                    trivial &= same == IrBlock::NONE;
+                    same = operand;
+                }
+                if (trivial && same != IrBlock::NONE)
+                {
+                    makeCopy(function, v, same);
+                    changed = true;
+                }
+            }
+            else if (instruction.op == IrInstruction::CHECK_INIT && !uninitialized[resolve(instruction.operands[0])])
+            {
+                makeCopy(function, v, instruction.operands[0]);
+                changed = true;
+            }
+        }
+    }
+
+    for (IrInstruction &instruction : values)
+    {
+        if (instruction.removed)
+            continue;
+        for (uint32_t &operand : instruction.operands)
+            operand = resolve(operand);
+    }
+    for (IrBlock &block : function.blocks)
+    {
+        if (!block.removed && (block.end == IrBlock::End::BRANCH || block.end == IrBlock::End::RETURN))
+            block.value = resolve(block.value);
+    }
+}
+
+/* -------------------- VALUE NUMBERING -------------------- */
+
+// What makes two instructions compute the same value, empty if it can't be shared
+static std::string numberingKey(const IrInstruction &instruction)
+{
+    std::string key;
+    switch (instruction.op)
+    {
+    case IrInstruction::CONSTANT: {
+        const Value &constant = instruction.constant;
+        if (constant.second != TokenInfo::Type::NUMBER && constant.second != TokenInfo::Type::STRING)
+            return key;
+        key = constant.second == TokenInfo::Type::NUMBER ? "n" : "s";
+        if (constant.first == nullptr)
+            return key;
+        if (constant.second == TokenInfo::Type::NUMBER)
+            key.append(static_cast<const char *>(constant.first.get()), sizeof(double));
+        else
+            key += *static_cast<std::string *>(constant.first.get());
+        return key;
+    }
+    case IrInstruction::PHI:
+        // Only the same operands in the same block
+        key = "p" + std::to_string(instruction.block);
+        break;
+    case IrInstruction::UNARY:
+    case IrInstruction::BINARY:
+        key = (instruction.op == IrInstruction::UNARY ? "u" : "b") + std::to_string(static_cast<int>(instruction.type));
+        break;
+    case IrInstruction::CHECK_INIT:
+        key = "c";
+        break;
+    default:
+        return key;
+    }
+    for (uint32_t operand : instruction.operands)
+        key += "," + std::to_string(operand);
+    return key;
+}
+
+void IrOptimizer::numberValues(IrFunction &function)
+{
+    std::vector<IrBlock> &blocks = function.blocks;
+
+    // Reverse postorder and immediate dominators (Cooper, Harvey & Kennedy, "A Simple, Fast Dominance Algorithm")
+    std::vector<uint32_t> order;
+    std::vector<uint32_t> rank(blocks.size(), IrBlock::NONE);
+    {
+        std::vector<bool> visited(blocks.size());
+        std::vector<std::pair<uint32_t, size_t>> stack = {{0, 0}};
+        visited[0] = true;
+        while (!stack.empty())
+        {
+            auto &[block, next] = stack.back();
+            std::vector<uint32_t> edges = function.edges(block);
+            if (next < edges.size())
+            {
+                uint32_t successor = edges[next++];
+                if (!visited[successor])
+                {
+                    visited[successor] = true;
+                    stack.push_back({successor, 0});
+                }
+                continue;
+            }
+            order.push_back(block);
+            stack.pop_back();
+        }
+        std::reverse(order.begin(), order.end());
+        for (uint32_t i = 0; i < order.size(); i++)
+            rank[order[i]] = i;
+    }
+
+    std::vector<uint32_t> idom(blocks.size(), IrBlock::NONE);
+    idom[0] = 0;
+    for (bool changed = true; changed;)
+    {
+        changed = false;
+        for (size_t i = 1; i < order.size(); i++)
+        {
+            uint32_t block = order[i];
+            uint32_t dominator = IrBlock::NONE;
+            for (uint32_t predecessor : blocks[block].predecessors)
+            {
+                if (idom[predecessor] == IrBlock::NONE)
+                    continue;
+                if (dominator == IrBlock::NONE)
+                {
+                    dominator = predecessor;
+                    continue;
+                }
+                uint32_t a = predecessor;
+                uint32_t b = dominator;
+                while (a != b)
+                {
+                    while (rank[a] > rank[b])
+                        a = idom[a];
+                    while (rank[b] > rank[a])
+                        b = idom[b];
+                }
+                dominator = a;
+            }
+            if (idom[block] != dominator)
+            {
+                idom[block] = dominator;
+                changed = true;
+            }
+        }
+    }
+
+    std::vector<std::vector<uint32_t>> children(blocks.size());
+    for (size_t i = 1; i < order.size(); i++)
+        children[idom[order[i]]].push_back(order[i]);
+
+    // Walk the dominator tree with a scoped table of the values computed so far. The value of an instruction that
+    // can fail is only there once it succeeded, in the block it continues in.
+    std::unordered_map<std::string, uint32_t> table;
+    std::vector<std::string> added;
+    std::vector<std::pair<std::string, uint32_t>> pending(blocks.size());
+    struct Visit
+    {
+        uint32_t block;
+        size_t scope;
+        size_t next;
+    };
+    std::vector<Visit> stack;
+
+    auto enter = [&](uint32_t block) {
+        stack.push_back({block, added.size(), 0});
+        uint32_t dominator = idom[block];
+        if (block != 0 && !pending[dominator].first.empty() && blocks[dominator].successors.size() == 1 &&
+            blocks[dominator].successors[0] == block && blocks[block].predecessors.size() == 1)
+        {
+            if (table.emplace(pending[dominator].first, pending[dominator].second).second)
+                added.push_back(pending[dominator].first);
+        }
+
+        for (uint32_t v : blocks[block].code)
+        {
+            std::string key = numberingKey(function.values[v]);
+            if (key.empty())
+                continue;
+            auto existing = table.find(key);
+            if (existing != table.end())
+                makeCopy(function, v, existing->second);
+            else if (failing(function, v))
+                pending[block] = {key, v};
+            else
+            {
+                table.emplace(key, v);
+                added.push_back(std::move(key));
+            }
+        }
+    };
+
+    enter(0);
+    while (!stack.empty())
+    {
+        Visit &visit = stack.back();
+        if (visit.next < children[visit.block].size())
+        {
+            enter(children[visit.block][visit.next++]);
+            continue;
+        }
+        while (added.size() > visit.scope)
+        {
+            table.erase(added.back());
+            added.pop_back();
+        }
+        stack.pop_back();
+    }
+}
+
+/* -------------------- DEAD CODE -------------------- */
+
+void IrOptimizer::eliminateDeadCode(IrFunction &function)
+{
+    std::vector<bool> live(function.values.size());
+    std::vector<uint32_t> work;
+    auto mark = [&](uint32_t value) {
+        if (!live[value])
+        {
+            live[value] = true;
+            work.push_back(value);
+        }
+    };
+
+    for (const IrBlock &block : function.blocks)
+    {
+        if (block.removed)
+            continue;
+        for (uint32_t v : block.code)
+        {
+            if (function.values[v].hasEffect() || failing(function, v))
+                mark(v);
+        }
+        if (block.end == IrBlock::End::BRANCH || block.end == IrBlock::End::RETURN)
+            mark(block.value);
+    }
+    while (!work.empty())
+    {
+        uint32_t value = work.back();
+        work.pop_back();
+        for (uint32_t operand : function.values[value].operands)
+            mark(operand);
+    }
+
+    for (IrBlock &block : function.blocks)
+    {
+        std::vector<uint32_t> code;
+        for (uint32_t v : block.code)
+        {
+            if (live[v])
+                code.push_back(v);
+            else
+                function.values[v].removed = true;
+        }
+        block.code = std::move(code);
+    }
+}
+
+/* -------------------- BLOCKS -------------------- */
+
+void IrOptimizer::mergeBlocks(IrFunction &function)
+{
+    std::vector<IrBlock> &blocks = function.blocks;
+    for (uint32_t b = 0; b < blocks.size(); b++)
+    {
+        while (!blocks[b].removed && blocks[b].end == IrBlock::End::JUMP && blocks[b].unwind == IrBlock::NONE)
+        {
+            uint32_t next = blocks[b].successors[0];
+            if (next == b || next == 0 || blocks[next].predecessors.size() != 1)
+                break;
+
+            // Phis of a block with one predecessor just pass on their operand
+            IrBlock merged = std::move(blocks[next]);
+            for (uint32_t v : merged.code)
+            {
+                IrInstruction &instruction = function.values[v];
+                if (instruction.op == IrInstruction::PHI)
+                    instruction.op = IrInstruction::COPY;
+                instruction.block = b;
+                blocks[b].code.push_back(v);
+            }
+            for (uint32_t target : merged.successors)
+            {
+                for (uint32_t &predecessor : blocks[target].predecessors)
+                {
+                    if (predecessor == next)
+                        predecessor = b;
+                }
+            }
+            if (merged.unwind != IrBlock::NONE)
+            {
+                for (uint32_t &predecessor : blocks[merged.unwind].predecessors)
+                {
+                    if (predecessor == next)
+                        predecessor = b;
+                }
+            }
+
+            blocks[b].end = merged.end;
+            blocks[b].value = merged.value;
+            blocks[b].successors = std::move(merged.successors);
+            blocks[b].unwind = merged.unwind;
+            blocks[next] = IrBlock();
+            blocks[next].removed = true;
+        }
+    }
+}
@@ -0,0 +1,401 @@
+#include "headers/JitCompiler.hpp"
+#include <algorithm>
+#include <sys/mman.h>
+
+// Thrown while compiling when the function uses something the JIT doesn't handle
+struct Unsupported
+{
+};
+
+JitCode::~JitCode()
+{
+    munmap(memory, size);
+}
+
+std::unique_ptr<JitCode> JitCompiler::compile(const Function &declaration)
+{
+#if defined(__x86_64__) && defined(__linux__)
+    if (declaration.params.size() > JitCode::MAX_PARAMS)
+        return nullptr;
+
+    JitCompiler compiler(declaration);
+    try
+    {
+        return compiler.finish();
+    }
+    catch (const Unsupported &)
+    {
+        return nullptr;
+    }
+#else
+    return nullptr;
+#endif
+}
+
+std::unique_ptr<JitCode> JitCompiler::finish()
+{
+    entry = code.newLabel();
+    exit = code.newLabel();
+    bail = code.newLabel();
+
+    // Called as JitCode::Entry: rdi points to the arguments, rsi to the depth budget (kept in r12)
+    code.bind(entry);
+    size_t frameSize = code.prologue();
+
+    // The parameters are the first slots. Of two with the same name the last one wins, like in Environment.
+    scopes.emplace_back();
+    for (size_t i = 0; i < function.params.size(); i++)
+    {
+        code.loadArgument(static_cast<int32_t>(i * 8));
+        code.storeSlot(slotOffset(declare(function.params[i].getLexeme())));
+    }
+
+    for (const auto &stmt : function.getBody())
+        execute(stmt);
+
+    // Falling off the end returns nil, which only the interpreter returns
+    code.jump(bail);
+
+    code.bind(bail);
+    code.status(1);
+    code.bind(exit);
+    code.epilogue();
+
+    // Slots below the saved r12, keeping rsp 16-byte aligned
+    int32_t slots = slotCount * 8;
+    slots = slots % 16 == 0 ? slots + 8 : slots;
+    code.patch(frameSize, slots);
+
+    // A nested call takes the return address, rbp, r12, the slots and the pushed values (plus one for alignment)
+    size_t stackPerCall = 24 + static_cast<size_t>(slots) + 8 * static_cast<size_t>(mostPushed + 1);
+
+    // Copy into a fresh mapping and only then make it executable
+    const std::vector<uint8_t> &bytes = code.bytes();
+    void *memory = mmap(nullptr, bytes.size(), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (memory == MAP_FAILED)
+        return nullptr;
+    std::memcpy(memory, bytes.data(), bytes.size());
+    if (mprotect(memory, bytes.size(), PROT_READ | PROT_EXEC) != 0)
+    {
+        munmap(memory, bytes.size());
+        return nullptr;
+    }
+
+    return std::make_unique<JitCode>(memory, bytes.size(), callsItself, stackPerCall);
+}
+
+int32_t JitCompiler::slotOffset(int slot)
+{
+    // rbp - 8 holds the saved r12
+    return -16 - slot * 8;
+}
+
+int JitCompiler::resolve(std::string_view name) const
+{
+    // The latest declaration of the name in the innermost scope that has one
+    for (size_t i = scopes.size(); i-- > 0;)
+    {
+        for (size_t j = scopes[i].size(); j-- > 0;)
+        {
+            if (scopes[i][j].first == name)
+                return scopes[i][j].second;
+        }
+    }
+    return -1;
+}
+
+int JitCompiler::declare(std::string_view name)
+{
+    scopes.back().push_back({name, slotCount});
+    return slotCount++;
+}
+
+JitType JitCompiler::evaluate(const std::unique_ptr<Expr> &expr)
+{
+    return expr->accept(*this);
+}
+
+void JitCompiler::evaluateNumber(const std::unique_ptr<Expr> &expr)
+{
+    // Operators on anything but numbers mean an error or a value the native code can't hold
+    if (evaluate(expr) != JitType::NUMBER)
+        throw Unsupported();
+}
+
+void JitCompiler::execute(const std::unique_ptr<Stmt> &stmt)
+{
+    stmt->accept(*this);
+}
+
+/* -------------------- EXPRESSIONS -------------------- */
+
+JitType JitCompiler::visitLiteralExpr(const Literal &expr)
+{
+    // true / false / nil literals are unboxed values, unlike computed booleans (see Operators::isEqual)
+    if (expr.type != TokenInfo::Type::NUMBER)
+        throw Unsupported();
+
+    code.loadConstant(*std::static_pointer_cast<double>(expr.value));
+    return JitType::NUMBER;
+}
+
+JitType JitCompiler::visitGroupingExpr(const Grouping &expr)
+{
+    return evaluate(expr.expression);
+}
+
+JitType JitCompiler::visitVariableExpr(const Variable &expr)
+{
+    // Only the function's own variables, anything outside it could change without the native code knowing
+    int slot = resolve(expr.name.getLexeme());
+    if (slot < 0)
+        throw Unsupported();
+
+    code.loadSlot(slotOffset(slot));
+    return JitType::NUMBER;
+}
+
+JitType JitCompiler::visitAssignExpr(const Assign &expr)
+{
+    int slot = resolve(expr.name.getLexeme());
+    if (slot < 0)
+        throw Unsupported();
+
+    evaluateNumber(expr.value);
+    code.storeSlot(slotOffset(slot));
+    return JitType::NUMBER;
+}
+
+JitType JitCompiler::visitUnaryExpr(const Unary &expr)
+{
+    switch (expr.op.getType())
+    {
+    case TokenInfo::Type::BANG:
+        // 1.0 if the operand is falsy (equal to 0, NaN is truthy)
+        evaluate(expr.right);
+        code.compareZero(0);
+        code.setAl(X64Assembler::EQUAL);
+        code.setCl(X64Assembler::NO_PARITY);
+        code.andAlCl();
+        code.alToDouble();
+        return JitType::BOOLEAN;
+
+    case TokenInfo::Type::MINUS:
+        // Negation gives back its operand (see Operators::unary)
+        evaluateNumber(expr.right);
+        return JitType::NUMBER;
+
+    default:
+        throw Unsupported();
+    }
+}
+
+JitType JitCompiler::visitBinaryExpr(const Binary &expr)
+{
+    // Left operand ends up in xmm0, right one in xmm1
+    evaluateNumber(expr.left);
+    code.pushValue();
+    pushed++;
+    mostPushed = std::max(mostPushed, pushed);
+    evaluateNumber(expr.right);
+    code.popLeft();
+    pushed--;
+
+    switch (expr.op.getType())
+    {
+    case TokenInfo::Type::PLUS:
+        code.addsd();
+        return JitType::NUMBER;
+    case TokenInfo::Type::MINUS:
+        code.subsd();
+        return JitType::NUMBER;
+    case TokenInfo::Type::STAR:
+        code.mulsd();
+        return JitType::NUMBER;
+    case TokenInfo::Type::SLASH: {
+        // Division by zero is a runtime error
+        int divide = code.newLabel();
+        code.compareZero(1);
+        code.jumpIf(X64Assembler::PARITY, divide);
+        code.jumpIf(X64Assembler::EQUAL, bail);
+        code.bind(divide);
+        code.divsd();
+        return JitType::NUMBER;
+    }
+
+    // Comparisons are false when either side is NaN, like in C++: "above" flags are clear on unordered operands
+    case TokenInfo::Type::GREATER:
+        code.compare(false);
+        code.setAl(X64Assembler::ABOVE);
+        break;
+    case TokenInfo::Type::GREATER_EQUAL:
+        code.compare(false);
+        code.setAl(X64Assembler::ABOVE_EQUAL);
+        break;
+    case TokenInfo::Type::LESS:
+        code.compare(true);
+        code.setAl(X64Assembler::ABOVE);
+        break;
+    case TokenInfo::Type::LESS_EQUAL:
+        code.compare(true);
+        code.setAl(X64Assembler::ABOVE_EQUAL);
+        break;
+    case TokenInfo::Type::EQUAL_EQUAL:
+        code.compare(false);
+        code.setAl(X64Assembler::EQUAL);
+        code.setCl(X64Assembler::NO_PARITY);
+        code.andAlCl();
+        break;
+    case TokenInfo::Type::BANG_EQUAL:
+        code.compare(false);
+        code.setAl(X64Assembler::NOT_EQUAL);
+        code.setCl(X64Assembler::PARITY);
+        code.orAlCl();
+        break;
+
+    default:
+        throw Unsupported();
+    }
+
+    code.alToDouble();
+    return JitType::BOOLEAN;
+}
+
+JitType JitCompiler::visitLogicalExpr(const Logical &expr)
+{
+    // The result is one of the operands, so they have to be the same kind of value
+    int end = code.newLabel();
+    JitType left = evaluate(expr.left);
+
+    if (expr.op.getType() == TokenInfo::Type::OR)
+        code.jumpIfTruthy(end);
+    else
+        code.jumpIfFalsy(end);
+
+    if (evaluate(expr.right) != left)
+        throw Unsupported();
+    code.bind(end);
+    return left;
+}
+
+JitType JitCompiler::visitCallExpr(const Call &expr)
+{
+    // Only calls of the function itself by its name, which the caller checks before running the code
+    const Variable *callee = expr.calleeVariable;
+    if (callee == nullptr || callee->name.getLexeme() != function.name.getLexeme() ||
+        resolve(callee->name.getLexeme()) >= 0 || expr.arguments.size() != function.params.size())
+        throw Unsupported();
+    callsItself = true;
+
+    // The arguments go to slots of their own, in order from the lowest address
+    size_t count = expr.arguments.size();
+    int first = slotCount;
+    slotCount += static_cast<int>(count);
+    for (size_t i = 0; i < count; i++)
+    {
+        evaluateNumber(expr.arguments[i]);
+        code.storeSlot(slotOffset(first + static_cast<int>(count - 1 - i)));
+    }
+
+    // Out of depth: the interpreter reports the stack overflow
+    code.testBudget();
+    code.jumpIf(X64Assembler::LESS_EQUAL, bail);
+    code.decrementBudget();
+
+    if (pushed % 2 != 0)
+        code.subRsp(8);
+    code.callArguments(slotOffset(first + static_cast<int>(count) - 1));
+    code.call(entry);
+    if (pushed % 2 != 0)
+        code.addRsp(8);
+
+    code.incrementBudget();
+    code.testStatus();
+    code.jumpIf(X64Assembler::NOT_EQUAL, bail);
+    return JitType::NUMBER;
+}
+
+/* -------------------- STATEMENTS -------------------- */
+
+void JitCompiler::visitExpressionStmt(const Expression &stmt)
+{
+    evaluate(stmt.expression);
+}
+
+void JitCompiler::visitPrintStmt(const Print &)
+{
+    throw Unsupported();
+}
+
+void JitCompiler::visitFunctionStmt(const Function &)
+{
+    throw Unsupported();
+}
+
+void JitCompiler::visitVarStmt(const Var &stmt)
+{
+    // Variables without an initializer are uninitialized, not a number
+    if (stmt.initializer == nullptr)
+        throw Unsupported();
+
+    evaluateNumber(stmt.initializer);
+    code.storeSlot(slotOffset(declare(stmt.name.getLexeme())));
+}
+
+void JitCompiler::visitBlockStmt(const Block &stmt)
+{
+    scopes.emplace_back();
+    for (const auto &statement : stmt.statements)
+        execute(statement);
+    scopes.pop_back();
+}
+
+void JitCompiler::visitIfStmt(const If &stmt)
+{
+    int otherwise = code.newLabel();
+    int end = code.newLabel();
+
+    evaluate(stmt.condition);
+    code.jumpIfFalsy(otherwise);
+    execute(stmt.thenBranch);
+    code.jump(end);
+    code.bind(otherwise);
+    if (stmt.elseBranch != nullptr)
+        execute(stmt.elseBranch);
+    code.bind(end);
+}
+
+void JitCompiler::visitWhileStmt(const While &stmt)
+{
+    int condition = code.newLabel();
+    int end = code.newLabel();
+
+    code.bind(condition);
+    evaluate(stmt.condition);
+    code.jumpIfFalsy(end);
+
+    loopEnds.push_back(end);
+    execute(stmt.body);
+    loopEnds.pop_back();
+
+    code.jump(condition);
+    code.bind(end);
+}
+
+void JitCompiler::visitBreakStmt(const Break &)
+{
+    if (loopEnds.empty())
+        throw Unsupported();
+    code.jump(loopEnds.back());
+}
+
+void JitCompiler::visitReturnStmt(const Return &stmt)
+{
+    // A bare return gives nil
+    if (stmt.value == nullptr)
+        throw Unsupported();
+
+    evaluateNumber(stmt.value);
+    code.status(0);
+    code.jump(exit);
+}
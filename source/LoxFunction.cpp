@@ -1,28 +1,100 @@
 #include "headers/LoxFunction.hpp"
 #include "headers/AstInterpreter.hpp"
+#include "headers/CallStack.hpp"
 #include "headers/Environment.hpp"
 #include "headers/ReturnException.hpp"
+#include <algorithm>
 
-std::pair<std::shared_ptr<void>, TokenInfo::Type> LoxFunction::call(
-    AstInterpreter &interpreter, const std::vector<std::pair<std::shared_ptr<void>, TokenInfo::Type>> &arguments)
+LoxFunction::LoxFunction(std::unique_ptr<Function> &declaration, std::shared_ptr<Environment> &closure)
+    : declaration(std::move(declaration)), closure(closure)
+{
+    auto names = std::make_shared<std::vector<std::string_view>>();
+    for (const Token &param : this->declaration->params)
+    {
+        names->push_back(param.getLexeme());
+        paramBits |= Environment::nameBit(names->back());
+    }
+    paramNames = std::move(names);
+}
+
+std::shared_ptr<Environment> LoxFunction::makeEnvironment() const
 {
     // Make closure (the env that was active during function definition) the environment of the function execution
-    std::shared_ptr<Environment> funcEnv = std::make_shared<Environment>(closure);
+    return std::make_shared<Environment>(closure, paramNames, paramBits);
+}
 
-    for (int i = 0; i < declaration->params.size(); i++)
+std::pair<std::shared_ptr<void>, TokenInfo::Type> LoxFunction::call(AstInterpreter &interpreter,
+                                                                    const std::shared_ptr<Environment> &funcEnv)
+{
+    // A tail call takes the place of the function making it: the loop runs it on the same native frame and drops
+    // the environment of the caller, so tail recursion runs in constant space (and doesn't count toward --max-depth)
+    LoxFunction *function = this;
+    std::shared_ptr<LoxFunction> callee;
+    std::shared_ptr<Environment> environment = funcEnv;
+    while (true)
     {
-        // Define the parameters in the new environment. Set arguments to be values of the parameters
-        funcEnv->defineVar(declaration->params[i].getLexeme(), arguments[i].first, arguments[i].second);
+        try
+        {
+            interpreter.executeBlock(function->declaration->getBody(), environment);
+            return std::make_pair(nullptr, TokenInfo::Type::NIL);
+        }
+        catch (ReturnException &e)
+        {
+            if (e.tailCallee == nullptr)
+                return std::make_pair(e.value, e.type);
+            callee = std::move(e.tailCallee);
+            environment = std::move(e.tailEnvironment);
+            function = callee.get();
+        }
     }
+}
 
-    try
+bool LoxFunction::runJit(Environment &funcEnv, int64_t budget,
+                         std::pair<std::shared_ptr<void>, TokenInfo::Type> &value)
+{
+    if (jit == nullptr)
     {
-        interpreter.executeBlock(declaration->body, funcEnv);
+        if (jitFailed || ++calls < JIT_THRESHOLD)
+            return false;
+        jit = JitCompiler::compile(*declaration);
+        if (jit == nullptr)
+        {
+            jitFailed = true;
+            return false;
+        }
     }
-    catch (const ReturnException &e)
+
+    double args[JitCode::MAX_PARAMS];
+    for (size_t i = 0; i < funcEnv.slotCount(); i++)
+    {
+        const auto &argument = funcEnv.slot(i);
+        if (argument.second != TokenInfo::Type::NUMBER)
+            return false;
+        args[i] = *static_cast<double *>(argument.first.get());
+    }
+
+    // The native code calls itself where the body calls the function by name, so the name has to still mean it
+    if (jit->isRecursive())
+    {
+        const auto *binding = closure->find(std::string(declaration->name.getLexeme()));
+        if (binding == nullptr || binding->second != TokenInfo::Type::FUN || binding->first.get() != this)
+            return false;
+    }
+
+    // The native calls nest on this thread's stack: no deeper than fits above the interpreter's reserve
+    budget = std::min(budget, static_cast<int64_t>(NativeStack::left() / jit->nativeStackPerCall()));
+
+    double result;
+    if (!jit->run(args, budget, result))
     {
-        return std::make_pair(e.value, e.type);
+        if (++jitBails >= MAX_JIT_BAILS)
+        {
+            jit.reset();
+            jitFailed = true;
+        }
+        return false;
     }
 
-    return std::make_pair(nullptr, TokenInfo::Type::NIL);
+    value = std::make_pair(std::make_shared<double>(result), TokenInfo::Type::NUMBER);
+    return true;
 }
@@ -0,0 +1,155 @@
+#include "headers/LoxRuntime.hpp"
+#include "headers/CallStack.hpp"
+#include "headers/Source.hpp"
+#include <cstring>
+#include <iostream>
+#include <pthread.h>
+#include <string>
+
+unsigned LoxRuntime::maxDepth = 0;
+unsigned LoxRuntime::depth = 0;
+bool LoxRuntime::hadRuntimeError = false;
+
+int LoxRuntime::main(const char *source, unsigned maxDepth, void (*program)(const Env &globals))
+{
+    // Tokens of the program are offsets into the script, which has to be the first source
+    Source::add(source);
+    LoxRuntime::maxDepth = maxDepth;
+
+    // Same native stack as Loxpp::runWithStack gives the interpreter
+    static void (*run)(const Env &) = program;
+    static size_t stackSize = 8 * 1024 * 1024 + size_t(maxDepth) * 16 * 1024;
+    auto start = [](void *) -> void * {
+        NativeStack::enter(stackSize);
+        try
+        {
+            run(std::make_shared<Environment>());
+        }
+        catch (RuntimeError &error)
+        {
+            report(error);
+        }
+        return nullptr;
+    };
+
+    pthread_attr_t attributes;
+    pthread_attr_init(&attributes);
+    int failed = pthread_attr_setstacksize(&attributes, stackSize);
+    pthread_t thread;
+    if (failed == 0)
+        failed = pthread_create(&thread, &attributes, start, nullptr);
+    pthread_attr_destroy(&attributes);
+
+    if (failed != 0)
+    {
+        std::cerr << "Could not start the program with " << stackSize / (1024 * 1024) << " MB of stack: "
+                  << std::strerror(failed) << ".\n";
+        return 71;
+    }
+    pthread_join(thread, nullptr);
+
+    return hadRuntimeError ? 70 : 0;
+}
+
+void LoxRuntime::report(const RuntimeError &error)
+{
+    std::cerr << "[line " << error.token.getLine() << "] " << error.token.getLexeme() << " : " << error.what() << "\n";
+    hadRuntimeError = true;
+}
+
+void LoxRuntime::print(const Value &value)
+{
+    std::cout << Operators::stringify(value.first, value.second) << "\n";
+}
+
+/* -------------------- VARIABLES -------------------- */
+
+Value LoxRuntime::get(const Env &env, const Token &name, LookupCache &cache)
+{
+    Value &binding = env->lookup(name, cache);
+    if (binding.second == TokenInfo::Type::UNINITIALIZED)
+        throw RuntimeError(name, "Variable used before being initialized.");
+    return binding;
+}
+
+void LoxRuntime::assign(const Env &env, const Token &name, Value value)
+{
+    env->assign(name, value.first, value.second);
+}
+
+void LoxRuntime::define(const Env &env, const Token &name, Value value)
+{
+    env->defineVar(std::string(name.getLexeme()), std::move(value.first), value.second);
+}
+
+void LoxRuntime::defineFunction(const Env &env, const Token &name, Body body, const Params &params)
+{
+    uint64_t paramBits = 0;
+    for (std::string_view param : *params)
+        paramBits |= Environment::nameBit(param);
+
+    auto function = std::make_shared<Function>(Function{body, env, params, paramBits});
+    env->defineVar(std::string(name.getLexeme()), function, TokenInfo::Type::FUN);
+}
+
+/* -------------------- OPERATORS -------------------- */
+
+Value LoxRuntime::unary(const Token &op, const Value &right)
+{
+    Value value;
+    if (const char *error = Operators::unary(op.getType(), right, value))
+        throw RuntimeError(op, error);
+    return value;
+}
+
+Value LoxRuntime::binary(const Token &op, const Value &left, const Value &right)
+{
+    Value value;
+    if (const char *error = Operators::binary(op.getType(), left, right, value))
+        throw RuntimeError(op, error);
+    return value;
+}
+
+/* -------------------- CALLS -------------------- */
+
+LoxRuntime::Env LoxRuntime::prepare(const Value &callee, const Token &paren)
+{
+    if (callee.second != TokenInfo::Type::FUN && callee.second != TokenInfo::Type::CLASS)
+        throw RuntimeError(paren, "Can only call functions and classes.");
+
+    const Function &function = *static_cast<const Function *>(callee.first.get());
+    return std::make_shared<Environment>(function.closure, function.params, function.paramBits);
+}
+
+void LoxRuntime::argument(const Env &funcEnv, size_t i, Value value)
+{
+    // Extra arguments are only evaluated, the arity check comes after all of them
+    if (i < funcEnv->slotCount())
+        funcEnv->slot(i) = std::move(value);
+}
+
+Value LoxRuntime::call(const Value &callee, const Env &funcEnv, size_t count, const Token &paren)
+{
+    const Function &function = *static_cast<const Function *>(callee.first.get());
+    size_t arity = function.params->size();
+    if (count != arity)
+        throw RuntimeError(paren, "Expected " + std::to_string(arity) + " arguments but got " + std::to_string(count) +
+                                      ".");
+
+    if (depth >= maxDepth || NativeStack::low())
+        throw RuntimeError(paren, "Stack overflow.");
+
+    // Keep the depth right when the call ends with an error
+    struct Frame
+    {
+        Frame()
+        {
+            depth++;
+        }
+        ~Frame()
+        {
+            depth--;
+        }
+    } frame;
+    return function.body(funcEnv);
+}
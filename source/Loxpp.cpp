@@ -1,15 +1,30 @@
 #include "headers/Loxpp.hpp"
+#include "headers/AstOptimizer.hpp"
+#include "headers/CallStack.hpp"
+#include "headers/CppEmitter.hpp"
+#include "headers/FlatAstBuilder.hpp"
+#include "headers/FlatCache.hpp"
+#include "headers/FlatSnapshot.hpp"
+#include "headers/ParallelParser.hpp"
+#include "headers/ParallelScanner.hpp"
 #include "headers/Parser.hpp"
 #include "headers/Scanner.hpp"
 #include "headers/Token.hpp"
+#include <cstring>
 #include <fstream>
 #include <iostream>
+#include <pthread.h>
 #include <vector>
 
 // Everything is static in this class
 bool Loxpp::hadError = false;
 bool Loxpp::hadRuntimeError = false;
+thread_local unsigned *Loxpp::suppressedErrors = nullptr;
 AstInterpreter Loxpp::interpreter;
+FlatInterpreter Loxpp::flatInterpreter;
+ClosureInterpreter Loxpp::closureInterpreter;
+IrInterpreter Loxpp::irInterpreter;
+Options Loxpp::options;
 
 int Loxpp::runFile(const std::string &path)
 {
@@ -22,11 +37,24 @@ int Loxpp::runFile(const std::string &path)
 
     file.close();
 
+    // Start from the state a previous run left behind, instead of running its prelude again
+    if (!options.snapshotIn.empty() && !FlatSnapshot::load(options.snapshotIn, flatInterpreter))
+    {
+        std::cerr << "Could not load snapshot '" << options.snapshotIn << "'.\n";
+        return 66;
+    }
+
     // Get source code from input read
     // Create string from bytes
     // Run the source code
     run(std::string(bytes.begin(), bytes.end()));
 
+    if (!options.snapshotOut.empty() && !hadError && !FlatSnapshot::save(options.snapshotOut, flatInterpreter))
+    {
+        std::cerr << "Could not write snapshot '" << options.snapshotOut << "'.\n";
+        return 74;
+    }
+
     if (hadError)
         return 65;
     if (hadRuntimeError)
@@ -84,20 +112,134 @@ void Loxpp::runPrompt()
 // Run the source code
 void Loxpp::run(const std::string &source)
 {
-    Scanner scanner(source);
-    std::vector<Token> tokens = scanner.scanTokens();
+    uint32_t base = Source::add(source);
+
+    // An unchanged script that ran before is already lowered, skip straight to running it
+    if (!options.cacheDir.empty())
+    {
+        std::unique_ptr<FlatAst> cached = FlatCache::load(options.cacheDir, base);
+        if (cached)
+        {
+            flatInterpreter.interpret(std::move(cached));
+            return;
+        }
+    }
+
+    std::vector<Token> tokens;
+    if (options.parallelScan)
+        tokens = ParallelScanner::scanTokens(base, threadPool());
+    else
+    {
+        Scanner scanner(base);
+        tokens = std::move(scanner.scanTokens());
+    }
 
     // Parse tokens into AST statements and expressions
-    Parser parser(tokens);
-    std::vector<std::unique_ptr<Stmt>> statements = parser.parse();
+    // Lazily parsed function bodies hold on to the tokens until they are called
+    std::shared_ptr<const std::vector<Token>> lazyTokens;
+    if (options.lazyParse)
+        lazyTokens = std::make_shared<const std::vector<Token>>(std::move(tokens));
+    const std::vector<Token> &parsed = options.lazyParse ? *lazyTokens : tokens;
+    int eof = static_cast<int>(parsed.size()) - 1;
+
+    std::vector<std::unique_ptr<Stmt>> statements;
+    if (options.parallelParse)
+        statements = ParallelParser::parse(parsed, threadPool(), lazyTokens);
+    else if (options.lazyParse)
+        statements = Parser(lazyTokens, 0, eof).parse();
+    else
+    {
+        Parser parser(tokens);
+        statements = parser.parse();
+    }
 
     // If there was an error, don't run the interpreter
     if (hadError)
         return;
 
+    // Translate the script instead of running it
+    if (!options.emitCpp.empty())
+    {
+        std::ofstream file(options.emitCpp, std::ios::binary);
+        file << CppEmitter::emit(statements, base, options.maxDepth);
+        if (!file)
+        {
+            std::cerr << "Could not write '" << options.emitCpp << "'.\n";
+            hadError = true;
+        }
+        return;
+    }
+
+    if (options.ir)
+    {
+        irInterpreter.interpret(statements);
+        return;
+    }
+
+    if (options.flatAst)
+    {
+        // The tree is only needed until it is lowered
+        std::unique_ptr<FlatAst> flat = FlatAstBuilder().build(statements);
+        statements.clear();
+        if (!options.cacheDir.empty())
+            FlatCache::save(options.cacheDir, base, *flat);
+        flatInterpreter.interpret(std::move(flat));
+        return;
+    }
+
+    if (options.closures)
+    {
+        closureInterpreter.interpret(std::move(statements));
+        return;
+    }
+
+    if (options.astOptimize)
+        AstOptimizer::optimize(statements);
     interpreter.setInterpretResult(statements);
 }
 
+int Loxpp::runWithStack(const std::function<int()> &body)
+{
+    struct Job
+    {
+        const std::function<int()> *body;
+        size_t stackSize;
+        int result;
+    } job = {&body, BASE_STACK + options.maxDepth * CALL_STACK, 0};
+
+    pthread_attr_t attributes;
+    pthread_attr_init(&attributes);
+    int failed = pthread_attr_setstacksize(&attributes, job.stackSize);
+
+    pthread_t thread;
+    auto start = [](void *argument) -> void * {
+        Job *job = static_cast<Job *>(argument);
+        NativeStack::enter(job->stackSize);
+        job->result = (*job->body)();
+        return nullptr;
+    };
+    if (failed == 0)
+        failed = pthread_create(&thread, &attributes, start, &job);
+    pthread_attr_destroy(&attributes);
+
+    // Running on a smaller stack would just crash later, on a deep enough call
+    if (failed != 0)
+    {
+        std::cerr << "Could not start the interpreter with " << job.stackSize / (1024 * 1024)
+                  << " MB of stack for --max-depth=" << options.maxDepth << ": " << std::strerror(failed) << ".\n";
+        return 71;
+    }
+    pthread_join(thread, nullptr);
+    return job.result;
+}
+
+ThreadPool &Loxpp::threadPool()
+{
+    // Only started the first time a parallel option needs it
+    static ThreadPool pool(options.threads);
+    return pool;
+}
+
 // Error handling
 void Loxpp::runtimeError(const RuntimeError &error)
 {
@@ -112,7 +254,7 @@ void Loxpp::error(const Token &token, const std::string &message)
     }
     else
     {
-        report(token.getLine(), " at '" + token.getLexeme() + "'", message);
+        report(token.getLine(), " at '" + std::string(token.getLexeme()) + "'", message);
     }
 }
 
@@ -125,6 +267,12 @@ void Loxpp::error(int line, const std::string &message)
 // Will set hadError to true
 void Loxpp::report(int line, const std::string &where, const std::string &message)
 {
+    if (suppressedErrors != nullptr)
+    {
+        (*suppressedErrors)++;
+        return;
+    }
+
     std::cerr << "[line " << line << "] Error" << where << ": " << message << "\n";
     hadError = true;
 }
@@ -0,0 +1,175 @@
+#include "headers/Operators.hpp"
+
+bool Operators::isTruthy(const std::shared_ptr<void> &value, TokenInfo::Type type)
+{
+    if (type == TokenInfo::Type::NIL)
+        return false;
+
+    // If it's a number, check if it's not equal to 0
+    if (type == TokenInfo::Type::NUMBER)
+        return *static_cast<double *>(value.get()) != 0;
+
+    // If it's a string, check if it's not empty
+    else if (type == TokenInfo::Type::STRING)
+        return !static_cast<std::string *>(value.get())->empty();
+
+    // If's a boolean holding false value
+    else if (type == TokenInfo::Type::FALSE)
+        return false;
+
+    return true;
+}
+
+bool Operators::isEqual(const std::shared_ptr<void> &left, const std::shared_ptr<void> &right,
+                        TokenInfo::Type leftType, TokenInfo::Type rightType)
+{
+    if (left == nullptr && right == nullptr)
+        return true;
+
+    // If bools, check if they are equal
+    if (leftType != rightType)
+        return false;
+
+    // If both are numbers, check if they are equal
+    if (leftType == TokenInfo::Type::NUMBER)
+        return *static_cast<double *>(left.get()) == *static_cast<double *>(right.get());
+
+    // If both are strings, check if they are equal
+    if (leftType == TokenInfo::Type::STRING)
+        return *static_cast<std::string *>(left.get()) == *static_cast<std::string *>(right.get());
+
+    return false;
+}
+
+std::string Operators::stringify(const std::shared_ptr<void> &value, TokenInfo::Type type)
+{
+    if (type == TokenInfo::Type::NUMBER)
+        return std::to_string(*static_cast<double *>(value.get()));
+
+    if (type == TokenInfo::Type::STRING)
+        return *static_cast<std::string *>(value.get());
+
+    if (type == TokenInfo::Type::TRUE)
+        return "true";
+
+    if (type == TokenInfo::Type::FALSE)
+        return "false";
+
+    return "nil";
+}
+
+Value Operators::boolean(bool value)
+{
+    return {std::make_shared<bool>(value), value ? TokenInfo::Type::TRUE : TokenInfo::Type::FALSE};
+}
+
+const char *Operators::unary(TokenInfo::Type op, const Value &right, Value &result)
+{
+    switch (op)
+    {
+    case TokenInfo::Type::BANG:
+        result = boolean(!isTruthy(right.first, right.second));
+        return nullptr;
+
+    case TokenInfo::Type::MINUS:
+        if (right.second != TokenInfo::Type::NUMBER)
+            return "Operand must be a number.";
+        result = right;
+        return nullptr;
+
+    default:
+        return nullptr;
+    }
+}
+
+const char *Operators::binary(TokenInfo::Type op, const Value &left, const Value &right, Value &result)
+{
+    const auto &[leftVal, leftType] = left;
+    const auto &[rightVal, rightType] = right;
+    bool numbers = leftType == TokenInfo::Type::NUMBER && rightType == TokenInfo::Type::NUMBER;
+
+    switch (op)
+    {
+    // Comparison operators
+    case TokenInfo::Type::GREATER:
+        if (!numbers)
+            return "Operands must be numbers.";
+        result = boolean(*static_cast<double *>(leftVal.get()) > *static_cast<double *>(rightVal.get()));
+        return nullptr;
+    case TokenInfo::Type::GREATER_EQUAL:
+        if (!numbers)
+            return "Operands must be numbers.";
+        result = boolean(*static_cast<double *>(leftVal.get()) >= *static_cast<double *>(rightVal.get()));
+        return nullptr;
+    case TokenInfo::Type::LESS:
+        if (!numbers)
+            return "Operands must be numbers.";
+        result = boolean(*static_cast<double *>(leftVal.get()) < *static_cast<double *>(rightVal.get()));
+        return nullptr;
+    case TokenInfo::Type::LESS_EQUAL:
+        if (!numbers)
+            return "Operands must be numbers.";
+        result = boolean(*static_cast<double *>(leftVal.get()) <= *static_cast<double *>(rightVal.get()));
+        return nullptr;
+
+    case TokenInfo::Type::BANG_EQUAL:
+        result = boolean(!isEqual(leftVal, rightVal, leftType, rightType));
+        return nullptr;
+    case TokenInfo::Type::EQUAL_EQUAL:
+        result = boolean(isEqual(leftVal, rightVal, leftType, rightType));
+        return nullptr;
+
+    case TokenInfo::Type::MINUS:
+        if (!numbers)
+            return "Operands must be numbers.";
+        result = {std::make_shared<double>(*static_cast<double *>(leftVal.get()) -
+                                           *static_cast<double *>(rightVal.get())),
+                  TokenInfo::Type::NUMBER};
+        return nullptr;
+
+    // Since + can do add & string concat, the ++ is overLOADED.
+    case TokenInfo::Type::PLUS:
+        if (numbers)
+            result = {std::make_shared<double>(*static_cast<double *>(leftVal.get()) +
+                                               *static_cast<double *>(rightVal.get())),
+                      TokenInfo::Type::NUMBER};
+        // Concatenate strings
+        else if (leftType == TokenInfo::Type::STRING && rightType == TokenInfo::Type::STRING)
+            result = {std::make_shared<std::string>(*static_cast<std::string *>(leftVal.get()) +
+                                                    *static_cast<std::string *>(rightVal.get())),
+                      TokenInfo::Type::STRING};
+        // Convert number to string and concat
+        else if (leftType == TokenInfo::Type::STRING && rightType == TokenInfo::Type::NUMBER)
+            result = {std::make_shared<std::string>(*static_cast<std::string *>(leftVal.get()) +
+                                                    std::to_string(*static_cast<double *>(rightVal.get()))),
+                      TokenInfo::Type::STRING};
+        else if (leftType == TokenInfo::Type::NUMBER && rightType == TokenInfo::Type::STRING)
+            result = {std::make_shared<std::string>(std::to_string(*static_cast<double *>(leftVal.get())) +
+                                                    *static_cast<std::string *>(rightVal.get())),
+                      TokenInfo::Type::STRING};
+        else
+            return "Operands must be two numbers or two strings.";
+        return nullptr;
+
+    case TokenInfo::Type::SLASH: {
+        if (!numbers)
+            return "Operands must be numbers.";
+        double rightNum = *static_cast<double *>(rightVal.get());
+        if (rightNum == 0)
+            return "Division by zero.";
+        result = {std::make_shared<double>(*static_cast<double *>(leftVal.get()) / rightNum), TokenInfo::Type::NUMBER};
+        return nullptr;
+    }
+
+    case TokenInfo::Type::STAR:
+        if (!numbers)
+            return "Operands must be numbers.";
+        result = {std::make_shared<double>(*static_cast<double *>(leftVal.get()) *
+                                           *static_cast<double *>(rightVal.get())),
+                  TokenInfo::Type::NUMBER};
+        return nullptr;
+
+    default:
+        return nullptr;
+    }
+}
@@ -0,0 +1,84 @@
+#include "headers/ParallelParser.hpp"
+#include "headers/Loxpp.hpp"
+#include "headers/Parser.hpp"
+#include <algorithm>
+
+// Statements of one range, and how many errors came up parsing it
+struct RangeResult
+{
+    std::vector<std::unique_ptr<Stmt>> statements;
+    unsigned errors = 0;
+};
+
+std::vector<std::unique_ptr<Stmt>> ParallelParser::parse(const std::vector<Token> &tokens, ThreadPool &pool,
+                                                         std::shared_ptr<const std::vector<Token>> lazyTokens)
+{
+    auto parseRange = [&](size_t begin, size_t end) {
+        if (lazyTokens != nullptr)
+            return Parser(lazyTokens, begin, end).parse();
+        return Parser(tokens, begin, end).parse();
+    };
+
+    size_t eof = tokens.size() - 1;
+    size_t rangeSize = std::max(MIN_RANGE, eof / (pool.size() * 4));
+
+    // Cut the tokens at top-level declarations, once a range is big enough
+    std::vector<size_t> bounds = {0};
+    int depth = 0;
+    for (size_t i = 0; i < eof; i++)
+    {
+        switch (tokens[i].getType())
+        {
+        case TokenInfo::Type::LEFT_BRACE:
+        case TokenInfo::Type::LEFT_PAREN:
+            depth++;
+            break;
+        case TokenInfo::Type::RIGHT_BRACE:
+        case TokenInfo::Type::RIGHT_PAREN:
+            depth--;
+            break;
+        case TokenInfo::Type::FUN:
+        case TokenInfo::Type::VAR:
+        {
+            if (depth != 0 || i - bounds.back() < rangeSize)
+                break;
+
+            TokenInfo::Type before = tokens[i - 1].getType();
+            if (before == TokenInfo::Type::SEMICOLON || before == TokenInfo::Type::RIGHT_BRACE)
+                bounds.push_back(i);
+            break;
+        }
+        default:
+            break;
+        }
+    }
+    bounds.push_back(eof);
+
+    size_t ranges = bounds.size() - 1;
+    if (ranges == 1)
+        return parseRange(0, eof);
+
+    std::vector<RangeResult> results(ranges);
+    pool.forEach(ranges, [&](size_t i) {
+        Loxpp::suppressErrors(&results[i].errors);
+        results[i].statements = parseRange(bounds[i], bounds[i + 1]);
+        Loxpp::suppressErrors(nullptr);
+    });
+
+    // Merge in source order, up to the first range that had an error
+    std::vector<std::unique_ptr<Stmt>> statements;
+    for (size_t i = 0; i < ranges; i++)
+    {
+        if (results[i].errors != 0)
+        {
+            // Parse the rest again the usual way to report the errors
+            std::vector<std::unique_ptr<Stmt>> rest = parseRange(bounds[i], eof);
+            std::move(rest.begin(), rest.end(), std::back_inserter(statements));
+            break;
+        }
+
+        std::move(results[i].statements.begin(), results[i].statements.end(), std::back_inserter(statements));
+    }
+
+    return statements;
+}
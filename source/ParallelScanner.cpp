@@ -0,0 +1,68 @@
+#include "headers/ParallelScanner.hpp"
+#include "headers/Loxpp.hpp"
+#include "headers/ScanKernels.hpp"
+#include <algorithm>
+
+// What scanning one chunk on the guess that it starts in normal code gave
+struct ChunkResult
+{
+    std::vector<Token> tokens;
+    std::vector<std::pair<uint32_t, std::string>> errors;
+    Scanner::ChunkState exit;
+};
+
+std::vector<Token> ParallelScanner::scanTokens(uint32_t base, ThreadPool &pool)
+{
+    const std::string &text = Source::text(base);
+
+    // A few chunks per thread so one slow chunk doesn't hold up the rest. Every chunk but the last ends just after a
+    // newline.
+    size_t chunkSize = std::max(MIN_CHUNK, text.length() / (pool.size() * 4));
+    std::vector<uint32_t> bounds = {0};
+    while (bounds.back() < text.length())
+    {
+        size_t end = ScanKernels::find(text.data(), std::min(bounds.back() + chunkSize, text.length()), text.length(),
+                                       '\n');
+        bounds.push_back(static_cast<uint32_t>(std::min(end + 1, text.length())));
+    }
+
+    size_t chunks = bounds.size() - 1;
+    std::vector<ChunkResult> results(chunks);
+    pool.forEach(chunks, [&](size_t i) {
+        Scanner scanner(base, &results[i].errors);
+        results[i].exit = scanner.scanChunk(bounds[i], bounds[i + 1], Scanner::ChunkState());
+        results[i].tokens = std::move(scanner.getTokens());
+    });
+
+    // Stitch the chunks together in source order
+    size_t total = 1;
+    for (const ChunkResult &result : results)
+        total += result.tokens.size();
+
+    std::vector<Token> tokens;
+    tokens.reserve(total);
+    Scanner::ChunkState state;
+    for (size_t i = 0; i < chunks; i++)
+    {
+        ChunkResult &result = results[i];
+
+        // The guess was wrong, scan the chunk again from where the last one really left off
+        if (state.kind != Scanner::ChunkState::NORMAL)
+        {
+            result.errors.clear();
+            Scanner scanner(base, &result.errors);
+            result.exit = scanner.scanChunk(bounds[i], bounds[i + 1], state);
+            result.tokens = std::move(scanner.getTokens());
+        }
+
+        tokens.insert(tokens.end(), result.tokens.begin(), result.tokens.end());
+        for (const auto &[offset, message] : result.errors)
+            Loxpp::error(Source::lineAt(offset), message);
+
+        state = result.exit;
+        std::vector<Token>().swap(result.tokens);
+    }
+
+    tokens.push_back(Token(TokenInfo::Type::END_OF_FILE, base + static_cast<uint32_t>(text.length()), 0));
+    return tokens;
+}
@@ -1,20 +1,88 @@
 #include "headers/Parser.hpp"
 #include "headers/Loxpp.hpp"
 #include "headers/ParserError.hpp"
+#include "headers/ParserTables.hpp"
+#include "headers/PreParser.hpp"
 #include "headers/Stmt.hpp"
 #include <memory>
 
-Token Parser::previous() const
+// An operator (or an open grouping / argument list) waiting on the expression parser's stack for its operands
+struct PendingOp
+{
+    enum Kind : uint8_t
+    {
+        UNARY,
+        BINARY,
+        LOGICAL,
+        ASSIGN,
+        GROUP, // marker for "(" expression ")"
+        CALL   // marker for an argument list, the callee sits at operands[base]
+    } kind;
+    Precedence precedence;
+    uint32_t base;
+    Token token;
+};
+
+// Whether the operator on top of the stack should be reduced before pushing one with the given precedence.
+// Markers are only removed by their closing ')'.
+static bool reducible(const PendingOp &top, Precedence incoming)
+{
+    if (top.kind == PendingOp::GROUP || top.kind == PendingOp::CALL)
+        return false;
+
+    // '=' is right associative, everything else is left associative
+    if (incoming == Precedence::ASSIGNMENT)
+        return top.precedence > incoming;
+
+    return top.precedence >= incoming;
+}
+
+// Pop the operator's operands and push the node it builds
+static void reduce(std::vector<std::unique_ptr<Expr>> &operands, const PendingOp &op)
+{
+    std::unique_ptr<Expr> right = std::move(operands.back());
+    operands.pop_back();
+
+    if (op.kind == PendingOp::UNARY)
+    {
+        operands.push_back(std::make_unique<Unary>(op.token, std::move(right)));
+        return;
+    }
+
+    std::unique_ptr<Expr> &left = operands.back();
+    switch (op.kind)
+    {
+    case PendingOp::BINARY:
+        left = std::make_unique<Binary>(std::move(left), op.token, std::move(right));
+        break;
+    case PendingOp::LOGICAL:
+        left = std::make_unique<Logical>(std::move(left), op.token, std::move(right));
+        break;
+    default:
+        // Assignment: the target has to be a variable expression
+        if (Variable *variable = dynamic_cast<Variable *>(left.get()))
+        {
+            left = std::make_unique<Assign>(variable->name, std::move(right));
+            break;
+        }
+
+        // Otherwise report but keep the target, the parser is not in a "confused" state so we don't throw
+        Loxpp::error(op.token, "Invalid assignment target.");
+        break;
+    }
+}
+
+const Token &Parser::previous() const
 {
     return tokens[current - 1];
 }
 
-Token Parser::peek() const
+const Token &Parser::peek() const
 {
     return tokens[current];
 }
 
-Token Parser::advance()
+const Token &Parser::advance()
 {
     // Move foward
     if (!isAtEnd())
@@ -28,7 +96,7 @@ Token Parser::advance()
 
 bool Parser::isAtEnd() const
 {
-    return peek().getType() == TokenInfo::Type::END_OF_FILE;
+    return current >= end;
 }
 
 bool Parser::check(TokenInfo::Type type) const
@@ -41,18 +109,22 @@ bool Parser::check(TokenInfo::Type type) const
     return peek().getType() == type;
 }
 
-bool Parser::match(const std::vector<TokenInfo::Type> &types)
+bool Parser::match(TokenSet types)
 {
-    for (const auto &type : types)
-    {
-        if (check(type))
-        {
-            advance();
-            return true;
-        }
-    }
+    if (isAtEnd() || !types.contains(peek().getType()))
+        return false;
+
+    advance();
+    return true;
+}
+
+bool Parser::match(TokenInfo::Type type)
+{
+    if (!check(type))
+        return false;
 
-    return false;
+    advance();
+    return true;
 }
 
 // Run tokens with grammar rules to form expressions
@@ -63,10 +135,10 @@ std::unique_ptr<Stmt> Parser::declaration()
     try
     {
         // If the current token is a var, then it is a variable declaration
-        if (match({TokenInfo::Type::VAR}))
+        if (match(TokenInfo::Type::VAR))
             return varDeclaration();
 
-        if (match({TokenInfo::Type::FUN}))
+        if (match(TokenInfo::Type::FUN))
             return function("function");
 
         // Else some other kind of statement (print, expression, etc.)
@@ -104,7 +176,7 @@ std::unique_ptr<Function> Parser::function(const std::string &kind)
             }
 
             params.push_back(consume(TokenInfo::Type::IDENTIFIER, "Expect parameter name."));
-        } while (match({TokenInfo::Type::COMMA})); // as long as there are commas
+        } while (match(TokenInfo::Type::COMMA)); // as long as there are commas
     }
 
     consume(TokenInfo::Type::RIGHT_PAREN, "Expect ')' after parameters.");
@@ -112,6 +184,18 @@ std::unique_ptr<Function> Parser::function(const std::string &kind)
     // Parse function body (block code)
     consume(TokenInfo::Type::LEFT_BRACE, "Expect '{' before " + kind + " body.");
 
+    // Lazy mode: if the body is free of errors, only remember where it is
+    if (lazyTokens != nullptr)
+    {
+        int close = PreParser(tokens, current, end, loopDepth).skipBody();
+        if (close >= 0)
+        {
+            std::shared_ptr<LazyBody> lazyBody = std::make_shared<LazyBody>(lazyTokens, current, close, loopDepth);
+            current = close + 1;
+            return std::make_unique<Function>(name, params, lazyBody);
+        }
+    }
+
     std::vector<std::unique_ptr<Stmt>> body = block();
 
     // After we get block, we now have function (name) with params and body.
@@ -129,7 +213,7 @@ std::unique_ptr<Stmt> Parser::varDeclaration()
     // + 2 etc.)
     std::unique_ptr<Expr> initializer = nullptr;
 
-    if (match({TokenInfo::Type::EQUAL}))
+    if (match(TokenInfo::Type::EQUAL))
         initializer = expression();
 
     consume(TokenInfo::Type::SEMICOLON, "Expect ';' after variable declaration.");
@@ -141,19 +225,19 @@ std::unique_ptr<Stmt> Parser::varDeclaration()
 std::unique_ptr<Stmt> Parser::statement()
 {
     // Check if current token is an IF statement
-    if (match({TokenInfo::Type::IF}))
+    if (match(TokenInfo::Type::IF))
         return ifStatement();
 
     // Check if the current token is a return statement
-    if (match({TokenInfo::Type::RETURN}))
+    if (match(TokenInfo::Type::RETURN))
         return returnStatement();
 
     // Check if the current token is a print statement
-    if (match({TokenInfo::Type::PRINT}))
+    if (match(TokenInfo::Type::PRINT))
         return printStatement();
 
     // Check if the current token is a for statement
-    if (match({TokenInfo::Type::FOR}))
+    if (match(TokenInfo::Type::FOR))
     {
         auto forStmt = forStatement();
         loopDepth--;
@@ -161,7 +245,7 @@ std::unique_ptr<Stmt> Parser::statement()
     }
 
     // Check if the current token is a while statement
-    if (match({TokenInfo::Type::WHILE}))
+    if (match(TokenInfo::Type::WHILE))
     {
         auto whileStmt = whileStatement();
         loopDepth--;
@@ -169,10 +253,10 @@ std::unique_ptr<Stmt> Parser::statement()
     }
 
     // Check if the current token is a break statement
-    if (match({TokenInfo::Type::BREAK}))
+    if (match(TokenInfo::Type::BREAK))
         return breakStatement();
 
-    if (match({TokenInfo::Type::LEFT_BRACE}))
+    if (match(TokenInfo::Type::LEFT_BRACE))
     {
         // Block is a type of statement (containing multiple statements)
         auto b = block();
@@ -206,7 +290,7 @@ std::unique_ptr<Stmt> Parser::ifStatement()
 
     std::unique_ptr<Stmt> thenBranch = statement();
     std::unique_ptr<Stmt> elseBranch = nullptr;
-    if (match({TokenInfo::Type::ELSE}))
+    if (match(TokenInfo::Type::ELSE))
         elseBranch = statement();
 
     return std::make_unique<If>(condition, thenBranch, elseBranch);
@@ -221,10 +305,10 @@ std::unique_ptr<Stmt> Parser::forStatement()
     // INITIALIZER --------
 
     std::unique_ptr<Stmt> initializer;
-    if (match({TokenInfo::Type::SEMICOLON}))
+    if (match(TokenInfo::Type::SEMICOLON))
         initializer = nullptr;
 
-    else if (match({TokenInfo::Type::VAR}))
+    else if (match(TokenInfo::Type::VAR))
         initializer = varDeclaration();
 
     else
@@ -355,227 +439,156 @@ std::unique_ptr<Stmt> Parser::expressionStatement()
     return std::make_unique<Expression>(value);
 }
 
+/*
+ * Expressions are parsed with precedence climbing over explicit operand and operator stacks rather than one recursive
+ * function per grammar rule, so a literal costs one primary() call and deeply nested input can't overflow the C++
+ * stack. '(' groupings and call argument lists are pushed as markers that stop reduction until their ')' is found.
+ */
 std::unique_ptr<Expr> Parser::expression()
 {
-    return assignment();
-}
-
-std::unique_ptr<Expr> Parser::assignment()
-{
-    std::unique_ptr<Expr> expr = logicalOr();
+    std::vector<std::unique_ptr<Expr>> operands;
+    std::vector<PendingOp> operators;
+    bool expectOperand = true;
 
-    // If we have an equal sign, then it is an assignment
-    if (match({TokenInfo::Type::EQUAL}))
+    while (true)
     {
-        Token equals = previous();
-        std::unique_ptr<Expr> value = assignment();
-
-        // Check if expr is a variable expression
-        // If it was then expr returned from equality would be pointer of Variable class
-        // Reference: https://stackoverflow.com/a/307801
-        if (dynamic_cast<Variable *>(expr.get()) != nullptr)
+        if (expectOperand)
         {
-            Token name = static_cast<Variable *>(expr.get())->name;
-            return std::make_unique<Assign>(name, value);
+            // Prefix position: unary operators and groupings until we get to an operand
+            if (match(UNARY_OPS))
+                operators.push_back({PendingOp::UNARY, Precedence::UNARY, 0, previous()});
+            else if (match(TokenInfo::Type::LEFT_PAREN))
+                operators.push_back({PendingOp::GROUP, Precedence::NONE, 0, previous()});
+            else
+            {
+                operands.push_back(primary());
+                expectOperand = false;
+            }
+            continue;
         }
 
-        // If it was not a variable expression, and we're at this point (because we had a equals '=' sign for
-        // assignment) then error
-        Loxpp::error(equals, "Invalid assignment target.");
-        // don't throw error because parser is not in "confused" state
-    }
-
-    return expr;
-}
-
-std::unique_ptr<Expr> Parser::logicalOr()
-{
-    std::unique_ptr<Expr> expr = logicalAnd();
-
-    while (match({TokenInfo::Type::OR}))
-    {
-        Token op = previous();
-        std::unique_ptr<Expr> right = logicalAnd();
-        expr = std::make_unique<Logical>(expr, op, right);
-    }
-
-    return expr;
-}
-
-std::unique_ptr<Expr> Parser::logicalAnd()
-{
-    std::unique_ptr<Expr> expr = equality();
-
-    while (match({TokenInfo::Type::AND}))
-    {
-        Token op = previous();
-        std::unique_ptr<Expr> right = equality();
-        expr = std::make_unique<Logical>(expr, op, right);
-    }
-
-    return expr;
-}
-
-// equality → comparison ( ( "!=" | "==" ) comparison )* ;
-std::unique_ptr<Expr> Parser::equality()
-{
-
-    std::unique_ptr<Expr> expr = comparison();
-
-    // while the current token is either '!=' or '=='
-    while (match({TokenInfo::Type::BANG_EQUAL, TokenInfo::Type::EQUAL_EQUAL}))
-    {
-        Token op = previous();
-        std::unique_ptr<Expr> right = comparison();
-        expr = std::make_unique<Binary>(expr, op, right);
-    }
-
-    return expr;
-}
-
-// comparison → term ( ( ">" | ">=" | "<" | "<=" ) term )* ;
-std::unique_ptr<Expr> Parser::comparison()
-{
-    std::unique_ptr<Expr> expr = term();
-
-    while (match(
-        {TokenInfo::Type::GREATER, TokenInfo::Type::GREATER_EQUAL, TokenInfo::Type::LESS, TokenInfo::Type::LESS_EQUAL}))
-    {
-        Token op = previous();
-        std::unique_ptr<Expr> right = term();
-        expr = std::make_unique<Binary>(expr, op, right);
-    }
-
-    return expr;
-}
-
-// term → factor ( ( "-" | "+" ) factor )* ;
-std::unique_ptr<Expr> Parser::term()
-{
-    std::unique_ptr<Expr> expr = factor();
-
-    while (match({TokenInfo::Type::MINUS, TokenInfo::Type::PLUS}))
-    {
-        Token op = previous();
-        std::unique_ptr<Expr> right = factor();
-        expr = std::make_unique<Binary>(expr, op, right);
-    }
-
-    return expr;
-}
-
-// factor → unary ( ( "/" | "*" ) unary )* ;
-std::unique_ptr<Expr> Parser::factor()
-{
-    std::unique_ptr<Expr> expr = unary();
-
-    while (match({TokenInfo::Type::SLASH, TokenInfo::Type::STAR}))
-    {
-        Token op = previous();
-        std::unique_ptr<Expr> right = unary();
-        expr = std::make_unique<Binary>(expr, op, right);
-    }
-
-    return expr;
-}
+        // Postfix position: a call binds tighter than any operator, so it applies straight to the last operand
+        if (match(TokenInfo::Type::LEFT_PAREN))
+        {
+            uint32_t callee = operands.size() - 1;
+            if (match(TokenInfo::Type::RIGHT_PAREN))
+            {
+                std::vector<std::unique_ptr<Expr>> arguments;
+                operands.back() = std::make_unique<Call>(std::move(operands.back()), previous(), std::move(arguments));
+            }
+            else
+            {
+                operators.push_back({PendingOp::CALL, Precedence::NONE, callee, previous()});
+                expectOperand = true;
+            }
+            continue;
+        }
 
-// unary → ( "!" | "-" ) unary | call ;
-std::unique_ptr<Expr> Parser::unary()
-{
-    if (match({TokenInfo::Type::BANG, TokenInfo::Type::MINUS}))
-    {
-        Token op = previous();
-        std::unique_ptr<Expr> right = unary();
-        return std::make_unique<Unary>(op, right);
-    }
-    else
-        return call();
-}
+        // Infix position: reduce everything that binds at least as tight (tighter for '=', which is right
+        // associative) and wait for the right operand
+        Precedence precedence = INFIX_PRECEDENCE[peek().getType()];
+        if (precedence != Precedence::NONE)
+        {
+            const Token &op = advance();
+            while (!operators.empty() && reducible(operators.back(), precedence))
+            {
+                reduce(operands, operators.back());
+                operators.pop_back();
+            }
 
-// call → primary ( "(" arguments? ")" )* ;
-std::unique_ptr<Expr> Parser::call()
-{
-    std::unique_ptr<Expr> expr = primary();
+            PendingOp::Kind kind = precedence == Precedence::ASSIGNMENT ? PendingOp::ASSIGN
+                                   : precedence <= Precedence::AND     ? PendingOp::LOGICAL
+                                                                       : PendingOp::BINARY;
+            operators.push_back({kind, precedence, 0, op});
+            expectOperand = true;
+            continue;
+        }
 
-    while (true)
-    {
-        if (match({TokenInfo::Type::LEFT_PAREN}))
+        // Nothing continues the expression: finish it up to the innermost grouping or argument list
+        while (!operators.empty() && reducible(operators.back(), Precedence::NONE))
         {
-            expr = finishCall(expr);
+            reduce(operands, operators.back());
+            operators.pop_back();
         }
-        else
-            break;
-    }
 
-    return expr;
-}
+        if (operators.empty())
+            return std::move(operands.back());
 
-std::unique_ptr<Expr> Parser::finishCall(std::unique_ptr<Expr> &callee)
-{
-    std::vector<std::unique_ptr<Expr>> arguments;
-    if (!check(TokenInfo::Type::RIGHT_PAREN))
-    {
-        do
+        PendingOp marker = operators.back();
+        if (marker.kind == PendingOp::GROUP)
+        {
+            consume(TokenInfo::Type::RIGHT_PAREN, "Expect ')' after expression.");
+            operands.back() = std::make_unique<Grouping>(std::move(operands.back()));
+            operators.pop_back();
+        }
+        else if (match(TokenInfo::Type::COMMA))
         {
-            if (arguments.size() >= 255)
+            // Another argument
+            if (operands.size() - marker.base - 1 >= 255)
                 Loxpp::error(peek(), "Cannot have more than 255 arguments.");
-            arguments.push_back(expression());
-
-        } while (match({TokenInfo::Type::COMMA}));
-    }
+            expectOperand = true;
+        }
+        else
+        {
+            const Token &paren = consume(TokenInfo::Type::RIGHT_PAREN, "Expect ')' after arguments.");
 
-    Token paren = consume(TokenInfo::Type::RIGHT_PAREN, "Expect ')' after arguments.");
+            std::vector<std::unique_ptr<Expr>> arguments;
+            arguments.reserve(operands.size() - marker.base - 1);
+            for (size_t i = marker.base + 1; i < operands.size(); i++)
+                arguments.push_back(std::move(operands[i]));
 
-    return std::make_unique<Call>(callee, paren, arguments);
+            operands.resize(marker.base + 1);
+            operands.back() = std::make_unique<Call>(std::move(operands.back()), paren, std::move(arguments));
+            operators.pop_back();
+        }
+    }
 }
 
-// primary → NUMBER | STRING | "true" | "false" | "nil" | "(" expression ")" | IDENTIFIER;
+// primary → NUMBER | STRING | "true" | "false" | "nil" | IDENTIFIER ;
+// ( "(" expression ")" groupings are handled by expression() )
 std::unique_ptr<Expr> Parser::primary()
 {
-    if (match({TokenInfo::Type::FALSE}))
+    if (match(TokenInfo::Type::FALSE))
     {
         auto nilptr = std::shared_ptr<void>();
         return std::make_unique<Literal>(nilptr, TokenInfo::Type::FALSE);
     }
-    if (match({TokenInfo::Type::TRUE}))
+    if (match(TokenInfo::Type::TRUE))
     {
         auto nilptr = std::shared_ptr<void>();
         return std::make_unique<Literal>(nilptr, TokenInfo::Type::TRUE);
     }
-    if (match({TokenInfo::Type::NIL}))
+    if (match(TokenInfo::Type::NIL))
     {
         auto nilptr = std::shared_ptr<void>();
         return std::make_unique<Literal>(nilptr, TokenInfo::Type::NIL);
     }
 
-    if (match({TokenInfo::Type::NUMBER, TokenInfo::Type::STRING}))
+    if (match(LITERALS))
     {
         auto prevLiteral = previous().getLiteral();
         return std::make_unique<Literal>(prevLiteral, previous().getType());
     }
 
     // If we find an identifier, then it is a variable
-    if (match({TokenInfo::Type::IDENTIFIER}))
+    if (match(TokenInfo::Type::IDENTIFIER))
         return std::make_unique<Variable>(previous());
 
-    // If we find a left parenthesis, we should find right else throw an error
-    if (match({TokenInfo::Type::LEFT_PAREN}))
-    {
-        // After finding left paren, parse the inside expression (will consume tokens)
-        std::unique_ptr<Expr> expr = expression();
-
-        // After parsing the expression, we should find a right parenthesis
-        consume(TokenInfo::Type::RIGHT_PAREN, "Expect ')' after expression.");
+    // If we've reached here, then throw an error because we couldn't find a valid expression to put into AST
+    throw ParserError(peek(), "Expect expression.");
+}
 
-        // If we've reached here, we've found a valid grouping
-        return std::make_unique<Grouping>(expr);
+const Token &Parser::consume(TokenInfo::Type type, const char *message)
+{
+    if (check(type))
+    {
+        return advance();
     }
 
-    // If we've reached here, then throw an error because we couldn't find a valid expression to put into AST
-    throw ParserError(peek(), "Expect expression.");
+    throw ParserError(peek(), message);
 }
 
-Token Parser::consume(TokenInfo::Type type, const std::string &message)
+const Token &Parser::consume(TokenInfo::Type type, const std::string &message)
 {
     if (check(type))
     {
@@ -616,6 +629,18 @@ void Parser::synchronize()
 
 // Parse
 
+const std::vector<std::unique_ptr<Stmt>> &LazyBody::get()
+{
+    if (tokens != nullptr)
+    {
+        // Nested functions are left for later too
+        statements = Parser(tokens, begin, end, loopDepth).parse();
+        tokens.reset();
+    }
+
+    return statements;
+}
+
 std::vector<std::unique_ptr<Stmt>> Parser::parse()
 {
     try
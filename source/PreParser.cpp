@@ -0,0 +1,260 @@
+#include "headers/PreParser.hpp"
+#include "headers/ParserTables.hpp"
+
+int PreParser::skipBody()
+{
+    try
+    {
+        while (!check(TokenInfo::Type::RIGHT_BRACE) && !isAtEnd())
+            declaration();
+
+        if (!check(TokenInfo::Type::RIGHT_BRACE))
+            return -1;
+
+        return current;
+    }
+    catch (const Invalid &)
+    {
+        return -1;
+    }
+}
+
+// Operands that are never an assignment target (besides the LITERALS)
+static constexpr TokenSet CONSTANTS = {TokenInfo::Type::FALSE, TokenInfo::Type::TRUE, TokenInfo::Type::NIL};
+
+// The rules below follow the Parser's, see Parser.cpp for what each one does
+
+void PreParser::declaration()
+{
+    if (match(TokenInfo::Type::VAR))
+        varDeclaration();
+    else if (match(TokenInfo::Type::FUN))
+        function();
+    else
+        statement();
+}
+
+void PreParser::function()
+{
+    consume(TokenInfo::Type::IDENTIFIER);
+    consume(TokenInfo::Type::LEFT_PAREN);
+
+    if (!check(TokenInfo::Type::RIGHT_PAREN))
+    {
+        int params = 0;
+        do
+        {
+            // "Cannot have more than 255 parameters."
+            if (params++ >= 255)
+                throw Invalid();
+
+            consume(TokenInfo::Type::IDENTIFIER);
+        } while (match(TokenInfo::Type::COMMA));
+    }
+
+    consume(TokenInfo::Type::RIGHT_PAREN);
+    consume(TokenInfo::Type::LEFT_BRACE);
+    block();
+}
+
+void PreParser::varDeclaration()
+{
+    consume(TokenInfo::Type::IDENTIFIER);
+
+    if (match(TokenInfo::Type::EQUAL))
+        expression();
+
+    consume(TokenInfo::Type::SEMICOLON);
+}
+
+void PreParser::statement()
+{
+    if (match(TokenInfo::Type::IF))
+    {
+        consume(TokenInfo::Type::LEFT_PAREN);
+        expression();
+        consume(TokenInfo::Type::RIGHT_PAREN);
+        statement();
+        if (match(TokenInfo::Type::ELSE))
+            statement();
+    }
+    else if (match(TokenInfo::Type::RETURN))
+    {
+        if (!check(TokenInfo::Type::SEMICOLON))
+            expression();
+        consume(TokenInfo::Type::SEMICOLON);
+    }
+    else if (match(TokenInfo::Type::PRINT))
+    {
+        expression();
+        consume(TokenInfo::Type::SEMICOLON);
+    }
+    else if (match(TokenInfo::Type::FOR))
+    {
+        consume(TokenInfo::Type::LEFT_PAREN);
+        if (match(TokenInfo::Type::SEMICOLON))
+            ;
+        else if (match(TokenInfo::Type::VAR))
+            varDeclaration();
+        else
+        {
+            expression();
+            consume(TokenInfo::Type::SEMICOLON);
+        }
+
+        if (!check(TokenInfo::Type::SEMICOLON))
+            expression();
+        consume(TokenInfo::Type::SEMICOLON);
+
+        if (!check(TokenInfo::Type::RIGHT_PAREN))
+            expression();
+        consume(TokenInfo::Type::RIGHT_PAREN);
+
+        loopDepth++;
+        statement();
+        loopDepth--;
+    }
+    else if (match(TokenInfo::Type::WHILE))
+    {
+        consume(TokenInfo::Type::LEFT_PAREN);
+        expression();
+        consume(TokenInfo::Type::RIGHT_PAREN);
+
+        loopDepth++;
+        statement();
+        loopDepth--;
+    }
+    else if (match(TokenInfo::Type::BREAK))
+    {
+        consume(TokenInfo::Type::SEMICOLON);
+
+        // "Cannot use 'break' outside of a loop."
+        if (loopDepth == 0)
+            throw Invalid();
+    }
+    else if (match(TokenInfo::Type::LEFT_BRACE))
+        block();
+    else
+    {
+        expression();
+        consume(TokenInfo::Type::SEMICOLON);
+    }
+}
+
+void PreParser::block()
+{
+    while (!check(TokenInfo::Type::RIGHT_BRACE) && !isAtEnd())
+        declaration();
+
+    consume(TokenInfo::Type::RIGHT_BRACE);
+}
+
+/*
+ * Same precedence climbing as Parser::expression, but an operand is only a flag saying whether it is a bare variable
+ * (the one valid assignment target) and an operator only its precedence.
+ */
+void PreParser::expression()
+{
+    // Markers for open groupings and argument lists, below any precedence
+    constexpr int GROUP = -1;
+    constexpr int CALL = -2;
+
+    std::vector<bool> operands;
+    std::vector<int> operators;
+    // Operand stack size when each argument list was opened
+    std::vector<size_t> callBases;
+    bool expectOperand = true;
+
+    // Pop an operator and its operands, leaving one operand that is not a variable
+    auto reduce = [&]() {
+        if (operators.back() != static_cast<int>(Precedence::UNARY))
+            operands.pop_back();
+        operands.back() = false;
+        operators.pop_back();
+    };
+
+    while (true)
+    {
+        if (expectOperand)
+        {
+            if (match(UNARY_OPS))
+                operators.push_back(static_cast<int>(Precedence::UNARY));
+            else if (match(TokenInfo::Type::LEFT_PAREN))
+                operators.push_back(GROUP);
+            else if (match(TokenInfo::Type::IDENTIFIER))
+            {
+                operands.push_back(true);
+                expectOperand = false;
+            }
+            else if (match(CONSTANTS) || match(LITERALS))
+            {
+                operands.push_back(false);
+                expectOperand = false;
+            }
+            else
+                throw Invalid(); // "Expect expression."
+            continue;
+        }
+
+        if (match(TokenInfo::Type::LEFT_PAREN))
+        {
+            if (match(TokenInfo::Type::RIGHT_PAREN))
+                operands.back() = false;
+            else
+            {
+                operators.push_back(CALL);
+                callBases.push_back(operands.size());
+                expectOperand = true;
+            }
+            continue;
+        }
+
+        Precedence precedence = INFIX_PRECEDENCE[tokens[current].getType()];
+        if (precedence != Precedence::NONE)
+        {
+            current++;
+            int incoming = static_cast<int>(precedence);
+            // '=' is right associative, everything else is left associative
+            while (!operators.empty() && operators.back() > 0 &&
+                   (operators.back() > incoming ||
+                    (operators.back() == incoming && precedence != Precedence::ASSIGNMENT)))
+                reduce();
+
+            // "Invalid assignment target."
+            if (precedence == Precedence::ASSIGNMENT && !operands.back())
+                throw Invalid();
+
+            operators.push_back(incoming);
+            expectOperand = true;
+            continue;
+        }
+
+        while (!operators.empty() && operators.back() > 0)
+            reduce();
+
+        if (operators.empty())
+            return;
+
+        if (operators.back() == GROUP)
+        {
+            consume(TokenInfo::Type::RIGHT_PAREN);
+            operands.back() = false;
+            operators.pop_back();
+        }
+        else if (match(TokenInfo::Type::COMMA))
+        {
+            // "Cannot have more than 255 arguments."
+            if (operands.size() - callBases.back() >= 255)
+                throw Invalid();
+            expectOperand = true;
+        }
+        else
+        {
+            consume(TokenInfo::Type::RIGHT_PAREN);
+            operands.resize(callBases.back());
+            operands.back() = false;
+            callBases.pop_back();
+            operators.pop_back();
+        }
+    }
+}
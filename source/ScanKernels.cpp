@@ -0,0 +1,207 @@
+#include "headers/ScanKernels.hpp"
+#include <cstdint>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// Scalar versions of the character classes, used without SIMD and for the tail of the input
+static bool isWhitespace(char c)
+{
+    return c == ' ' || c == '\r' || c == '\t' || c == '\n';
+}
+
+static bool isDigit(char c)
+{
+    return c >= '0' && c <= '9';
+}
+
+static bool isIdentifierChar(char c)
+{
+    char lower = c | 0x20;
+    return (lower >= 'a' && lower <= 'z') || isDigit(c) || c == '_';
+}
+
+/*
+ * A block of bytes and the few operations the kernels need on it. Comparisons give a bitmask with one bit per byte
+ * (bit i set if byte i matched), so the first match is the number of trailing zeros.
+ */
+#if defined(__AVX2__)
+
+using Block = __m256i;
+static constexpr size_t WIDTH = 32;
+
+static inline Block load(const char *p)
+{
+    return _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+}
+
+static inline Block equal(Block block, char c)
+{
+    return _mm256_cmpeq_epi8(block, _mm256_set1_epi8(c));
+}
+
+// lo <= byte <= hi for ASCII bounds. Bytes >= 0x80 are negative as signed chars so they never match.
+static inline Block inRange(Block block, char lo, char hi)
+{
+    return _mm256_andnot_si256(_mm256_cmpgt_epi8(_mm256_set1_epi8(lo), block),
+                               _mm256_cmpgt_epi8(_mm256_set1_epi8(hi + 1), block));
+}
+
+static inline Block either(Block a, Block b)
+{
+    return _mm256_or_si256(a, b);
+}
+
+static inline Block both(Block a, Block b)
+{
+    return _mm256_and_si256(a, b);
+}
+
+static inline Block lowercase(Block block)
+{
+    return _mm256_or_si256(block, _mm256_set1_epi8(0x20));
+}
+
+static inline uint32_t mask(Block block)
+{
+    return static_cast<uint32_t>(_mm256_movemask_epi8(block));
+}
+
+#elif defined(__SSE2__)
+
+using Block = __m128i;
+static constexpr size_t WIDTH = 16;
+
+static inline Block load(const char *p)
+{
+    return _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+}
+
+static inline Block equal(Block block, char c)
+{
+    return _mm_cmpeq_epi8(block, _mm_set1_epi8(c));
+}
+
+// lo <= byte <= hi for ASCII bounds. Bytes >= 0x80 are negative as signed chars so they never match.
+static inline Block inRange(Block block, char lo, char hi)
+{
+    return _mm_andnot_si128(_mm_cmplt_epi8(block, _mm_set1_epi8(lo)), _mm_cmplt_epi8(block, _mm_set1_epi8(hi + 1)));
+}
+
+static inline Block either(Block a, Block b)
+{
+    return _mm_or_si128(a, b);
+}
+
+static inline Block both(Block a, Block b)
+{
+    return _mm_and_si128(a, b);
+}
+
+static inline Block lowercase(Block block)
+{
+    return _mm_or_si128(block, _mm_set1_epi8(0x20));
+}
+
+static inline uint32_t mask(Block block)
+{
+    return static_cast<uint32_t>(_mm_movemask_epi8(block));
+}
+
+#endif
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#define SCAN_KERNELS_SIMD 1
+
+// Full blocks (from pos) that fit before end. stop(block) gives the mask of bytes that end the scan.
+template <typename Stop> static inline size_t scanBlocks(const char *text, size_t pos, size_t end, Stop stop)
+{
+    while (pos + WIDTH <= end)
+    {
+        uint32_t found = mask(stop(load(text + pos)));
+        if (found != 0)
+            return pos + __builtin_ctz(found);
+        pos += WIDTH;
+    }
+    return pos;
+}
+#endif
+
+size_t ScanKernels::skipWhitespace(const char *text, size_t pos, size_t end)
+{
+#ifdef SCAN_KERNELS_SIMD
+    // Most whitespace runs are a single space, don't pay for a block load for those
+    if (pos < end && !isWhitespace(text[pos]))
+        return pos;
+
+    pos = scanBlocks(text, pos, end, [](Block block) {
+        Block space = either(either(equal(block, ' '), equal(block, '\n')), either(equal(block, '\t'), equal(block, '\r')));
+        return equal(space, 0);
+    });
+#endif
+    while (pos < end && isWhitespace(text[pos]))
+        pos++;
+    return pos;
+}
+
+size_t ScanKernels::skipIdentifier(const char *text, size_t pos, size_t end)
+{
+#ifdef SCAN_KERNELS_SIMD
+    pos = scanBlocks(text, pos, end, [](Block block) {
+        Block letter = inRange(lowercase(block), 'a', 'z');
+        Block identifier = either(either(letter, inRange(block, '0', '9')), equal(block, '_'));
+        return equal(identifier, 0);
+    });
+#endif
+    while (pos < end && isIdentifierChar(text[pos]))
+        pos++;
+    return pos;
+}
+
+size_t ScanKernels::skipDigits(const char *text, size_t pos, size_t end)
+{
+#ifdef SCAN_KERNELS_SIMD
+    pos = scanBlocks(text, pos, end, [](Block block) { return equal(inRange(block, '0', '9'), 0); });
+#endif
+    while (pos < end && isDigit(text[pos]))
+        pos++;
+    return pos;
+}
+
+size_t ScanKernels::find(const char *text, size_t pos, size_t end, char c)
+{
+#ifdef SCAN_KERNELS_SIMD
+    pos = scanBlocks(text, pos, end, [c](Block block) { return equal(block, c); });
+#endif
+    while (pos < end && text[pos] != c)
+        pos++;
+    return pos;
+}
+
+size_t ScanKernels::findCommentDelimiter(const char *text, size_t pos, size_t end)
+{
+#ifdef SCAN_KERNELS_SIMD
+    // Compare every byte and the one after it, so both loads have to fit
+    while (pos + WIDTH + 1 <= end)
+    {
+        Block current = load(text + pos);
+        Block next = load(text + pos + 1);
+        Block close = both(equal(current, '*'), equal(next, '/'));
+        Block open = both(equal(current, '/'), equal(next, '*'));
+
+        uint32_t found = mask(either(close, open));
+        if (found != 0)
+            return pos + __builtin_ctz(found);
+        pos += WIDTH;
+    }
+#endif
+    for (; pos + 1 < end; pos++)
+    {
+        if ((text[pos] == '*' && text[pos + 1] == '/') || (text[pos] == '/' && text[pos + 1] == '*'))
+            return pos;
+    }
+    return end;
+}
@@ -1,10 +1,33 @@
 #include "headers/Scanner.hpp"
 #include "headers/Loxpp.hpp"
+#include "headers/ScanKernels.hpp"
 #include <cctype>
 #include <string>
 
 std::vector<Token> &Scanner::scanTokens()
 {
+    scanChunk(0, source.length(), ChunkState());
+
+    tokens.push_back(Token(TokenInfo::Type::END_OF_FILE, base + current, 0));
+
+    return tokens;
+}
+
+Scanner::ChunkState Scanner::scanChunk(uint32_t begin, uint32_t end, ChunkState entry)
+{
+    current = begin;
+    limit = end;
+    pending = ChunkState();
+
+    // Finish the string or comment the previous chunk ended in
+    if (entry.kind == ChunkState::STRING)
+    {
+        start = entry.start;
+        string();
+    }
+    else if (entry.kind == ChunkState::COMMENT)
+        multiLineComment(entry.nesting);
+
     while (!isAtEnd())
     {
         // We are at the beginning of the next lexeme.
@@ -18,16 +41,13 @@ std::vector<Token> &Scanner::scanTokens()
         scanToken();
     }
 
-    auto nilptr = std::shared_ptr<void>();
-    tokens.push_back(Token(TokenInfo::Type::END_OF_FILE, "", nilptr, line));
-
-    return tokens;
+    return pending;
 }
 
 bool Scanner::isAtEnd()
 {
 
-    return current >= source.length();
+    return current >= limit;
 }
 
 void Scanner::scanToken()
@@ -89,11 +109,8 @@ void Scanner::scanToken()
         // Comment
         if (match('/'))
         {
-            // As long as we are on the same line and it's not the endof the source code
-            while (peek() != '\n' && !isAtEnd())
-                // Don't add comments to tokens
-                // Just simply advance the current pointer
-                advance();
+            // Skip to the end of the line (or of the source code). Comments are not added to tokens.
+            current = ScanKernels::find(source.data(), current, limit, '\n');
         }
         // Multi-line comment
         else if (match('*'))
@@ -107,13 +124,13 @@ void Scanner::scanToken()
         }
         break;
 
-    // Ignore whitespace. This will end loop and move to next lexeme in the outer while loop.
+    // Ignore whitespace, the whole run of it at once. This will end loop and move to next lexeme in the outer while
+    // loop.
     case ' ':
     case '\r':
     case '\t':
-        break;
     case '\n':
-        line++;
+        current = ScanKernels::skipWhitespace(source.data(), current, limit);
         break;
 
     // String literals
@@ -134,7 +151,7 @@ void Scanner::scanToken()
         }
         else
         {
-            Loxpp::error(line, "Unexpected character.");
+            error("Unexpected character.");
         }
         break;
     }
@@ -147,14 +164,19 @@ char Scanner::advance()
 
 void Scanner::addToken(TokenInfo::Type type)
 {
-    auto nilptr = std::shared_ptr<void>();
-    addToken(type, nilptr);
+    // The lexeme and literal value are read back from the source when needed
+    tokens.push_back(Token(type, base + start, current - start));
 }
 
-void Scanner::addToken(TokenInfo::Type type, std::shared_ptr<void> &literal)
+void Scanner::error(const std::string &message)
 {
-    std::string text = source.substr(start, current - start);
-    tokens.push_back(Token(type, text, literal, line));
+    if (deferredErrors != nullptr)
+    {
+        deferredErrors->push_back({base + current, message});
+        return;
+    }
+
+    Loxpp::error(Source::lineAt(base + current), message);
 }
 
 bool Scanner::match(char expected)
@@ -189,40 +211,34 @@ char Scanner::peekNext()
 void Scanner::string()
 {
 
-    // As long as we are not at the end of the source code and we haven't encountered the closing double quote
-    while (peek() != '"' && !isAtEnd())
-    {
-        // If we encounter a newline, we are in a multi-line string
-        if (peek() == '\n')
-            line++;
-
-        // Consume but don't save it anywhere to add to tokens
-        advance();
-    }
+    // Skip to the closing double quote or the end of the source code (strings can span multiple lines)
+    current = ScanKernels::find(source.data(), current, limit, '"');
 
-    // Unterminated string
     if (isAtEnd())
     {
-        Loxpp::error(line, "Unterminated string.");
+        // Only the chunk ends here, the string goes on in the next one
+        if (limit < source.length())
+        {
+            pending = {ChunkState::STRING, start, 0};
+            return;
+        }
+
+        // Unterminated string
+        error("Unterminated string.");
         return;
     }
 
     // The closing quote. Consume it.
     advance();
 
-    // Remove surrounding quotes to add purely the string value to tokens
-
-    // Create string in memory
-    std::string str = source.substr(start + 1, current - (start + 1) - 1);
-    std::shared_ptr<void> string = std::make_shared<std::string>(str);
-    addToken(TokenInfo::Type::STRING, string);
+    // The token keeps the quotes, Token::getLiteral() removes them
+    addToken(TokenInfo::Type::STRING);
 }
 
 void Scanner::number()
 {
     // Keep consuming (moving current forward) until we find something not a digit
-    while (isdigit(peek()))
-        advance();
+    current = ScanKernels::skipDigits(source.data(), current, limit);
 
     // If we encounter decimal point and next char after is digit,
     // then continue consumption until we find something not a digit
@@ -231,55 +247,54 @@ void Scanner::number()
         // Consume the '.'
         advance();
 
-        // Consume the digit after the '.'
-        while (isdigit(peek()))
-            advance();
+        // Consume the digits after the '.'
+        current = ScanKernels::skipDigits(source.data(), current, limit);
     }
 
-    // Parse string into double and store in tokens
-    std::shared_ptr<void> number = std::make_shared<double>(std::stod(source.substr(start, current)));
-    addToken(TokenInfo::Type::NUMBER, number);
+    // Token::getLiteral() parses the lexeme into a double
+    addToken(TokenInfo::Type::NUMBER);
 }
 
-void Scanner::multiLineComment()
+void Scanner::multiLineComment(int nesting)
 {
-
-    int nesting = 1;
-
-    while (!isAtEnd())
+    while (true)
     {
-        if (peek() == '*' && peekNext() == '/')
+        // Jump to the next "*/" or "/*", everything in between is comment
+        current = ScanKernels::findCommentDelimiter(source.data(), current, limit);
+        if (isAtEnd())
+            break;
+
+        if (source[current] == '*')
         {
             nesting--;
 
             if (nesting == 0)
             {
-                // Consume the '*'
-                // Consume the '/'
-                advance();
-                advance();
+                // Consume the '*' and the '/'
+                current += 2;
                 return;
             }
-        }
 
-        if (peek() == '/' && peekNext() == '*')
+            // Only consume the '*', the '/' may still start a nested comment ("*/*")
+            current++;
+        }
+        else
         {
             nesting++;
-            // Consume the '/'
-            // Consume the '*'
-            advance();
-            advance();
-            continue;
+            // Consume the '/' and the '*'
+            current += 2;
         }
+    }
 
-        if (peek() == '\n')
-            line++;
-
-        advance();
+    // Only the chunk ends here, the comment goes on in the next one
+    if (limit < source.length())
+    {
+        pending = {ChunkState::COMMENT, 0, nesting};
+        return;
     }
 
     // Unterminated multi-line comment
-    Loxpp::error(line, nesting == 1 ? "Unterminated multi-line comment." : "Unterminated nested multi-line comment");
+    error(nesting == 1 ? "Unterminated multi-line comment." : "Unterminated nested multi-line comment");
     return;
 }
 
@@ -288,19 +303,13 @@ bool Scanner::isAlpha(char c)
     return isalpha(c) || c == '_';
 }
 
-bool Scanner::isAlphaNumeric(char c)
-{
-    return isAlpha(c) || isdigit(c);
-}
-
 void Scanner::identifier()
 {
     // Keep consuming until we find something not an alphanumeric character
-    while (isAlphaNumeric(peek()))
-        advance();
+    current = ScanKernels::skipIdentifier(source.data(), current, limit);
 
     // Check if current lexeme between start & current is a reserved keyword with TokenInfo typeString
-    std::string text = source.substr(start, current - start);
+    std::string_view text(source.data() + start, current - start);
     TokenInfo::Type type = TokenInfo::getKeywordOrIdentifier(text);
     addToken(type);
 }
@@ -0,0 +1,72 @@
+#include "headers/Source.hpp"
+#include "headers/ScanKernels.hpp"
+#include <algorithm>
+
+std::vector<std::unique_ptr<std::string>> Source::chunks;
+std::vector<uint32_t> Source::chunkStarts;
+uint32_t Source::size = 0;
+std::vector<std::pair<uint32_t, int>> Source::lines;
+
+uint32_t Source::append(const std::string &text)
+{
+    uint32_t start = size;
+    chunks.push_back(std::make_unique<std::string>(text));
+    chunkStarts.push_back(start);
+    size += static_cast<uint32_t>(text.length());
+    return start;
+}
+
+uint32_t Source::add(const std::string &source)
+{
+    uint32_t start = append(source);
+
+    int line = 1;
+    lines.push_back({start, line});
+    for (size_t i = ScanKernels::find(source.data(), 0, source.length(), '\n'); i < source.length();
+         i = ScanKernels::find(source.data(), i + 1, source.length(), '\n'))
+    {
+        lines.push_back({start + static_cast<uint32_t>(i) + 1, ++line});
+    }
+
+    return start;
+}
+
+uint32_t Source::addSynthetic(const std::string &text, int line)
+{
+    uint32_t start = append(text);
+    lines.push_back({start, line});
+    return start;
+}
+
+const std::string &Source::chunkAt(uint32_t offset, uint32_t &chunkStart)
+{
+    // The last chunk starting at or before offset. Empty chunks share their start with the next one, so prefer later.
+    size_t index = std::upper_bound(chunkStarts.begin(), chunkStarts.end(), offset) - chunkStarts.begin() - 1;
+    chunkStart = chunkStarts[index];
+    return *chunks[index];
+}
+
+const std::string &Source::text(uint32_t start)
+{
+    uint32_t chunkStart;
+    return chunkAt(start, chunkStart);
+}
+
+std::string_view Source::view(uint32_t offset, uint32_t length)
+{
+    if (length == 0)
+        return std::string_view();
+
+    uint32_t chunkStart;
+    const std::string &chunk = chunkAt(offset, chunkStart);
+    return std::string_view(chunk).substr(offset - chunkStart, length);
+}
+
+int Source::lineAt(uint32_t offset)
+{
+    auto after = std::upper_bound(lines.begin(), lines.end(), std::make_pair(offset, INT32_MAX));
+    if (after == lines.begin())
+        return 1;
+
+    return (after - 1)->second;
+}
@@ -0,0 +1,86 @@
+#include "headers/ThreadPool.hpp"
+#include <algorithm>
+
+ThreadPool::ThreadPool(unsigned threads)
+{
+    if (threads == 0)
+        threads = std::max(1u, std::thread::hardware_concurrency());
+
+    for (unsigned i = 1; i < threads; i++)
+        workers.emplace_back(&ThreadPool::work, this);
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+
+    for (std::thread &worker : workers)
+        worker.join();
+}
+
+void ThreadPool::runTasks()
+{
+    size_t ran = 0;
+    for (size_t i = next++; i < count; i = next++)
+    {
+        (*task)(i);
+        ran++;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    finished += ran;
+    if (finished == count)
+        done.notify_all();
+}
+
+void ThreadPool::work()
+{
+    unsigned long seen = 0;
+
+    while (true)
+    {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [&] { return stopping || batch != seen; });
+            if (stopping)
+                return;
+
+            seen = batch;
+            busy++;
+        }
+
+        runTasks();
+
+        std::lock_guard<std::mutex> lock(mutex);
+        busy--;
+        if (busy == 0)
+            done.notify_all();
+    }
+}
+
+void ThreadPool::forEach(size_t count, const std::function<void(size_t)> &task)
+{
+    {
+        // A worker that woke up late for the last batch may still be looking at it
+        std::unique_lock<std::mutex> lock(mutex);
+        done.wait(lock, [&] { return busy == 0; });
+
+        this->task = &task;
+        this->count = count;
+        next = 0;
+        finished = 0;
+        batch++;
+    }
+    wake.notify_all();
+
+    // Help out instead of just waiting
+    runTasks();
+
+    // Wait for the tasks to finish and for every worker to let go of the batch, so the next one can replace it
+    std::unique_lock<std::mutex> lock(mutex);
+    done.wait(lock, [&] { return finished == count && busy == 0; });
+}
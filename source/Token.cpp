@@ -1,10 +1,72 @@
 #include "headers/Token.hpp"
+#include "headers/Source.hpp"
+#include <charconv>
+
+std::string_view Token::getLexeme() const
+{
+    return Source::view(offset, length);
+}
+
+double Token::parseNumber(std::string_view lexeme)
+{
+    // Number lexemes are digits with an optional '.' followed by more digits (see Scanner::number).
+    // Fast path: with at most 15 digits the digits form an integer that a double holds exactly, and dividing it by an
+    // exact power of ten is correctly rounded, so this gives the same result as a full decimal conversion.
+    static constexpr double POWERS_OF_TEN[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7,
+                                               1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15};
+
+    if (lexeme.length() <= 16)
+    {
+        uint64_t digits = 0;
+        int decimals = -1;
+        for (char c : lexeme)
+        {
+            if (c == '.')
+                decimals = 0;
+            else
+            {
+                digits = digits * 10 + (c - '0');
+                if (decimals >= 0)
+                    decimals++;
+            }
+        }
+
+        if (decimals < 0 && lexeme.length() <= 15)
+            return static_cast<double>(digits);
+        if (decimals >= 0)
+            return static_cast<double>(digits) / POWERS_OF_TEN[decimals];
+    }
+
+    // Long literals: exact, locale independent and straight from the source text
+    double value = 0;
+    std::from_chars(lexeme.data(), lexeme.data() + lexeme.length(), value);
+    return value;
+}
+
+std::shared_ptr<void> Token::getLiteral() const
+{
+    if (type == TokenInfo::Type::NUMBER)
+        return std::make_shared<double>(parseNumber(getLexeme()));
+
+    // Remove surrounding quotes to get purely the string value
+    if (type == TokenInfo::Type::STRING)
+        return std::make_shared<std::string>(getLexeme().substr(1, length - 2));
+
+    return nullptr;
+}
+
+int Token::getLine() const
+{
+    // The line the lexeme ends on, as the scanner used to stamp tokens: a string spanning lines reports its last one
+    return Source::lineAt(length == 0 ? offset : offset + length - 1);
+}
 
 std::string Token::toString() const
 {
 
     std::string result = "Type: " + TokenInfo::getTypeString(type) + ", Literal: ";
 
+    std::shared_ptr<void> literal = getLiteral();
     if (literal != nullptr)
     {
         if (type == TokenInfo::Type::STRING)
@@ -25,5 +87,5 @@ std::string Token::toString() const
         }
     }
 
-    return result + ", Lexeme: " + lexeme;
+    return result + ", Lexeme: " + std::string(getLexeme());
 }
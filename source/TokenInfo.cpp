@@ -1,5 +1,5 @@
 #include "headers/TokenInfo.hpp"
-#include <algorithm>
+#include <utility>
 #include <string>
 #include <vector>
 
@@ -28,21 +28,22 @@ std::string TokenInfo::getTypeString(Type type)
     return TypeStrings[type];
 }
 
-TokenInfo::Type TokenInfo::getKeywordOrIdentifier(std::string &type)
+TokenInfo::Type TokenInfo::getKeywordOrIdentifier(std::string_view text)
 {
-    // From "and" to "break" are user-usable keywords.
-    for (int i = 22; i < 39; i++)
+    // User-usable keywords, spelled the way they appear in source code.
+    static constexpr std::pair<std::string_view, TokenInfo::Type> keywords[] = {
+        {"and", AND},     {"class", CLASS}, {"else", ELSE},   {"false", FALSE},   {"fun", FUN},     {"for", FOR},
+        {"if", IF},       {"nil", NIL},     {"or", OR},       {"print", PRINT},   {"return", RETURN},
+        {"super", SUPER}, {"this", THIS},   {"true", TRUE},   {"var", VAR},       {"while", WHILE}, {"break", BREAK}};
+
+    // Keywords are 2 to 6 characters long, anything else can't be one.
+    if (text.length() < 2 || text.length() > 6)
+        return TokenInfo::Type::IDENTIFIER;
+
+    for (const auto &[keyword, type] : keywords)
     {
-        // Lowercase the string from TypeStrings vector.
-        std::string lower = TypeStrings[i];
-        std::transform(lower.begin(), lower.end(), lower.begin(), ::tolower);
-
-        // If the string from TypeStrings vector matches the input string, return the corresponding Type.
-        if (lower == type)
-        {
-            // Cast i to to a Type enum.
-            return static_cast<TokenInfo::Type>(i);
-        }
+        if (keyword == text)
+            return type;
     }
 
     // If no match is found, return IDENTIFIER.
@@ -0,0 +1,154 @@
+#include "headers/Trace.hpp"
+#include "headers/TraceRecorder.hpp"
+#include <iostream>
+
+Trace::Exit Trace::run(Environment &env) const
+{
+    // Type guards on entry: every variable from outside the loop has to still be a number
+    std::vector<Value *> bindings;
+    std::vector<double> regs(registers);
+    for (const Input &input : inputs)
+    {
+        Value *binding = env.find(input.name);
+        if (binding == nullptr || binding->second != TokenInfo::Type::NUMBER)
+            return Exit::DEOPTIMIZED;
+        bindings.push_back(binding);
+        regs[input.reg] = *static_cast<double *>(binding->first.get());
+    }
+
+    // Inputs and output as of the end of the last whole iteration
+    std::vector<double> saved(inputs.size());
+    std::string output;
+    size_t committedOutput = 0;
+    Exit exit = Exit::DEOPTIMIZED;
+
+    const TraceInstruction *begin = code.data();
+    const TraceInstruction *ip = begin;
+    for (size_t i = 0; i < inputs.size(); i++)
+        saved[i] = regs[inputs[i].reg];
+
+    while (true)
+    {
+        const TraceInstruction &in = *ip++;
+        switch (in.op)
+        {
+        case TraceInstruction::CONSTANT:
+            regs[in.target] = in.constant;
+            continue;
+        case TraceInstruction::MOVE:
+            regs[in.target] = regs[in.left];
+            continue;
+        case TraceInstruction::ADD:
+            regs[in.target] = regs[in.left] + regs[in.right];
+            continue;
+        case TraceInstruction::SUBTRACT:
+            regs[in.target] = regs[in.left] - regs[in.right];
+            continue;
+        case TraceInstruction::MULTIPLY:
+            regs[in.target] = regs[in.left] * regs[in.right];
+            continue;
+        case TraceInstruction::DIVIDE:
+            if (regs[in.right] == 0)
+                break;
+            regs[in.target] = regs[in.left] / regs[in.right];
+            continue;
+        case TraceInstruction::GREATER:
+            regs[in.target] = regs[in.left] > regs[in.right];
+            continue;
+        case TraceInstruction::GREATER_EQUAL:
+            regs[in.target] = regs[in.left] >= regs[in.right];
+            continue;
+        case TraceInstruction::LESS:
+            regs[in.target] = regs[in.left] < regs[in.right];
+            continue;
+        case TraceInstruction::LESS_EQUAL:
+            regs[in.target] = regs[in.left] <= regs[in.right];
+            continue;
+        case TraceInstruction::EQUAL:
+            regs[in.target] = regs[in.left] == regs[in.right];
+            continue;
+        case TraceInstruction::NOT_EQUAL:
+            regs[in.target] = !(regs[in.left] == regs[in.right]);
+            continue;
+        case TraceInstruction::NOT:
+            // Only 0 (and false) is falsy, NaN is truthy like in Operators::isTruthy
+            regs[in.target] = !(regs[in.left] != 0);
+            continue;
+        case TraceInstruction::GUARD_TRUTHY:
+            if (!(regs[in.left] != 0))
+                break;
+            continue;
+        case TraceInstruction::GUARD_FALSY:
+            if (regs[in.left] != 0)
+                break;
+            continue;
+        case TraceInstruction::PRINT_NUMBER:
+            // Same text as Operators::stringify
+            output += std::to_string(regs[in.left]);
+            output += '\n';
+            continue;
+        case TraceInstruction::PRINT_BOOLEAN:
+            output += regs[in.left] != 0 ? "true\n" : "false\n";
+            continue;
+        case TraceInstruction::PRINT_STRING:
+            output += strings[in.left];
+            output += '\n';
+            continue;
+        case TraceInstruction::LOOP:
+            // The iteration is done, make it stick
+            for (size_t i = 0; i < inputs.size(); i++)
+                saved[i] = regs[inputs[i].reg];
+            if (output.size() > 4096)
+            {
+                std::cout << output;
+                output.clear();
+            }
+            committedOutput = output.size();
+
+            if (!(regs[in.left] != 0))
+            {
+                exit = Exit::FINISHED;
+                break;
+            }
+            ip = begin;
+            continue;
+        }
+        break;
+    }
+
+    // Back to the state after the last whole iteration, which is also where the interpreter picks up
+    output.resize(committedOutput);
+    std::cout << output;
+    for (size_t i = 0; i < inputs.size(); i++)
+    {
+        if (inputs[i].written)
+            *bindings[i] = {std::make_shared<double>(saved[i]), TokenInfo::Type::NUMBER};
+    }
+    return exit;
+}
+
+bool LoopTrace::run(const While &loop, Environment &env)
+{
+    if (trace == nullptr)
+    {
+        if (recordings >= MAX_RECORDINGS || ++iterations < THRESHOLD)
+            return false;
+
+        recordings++;
+        trace = TraceRecorder::record(loop, env);
+        if (trace == nullptr)
+            return false;
+    }
+
+    if (trace->run(env) == Trace::Exit::FINISHED)
+        return true;
+
+    // Left through a guard: the loop went another way than when it was recorded
+    if (++deoptimizations >= MAX_DEOPTIMIZATIONS)
+    {
+        trace.reset();
+        deoptimizations = 0;
+        iterations = 0;
+    }
+    return false;
+}
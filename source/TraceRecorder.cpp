@@ -0,0 +1,314 @@
+#include "headers/TraceRecorder.hpp"
+#include <limits>
+
+// Thrown while recording when the iteration does something a trace can't do
+struct Untraceable
+{
+};
+
+std::unique_ptr<Trace> TraceRecorder::record(const While &loop, Environment &env)
+{
+    auto trace = std::make_unique<Trace>();
+    TraceRecorder recorder(*trace, env);
+
+    try
+    {
+        recorder.execute(loop.body);
+        uint16_t condition = recorder.evaluate(loop.condition);
+
+        // The next iteration expects numbers in the variables from outside, like on entry
+        for (const Trace::Input &input : trace->inputs)
+        {
+            if (recorder.types[input.reg] != Type::NUMBER)
+                throw Untraceable();
+        }
+        recorder.emit(TraceInstruction::LOOP, 0, condition);
+    }
+    catch (const Untraceable &)
+    {
+        return nullptr;
+    }
+
+    trace->registers = static_cast<uint16_t>(recorder.values.size());
+    return trace;
+}
+
+uint16_t TraceRecorder::allocate(Type type, double value)
+{
+    if (values.size() >= std::numeric_limits<uint16_t>::max())
+        throw Untraceable();
+
+    values.push_back(value);
+    types.push_back(type);
+    return static_cast<uint16_t>(values.size() - 1);
+}
+
+void TraceRecorder::emit(TraceInstruction::Op op, uint16_t target, uint16_t left, uint16_t right, double constant)
+{
+    trace.code.push_back({op, target, left, right, constant});
+}
+
+uint16_t TraceRecorder::variable(const Token &name, bool write)
+{
+    std::string_view lexeme = name.getLexeme();
+    for (size_t i = scopes.size(); i-- > 0;)
+    {
+        for (size_t j = scopes[i].size(); j-- > 0;)
+        {
+            if (scopes[i][j].first == lexeme)
+                return scopes[i][j].second;
+        }
+    }
+
+    for (Trace::Input &input : trace.inputs)
+    {
+        if (input.name == lexeme)
+        {
+            input.written |= write;
+            return input.reg;
+        }
+    }
+
+    // First use of a variable from outside the loop
+    Value *binding = env.find(std::string(lexeme));
+    if (binding == nullptr || binding->second != TokenInfo::Type::NUMBER)
+        throw Untraceable();
+
+    uint16_t reg = allocate(Type::NUMBER, *static_cast<double *>(binding->first.get()));
+    trace.inputs.push_back({std::string(lexeme), reg, write});
+    return reg;
+}
+
+uint16_t TraceRecorder::evaluate(const std::unique_ptr<Expr> &expr)
+{
+    return expr->accept(*this);
+}
+
+uint16_t TraceRecorder::evaluateNumber(const std::unique_ptr<Expr> &expr)
+{
+    uint16_t reg = evaluate(expr);
+    if (types[reg] != Type::NUMBER)
+        throw Untraceable();
+    return reg;
+}
+
+void TraceRecorder::execute(const std::unique_ptr<Stmt> &stmt)
+{
+    stmt->accept(*this);
+}
+
+bool TraceRecorder::guard(uint16_t reg)
+{
+    bool truthy = values[reg] != 0;
+    emit(truthy ? TraceInstruction::GUARD_TRUTHY : TraceInstruction::GUARD_FALSY, 0, reg);
+    return truthy;
+}
+
+/* -------------------- EXPRESSIONS -------------------- */
+
+uint16_t TraceRecorder::visitLiteralExpr(const Literal &expr)
+{
+    uint16_t reg;
+    switch (expr.type)
+    {
+    case TokenInfo::Type::NUMBER:
+        reg = allocate(Type::NUMBER, *std::static_pointer_cast<double>(expr.value));
+        break;
+    case TokenInfo::Type::TRUE:
+        reg = allocate(Type::BOOLEAN, 1);
+        break;
+    case TokenInfo::Type::FALSE:
+        reg = allocate(Type::BOOLEAN, 0);
+        break;
+    default:
+        throw Untraceable();
+    }
+
+    emit(TraceInstruction::CONSTANT, reg, 0, 0, values[reg]);
+    return reg;
+}
+
+uint16_t TraceRecorder::visitGroupingExpr(const Grouping &expr)
+{
+    return evaluate(expr.expression);
+}
+
+uint16_t TraceRecorder::visitVariableExpr(const Variable &expr)
+{
+    // A copy, so assignments later in the same expression don't change it
+    uint16_t source = variable(expr.name, false);
+    uint16_t reg = allocate(types[source], values[source]);
+    emit(TraceInstruction::MOVE, reg, source);
+    return reg;
+}
+
+uint16_t TraceRecorder::visitAssignExpr(const Assign &expr)
+{
+    uint16_t value = evaluate(expr.value);
+    uint16_t reg = variable(expr.name, true);
+    values[reg] = values[value];
+    types[reg] = types[value];
+    emit(TraceInstruction::MOVE, reg, value);
+    return value;
+}
+
+uint16_t TraceRecorder::visitUnaryExpr(const Unary &expr)
+{
+    switch (expr.op.getType())
+    {
+    case TokenInfo::Type::BANG: {
+        uint16_t right = evaluate(expr.right);
+        uint16_t reg = allocate(Type::BOOLEAN, !(values[right] != 0));
+        emit(TraceInstruction::NOT, reg, right);
+        return reg;
+    }
+
+    case TokenInfo::Type::MINUS:
+        // Gives back its operand (see Operators::unary)
+        return evaluateNumber(expr.right);
+
+    default:
+        throw Untraceable();
+    }
+}
+
+uint16_t TraceRecorder::visitBinaryExpr(const Binary &expr)
+{
+    // Strings and the quirks of comparing booleans stay with the interpreter
+    uint16_t left = evaluateNumber(expr.left);
+    uint16_t right = evaluateNumber(expr.right);
+    double l = values[left];
+    double r = values[right];
+
+    TraceInstruction::Op op;
+    Type type = Type::BOOLEAN;
+    double value;
+    switch (expr.op.getType())
+    {
+    case TokenInfo::Type::PLUS:
+        op = TraceInstruction::ADD, type = Type::NUMBER, value = l + r;
+        break;
+    case TokenInfo::Type::MINUS:
+        op = TraceInstruction::SUBTRACT, type = Type::NUMBER, value = l - r;
+        break;
+    case TokenInfo::Type::STAR:
+        op = TraceInstruction::MULTIPLY, type = Type::NUMBER, value = l * r;
+        break;
+    case TokenInfo::Type::SLASH:
+        if (r == 0)
+            throw Untraceable();
+        op = TraceInstruction::DIVIDE, type = Type::NUMBER, value = l / r;
+        break;
+    case TokenInfo::Type::GREATER:
+        op = TraceInstruction::GREATER, value = l > r;
+        break;
+    case TokenInfo::Type::GREATER_EQUAL:
+        op = TraceInstruction::GREATER_EQUAL, value = l >= r;
+        break;
+    case TokenInfo::Type::LESS:
+        op = TraceInstruction::LESS, value = l < r;
+        break;
+    case TokenInfo::Type::LESS_EQUAL:
+        op = TraceInstruction::LESS_EQUAL, value = l <= r;
+        break;
+    case TokenInfo::Type::EQUAL_EQUAL:
+        op = TraceInstruction::EQUAL, value = l == r;
+        break;
+    case TokenInfo::Type::BANG_EQUAL:
+        op = TraceInstruction::NOT_EQUAL, value = !(l == r);
+        break;
+    default:
+        throw Untraceable();
+    }
+
+    uint16_t reg = allocate(type, value);
+    emit(op, reg, left, right);
+    return reg;
+}
+
+uint16_t TraceRecorder::visitLogicalExpr(const Logical &expr)
+{
+    // The value is one of the operands, which one is guarded
+    uint16_t left = evaluate(expr.left);
+    bool truthy = guard(left);
+
+    if (truthy == (expr.op.getType() == TokenInfo::Type::OR))
+        return left;
+    return evaluate(expr.right);
+}
+
+uint16_t TraceRecorder::visitCallExpr(const Call &)
+{
+    throw Untraceable();
+}
+
+/* -------------------- STATEMENTS -------------------- */
+
+void TraceRecorder::visitExpressionStmt(const Expression &stmt)
+{
+    evaluate(stmt.expression);
+}
+
+void TraceRecorder::visitPrintStmt(const Print &stmt)
+{
+    // String literals are printed as they are, other strings aren't traced
+    if (stmt.expression->kind == ExprKind::Literal)
+    {
+        const auto &literal = static_cast<const Literal &>(*stmt.expression);
+        if (literal.type == TokenInfo::Type::STRING)
+        {
+            trace.strings.push_back(*std::static_pointer_cast<std::string>(literal.value));
+            emit(TraceInstruction::PRINT_STRING, 0, static_cast<uint16_t>(trace.strings.size() - 1));
+            return;
+        }
+    }
+
+    uint16_t reg = evaluate(stmt.expression);
+    emit(types[reg] == Type::NUMBER ? TraceInstruction::PRINT_NUMBER : TraceInstruction::PRINT_BOOLEAN, 0, reg);
+}
+
+void TraceRecorder::visitVarStmt(const Var &stmt)
+{
+    // Only locals of the body block, which start over every iteration
+    if (stmt.initializer == nullptr || scopes.empty())
+        throw Untraceable();
+
+    uint16_t reg = evaluate(stmt.initializer);
+    scopes.back().push_back({stmt.name.getLexeme(), reg});
+}
+
+void TraceRecorder::visitBlockStmt(const Block &stmt)
+{
+    scopes.emplace_back();
+    for (const auto &statement : stmt.statements)
+        execute(statement);
+    scopes.pop_back();
+}
+
+void TraceRecorder::visitIfStmt(const If &stmt)
+{
+    if (guard(evaluate(stmt.condition)))
+        execute(stmt.thenBranch);
+    else if (stmt.elseBranch != nullptr)
+        execute(stmt.elseBranch);
+}
+
+void TraceRecorder::visitWhileStmt(const While &)
+{
+    throw Untraceable();
+}
+
+void TraceRecorder::visitBreakStmt(const Break &)
+{
+    throw Untraceable();
+}
+
+void TraceRecorder::visitReturnStmt(const Return &)
+{
+    throw Untraceable();
+}
+
+void TraceRecorder::visitFunctionStmt(const Function &)
+{
+    throw Untraceable();
+}
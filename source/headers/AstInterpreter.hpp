@@ -2,34 +2,43 @@
 #define ASTINTERPRETER_HPP
 
 /* #include "Clock.hpp" */
+#include "CallStack.hpp"
 #include "Environment.hpp"
 #include "Expr.hpp"
 #include "Stmt.hpp"
-
-class AstInterpreter : public ExprVisitor, StmtVisitor
+#include "Value.hpp"
+#include <unordered_map>
+
+/*
+ * Expression visits return the value of the expression, statement visits return nothing. Final, so accept() on the
+ * tree calls the visit methods directly instead of through the vtable.
+ */
+class AstInterpreter final : public ExprVisitor<Value>, public StmtVisitor<void>
 {
 
     // Global environment for the interpreter
     std::shared_ptr<Environment> globals = std::make_shared<Environment>();
     std::shared_ptr<Environment> environment = globals;
 
-    // Result of the interpretation
-    TokenInfo::Type type;         // Can return any type of value. Type of the literal (string, number, etc.)
-    std::shared_ptr<void> result; // Value ("Hello", 2, etc.)
+    // Calls in progress, limited to --max-depth
+    CallStack callStack;
 
-    bool isTruthy(const std::shared_ptr<void> &value, TokenInfo::Type type);
-    bool isEqual(const std::shared_ptr<void> &left, const std::shared_ptr<void> &right, TokenInfo::Type leftType,
-                 TokenInfo::Type rightType);
-    bool isCallableType(TokenInfo::Type type);
+    // The LoxFunction of every lifted function declaration that has run (see Function::lifted), by the offset of its
+    // name
+    std::unordered_map<uint32_t, std::shared_ptr<LoxFunction>> liftedFunctions;
 
-    // Runtime error checkers for binary and unary operations
-    void checkNumberOperand(const Token &op, TokenInfo::Type rightType);
-    void checkNumberOperands(const Token &op, TokenInfo::Type leftType, TokenInfo::Type rightType);
+    bool isCallableType(TokenInfo::Type type);
+    // A call the AstOptimizer inlined (see Call::inlined), callable being the function it inlined
+    Value callInlined(const Call &expr, LoxFunction &callable);
+    // A call up to running the function: finds the callee, makes its environment with the arguments in place and
+    // checks the arity. False if the call was inlined instead, value being its result.
+    bool prepareCall(const Call &expr, std::shared_ptr<LoxFunction> &callable, std::shared_ptr<Environment> &funcEnv,
+                     Value &value);
 
   public:
     /*
-     * Interpreter will go through the AST of statements and expressions and set the result var equal to a computed
-     * value from the statements or expressions. Use getResult() to get the result of the interpretation.
+     * Interpreter will go through the AST of statements and expressions, evaluating the expressions to their values
+     * and executing the statements.
      */
 
     AstInterpreter()
@@ -40,32 +49,26 @@ class AstInterpreter : public ExprVisitor, StmtVisitor
         /* globals->define("clock", std::make_shared<Clock>(), TokenInfo::Type::FUN); */
     }
 
-    void setInterpretResult(const std::unique_ptr<Expr> &expr);                    // For expressions
     void setInterpretResult(const std::vector<std::unique_ptr<Stmt>> &statements); // For statements
     void execute(const std::unique_ptr<Stmt> &stmt);                               // Execute statements line by line
     void executeBlock(const std::vector<std::unique_ptr<Stmt>> &statements,
                       const std::shared_ptr<Environment> &localEnv); // Execute blocks (e.g. if, while, for, etc.
 
-    // Calls setInterpretResult() (then use getResult) to begin interpreting the AST
-    bool evaluate(const std::unique_ptr<Expr> &expr);
-
-    // Get the result of the interpretation
-    std::shared_ptr<void> &getResult();
-    TokenInfo::Type getResultType();
-
-    // Get value from void pointer and set it to shared_ptr
-    void setResult(std::shared_ptr<void> &toSet, std::shared_ptr<void> &toGet, TokenInfo::Type type);
+    // Value of an expression, a runtime error is propagated
+    Value evaluate(const std::unique_ptr<Expr> &expr);
+    // Evaluate, but report a runtime error instead of propagating it. Returns false (and value is nil) on error.
+    bool evaluateReported(const std::unique_ptr<Expr> &expr, Value &value);
 
     /* -------------------- EXPRESSIONS -------------------- */
-    void visitBinaryExpr(const Binary &expr) override;
-    void visitUnaryExpr(const Unary &expr) override;
-    void visitLiteralExpr(const Literal &expr) override;
-    void visitGroupingExpr(const Grouping &expr) override;
-    void visitVariableExpr(const Variable &expr)
+    Value visitBinaryExpr(const Binary &expr) override;
+    Value visitUnaryExpr(const Unary &expr) override;
+    Value visitLiteralExpr(const Literal &expr) override;
+    Value visitGroupingExpr(const Grouping &expr) override;
+    Value visitVariableExpr(const Variable &expr)
         override; // Simply returns the value of the variable, e.g. var x = 2 then x would return 2
-    void visitAssignExpr(const Assign &expr) override;
-    void visitLogicalExpr(const Logical &expr) override;
-    void visitCallExpr(const Call &expr) override;
+    Value visitAssignExpr(const Assign &expr) override;
+    Value visitLogicalExpr(const Logical &expr) override;
+    Value visitCallExpr(const Call &expr) override;
     /* ---------------------------------------------------- */
 
     /* -------------------- STATEMENTS -------------------- */
@@ -81,7 +84,6 @@ class AstInterpreter : public ExprVisitor, StmtVisitor
     void visitFunctionStmt(const Function &stmt) override;
     /* ---------------------------------------------------- */
 
-    std::string stringifyResult(const std::shared_ptr<void> &result, TokenInfo::Type type);
     std::shared_ptr<Environment> &getGlobals()
     {
         return globals;
@@ -0,0 +1,67 @@
+#ifndef ASTOPTIMIZER_HPP
+#define ASTOPTIMIZER_HPP
+
+#include "Expr.hpp"
+#include "Stmt.hpp"
+#include "Value.hpp"
+#include <memory>
+#include <vector>
+
+/*
+ * Rewrites the parsed statements before the AstInterpreter runs them (--ast-optimize=on|off). Operators on literals
+ * are folded into a Literal holding their value, so e.g. 60 * 60 * 24 is computed once instead of every time it runs.
+ * Statements that can never run are dropped: the rest of a block after a return or break, the branch of an if on a
+ * literal that isn't taken, a while on a falsy literal, an expression statement that is just a literal.
+ * An operator that fails (1 / 0, "a" - 1) is left as it is, so the error still happens at run time on its line. A
+ * logical operator is only folded when its left side decides it or both sides are literals: a runtime error in the
+ * right side is reported and makes it nil, which wouldn't happen anymore if the right side took its place.
+ * Next, a function declared inside a global one is lifted when it doesn't need a closure of its own: it only uses
+ * globals, itself and variables of the enclosing function that are declared before it and that no nested function
+ * assigns. At most MAX_CAPTURED of those variables become extra parameters. Every call then passes them, so the name
+ * may only be used to call the function, with nothing in between declaring those variables again. The AstInterpreter
+ * makes a lifted function once instead of on every run of the enclosing function (see Function::lifted).
+ * A call of a global function declared once and never assigned, whose body just returns an expression of at most
+ * --inline-budget nodes without calls or assignments, gets that expression with the parameters renamed to
+ * temporaries of the call. Evaluating it spares the environment and the ReturnException of the call.
+ * Last, pure expressions (operators on variables and literals) aren't computed more often than they have to be:
+ * - one that reads no variable a while loop assigns or declares is computed once per run of the loop and kept in a
+ *   temporary (Grouping::Temporary::REUSE),
+ * - one that appears again later in the same statement is computed once and read back the second time (STORE and
+ *   LOAD).
+ * Both only happen without calls in the loop or statement (the function could assign anything it sees). They keep the
+ * first evaluation where it was, so errors come in the same order and a failed one is just tried again.
+ * Function bodies parsed on their first call (--lazy-parse) are run as they are.
+ * Is not meant to be instantiated.
+ */
+class AstOptimizer
+{
+    // The value of expr if it is a Literal
+    static bool constant(const Expr &expr, Value &value);
+    static void fold(std::unique_ptr<Expr> &expr);
+
+    // Returns false if stmt does nothing and can be dropped
+    static bool simplify(std::unique_ptr<Stmt> &stmt);
+    // The body of an if or while, an empty block if it does nothing
+    static void simplifyBranch(std::unique_ptr<Stmt> &stmt);
+    // Statements of a block or function body
+    static void simplifyBlock(std::vector<std::unique_ptr<Stmt>> &statements);
+
+    // Lambda lifting, for the functions declared in outer (a global function)
+    static constexpr size_t MAX_CAPTURED = 4;
+    static void lift(Function &outer);
+
+    // Calls of small global functions get the expression their body returns (see Call::inlined)
+    static void inlineCalls(std::vector<std::unique_ptr<Stmt>> &statements);
+
+    // Loop-invariant code motion, for the loops in stmt (outer ones first)
+    static void hoist(Stmt &stmt);
+    static void hoistLoop(While &loop);
+    // Common subexpressions, within each expression of stmt and the statements nested in it
+    static void share(Stmt &stmt);
+    static void shareWithin(std::unique_ptr<Expr> &expr);
+
+  public:
+    static void optimize(std::vector<std::unique_ptr<Stmt>> &statements);
+};
+
+#endif // ASTOPTIMIZER_HPP
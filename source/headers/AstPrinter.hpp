@@ -3,7 +3,7 @@
 
 #include "Expr.hpp"
 
-class AstPrinter : public ExprVisitor
+class AstPrinter : public ExprVisitor<void>
 {
 
     std::string result = "";
@@ -0,0 +1,93 @@
+#ifndef ASTVISITOR_HPP
+#define ASTVISITOR_HPP
+
+// Generated by tool/GenerateAST.cpp ("GenerateAST visitors"), do not edit by hand.
+
+#include <cstdint>
+
+class Assign;
+class Binary;
+class Call;
+class Grouping;
+class Literal;
+class Logical;
+class Unary;
+class Variable;
+class Block;
+class Break;
+class Expression;
+class Function;
+class If;
+class Print;
+class Return;
+class Var;
+class While;
+
+// Kind of a node, stored in it so accept() can switch on it instead of making a virtual call.
+enum class ExprKind : uint8_t
+{
+    Assign,
+    Binary,
+    Call,
+    Grouping,
+    Literal,
+    Logical,
+    Unary,
+    Variable,
+};
+
+enum class StmtKind : uint8_t
+{
+    Block,
+    Break,
+    Expression,
+    Function,
+    If,
+    Print,
+    Return,
+    Var,
+    While,
+};
+
+/*
+ * Visitors of the Expr / Stmt tree. R is what the visit methods return, e.g. the value of an expression
+ * for the AstInterpreter. node.accept(visitor) calls the visit method for the node's kind.
+ */
+template <typename R> class ExprVisitor
+{
+  public:
+    // What the visit methods return, accept() returns the same
+    using ExprResult = R;
+
+    virtual ~ExprVisitor() = default;
+
+    virtual R visitAssignExpr(const Assign &expr) = 0;
+    virtual R visitBinaryExpr(const Binary &expr) = 0;
+    virtual R visitCallExpr(const Call &expr) = 0;
+    virtual R visitGroupingExpr(const Grouping &expr) = 0;
+    virtual R visitLiteralExpr(const Literal &expr) = 0;
+    virtual R visitLogicalExpr(const Logical &expr) = 0;
+    virtual R visitUnaryExpr(const Unary &expr) = 0;
+    virtual R visitVariableExpr(const Variable &expr) = 0;
+};
+
+template <typename R> class StmtVisitor
+{
+  public:
+    // What the visit methods return, accept() returns the same
+    using StmtResult = R;
+
+    virtual ~StmtVisitor() = default;
+
+    virtual R visitBlockStmt(const Block &stmt) = 0;
+    virtual R visitBreakStmt(const Break &stmt) = 0;
+    virtual R visitExpressionStmt(const Expression &stmt) = 0;
+    virtual R visitFunctionStmt(const Function &stmt) = 0;
+    virtual R visitIfStmt(const If &stmt) = 0;
+    virtual R visitPrintStmt(const Print &stmt) = 0;
+    virtual R visitReturnStmt(const Return &stmt) = 0;
+    virtual R visitVarStmt(const Var &stmt) = 0;
+    virtual R visitWhileStmt(const While &stmt) = 0;
+};
+
+#endif // ASTVISITOR_HPP
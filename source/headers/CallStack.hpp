@@ -0,0 +1,90 @@
+#ifndef CALLSTACK_HPP
+#define CALLSTACK_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// One Lox call in progress: the function (LoxFunction or FlatFunction) and where it was called from.
+struct CallFrame
+{
+    const void *function;
+    uint32_t callPos; // Source offset of the call's '('
+};
+
+/*
+ * Where the native stack of the interpreter's thread runs out (see Loxpp::runWithStack). The stack is sized for
+ * --max-depth calls of a typical size, but a call can take a lot more (blocks and expressions nested deep in its
+ * body), so the interpreters also check that at least RESERVE bytes are left before every call. Threads that never
+ * called enter() aren't checked.
+ */
+class NativeStack
+{
+    static inline thread_local uintptr_t limit = 0;
+
+  public:
+    // Left for the code between two calls, the error report and the unwinding
+    static constexpr size_t RESERVE = 2 * 1024 * 1024;
+
+    // Called first thing on a thread whose stack is size bytes
+    static void enter(size_t size)
+    {
+        char here;
+        limit = reinterpret_cast<uintptr_t>(&here) - size + RESERVE;
+    }
+
+    static bool low()
+    {
+        char here;
+        return reinterpret_cast<uintptr_t>(&here) < limit;
+    }
+
+    // Bytes that can still be used before low(), as good as unlimited on threads that didn't enter()
+    static size_t left()
+    {
+        char here;
+        uintptr_t at = reinterpret_cast<uintptr_t>(&here);
+        if (limit == 0)
+            return SIZE_MAX / 2;
+        return at > limit ? at - limit : 0;
+    }
+};
+
+/*
+ * The Lox calls in progress, innermost last, in one contiguous vector. The interpreters check it before every call
+ * (full()), so running out of depth or native stack is a RuntimeError and not a crash.
+ */
+class CallStack
+{
+    std::vector<CallFrame> frames;
+
+  public:
+    size_t depth() const
+    {
+        return frames.size();
+    }
+
+    // Whether another call would go past maxDepth or leave too little native stack
+    bool full(size_t maxDepth) const
+    {
+        return frames.size() >= maxDepth || NativeStack::low();
+    }
+
+    // Keeps a frame pushed for as long as it lives, also when the call ends with an exception.
+    class Frame
+    {
+        CallStack &stack;
+
+      public:
+        Frame(CallStack &stack, CallFrame frame) : stack(stack)
+        {
+            stack.frames.push_back(frame);
+        }
+        ~Frame()
+        {
+            stack.frames.pop_back();
+        }
+    };
+};
+
+#endif // CALLSTACK_HPP
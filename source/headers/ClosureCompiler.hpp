@@ -0,0 +1,100 @@
+#ifndef CLOSURECOMPILER_HPP
+#define CLOSURECOMPILER_HPP
+
+#include "Expr.hpp"
+#include "Stmt.hpp"
+#include "Value.hpp"
+#include <functional>
+#include <string_view>
+#include <vector>
+
+class ClosureInterpreter;
+class Environment;
+
+// How a statement finished. Break and return unwind through the enclosing statements instead of throwing.
+enum class Completion
+{
+    NORMAL,
+    BREAK,
+    RETURN
+};
+
+// Compiled expressions and statements. Each one holds its compiled children and whatever it needs from its node.
+using ExprCode = std::function<Value(ClosureInterpreter &)>;
+using StmtCode = std::function<Completion(ClosureInterpreter &)>;
+
+/*
+ * Compiles the Expr / Stmt tree into ExprCode / StmtCode closures for the ClosureInterpreter (--closures).
+ * Everything that only depends on the node is decided here once: which operator to apply, the constant of a literal,
+ * and where a variable lives. A name declared earlier in the function being compiled (a parameter, or a var / fun in
+ * one of its blocks) is resolved to a number of environments out and, for parameters, a slot. Other names can still
+ * be declared by the time the code runs, so they are looked up by name (with a LookupCache) like the AstInterpreter
+ * does.
+ * Function bodies are compiled on their first call, see compileBody.
+ */
+class ClosureCompiler final : public ExprVisitor<ExprCode>, public StmtVisitor<StmtCode>
+{
+    // Names declared so far in one environment of the function being compiled. params is set for the environment of
+    // the call itself.
+    struct Scope
+    {
+        const std::vector<std::string_view> *params = nullptr;
+        std::vector<std::string_view> names;
+    };
+    // Innermost last. Empty at the top level of a script, globals are always looked up by name.
+    std::vector<Scope> scopes;
+
+    // Where a name resolved to. hops < 0 if it has to be looked up by name.
+    struct Resolved
+    {
+        int hops = -1;
+        int slot = -1; // Parameter slot, or -1 for a variable in the environment's table
+    };
+    Resolved resolve(std::string_view name) const;
+    void declare(std::string_view name);
+    // The environment hops environments out from env
+    static Environment *ancestor(Environment *env, int hops);
+
+    // Operators (groupings included) nested deeper than this are compiled by compileOperators instead of the
+    // visitors, whose compiling, running and freeing of the code all recurse once per level
+    static constexpr int MAX_OPERATOR_DEPTH = 64;
+
+    ExprCode compile(const std::unique_ptr<Expr> &expr);
+    // compile for an operand of an operator the visitors compile, which is already known not to be nested too deep
+    ExprCode compileOperand(const std::unique_ptr<Expr> &expr);
+    // Compile a chain of operators into a list of steps run with a stack of values, walking it without recursion
+    ExprCode compileOperators(const Expr &expr);
+    StmtCode compile(const std::unique_ptr<Stmt> &stmt);
+    std::vector<StmtCode> compileList(const std::vector<std::unique_ptr<Stmt>> &statements);
+
+  public:
+    // Compile the top level statements of a script
+    static std::vector<StmtCode> compileProgram(const std::vector<std::unique_ptr<Stmt>> &statements);
+    // Compile the body of a function, params are its parameter names
+    static std::vector<StmtCode> compileBody(const Function &declaration, const std::vector<std::string_view> &params);
+
+    /* -------------------- EXPRESSIONS -------------------- */
+    ExprCode visitAssignExpr(const Assign &expr) override;
+    ExprCode visitBinaryExpr(const Binary &expr) override;
+    ExprCode visitCallExpr(const Call &expr) override;
+    ExprCode visitGroupingExpr(const Grouping &expr) override;
+    ExprCode visitLiteralExpr(const Literal &expr) override;
+    ExprCode visitLogicalExpr(const Logical &expr) override;
+    ExprCode visitUnaryExpr(const Unary &expr) override;
+    ExprCode visitVariableExpr(const Variable &expr) override;
+    /* ---------------------------------------------------- */
+
+    /* -------------------- STATEMENTS -------------------- */
+    StmtCode visitBlockStmt(const Block &stmt) override;
+    StmtCode visitBreakStmt(const Break &stmt) override;
+    StmtCode visitExpressionStmt(const Expression &stmt) override;
+    StmtCode visitFunctionStmt(const Function &stmt) override;
+    StmtCode visitIfStmt(const If &stmt) override;
+    StmtCode visitPrintStmt(const Print &stmt) override;
+    StmtCode visitReturnStmt(const Return &stmt) override;
+    StmtCode visitVarStmt(const Var &stmt) override;
+    StmtCode visitWhileStmt(const While &stmt) override;
+    /* ---------------------------------------------------- */
+};
+
+#endif // CLOSURECOMPILER_HPP
@@ -0,0 +1,75 @@
+#ifndef CLOSUREINTERPRETER_HPP
+#define CLOSUREINTERPRETER_HPP
+
+#include "CallStack.hpp"
+#include "ClosureCompiler.hpp"
+#include "Environment.hpp"
+#include "Stmt.hpp"
+#include "Value.hpp"
+
+/*
+ * A function declaration as compiled by the ClosureCompiler. Shared by every function value made from the same
+ * declaration, the body is compiled the first time one of them is called.
+ */
+struct CompiledFunction
+{
+    const Function *declaration;
+    // Parameter names, shared with the environment of every call so it can bind arguments by position
+    std::shared_ptr<const std::vector<std::string_view>> paramNames;
+    uint64_t paramBits = 0;
+
+    bool compiled = false;
+    std::vector<StmtCode> body;
+
+    explicit CompiledFunction(const Function &declaration);
+};
+
+/*
+ * A function declared while running compiled code. Stored in environments with the FUN type, like LoxFunction is for
+ * the AstInterpreter.
+ */
+struct ClosureFunction
+{
+    std::shared_ptr<CompiledFunction> code;
+    std::shared_ptr<Environment> closure;
+};
+
+/*
+ * Runs programs compiled by the ClosureCompiler (--closures). Running a program is a call to each compiled statement,
+ * which calls its compiled children directly: no accept, no switch on the node kind or the operator.
+ * It behaves like the AstInterpreter, including where runtime errors are reported and recovered from, but like the
+ * FlatInterpreter signals break and return with a Completion instead of exceptions.
+ */
+class ClosureInterpreter
+{
+    std::shared_ptr<Environment> globals = std::make_shared<Environment>();
+    std::shared_ptr<Environment> environment = globals;
+
+    // The trees of every program run so far, compiled function bodies point into them. Functions declared by one
+    // (e.g. a REPL line) can be called from later ones.
+    // Never freed: that would only happen at exit, on the main thread, and freeing a deeply nested expression
+    // recurses once per level, with far less stack there than the interpreter thread has.
+    std::vector<std::vector<std::unique_ptr<Stmt>>> &programs = *new std::vector<std::vector<std::unique_ptr<Stmt>>>();
+
+    // Calls in progress, limited to --max-depth
+    CallStack callStack;
+
+    // Value of the last executed return statement.
+    Value returnValue;
+
+    // Evaluate, but report a runtime error instead of propagating it. Returns false (and value is nil) on error.
+    bool evaluateReported(const ExprCode &expr, Value &value);
+
+    Completion executeBlock(const std::vector<StmtCode> &statements, const std::shared_ptr<Environment> &localEnv);
+
+    // Run a function whose arguments are already in the slots of funcEnv
+    Value call(const ClosureFunction &function, const std::shared_ptr<Environment> &funcEnv);
+
+    // The compiled code reads and writes the state above
+    friend class ClosureCompiler;
+
+  public:
+    void interpret(std::vector<std::unique_ptr<Stmt>> statements);
+};
+
+#endif // CLOSUREINTERPRETER_HPP
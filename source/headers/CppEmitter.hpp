@@ -0,0 +1,95 @@
+#ifndef CPPEMITTER_HPP
+#define CPPEMITTER_HPP
+
+#include "Expr.hpp"
+#include "Stmt.hpp"
+#include <cstdint>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/*
+ * Translates a parsed program into a standalone C++17 program (--emit-cpp) that runs on the LoxRuntime.
+ * Every expression becomes a sequence of C++ statements on Value temporaries, every Lox function a C++ function
+ * taking the environment of its call, and variables are still looked up in Environments by name (with a LookupCache
+ * per place in the code), so the program behaves exactly like the AstInterpreter without walking a tree.
+ * Tokens of the generated program are offsets into the script, which is embedded in it for lexemes and lines.
+ */
+class CppEmitter final : public ExprVisitor<std::string>, public StmtVisitor<void>
+{
+    // Global offset of the script's first character
+    uint32_t base;
+
+    // Tokens, literals, lookup caches and parameter lists, at file scope
+    std::ostringstream constants;
+    std::unordered_map<uint32_t, std::string> tokens;
+    // Declarations and definitions of the functions made so far
+    std::ostringstream prototypes;
+    std::ostringstream functions;
+
+    // Body of the C++ function being written, its indentation and the C++ name of the current environment
+    std::ostringstream *out = nullptr;
+    int depth = 0;
+    std::string env;
+    // Loops around the current statement in the current Lox function
+    int loops = 0;
+    bool inFunction = false;
+    // Label after the top-level statement being written, and whether a return jumps to it
+    std::string statementEnd;
+    bool returnsAtTop = false;
+
+    int nextName = 0;
+
+    explicit CppEmitter(uint32_t base) : base(base)
+    {
+    }
+
+    std::string name(char prefix);
+    std::string token(const Token &token);
+    void line(const std::string &text);
+    void open();
+    void close();
+
+    // Write the statements computing an expression, returns the C++ expression holding its Value
+    std::string evaluate(const std::unique_ptr<Expr> &expr);
+    // Same as AstInterpreter::evaluateReported: a runtime error is reported and target becomes nil
+    void evaluateReported(const std::unique_ptr<Expr> &expr, const std::string &target);
+    void execute(const std::unique_ptr<Stmt> &stmt);
+    // A statement in a block of its own, so its temporaries don't clash with the ones around it
+    void executeNested(const std::unique_ptr<Stmt> &stmt);
+    void catchReported(const std::string &target);
+
+  public:
+    // The C++ program for the statements of a script added to Source at base
+    static std::string emit(const std::vector<std::unique_ptr<Stmt>> &statements, uint32_t base, unsigned maxDepth);
+
+    // A C++ string literal holding text
+    static std::string quote(const std::string &text);
+
+    /* -------------------- EXPRESSIONS -------------------- */
+    std::string visitAssignExpr(const Assign &expr) override;
+    std::string visitBinaryExpr(const Binary &expr) override;
+    std::string visitCallExpr(const Call &expr) override;
+    std::string visitGroupingExpr(const Grouping &expr) override;
+    std::string visitLiteralExpr(const Literal &expr) override;
+    std::string visitLogicalExpr(const Logical &expr) override;
+    std::string visitUnaryExpr(const Unary &expr) override;
+    std::string visitVariableExpr(const Variable &expr) override;
+    /* ---------------------------------------------------- */
+
+    /* -------------------- STATEMENTS -------------------- */
+    void visitBlockStmt(const Block &stmt) override;
+    void visitBreakStmt(const Break &stmt) override;
+    void visitExpressionStmt(const Expression &stmt) override;
+    void visitFunctionStmt(const Function &stmt) override;
+    void visitIfStmt(const If &stmt) override;
+    void visitPrintStmt(const Print &stmt) override;
+    void visitReturnStmt(const Return &stmt) override;
+    void visitVarStmt(const Var &stmt) override;
+    void visitWhileStmt(const While &stmt) override;
+    /* ---------------------------------------------------- */
+};
+
+#endif // CPPEMITTER_HPP
@@ -1,12 +1,16 @@
 #ifndef ENVIRONMENT_HPP
 #define ENVIRONMENT_HPP
 
+#include "LookupCache.hpp"
 #include "LoxFunction.hpp"
 #include "Token.hpp"
+#include <array>
 #include <memory>
 #include <string>
+#include <string_view>
 #include <unordered_map>
 #include <utility>
+#include <vector>
 
 class Environment
 {
@@ -20,6 +24,24 @@ class Environment
     // Key: variable, Value: pair of value and type
     std::unordered_map<std::string, std::pair<std::shared_ptr<void>, TokenInfo::Type>> values;
 
+    // Parameters of the function call this environment was made for, bound by position. A call fills the slots in
+    // place, so passing up to INLINE_SLOTS arguments doesn't allocate anything besides the environment itself.
+    static constexpr size_t INLINE_SLOTS = 4;
+    std::shared_ptr<const std::vector<std::string_view>> slotNames;
+    std::array<Value, INLINE_SLOTS> inlineSlots;
+    std::vector<Value> extraSlots;
+
+    // The binding of a name in this environment only (or only among the parameters), nullptr if it isn't here.
+    Value *findHere(const std::string &name);
+    Value *findSlot(const std::string &name);
+
+    // The nameBit of every name defined here. Bindings are never removed, so a clear bit means the name is not here.
+    uint64_t nameBits = 0;
+
+    // Unique for the whole run, unlike the address, so a LookupCache can't mistake a new environment for a freed one.
+    uint64_t id;
+    static uint64_t nextId;
+
     std::shared_ptr<void> makeCopy(std::shared_ptr<void> &value, TokenInfo::Type type)
     {
         switch (type)
@@ -36,31 +58,75 @@ class Environment
         }
     }
 
+    // Saves and restores environments of the FlatInterpreter
+    friend class FlatSnapshot;
+    // Compiled code goes straight to the environment a variable was resolved to
+    friend class ClosureCompiler;
+
   public:
     // For global environment.
-    Environment() : enclosing(nullptr)
+    Environment() : enclosing(nullptr), id(nextId++)
     {
     }
 
     // For local environments.
-    Environment(std::shared_ptr<Environment> &enclosing) : enclosing(enclosing)
+    Environment(const std::shared_ptr<Environment> &enclosing) : enclosing(enclosing), id(nextId++)
     {
     }
 
+    // For function calls: one slot per parameter, paramBits has the nameBit of each.
+    Environment(const std::shared_ptr<Environment> &enclosing,
+                const std::shared_ptr<const std::vector<std::string_view>> &params, uint64_t paramBits)
+        : enclosing(enclosing), slotNames(params), nameBits(paramBits), id(nextId++)
+    {
+        if (params->size() > INLINE_SLOTS)
+            extraSlots.resize(params->size() - INLINE_SLOTS);
+    }
+
+    // Value of the i-th parameter
+    Value &slot(size_t i)
+    {
+        return i < INLINE_SLOTS ? inlineSlots[i] : extraSlots[i - INLINE_SLOTS];
+    }
+    size_t slotCount() const
+    {
+        return slotNames ? slotNames->size() : 0;
+    }
+
+    // One of 64 bits picked by a name, cheap enough to compute on every definition.
+    static uint64_t nameBit(std::string_view name)
+    {
+        return uint64_t(1) << ((name.length() * 31 + name.front() * 7 + name.back()) & 63);
+    }
+
     // Get the value of a variable in the current (local) environment.
-    std::pair<std::shared_ptr<void>, TokenInfo::Type> get(Token name);
+    std::pair<std::shared_ptr<void>, TokenInfo::Type> get(const Token &name);
+
+    // Find the binding of a variable by name in this or an enclosing environment. Returns nullptr if undefined.
+    std::pair<std::shared_ptr<void>, TokenInfo::Type> *find(const std::string &name);
+
+    // Same as get(), but returns the binding itself and remembers where it was found in cache, so the next lookup of
+    // the name from the same place in the code can skip the hash lookups.
+    std::pair<std::shared_ptr<void>, TokenInfo::Type> &lookup(const Token &name, LookupCache &cache);
 
     // Define a variable in the current environment.
     void defineVar(std::string name, std::shared_ptr<void> value, TokenInfo::Type type);
 
+    // The binding of a name in this environment, defined as nil first if it isn't here. cache is used like in
+    // lookup(), so defining the same name again from the same place in the code is just a store.
+    std::pair<std::shared_ptr<void>, TokenInfo::Type> &defineHere(const Token &name, LookupCache &cache);
+
     // Assign a new value to a variable in the current environment.
-    void assign(Token name, std::shared_ptr<void> &value, TokenInfo::Type type);
+    void assign(const Token &name, std::shared_ptr<void> &value, TokenInfo::Type type);
 
     // Clone (for function calls)
     std::shared_ptr<Environment> clone()
     {
 
-        std::shared_ptr<Environment> newEnv = std::make_shared<Environment>(enclosing);
+        std::shared_ptr<Environment> newEnv = slotNames ? std::make_shared<Environment>(enclosing, slotNames, nameBits)
+                                                        : std::make_shared<Environment>(enclosing);
+        for (size_t i = 0; i < slotCount(); i++)
+            newEnv->slot(i) = {makeCopy(slot(i).first, slot(i).second), slot(i).second};
 
         for (auto &[key, value] : values)
         {
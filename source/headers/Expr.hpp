@@ -1,76 +1,22 @@
 #ifndef Expr_HPP
 #define Expr_HPP
+#include "AstVisitor.hpp"
+#include "LookupCache.hpp"
 #include "Token.hpp"
 #include <memory>
 
 // TODO: Ternary
-class Assign;
-class Binary;
-class Grouping;
-class Literal;
-class Logical;
-class Unary;
-class Variable;
-class Call;
-
-// Create visitor interface. Every subclass of Expr will implement Visitor to have access to accept method.
-// Visitor can return any type T, example: Integer, String (to try to print an expression), void, etc.
-// Visitor will have a visit method for each supported subclass of Expr.
-// Example: visitBinaryExpr, visitGroupingExpr, visitLiteralExpr, visitUnaryExpr
-
-class ExprVisitor
-{
-  public:
-    virtual void visitAssignExpr(const Assign &Expr) = 0;
-    virtual void visitBinaryExpr(const Binary &Expr) = 0;
-    virtual void visitGroupingExpr(const Grouping &Expr) = 0;
-    virtual void visitLiteralExpr(const Literal &Expr) = 0;
-    virtual void visitLogicalExpr(const Logical &Expr) = 0;
-    virtual void visitUnaryExpr(const Unary &Expr) = 0;
-    virtual void visitVariableExpr(const Variable &Expr) = 0;
-    virtual void visitCallExpr(const Call &Expr) = 0;
-};
 class Expr
 {
   public:
-    virtual ~Expr() = default;
-    virtual void accept(ExprVisitor &visitor) = 0;
-    virtual std::unique_ptr<Expr> clone() const = 0;
-};
-
-// e.g. sayHi("Hello", "World");
-class Call : public Expr
-{
-
-  public:
-    std::unique_ptr<Expr> callee;                 // sayHi
-    Token paren;                                  // (
-    std::vector<std::unique_ptr<Expr>> arguments; // "Hello", "World"
-
-    Call(std::unique_ptr<Expr> &callee, Token paren, std::vector<std::unique_ptr<Expr>> &arguments)
-        : callee(std::move(callee)), paren(paren), arguments(std::move(arguments))
-    {
-    }
-
-    Call(std::unique_ptr<Expr> &&callee, Token paren, std::vector<std::unique_ptr<Expr>> &&arguments)
-        : callee(std::move(callee)), paren(paren), arguments(std::move(arguments))
-    {
-    }
-
-    void accept(ExprVisitor &visitor) override
-    {
-        visitor.visitCallExpr(*this);
-    }
+    const ExprKind kind;
 
-    std::unique_ptr<Expr> clone() const override
+    explicit Expr(ExprKind kind) : kind(kind)
     {
-        std::vector<std::unique_ptr<Expr>> clonedArguments;
-        for (const auto &argument : arguments)
-        {
-            clonedArguments.push_back(argument->clone());
-        }
-        return std::make_unique<Call>(callee->clone(), paren, std::move(clonedArguments));
     }
+    virtual ~Expr() = default;
+    template <typename Visitor> typename Visitor::ExprResult accept(Visitor &visitor) const;
+    virtual std::unique_ptr<Expr> clone() const = 0;
 };
 
 class Assign : public Expr
@@ -79,17 +25,12 @@ class Assign : public Expr
     Token name;
     std::unique_ptr<Expr> value;
 
-    Assign(Token name, std::unique_ptr<Expr> &value) : name(name), value(std::move(value))
-    {
-    }
-
-    Assign(Token name, std::unique_ptr<Expr> &&value) : name(name), value(std::move(value))
+    Assign(Token name, std::unique_ptr<Expr> &value) : Expr(ExprKind::Assign), name(name), value(std::move(value))
     {
     }
 
-    void accept(ExprVisitor &visitor) override
+    Assign(Token name, std::unique_ptr<Expr> &&value) : Expr(ExprKind::Assign), name(name), value(std::move(value))
     {
-        visitor.visitAssignExpr(*this);
     }
 
     std::unique_ptr<Expr> clone() const override
@@ -105,20 +46,15 @@ class Binary : public Expr
     std::unique_ptr<Expr> right;
 
     Binary(std::unique_ptr<Expr> &left, Token op, std::unique_ptr<Expr> &right)
-        : left(std::move(left)), op(op), right(std::move(right))
+        : Expr(ExprKind::Binary), left(std::move(left)), op(op), right(std::move(right))
     {
     }
 
     Binary(std::unique_ptr<Expr> &&left, Token op, std::unique_ptr<Expr> &&right)
-        : left(std::move(left)), op(op), right(std::move(right))
+        : Expr(ExprKind::Binary), left(std::move(left)), op(op), right(std::move(right))
     {
     }
 
-    void accept(ExprVisitor &visitor) override
-    {
-        visitor.visitBinaryExpr(*this);
-    }
-
     std::unique_ptr<Expr> clone() const override
     {
         return std::make_unique<Binary>(left->clone(), op, right->clone());
@@ -129,22 +65,37 @@ class Grouping : public Expr
   public:
     std::unique_ptr<Expr> expression;
 
-    Grouping(std::unique_ptr<Expr> &expression) : expression(std::move(expression))
+    // Set by the AstOptimizer to keep the value in a temporary it made up (see Source::addSynthetic), the
+    // AstInterpreter then uses it instead of evaluating the expression every time:
+    // REUSE evaluates it only while the temporary is uninitialized (see While::temporaries) and keeps the value,
+    // STORE always evaluates it and defines the temporary, LOAD only reads the temporary a STORE before it defined.
+    // LOAD also passes a variable to a lifted function (see Function::lifted) as it is, initialized or not.
+    // Everything else evaluates the expression as usual.
+    enum class Temporary : uint8_t
     {
-    }
-
-    Grouping(std::unique_ptr<Expr> &&expression) : expression(std::move(expression))
+        NONE,
+        REUSE,
+        STORE,
+        LOAD,
+    };
+    Temporary temporary = Temporary::NONE;
+    Token name = Token(TokenInfo::Type::IDENTIFIER, 0, 0);
+    mutable LookupCache cache;
+
+    Grouping(std::unique_ptr<Expr> &expression) : Expr(ExprKind::Grouping), expression(std::move(expression))
     {
     }
 
-    void accept(ExprVisitor &visitor) override
+    Grouping(std::unique_ptr<Expr> &&expression) : Expr(ExprKind::Grouping), expression(std::move(expression))
     {
-        visitor.visitGroupingExpr(*this);
     }
 
     std::unique_ptr<Expr> clone() const override
     {
-        return std::make_unique<Grouping>(expression->clone());
+        auto cloned = std::make_unique<Grouping>(expression->clone());
+        cloned->temporary = temporary;
+        cloned->name = name;
+        return cloned;
     }
 };
 class Literal : public Expr
@@ -153,13 +104,9 @@ class Literal : public Expr
     TokenInfo::Type type;
     std::shared_ptr<void> value;
 
-    Literal(std::shared_ptr<void> &value, TokenInfo::Type type) : type(type), value(value)
+    Literal(std::shared_ptr<void> &value, TokenInfo::Type type) : Expr(ExprKind::Literal), type(type), value(value)
     {
     }
-    void accept(ExprVisitor &visitor) override
-    {
-        visitor.visitLiteralExpr(*this);
-    }
 
     std::unique_ptr<Expr> clone() const override
     {
@@ -176,17 +123,12 @@ class Logical : public Expr
     std::unique_ptr<Expr> right;
 
     Logical(std::unique_ptr<Expr> &left, Token op, std::unique_ptr<Expr> &right)
-        : left(std::move(left)), op(op), right(std::move(right))
+        : Expr(ExprKind::Logical), left(std::move(left)), op(op), right(std::move(right))
     {
     }
     Logical(std::unique_ptr<Expr> &&left, Token op, std::unique_ptr<Expr> &&right)
-        : left(std::move(left)), op(op), right(std::move(right))
-    {
-    }
-
-    void accept(ExprVisitor &visitor) override
+        : Expr(ExprKind::Logical), left(std::move(left)), op(op), right(std::move(right))
     {
-        visitor.visitLogicalExpr(*this);
     }
 
     std::unique_ptr<Expr> clone() const override
@@ -200,16 +142,12 @@ class Unary : public Expr
     Token op;
     std::unique_ptr<Expr> right;
 
-    Unary(Token op, std::unique_ptr<Expr> &right) : op(op), right(std::move(right))
+    Unary(Token op, std::unique_ptr<Expr> &right) : Expr(ExprKind::Unary), op(op), right(std::move(right))
     {
     }
-    Unary(Token op, std::unique_ptr<Expr> &&right) : op(op), right(std::move(right))
+    Unary(Token op, std::unique_ptr<Expr> &&right) : Expr(ExprKind::Unary), op(op), right(std::move(right))
     {
     }
-    void accept(ExprVisitor &visitor) override
-    {
-        visitor.visitUnaryExpr(*this);
-    }
 
     std::unique_ptr<Expr> clone() const override
     {
@@ -222,19 +160,102 @@ class Variable : public Expr
     // Type of value held by the variable (e.g. STRING, NUMBER, CLASS, etc.) is stored in the environment
     Token name;
 
-    Variable(Token name) : name(name)
+    Variable(Token name) : Expr(ExprKind::Variable), name(name)
+    {
+    }
+
+    std::unique_ptr<Expr> clone() const override
+    {
+        return std::make_unique<Variable>(name);
+    }
+};
+
+// e.g. sayHi("Hello", "World");
+class Call : public Expr
+{
+
+  public:
+    std::unique_ptr<Expr> callee;                 // sayHi
+    Token paren;                                  // (
+    std::vector<std::unique_ptr<Expr>> arguments; // "Hello", "World"
+
+    // The callee if it is just a name (the usual case), so the interpreter can look it up through calleeCache.
+    const Variable *calleeVariable;
+    mutable LookupCache calleeCache;
+
+    // Set by the AstOptimizer when the callee is a small global function it inlines here: the name of that
+    // function's declaration, a temporary for each of its parameters (see Source::addSynthetic) and the expression
+    // its body returns, reading the temporaries instead of the parameters (Grouping::Temporary::LOAD). As long as
+    // the callee still is that function, the AstInterpreter defines the temporaries in its closure and evaluates the
+    // expression there instead of making the call. The function has at most MAX_INLINED_PARAMS parameters, so the
+    // arguments fit on the native stack while they are evaluated.
+    static constexpr size_t MAX_INLINED_PARAMS = 8;
+    std::unique_ptr<Expr> inlined;
+    Token inlinedFunction = Token(TokenInfo::Type::IDENTIFIER, 0, 0);
+    std::vector<Token> inlinedParams;
+    mutable std::vector<LookupCache> inlinedCaches;
+
+    // Set by the AstOptimizer when the callee is a lifted function whose declaration doesn't bind its name (see
+    // Function::lifted): the name token of that declaration, the AstInterpreter finds the function by it instead.
+    Token liftedFunction = Token(TokenInfo::Type::IDENTIFIER, 0, 0);
+
+    Call(std::unique_ptr<Expr> &callee, Token paren, std::vector<std::unique_ptr<Expr>> &arguments)
+        : Expr(ExprKind::Call), callee(std::move(callee)), paren(paren), arguments(std::move(arguments)),
+          calleeVariable(dynamic_cast<const Variable *>(this->callee.get()))
     {
     }
-    void accept(ExprVisitor &visitor) override
+
+    Call(std::unique_ptr<Expr> &&callee, Token paren, std::vector<std::unique_ptr<Expr>> &&arguments)
+        : Expr(ExprKind::Call), callee(std::move(callee)), paren(paren), arguments(std::move(arguments)),
+          calleeVariable(dynamic_cast<const Variable *>(this->callee.get()))
     {
-        // variable expression is simply the value of the variable
-        // e.g. var x = 2 then x would return 2
-        visitor.visitVariableExpr(*this);
     }
 
     std::unique_ptr<Expr> clone() const override
     {
-        return std::make_unique<Variable>(name);
+        std::vector<std::unique_ptr<Expr>> clonedArguments;
+        for (const auto &argument : arguments)
+        {
+            clonedArguments.push_back(argument->clone());
+        }
+        auto cloned = std::make_unique<Call>(callee->clone(), paren, std::move(clonedArguments));
+        cloned->liftedFunction = liftedFunction;
+        if (inlined != nullptr)
+        {
+            cloned->inlined = inlined->clone();
+            cloned->inlinedFunction = inlinedFunction;
+            cloned->inlinedParams = inlinedParams;
+            cloned->inlinedCaches.resize(inlinedParams.size());
+        }
+        return cloned;
     }
 };
+
+// Calls the visit method for this node's kind. Visitor is the concrete visitor class, so when it is final the
+// call can be made directly (or inlined) instead of through the vtable.
+template <typename Visitor> typename Visitor::ExprResult Expr::accept(Visitor &visitor) const
+{
+    switch (kind)
+    {
+    case ExprKind::Assign:
+        return visitor.visitAssignExpr(static_cast<const Assign &>(*this));
+    case ExprKind::Binary:
+        return visitor.visitBinaryExpr(static_cast<const Binary &>(*this));
+    case ExprKind::Call:
+        return visitor.visitCallExpr(static_cast<const Call &>(*this));
+    case ExprKind::Grouping:
+        return visitor.visitGroupingExpr(static_cast<const Grouping &>(*this));
+    case ExprKind::Literal:
+        return visitor.visitLiteralExpr(static_cast<const Literal &>(*this));
+    case ExprKind::Logical:
+        return visitor.visitLogicalExpr(static_cast<const Logical &>(*this));
+    case ExprKind::Unary:
+        return visitor.visitUnaryExpr(static_cast<const Unary &>(*this));
+    case ExprKind::Variable:
+        return visitor.visitVariableExpr(static_cast<const Variable &>(*this));
+    }
+    // Every kind is handled above
+    __builtin_unreachable();
+}
+
 #endif
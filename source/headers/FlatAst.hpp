@@ -0,0 +1,522 @@
+#ifndef FLATAST_HPP
+#define FLATAST_HPP
+
+// Generated by tool/GenerateAST.cpp ("GenerateAST flat"), do not edit by hand.
+
+#include "FlatColumn.hpp"
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+/*
+ * Flat form of the AST. Instead of a tree of heap allocated Expr / Stmt objects, every node kind is
+ * stored as a struct of arrays (one column per field) and nodes refer to each other with 32-bit
+ * references. Tokens are replaced by their global source offset (see Source), names are interned and
+ * literal values live in constant tables.
+ */
+
+// Reference to a node: the node kind in the top 4 bits, its row in the kind's columns in the low 28.
+using FlatRef = uint32_t;
+const FlatRef FLAT_NONE = 0xFFFFFFFF;
+
+// Contiguous run of entries in one of the list columns (e.g. the statements of a block).
+struct FlatRange
+{
+    uint32_t first;
+    uint32_t count;
+};
+
+enum class FlatExpr : uint8_t
+{
+    Assign,
+    Binary,
+    Call,
+    Grouping,
+    Literal,
+    Logical,
+    Unary,
+    Variable,
+};
+
+enum class FlatStmt : uint8_t
+{
+    Block,
+    Break,
+    Expression,
+    Function,
+    If,
+    Print,
+    Return,
+    Var,
+    While,
+};
+
+// Columns of Assign Expr nodes, row i of each column is the i-th node.
+struct FlatAssignExpr
+{
+    uint32_t count = 0;
+    FlatColumn<uint32_t> name;
+    FlatColumn<uint32_t> namePos;
+    FlatColumn<FlatRef> value;
+
+    uint32_t push(uint32_t name_, uint32_t namePos_, FlatRef value_)
+    {
+        name.push_back(name_);
+        namePos.push_back(namePos_);
+        value.push_back(value_);
+        return count++;
+    }
+};
+
+// Columns of Binary Expr nodes, row i of each column is the i-th node.
+struct FlatBinaryExpr
+{
+    uint32_t count = 0;
+    FlatColumn<FlatRef> left;
+    FlatColumn<uint8_t> op;
+    FlatColumn<uint32_t> opPos;
+    FlatColumn<FlatRef> right;
+
+    uint32_t push(FlatRef left_, uint8_t op_, uint32_t opPos_, FlatRef right_)
+    {
+        left.push_back(left_);
+        op.push_back(op_);
+        opPos.push_back(opPos_);
+        right.push_back(right_);
+        return count++;
+    }
+};
+
+// Columns of Call Expr nodes, row i of each column is the i-th node.
+struct FlatCallExpr
+{
+    uint32_t count = 0;
+    FlatColumn<FlatRef> callee;
+    FlatColumn<uint32_t> parenPos;
+    FlatColumn<FlatRange> arguments;
+
+    uint32_t push(FlatRef callee_, uint32_t parenPos_, FlatRange arguments_)
+    {
+        callee.push_back(callee_);
+        parenPos.push_back(parenPos_);
+        arguments.push_back(arguments_);
+        return count++;
+    }
+};
+
+// Columns of Grouping Expr nodes, row i of each column is the i-th node.
+struct FlatGroupingExpr
+{
+    uint32_t count = 0;
+    FlatColumn<FlatRef> expression;
+
+    uint32_t push(FlatRef expression_)
+    {
+        expression.push_back(expression_);
+        return count++;
+    }
+};
+
+// Columns of Literal Expr nodes, row i of each column is the i-th node.
+struct FlatLiteralExpr
+{
+    uint32_t count = 0;
+    FlatColumn<uint8_t> type;
+    FlatColumn<uint32_t> value;
+
+    uint32_t push(uint8_t type_, uint32_t value_)
+    {
+        type.push_back(type_);
+        value.push_back(value_);
+        return count++;
+    }
+};
+
+// Columns of Logical Expr nodes, row i of each column is the i-th node.
+struct FlatLogicalExpr
+{
+    uint32_t count = 0;
+    FlatColumn<FlatRef> left;
+    FlatColumn<uint8_t> op;
+    FlatColumn<FlatRef> right;
+
+    uint32_t push(FlatRef left_, uint8_t op_, FlatRef right_)
+    {
+        left.push_back(left_);
+        op.push_back(op_);
+        right.push_back(right_);
+        return count++;
+    }
+};
+
+// Columns of Unary Expr nodes, row i of each column is the i-th node.
+struct FlatUnaryExpr
+{
+    uint32_t count = 0;
+    FlatColumn<uint8_t> op;
+    FlatColumn<uint32_t> opPos;
+    FlatColumn<FlatRef> right;
+
+    uint32_t push(uint8_t op_, uint32_t opPos_, FlatRef right_)
+    {
+        op.push_back(op_);
+        opPos.push_back(opPos_);
+        right.push_back(right_);
+        return count++;
+    }
+};
+
+// Columns of Variable Expr nodes, row i of each column is the i-th node.
+struct FlatVariableExpr
+{
+    uint32_t count = 0;
+    FlatColumn<uint32_t> name;
+    FlatColumn<uint32_t> namePos;
+
+    uint32_t push(uint32_t name_, uint32_t namePos_)
+    {
+        name.push_back(name_);
+        namePos.push_back(namePos_);
+        return count++;
+    }
+};
+
+// Columns of Block Stmt nodes, row i of each column is the i-th node.
+struct FlatBlockStmt
+{
+    uint32_t count = 0;
+    FlatColumn<FlatRange> statements;
+
+    uint32_t push(FlatRange statements_)
+    {
+        statements.push_back(statements_);
+        return count++;
+    }
+};
+
+// Columns of Break Stmt nodes, row i of each column is the i-th node.
+struct FlatBreakStmt
+{
+    uint32_t count = 0;
+
+    uint32_t push()
+    {
+        return count++;
+    }
+};
+
+// Columns of Expression Stmt nodes, row i of each column is the i-th node.
+struct FlatExpressionStmt
+{
+    uint32_t count = 0;
+    FlatColumn<FlatRef> expression;
+
+    uint32_t push(FlatRef expression_)
+    {
+        expression.push_back(expression_);
+        return count++;
+    }
+};
+
+// Columns of Function Stmt nodes, row i of each column is the i-th node.
+struct FlatFunctionStmt
+{
+    uint32_t count = 0;
+    FlatColumn<uint32_t> name;
+    FlatColumn<uint32_t> namePos;
+    FlatColumn<FlatRange> params;
+    FlatColumn<FlatRange> body;
+
+    uint32_t push(uint32_t name_, uint32_t namePos_, FlatRange params_, FlatRange body_)
+    {
+        name.push_back(name_);
+        namePos.push_back(namePos_);
+        params.push_back(params_);
+        body.push_back(body_);
+        return count++;
+    }
+};
+
+// Columns of If Stmt nodes, row i of each column is the i-th node.
+struct FlatIfStmt
+{
+    uint32_t count = 0;
+    FlatColumn<FlatRef> condition;
+    FlatColumn<FlatRef> thenBranch;
+    FlatColumn<FlatRef> elseBranch;
+
+    uint32_t push(FlatRef condition_, FlatRef thenBranch_, FlatRef elseBranch_)
+    {
+        condition.push_back(condition_);
+        thenBranch.push_back(thenBranch_);
+        elseBranch.push_back(elseBranch_);
+        return count++;
+    }
+};
+
+// Columns of Print Stmt nodes, row i of each column is the i-th node.
+struct FlatPrintStmt
+{
+    uint32_t count = 0;
+    FlatColumn<FlatRef> expression;
+
+    uint32_t push(FlatRef expression_)
+    {
+        expression.push_back(expression_);
+        return count++;
+    }
+};
+
+// Columns of Return Stmt nodes, row i of each column is the i-th node.
+struct FlatReturnStmt
+{
+    uint32_t count = 0;
+    FlatColumn<uint32_t> keywordPos;
+    FlatColumn<FlatRef> value;
+
+    uint32_t push(uint32_t keywordPos_, FlatRef value_)
+    {
+        keywordPos.push_back(keywordPos_);
+        value.push_back(value_);
+        return count++;
+    }
+};
+
+// Columns of Var Stmt nodes, row i of each column is the i-th node.
+struct FlatVarStmt
+{
+    uint32_t count = 0;
+    FlatColumn<uint32_t> name;
+    FlatColumn<uint32_t> namePos;
+    FlatColumn<FlatRef> initializer;
+
+    uint32_t push(uint32_t name_, uint32_t namePos_, FlatRef initializer_)
+    {
+        name.push_back(name_);
+        namePos.push_back(namePos_);
+        initializer.push_back(initializer_);
+        return count++;
+    }
+};
+
+// Columns of While Stmt nodes, row i of each column is the i-th node.
+struct FlatWhileStmt
+{
+    uint32_t count = 0;
+    FlatColumn<FlatRef> condition;
+    FlatColumn<FlatRef> body;
+
+    uint32_t push(FlatRef condition_, FlatRef body_)
+    {
+        condition.push_back(condition_);
+        body.push_back(body_);
+        return count++;
+    }
+};
+
+struct FlatAst
+{
+    FlatAssignExpr assignExprs;
+    FlatBinaryExpr binaryExprs;
+    FlatCallExpr callExprs;
+    FlatGroupingExpr groupingExprs;
+    FlatLiteralExpr literalExprs;
+    FlatLogicalExpr logicalExprs;
+    FlatUnaryExpr unaryExprs;
+    FlatVariableExpr variableExprs;
+    FlatBlockStmt blockStmts;
+    FlatBreakStmt breakStmts;
+    FlatExpressionStmt expressionStmts;
+    FlatFunctionStmt functionStmts;
+    FlatIfStmt ifStmts;
+    FlatPrintStmt printStmts;
+    FlatReturnStmt returnStmts;
+    FlatVarStmt varStmts;
+    FlatWhileStmt whileStmts;
+
+    // Shared list columns referenced by FlatRange fields.
+    FlatColumn<FlatRef> exprLists;
+    FlatColumn<FlatRef> stmtLists;
+    FlatColumn<uint32_t> nameLists;
+
+    // Constants. Literal values index numbers or strings depending on the literal type.
+    FlatColumn<double> numbers;
+    FlatColumn<FlatRange> strings;
+    // Interned identifiers (Name fields index this table).
+    FlatColumn<FlatRange> names;
+    // Characters of strings and names.
+    FlatColumn<char> chars;
+
+    // Top-level statements of the program (in stmtLists).
+    FlatRange program = {0, 0};
+
+    // Keeps the memory alive that columns were pointed at with view(), e.g. a mapped cache file.
+    std::shared_ptr<const void> storage;
+
+    static FlatRef makeRef(uint8_t kind, uint32_t row)
+    {
+        return (static_cast<FlatRef>(kind) << 28) | row;
+    }
+    static uint32_t row(FlatRef ref)
+    {
+        return ref & 0x0FFFFFFF;
+    }
+    static FlatExpr exprKind(FlatRef ref)
+    {
+        return static_cast<FlatExpr>(ref >> 28);
+    }
+    static FlatStmt stmtKind(FlatRef ref)
+    {
+        return static_cast<FlatStmt>(ref >> 28);
+    }
+
+    std::string text(FlatRange range) const
+    {
+        return std::string(chars.data() + range.first, range.count);
+    }
+
+    // Call f on every column, always in the same order (see FlatCache).
+    template <typename F> void forEachColumn(F &&f)
+    {
+        f(assignExprs.name);
+        f(assignExprs.namePos);
+        f(assignExprs.value);
+        f(binaryExprs.left);
+        f(binaryExprs.op);
+        f(binaryExprs.opPos);
+        f(binaryExprs.right);
+        f(callExprs.callee);
+        f(callExprs.parenPos);
+        f(callExprs.arguments);
+        f(groupingExprs.expression);
+        f(literalExprs.type);
+        f(literalExprs.value);
+        f(logicalExprs.left);
+        f(logicalExprs.op);
+        f(logicalExprs.right);
+        f(unaryExprs.op);
+        f(unaryExprs.opPos);
+        f(unaryExprs.right);
+        f(variableExprs.name);
+        f(variableExprs.namePos);
+        f(blockStmts.statements);
+        f(expressionStmts.expression);
+        f(functionStmts.name);
+        f(functionStmts.namePos);
+        f(functionStmts.params);
+        f(functionStmts.body);
+        f(ifStmts.condition);
+        f(ifStmts.thenBranch);
+        f(ifStmts.elseBranch);
+        f(printStmts.expression);
+        f(returnStmts.keywordPos);
+        f(returnStmts.value);
+        f(varStmts.name);
+        f(varStmts.namePos);
+        f(varStmts.initializer);
+        f(whileStmts.condition);
+        f(whileStmts.body);
+        f(exprLists);
+        f(stmtLists);
+        f(nameLists);
+        f(numbers);
+        f(strings);
+        f(names);
+        f(chars);
+    }
+    // Call f on every row count and on the program range, always in the same order.
+    template <typename F> void forEachScalar(F &&f)
+    {
+        f(assignExprs.count);
+        f(binaryExprs.count);
+        f(callExprs.count);
+        f(groupingExprs.count);
+        f(literalExprs.count);
+        f(logicalExprs.count);
+        f(unaryExprs.count);
+        f(variableExprs.count);
+        f(blockStmts.count);
+        f(breakStmts.count);
+        f(expressionStmts.count);
+        f(functionStmts.count);
+        f(ifStmts.count);
+        f(printStmts.count);
+        f(returnStmts.count);
+        f(varStmts.count);
+        f(whileStmts.count);
+        f(program.first);
+        f(program.count);
+    }
+
+    FlatRef addAssign(uint32_t name, uint32_t namePos, FlatRef value)
+    {
+        return makeRef(static_cast<uint8_t>(FlatExpr::Assign), assignExprs.push(name, namePos, value));
+    }
+    FlatRef addBinary(FlatRef left, uint8_t op, uint32_t opPos, FlatRef right)
+    {
+        return makeRef(static_cast<uint8_t>(FlatExpr::Binary), binaryExprs.push(left, op, opPos, right));
+    }
+    FlatRef addCall(FlatRef callee, uint32_t parenPos, FlatRange arguments)
+    {
+        return makeRef(static_cast<uint8_t>(FlatExpr::Call), callExprs.push(callee, parenPos, arguments));
+    }
+    FlatRef addGrouping(FlatRef expression)
+    {
+        return makeRef(static_cast<uint8_t>(FlatExpr::Grouping), groupingExprs.push(expression));
+    }
+    FlatRef addLiteral(uint8_t type, uint32_t value)
+    {
+        return makeRef(static_cast<uint8_t>(FlatExpr::Literal), literalExprs.push(type, value));
+    }
+    FlatRef addLogical(FlatRef left, uint8_t op, FlatRef right)
+    {
+        return makeRef(static_cast<uint8_t>(FlatExpr::Logical), logicalExprs.push(left, op, right));
+    }
+    FlatRef addUnary(uint8_t op, uint32_t opPos, FlatRef right)
+    {
+        return makeRef(static_cast<uint8_t>(FlatExpr::Unary), unaryExprs.push(op, opPos, right));
+    }
+    FlatRef addVariable(uint32_t name, uint32_t namePos)
+    {
+        return makeRef(static_cast<uint8_t>(FlatExpr::Variable), variableExprs.push(name, namePos));
+    }
+    FlatRef addBlock(FlatRange statements)
+    {
+        return makeRef(static_cast<uint8_t>(FlatStmt::Block), blockStmts.push(statements));
+    }
+    FlatRef addBreak()
+    {
+        return makeRef(static_cast<uint8_t>(FlatStmt::Break), breakStmts.push());
+    }
+    FlatRef addExpression(FlatRef expression)
+    {
+        return makeRef(static_cast<uint8_t>(FlatStmt::Expression), expressionStmts.push(expression));
+    }
+    FlatRef addFunction(uint32_t name, uint32_t namePos, FlatRange params, FlatRange body)
+    {
+        return makeRef(static_cast<uint8_t>(FlatStmt::Function), functionStmts.push(name, namePos, params, body));
+    }
+    FlatRef addIf(FlatRef condition, FlatRef thenBranch, FlatRef elseBranch)
+    {
+        return makeRef(static_cast<uint8_t>(FlatStmt::If), ifStmts.push(condition, thenBranch, elseBranch));
+    }
+    FlatRef addPrint(FlatRef expression)
+    {
+        return makeRef(static_cast<uint8_t>(FlatStmt::Print), printStmts.push(expression));
+    }
+    FlatRef addReturn(uint32_t keywordPos, FlatRef value)
+    {
+        return makeRef(static_cast<uint8_t>(FlatStmt::Return), returnStmts.push(keywordPos, value));
+    }
+    FlatRef addVar(uint32_t name, uint32_t namePos, FlatRef initializer)
+    {
+        return makeRef(static_cast<uint8_t>(FlatStmt::Var), varStmts.push(name, namePos, initializer));
+    }
+    FlatRef addWhile(FlatRef condition, FlatRef body)
+    {
+        return makeRef(static_cast<uint8_t>(FlatStmt::While), whileStmts.push(condition, body));
+    }
+};
+
+#endif // FLATAST_HPP
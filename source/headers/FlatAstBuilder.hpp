@@ -0,0 +1,56 @@
+#ifndef FLATASTBUILDER_HPP
+#define FLATASTBUILDER_HPP
+
+#include "Expr.hpp"
+#include "FlatAst.hpp"
+#include "Stmt.hpp"
+#include <unordered_map>
+
+/*
+ * Lowers the pointer tree produced by the Parser into a FlatAst.
+ * Each visit method returns the reference to the node it added. Children are lowered first so that the list entries of
+ * a node (block statements, call arguments) are contiguous.
+ */
+class FlatAstBuilder final : public ExprVisitor<FlatRef>, public StmtVisitor<FlatRef>
+{
+    std::unique_ptr<FlatAst> ast = std::make_unique<FlatAst>();
+
+    // Interned identifier -> index in ast->names
+    std::unordered_map<std::string, uint32_t> nameIds;
+
+    FlatRef lower(const std::unique_ptr<Expr> &expr);
+    FlatRef lower(const std::unique_ptr<Stmt> &stmt);
+    FlatRange lowerList(const std::vector<std::unique_ptr<Expr>> &exprs);
+    FlatRange lowerList(const std::vector<std::unique_ptr<Stmt>> &stmts);
+
+    uint32_t intern(std::string_view name);
+    FlatRange addChars(std::string_view text);
+
+  public:
+    std::unique_ptr<FlatAst> build(const std::vector<std::unique_ptr<Stmt>> &statements);
+
+    /* -------------------- EXPRESSIONS -------------------- */
+    FlatRef visitAssignExpr(const Assign &expr) override;
+    FlatRef visitBinaryExpr(const Binary &expr) override;
+    FlatRef visitGroupingExpr(const Grouping &expr) override;
+    FlatRef visitLiteralExpr(const Literal &expr) override;
+    FlatRef visitLogicalExpr(const Logical &expr) override;
+    FlatRef visitUnaryExpr(const Unary &expr) override;
+    FlatRef visitVariableExpr(const Variable &expr) override;
+    FlatRef visitCallExpr(const Call &expr) override;
+    /* ---------------------------------------------------- */
+
+    /* -------------------- STATEMENTS -------------------- */
+    FlatRef visitIfStmt(const If &stmt) override;
+    FlatRef visitWhileStmt(const While &stmt) override;
+    FlatRef visitBlockStmt(const Block &stmt) override;
+    FlatRef visitBreakStmt(const Break &stmt) override;
+    FlatRef visitExpressionStmt(const Expression &stmt) override;
+    FlatRef visitPrintStmt(const Print &stmt) override;
+    FlatRef visitVarStmt(const Var &stmt) override;
+    FlatRef visitFunctionStmt(const Function &stmt) override;
+    FlatRef visitReturnStmt(const Return &stmt) override;
+    /* ---------------------------------------------------- */
+};
+
+#endif // FLATASTBUILDER_HPP
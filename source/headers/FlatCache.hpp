@@ -0,0 +1,57 @@
+#ifndef FLATCACHE_HPP
+#define FLATCACHE_HPP
+
+#include "FlatAst.hpp"
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+/*
+ * On-disk cache of lowered programs (--cache-dir=DIR).
+ * A cache file is named after a hash of the source text, the cache format version and the offset the source was added
+ * at in Source (FlatAst positions are global offsets, so a program is only valid at the same offset). It holds the
+ * FlatAst columns one after the other, 8-byte aligned, with a table of where each one starts. Loading maps the file
+ * and points the columns straight into the mapping, nothing is copied or allocated per node. The header also holds a
+ * checksum of the rest and the build of the interpreter that wrote it, and every program is checked before it is
+ * used, so a damaged or stale file is just a miss.
+ * Is not meant to be instantiated.
+ */
+class FlatCache
+{
+    // Bump whenever the layout of the file or of any FlatAst column changes.
+    static constexpr uint32_t FORMAT_VERSION = 3;
+
+    static uint64_t hash(const std::string &text, uint32_t base);
+    static std::string path(const std::string &dir, uint64_t key);
+
+  public:
+    // Map a whole file read-only, size is set to its length. nullptr if it can't be mapped.
+    static std::shared_ptr<const void> map(const std::string &path, size_t &size);
+
+    // Checksum of a file's contents: any damaged byte shows, it's not meant to stand up to tampering.
+    static uint64_t checksum(const char *bytes, size_t size);
+    // Identifies this build of the interpreter. Files written by another build aren't used, what a program lowers to
+    // may have changed.
+    static uint64_t buildId();
+
+    // Append a program to bytes at the next 8-byte boundary: its scalars, a table of where its columns are and the
+    // columns. Returns the offset it starts at.
+    static size_t write(std::vector<char> &bytes, FlatAst &ast);
+    // Point a new FlatAst at a program written by write() at offset in a mapped file of the given size. The caller
+    // keeps the mapping alive (usually in FlatAst::storage). nullptr if it doesn't fit, has different columns or
+    // anything in it is out of bounds, including source positions outside [start, end].
+    static std::unique_ptr<FlatAst> view(const char *bytes, size_t size, size_t offset, uint32_t start, uint32_t end);
+
+    // Write bytes to path through a temporary file, so nothing ever maps a half written file. Returns false on error.
+    static bool writeFile(const std::string &path, const std::vector<char> &bytes);
+
+    // The cached program for the source added at base, or nullptr if there is no usable cache file.
+    static std::unique_ptr<FlatAst> load(const std::string &dir, uint32_t base);
+
+    // Write the program for the source added at base to the cache. Failing to write is not an error, the next run
+    // just misses.
+    static void save(const std::string &dir, uint32_t base, FlatAst &ast);
+};
+
+#endif // FLATCACHE_HPP
@@ -0,0 +1,87 @@
+#ifndef FLATCOLUMN_HPP
+#define FLATCOLUMN_HPP
+
+#include <cstddef>
+#include <vector>
+
+/*
+ * One column of a FlatAst. Usually it owns its items like a std::vector does, but it can also be pointed at items
+ * stored somewhere else (see FlatCache, which points columns straight into a mapped cache file), so a loaded program
+ * is used in place instead of being copied into new vectors.
+ */
+template <typename T> class FlatColumn
+{
+    std::vector<T> owned;
+    // The items, in owned or elsewhere
+    const T *items = nullptr;
+    size_t length = 0;
+
+  public:
+    using value_type = T;
+
+    FlatColumn() = default;
+
+    FlatColumn(const FlatColumn &other) : owned(other.begin(), other.end())
+    {
+        items = owned.data();
+        length = owned.size();
+    }
+
+    FlatColumn &operator=(const FlatColumn &other)
+    {
+        owned.assign(other.begin(), other.end());
+        items = owned.data();
+        length = owned.size();
+        return *this;
+    }
+
+    // Moving a vector keeps its buffer, so items stays valid
+    FlatColumn(FlatColumn &&other) = default;
+    FlatColumn &operator=(FlatColumn &&other) = default;
+
+    void push_back(const T &item)
+    {
+        owned.push_back(item);
+        items = owned.data();
+        length = owned.size();
+    }
+
+    template <typename Iterator> void append(Iterator first, Iterator last)
+    {
+        owned.insert(owned.end(), first, last);
+        items = owned.data();
+        length = owned.size();
+    }
+
+    // Use length items at the given address, which must outlive the column. The column can't grow after this.
+    void view(const T *address, size_t count)
+    {
+        owned.clear();
+        items = address;
+        length = count;
+    }
+
+    const T &operator[](size_t i) const
+    {
+        return items[i];
+    }
+
+    size_t size() const
+    {
+        return length;
+    }
+    const T *data() const
+    {
+        return items;
+    }
+    const T *begin() const
+    {
+        return items;
+    }
+    const T *end() const
+    {
+        return items + length;
+    }
+};
+
+#endif // FLATCOLUMN_HPP
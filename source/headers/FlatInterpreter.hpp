@@ -0,0 +1,96 @@
+#ifndef FLATINTERPRETER_HPP
+#define FLATINTERPRETER_HPP
+
+#include "CallStack.hpp"
+#include "Environment.hpp"
+#include "FlatAst.hpp"
+#include "RuntimeError.hpp"
+#include "Value.hpp"
+
+/*
+ * A FlatAst together with the runtime objects built once from its constant tables, so that evaluating a literal or
+ * looking up a name does not allocate.
+ */
+struct FlatProgram
+{
+    std::unique_ptr<FlatAst> ast;
+    std::vector<std::string> names;
+    std::vector<std::shared_ptr<void>> numbers;
+    std::vector<std::shared_ptr<void>> strings;
+};
+
+/*
+ * A function declared while running a FlatAst. Stored in environments with the FUN type, like LoxFunction is for the
+ * AstInterpreter.
+ */
+struct FlatFunction
+{
+    const FlatProgram *program;
+    uint32_t declaration; // Row in program->ast->functionStmts
+    std::shared_ptr<Environment> closure;
+};
+
+/*
+ * Interpreter path that walks a FlatAst instead of the Expr / Stmt tree.
+ * It follows AstInterpreter statement by statement, including where runtime errors are reported and recovered from,
+ * but signals break and return with a completion value instead of exceptions.
+ */
+class FlatInterpreter
+{
+    enum class Completion
+    {
+        NORMAL,
+        BREAK,
+        RETURN
+    };
+
+    std::shared_ptr<Environment> globals = std::make_shared<Environment>();
+    std::shared_ptr<Environment> environment = globals;
+
+    // Every program run so far. Functions declared by one (e.g. a REPL line) can be called from later ones.
+    std::vector<std::unique_ptr<FlatProgram>> programs;
+    // Program the currently executing code belongs to.
+    const FlatProgram *program = nullptr;
+
+    // Calls in progress, limited to --max-depth
+    CallStack callStack;
+
+    // Value of the last executed return statement.
+    Value returnValue;
+
+    // An operator, or an operand, still to be handled by evaluateOperators.
+    struct PendingOperator
+    {
+        FlatRef expr;
+        bool apply; // Its operands are on the operand stack.
+    };
+    // Stacks of evaluateOperators, shared by its nested runs: each one only touches what it pushed itself.
+    std::vector<PendingOperator> pendingOperators;
+    std::vector<Value> operands;
+
+    Value evaluate(FlatRef expr);
+    // Evaluate a grouping, unary or binary expression and every one of those nested in it with the stacks above
+    // instead of recursing, so chains of any depth (((((1))))) or 1 + 1 + ... + 1 don't run out of native stack.
+    Value evaluateOperators(FlatRef expr);
+    // Evaluate, but report a runtime error instead of propagating it. Returns false on error.
+    bool evaluateReported(FlatRef expr, Value &value);
+
+    Completion execute(FlatRef stmt);
+    Completion executeBlock(FlatRange statements, const std::shared_ptr<Environment> &localEnv);
+
+    Value call(const FlatFunction &function, std::vector<Value> &arguments);
+
+    // Add a program and build its constant tables, without running it.
+    const FlatProgram *load(std::unique_ptr<FlatAst> ast);
+
+    // Build the error for the token of the given length at source offset pos.
+    RuntimeError error(uint32_t pos, uint32_t length, const std::string &message) const;
+
+    // Saves and restores the programs and environments
+    friend class FlatSnapshot;
+
+  public:
+    void interpret(std::unique_ptr<FlatAst> ast);
+};
+
+#endif // FLATINTERPRETER_HPP
@@ -0,0 +1,31 @@
+#ifndef FLATSNAPSHOT_HPP
+#define FLATSNAPSHOT_HPP
+
+#include "FlatInterpreter.hpp"
+#include <string>
+
+/*
+ * Image of everything a FlatInterpreter has built up (--snapshot-out / --snapshot-in): the sources, the programs run
+ * so far, every environment reachable from the globals and the functions and values in them.
+ * Programs are stored like in a FlatCache file and used in place from the mapped image. Environments, functions and
+ * variables are fixed size records that refer to each other by index, so restoring is one pass over each table that
+ * turns indexes back into pointers, without parsing or running anything. Like a cache file an image carries a
+ * checksum and the build that wrote it, and everything in it is bounds checked before it is used.
+ * Is not meant to be instantiated.
+ */
+class FlatSnapshot
+{
+    // Bump whenever the layout of the image changes (FlatCache checks the program columns).
+    static constexpr uint32_t FORMAT_VERSION = 2;
+
+  public:
+    // Write the state of interpreter to path. Returns false if the file couldn't be written.
+    static bool save(const std::string &path, FlatInterpreter &interpreter);
+
+    // Restore the state saved to path into interpreter. Has to be done before any source is added or program is run,
+    // so the global offsets in the image are still free. Returns false if the image can't be used, interpreter may then
+    // be partly restored.
+    static bool load(const std::string &path, FlatInterpreter &interpreter);
+};
+
+#endif // FLATSNAPSHOT_HPP
@@ -0,0 +1,132 @@
+#ifndef IR_HPP
+#define IR_HPP
+
+#include "LookupCache.hpp"
+#include "Token.hpp"
+#include "Value.hpp"
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+
+struct IrFunction;
+
+/*
+ * One instruction of the SSA IR (see IrBuilder). Every instruction defines one value, numbered by its index in
+ * IrFunction::values, and its operands are the numbers of other values. Environments are values too, so the scope a
+ * name is looked up in is an operand like any other.
+ * An instruction that can fail with a runtime error is always the last one of its block, the error goes to the
+ * block's unwind successor.
+ */
+struct IrInstruction
+{
+    enum Op : uint8_t
+    {
+        CONSTANT,       // constant
+        ARGUMENT,       // Argument number index of the call
+        CLOSURE_ENV,    // Environment the function was declared in, the globals for a script
+        PHI,            // One operand per predecessor of the block, in the same order
+        COPY,           // operands[0]
+        NEW_ENV,        // New environment enclosed by operands[0]
+        LOAD,           // Variable token from environment operands[0]
+        STORE,          // Assign operands[1] to variable token from environment operands[0]
+        DEFINE,         // Define variable token in environment operands[0] as operands[1]
+        CHECK_INIT,     // operands[0], fails if it is a var declared without initializer
+        UNARY,          // type (the operator) applied to operands[0]
+        BINARY,         // type applied to operands[0] and operands[1]
+        CHECK_CALLABLE, // operands[0], fails if it can't be called
+        CALL,           // operands[0] called with the other operands as arguments
+        CLOSURE,        // function declared in environment operands[0]
+        PRINT,          // Print operands[0]
+        REPORT,         // Report the runtime error that led to this block
+    };
+
+    Op op;
+    // Operator of UNARY and BINARY
+    TokenInfo::Type type = TokenInfo::Type::NIL;
+    std::vector<uint32_t> operands;
+    Value constant;
+    // The name of a variable, or where a runtime error is reported
+    Token token = Token(TokenInfo::Type::NIL, 0, 0);
+    uint32_t index = 0;
+    const IrFunction *function = nullptr;
+
+    // The block the instruction is in, and whether an optimization took it out of its block
+    uint32_t block = 0;
+    bool removed = false;
+
+    mutable LookupCache cache;
+
+    explicit IrInstruction(Op op) : op(op)
+    {
+    }
+
+    // Whether running it can fail (if its block lets it, see IrBlock::unwind)
+    bool canFail() const;
+    // Whether it does something besides defining its value (and failing)
+    bool hasEffect() const;
+};
+
+/*
+ * A basic block: instructions (phis first) and how control leaves it.
+ */
+struct IrBlock
+{
+    static constexpr uint32_t NONE = std::numeric_limits<uint32_t>::max();
+
+    enum class End : uint8_t
+    {
+        JUMP,        // To successors[0]
+        BRANCH,      // To successors[0] if value is truthy, otherwise to successors[1]
+        RETURN,      // From the function, with value
+        HALT,        // Stop the script, a runtime error escaped its top level
+        UNREACHABLE, // Never gets here, the last instruction always fails
+    };
+
+    std::vector<uint32_t> code;
+    End end = End::JUMP;
+    uint32_t value = 0;
+    std::vector<uint32_t> successors;
+    // Where a runtime error in the last instruction goes, NONE if it can't fail
+    uint32_t unwind = NONE;
+    // One entry per edge into the block, operands of phis are in the same order
+    std::vector<uint32_t> predecessors;
+    bool removed = false;
+};
+
+/*
+ * A function (or the top level of a script) in SSA form. blocks[0] is the entry, removed blocks and instructions stay
+ * in place so numbers don't change.
+ */
+struct IrFunction
+{
+    std::string name;
+    size_t arity = 0;
+    std::vector<IrInstruction> values;
+    std::vector<IrBlock> blocks;
+
+    uint32_t addBlock();
+    // Append instruction to block, returns its value
+    uint32_t add(uint32_t block, IrInstruction instruction);
+    void addEdge(uint32_t from, uint32_t to);
+    // Take out one edge from -> to, with its operand in the phis of to
+    void removeEdge(uint32_t from, uint32_t to);
+    // Successors including the unwind block
+    std::vector<uint32_t> edges(uint32_t block) const;
+    // Take out blocks that can't be reached from the entry
+    void removeUnreachable();
+
+    void print(std::ostream &out) const;
+};
+
+// A script lowered to IR: functions[0] is its top level, the others are the functions declared in it
+struct IrProgram
+{
+    std::vector<std::unique_ptr<IrFunction>> functions;
+
+    void print(std::ostream &out) const;
+};
+
+#endif // IR_HPP
@@ -0,0 +1,136 @@
+#ifndef IRBUILDER_HPP
+#define IRBUILDER_HPP
+
+#include "Expr.hpp"
+#include "Ir.hpp"
+#include "Stmt.hpp"
+#include <cstdint>
+#include <memory>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+/*
+ * Lowers parsed statements to the SSA IR (--ir), one IrFunction for the top level and one for every function
+ * declaration. Expression visits return the value of the expression.
+ * Variables that no function declared inside the one being lowered mentions can't be seen from anywhere else, so
+ * they become SSA values (with phis where control flow meets) and never touch an Environment. Everything else, the
+ * globals included, is loaded from and stored to environments by name like the AstInterpreter does.
+ * Runtime errors follow the AstInterpreter too: every instruction that can fail ends its block, with an unwind edge to
+ * where the error would be caught (see evaluateReported, executeBlock).
+ * SSA is built on the fly (Braun et al., "Simple and Efficient Construction of Static Single Assignment Form"): a
+ * block is sealed once all its predecessors are known, reads in unsealed blocks get a phi that is completed then.
+ */
+class IrBuilder final : public ExprVisitor<uint32_t>, public StmtVisitor<void>
+{
+    IrProgram &program;
+    IrFunction &function;
+    // Lowering the top level of a script, where declarations outside of blocks are globals
+    bool topLevel;
+
+    // A variable living in SSA values. initialized is false for a var without initializer, reads check it then.
+    struct Local
+    {
+        std::string_view name;
+        uint32_t id;
+        bool initialized;
+    };
+    struct Scope
+    {
+        std::vector<Local> locals;
+        uint32_t env;
+    };
+    std::vector<Scope> scopes;
+    uint32_t nextLocal = 0;
+
+    // Names mentioned in functions declared inside this one, they have to stay in environments
+    std::unordered_set<std::string_view> captured;
+
+    // SSA construction state per block: value of each local at its end, phis waiting for the block to be sealed
+    std::vector<std::unordered_map<uint32_t, uint32_t>> definitions;
+    std::vector<std::vector<std::pair<uint32_t, uint32_t>>> incompletePhis;
+    std::vector<bool> sealed;
+
+    // The block being written to
+    uint32_t current = 0;
+    // Where a runtime error goes, innermost last
+    std::vector<uint32_t> handlers;
+    // Where a break goes, innermost last
+    std::vector<uint32_t> loopExits;
+    // At the top level, the block after the statement being lowered (return and break outside loops end it)
+    uint32_t statementEnd = IrBlock::NONE;
+
+    IrBuilder(IrProgram &program, IrFunction &function, bool topLevel)
+        : program(program), function(function), topLevel(topLevel)
+    {
+    }
+
+    static void mention(const Expr &expr, std::unordered_set<std::string_view> &names);
+    static void mention(const Stmt &stmt, std::unordered_set<std::string_view> &names);
+    void capture(const Stmt &stmt);
+
+    uint32_t newBlock();
+    void seal(uint32_t block);
+    // Start an unreachable block, for whatever follows a break or return
+    void startUnreachable();
+    uint32_t emit(IrInstruction::Op op, std::vector<uint32_t> operands = {});
+    uint32_t emit(IrInstruction instruction);
+    uint32_t constant(Value value);
+    void jump(uint32_t to);
+    void branch(uint32_t condition, uint32_t ifTruthy, uint32_t ifFalsy);
+    void ret(uint32_t value);
+    // Phi in join merging value per predecessor block (just the value if they are all the same)
+    uint32_t merge(uint32_t join, const std::vector<std::pair<uint32_t, uint32_t>> &incoming);
+
+    // Braun et al.
+    void write(uint32_t local, uint32_t block, uint32_t value);
+    uint32_t read(uint32_t local, uint32_t block);
+    uint32_t readRecursive(uint32_t local, uint32_t block);
+    uint32_t addPhi(uint32_t block);
+    uint32_t addPhiOperands(uint32_t local, uint32_t phi);
+    uint32_t tryRemoveTrivialPhi(uint32_t phi);
+
+    uint32_t env() const;
+    bool promoted(std::string_view name) const;
+    const Local *find(std::string_view name) const;
+    void enterScope(const std::vector<std::unique_ptr<Stmt>> &statements, const std::vector<Token> &params = {});
+    void declare(const Token &name, uint32_t value, bool initialized);
+
+    uint32_t evaluate(const std::unique_ptr<Expr> &expr);
+    // Same as AstInterpreter::evaluateReported: a runtime error is reported and the value is nil
+    uint32_t evaluateReported(const std::unique_ptr<Expr> &expr);
+    void execute(const std::unique_ptr<Stmt> &stmt);
+
+    static const IrFunction *buildFunction(IrProgram &program, const Function &declaration);
+
+  public:
+    // The IR of a script, with its function declarations
+    static std::unique_ptr<IrProgram> build(const std::vector<std::unique_ptr<Stmt>> &statements);
+
+    /* -------------------- EXPRESSIONS -------------------- */
+    uint32_t visitAssignExpr(const Assign &expr) override;
+    uint32_t visitBinaryExpr(const Binary &expr) override;
+    uint32_t visitCallExpr(const Call &expr) override;
+    uint32_t visitGroupingExpr(const Grouping &expr) override;
+    uint32_t visitLiteralExpr(const Literal &expr) override;
+    uint32_t visitLogicalExpr(const Logical &expr) override;
+    uint32_t visitUnaryExpr(const Unary &expr) override;
+    uint32_t visitVariableExpr(const Variable &expr) override;
+    /* ---------------------------------------------------- */
+
+    /* -------------------- STATEMENTS -------------------- */
+    void visitBlockStmt(const Block &stmt) override;
+    void visitBreakStmt(const Break &stmt) override;
+    void visitExpressionStmt(const Expression &stmt) override;
+    void visitFunctionStmt(const Function &stmt) override;
+    void visitIfStmt(const If &stmt) override;
+    void visitPrintStmt(const Print &stmt) override;
+    void visitReturnStmt(const Return &stmt) override;
+    void visitVarStmt(const Var &stmt) override;
+    void visitWhileStmt(const While &stmt) override;
+    /* ---------------------------------------------------- */
+};
+
+#endif // IRBUILDER_HPP
@@ -0,0 +1,45 @@
+#ifndef IRINTERPRETER_HPP
+#define IRINTERPRETER_HPP
+
+#include "CallStack.hpp"
+#include "Environment.hpp"
+#include "Ir.hpp"
+#include "Stmt.hpp"
+#include "Value.hpp"
+#include <memory>
+#include <vector>
+
+/*
+ * A function declared while running IR. Stored in environments with the FUN type, like LoxFunction is for the
+ * AstInterpreter.
+ */
+struct IrClosure
+{
+    const IrFunction *function;
+    std::shared_ptr<Environment> closure;
+};
+
+/*
+ * Runs scripts lowered to the SSA IR (--ir), after the IrOptimizer unless --ir-optimize=off. It is there to test the
+ * IR and its passes: a script prints the same with and without them, and the same as with the AstInterpreter.
+ * Every IR value gets a register in the frame of the call (environments too), the phis of a block are all assigned
+ * at once when it is entered.
+ */
+class IrInterpreter
+{
+    std::shared_ptr<Environment> globals = std::make_shared<Environment>();
+
+    // The IR of every script run so far, closures point into it
+    std::vector<std::unique_ptr<IrProgram>> programs;
+
+    // Calls in progress, limited to --max-depth
+    CallStack callStack;
+
+    Value run(const IrFunction &function, const std::shared_ptr<Environment> &closure,
+              const std::vector<Value> &arguments);
+
+  public:
+    void interpret(const std::vector<std::unique_ptr<Stmt>> &statements);
+};
+
+#endif // IRINTERPRETER_HPP
@@ -0,0 +1,32 @@
+#ifndef IROPTIMIZER_HPP
+#define IROPTIMIZER_HPP
+
+#include "Ir.hpp"
+
+/*
+ * Pass pipeline over the SSA IR (see IrBuilder): sparse conditional constant propagation, copy propagation, global
+ * value numbering and dead code elimination, then merging straight-line blocks.
+ * None of them changes what a script does, runtime errors included: an instruction that can fail is only folded or
+ * dropped once it is known not to fail, and one that always fails keeps failing (its block ends as unreachable).
+ * Is not meant to be instantiated.
+ */
+class IrOptimizer
+{
+    // Wegman & Zadeck: values are unknown, one constant or varying, and only code reached through edges found to be
+    // executable counts. Folds constants, branches on them and checks that can or can't fail.
+    static void propagateConstants(IrFunction &function);
+    // Uses of a copy (or of a phi merging one value, or of a check that can't fail) use its operand instead
+    static void propagateCopies(IrFunction &function);
+    // An instruction computing what one dominating it already computed becomes a copy of it
+    static void numberValues(IrFunction &function);
+    // Drop instructions without effect whose value isn't used
+    static void eliminateDeadCode(IrFunction &function);
+    // Append a block to its only predecessor when that one only jumps to it
+    static void mergeBlocks(IrFunction &function);
+
+  public:
+    static void optimize(IrProgram &program);
+    static void optimize(IrFunction &function);
+};
+
+#endif // IROPTIMIZER_HPP
@@ -0,0 +1,145 @@
+#ifndef JITCOMPILER_HPP
+#define JITCOMPILER_HPP
+
+#include "Expr.hpp"
+#include "Stmt.hpp"
+#include "X64Assembler.hpp"
+#include <cstdint>
+#include <memory>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+/*
+ * Native code of one Lox function, made by the JitCompiler. Lives in its own executable mapping.
+ */
+class JitCode
+{
+  public:
+    // What the native code returns: the value in xmm0 and a status in rax (0 on success, 1 to bail out)
+    struct Result
+    {
+        double value;
+        int64_t status;
+    };
+    using Entry = Result (*)(const double *args, int64_t *budget);
+
+    // Functions with more parameters are not compiled
+    static constexpr size_t MAX_PARAMS = 16;
+
+    JitCode(void *memory, size_t size, bool callsItself, size_t stackPerCall)
+        : memory(memory), size(size), callsItself(callsItself), stackPerCall(stackPerCall)
+    {
+    }
+    ~JitCode();
+    JitCode(const JitCode &) = delete;
+    JitCode &operator=(const JitCode &) = delete;
+
+    // Run with the given arguments, budget is how many more calls may be nested (see --max-depth). Returns false if
+    // the native code bailed out: the call has to be run by the interpreter instead.
+    bool run(const double *args, int64_t budget, double &result) const
+    {
+        Result returned = reinterpret_cast<Entry>(memory)(args, &budget);
+        result = returned.value;
+        return returned.status == 0;
+    }
+
+    // The body calls the function by its own name. The caller checks that name still is this function before running
+    // the code, which calls itself directly.
+    bool isRecursive() const
+    {
+        return callsItself;
+    }
+
+    // Native stack a call of the code takes, at most, so the caller can keep the budget within what is left
+    size_t nativeStackPerCall() const
+    {
+        return stackPerCall;
+    }
+
+  private:
+    void *memory;
+    size_t size;
+    bool callsItself;
+    size_t stackPerCall;
+};
+
+// What an expression compiled by the JitCompiler leaves in xmm0: a number, or a boolean as 1.0 / 0.0
+enum class JitType
+{
+    NUMBER,
+    BOOLEAN
+};
+
+/*
+ * Baseline JIT (--jit=on, x86-64 Linux only): translates the body of a hot function statement by statement into
+ * machine code, with a fixed template for each kind of node.
+ * Only functions that compute with numbers are compiled: their parameters and local variables are numbers kept
+ * unboxed in the native stack frame, and the only call they make is to themselves. They don't print or assign
+ * anything outside the function, so the native code has no side effects. Whenever it meets something it doesn't
+ * handle at run time (a runtime error, a call nested too deep, falling off the end of the body) it bails out and
+ * the interpreter runs the same call again from the start, which then gives the exact same output and errors.
+ */
+class JitCompiler final : public ExprVisitor<JitType>, public StmtVisitor<void>
+{
+    X64Assembler code;
+    const Function &function;
+
+    // Variables of each scope of the function with their frame slots, innermost last
+    std::vector<std::vector<std::pair<std::string_view, int>>> scopes;
+    int slotCount = 0;
+
+    // Values pushed on the native stack while evaluating an expression (calls keep the stack 16-byte aligned)
+    int pushed = 0;
+    int mostPushed = 0;
+
+    int entry;
+    int exit;
+    int bail;
+    std::vector<int> loopEnds;
+    bool callsItself = false;
+
+    explicit JitCompiler(const Function &function) : function(function)
+    {
+    }
+
+    static int32_t slotOffset(int slot);
+    int resolve(std::string_view name) const;
+    int declare(std::string_view name);
+
+    // Compile an expression into xmm0
+    JitType evaluate(const std::unique_ptr<Expr> &expr);
+    void evaluateNumber(const std::unique_ptr<Expr> &expr);
+    void execute(const std::unique_ptr<Stmt> &stmt);
+
+    std::unique_ptr<JitCode> finish();
+
+  public:
+    // Native code for the function, or nullptr if the function uses anything the JIT doesn't handle
+    static std::unique_ptr<JitCode> compile(const Function &declaration);
+
+    /* -------------------- EXPRESSIONS -------------------- */
+    JitType visitAssignExpr(const Assign &expr) override;
+    JitType visitBinaryExpr(const Binary &expr) override;
+    JitType visitCallExpr(const Call &expr) override;
+    JitType visitGroupingExpr(const Grouping &expr) override;
+    JitType visitLiteralExpr(const Literal &expr) override;
+    JitType visitLogicalExpr(const Logical &expr) override;
+    JitType visitUnaryExpr(const Unary &expr) override;
+    JitType visitVariableExpr(const Variable &expr) override;
+    /* ---------------------------------------------------- */
+
+    /* -------------------- STATEMENTS -------------------- */
+    void visitBlockStmt(const Block &stmt) override;
+    void visitBreakStmt(const Break &stmt) override;
+    void visitExpressionStmt(const Expression &stmt) override;
+    void visitFunctionStmt(const Function &stmt) override;
+    void visitIfStmt(const If &stmt) override;
+    void visitPrintStmt(const Print &stmt) override;
+    void visitReturnStmt(const Return &stmt) override;
+    void visitVarStmt(const Var &stmt) override;
+    void visitWhileStmt(const While &stmt) override;
+    /* ---------------------------------------------------- */
+};
+
+#endif // JITCOMPILER_HPP
@@ -0,0 +1,23 @@
+#ifndef LOOKUPCACHE_HPP
+#define LOOKUPCACHE_HPP
+
+#include "Value.hpp"
+#include <cstdint>
+
+/*
+ * Where a name was found the last time it was looked up from one place in the code (see Environment::lookup).
+ * The next lookup walks the same number of environments out, only checking that none of the ones it passes might
+ * define the name, and reuses the binding if it ends up in the same environment.
+ */
+struct LookupCache
+{
+    // Environment::nameBit of the name
+    uint64_t nameBit = 0;
+    // Environments walked out from the one the lookup started in
+    unsigned hops = 0;
+    // Environment::id of the environment the name was found in, 0 if nothing is cached
+    uint64_t found = 0;
+    Value *binding = nullptr;
+};
+
+#endif // LOOKUPCACHE_HPP
@@ -1,7 +1,10 @@
 #ifndef LOX_FUNCTION_HPP
 #define LOX_FUNCTION_HPP
 
+#include "JitCompiler.hpp"
 #include "Stmt.hpp"
+#include <string_view>
+#include <vector>
 
 class AstInterpreter;
 class Environment;
@@ -18,14 +21,31 @@ class LoxFunction
     std::unique_ptr<Function> declaration;
     std::shared_ptr<Environment> closure;
 
-    LoxFunction(std::unique_ptr<Function> &declaration, std::shared_ptr<Environment> &closure)
-        : declaration(std::move(declaration)), closure(closure)
-    {
-    }
+    // Parameter names, shared with the environment of every call so it can bind arguments by position
+    std::shared_ptr<const std::vector<std::string_view>> paramNames;
+    uint64_t paramBits = 0;
+
+    // Baseline JIT (--jit): the function is compiled once it has been called JIT_THRESHOLD times, and given up on
+    // once its native code has bailed out MAX_JIT_BAILS times.
+    static constexpr unsigned JIT_THRESHOLD = 50;
+    static constexpr unsigned MAX_JIT_BAILS = 8;
+    unsigned calls = 0;
+    unsigned jitBails = 0;
+    bool jitFailed = false;
+    std::unique_ptr<JitCode> jit;
+
+    LoxFunction(std::unique_ptr<Function> &declaration, std::shared_ptr<Environment> &closure);
+
+    // Environment for a call, the caller puts the arguments in its slots
+    std::shared_ptr<Environment> makeEnvironment() const;
+
+    // Call method to execute function that could return a value. funcEnv comes from makeEnvironment().
+    std::pair<std::shared_ptr<void>, TokenInfo::Type> call(AstInterpreter &interpreter,
+                                                           const std::shared_ptr<Environment> &funcEnv);
 
-    // Call method to execute function that could return a value
-    std::pair<std::shared_ptr<void>, TokenInfo::Type> call(
-        AstInterpreter &interpreter, const std::vector<std::pair<std::shared_ptr<void>, TokenInfo::Type>> &arguments);
+    // Run the call with the native code, if there is (or now is) any for the function and the arguments in funcEnv
+    // are all numbers. budget is how many more calls may be nested. Returns false if the interpreter has to run it.
+    bool runJit(Environment &funcEnv, int64_t budget, std::pair<std::shared_ptr<void>, TokenInfo::Type> &value);
 
     // Arity method to get the number of parameters the function has
     int arity() const
@@ -35,7 +55,7 @@ class LoxFunction
 
     std::string toString() const
     {
-        return "<fn " + declaration->name.getLexeme() + ">";
+        return "<fn " + std::string(declaration->name.getLexeme()) + ">";
     }
 };
 
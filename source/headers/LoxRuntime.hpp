@@ -0,0 +1,80 @@
+#ifndef LOXRUNTIME_HPP
+#define LOXRUNTIME_HPP
+
+#include "Environment.hpp"
+#include "LookupCache.hpp"
+#include "Operators.hpp"
+#include "RuntimeError.hpp"
+#include "Token.hpp"
+#include "Value.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+/*
+ * Runtime of the C++ programs written by the CppEmitter (--emit-cpp). A generated program includes this header and
+ * is linked with build/lib/libloxrt.a (make runtime), which holds this class together with the value, environment
+ * and operator code of the interpreter, so the program gives the same values and errors the interpreter does.
+ * Is not meant to be instantiated.
+ */
+class LoxRuntime
+{
+  public:
+    using Env = std::shared_ptr<Environment>;
+    using Params = std::shared_ptr<const std::vector<std::string_view>>;
+    // Runs a function body in the environment of a call
+    using Body = Value (*)(const Env &env);
+
+    // What a FUN value of a generated program points to
+    struct Function
+    {
+        Body body;
+        Env closure;
+        Params params;
+        uint64_t paramBits;
+    };
+
+    // Run program in a fresh global environment, on a thread with native stack for maxDepth nested calls. source is
+    // the script the program was generated from, tokens refer to it for their lexemes and lines. Returns the exit code
+    // the interpreter would return for the script.
+    static int main(const char *source, unsigned maxDepth, void (*program)(const Env &globals));
+
+    // Report a runtime error the way the interpreter does
+    static void report(const RuntimeError &error);
+
+    static Value nil()
+    {
+        return {nullptr, TokenInfo::Type::NIL};
+    }
+    static bool isTruthy(const Value &value)
+    {
+        return Operators::isTruthy(value.first, value.second);
+    }
+    static void print(const Value &value);
+
+    /* -------------------- VARIABLES -------------------- */
+    static Value get(const Env &env, const Token &name, LookupCache &cache);
+    static void assign(const Env &env, const Token &name, Value value);
+    static void define(const Env &env, const Token &name, Value value);
+    static void defineFunction(const Env &env, const Token &name, Body body, const Params &params);
+
+    /* -------------------- OPERATORS -------------------- */
+    static Value unary(const Token &op, const Value &right);
+    static Value binary(const Token &op, const Value &left, const Value &right);
+
+    /* -------------------- CALLS -------------------- */
+    // Environment for calling callee, the arguments go into its slots with argument()
+    static Env prepare(const Value &callee, const Token &paren);
+    static void argument(const Env &funcEnv, size_t i, Value value);
+    // Check the arity and depth, then run the body
+    static Value call(const Value &callee, const Env &funcEnv, size_t count, const Token &paren);
+
+  private:
+    static unsigned maxDepth;
+    static unsigned depth;
+    static bool hadRuntimeError;
+};
+
+#endif // LOXRUNTIME_HPP
@@ -2,23 +2,51 @@
 #define LOXPP_HPP
 
 #include "AstInterpreter.hpp"
+#include "ClosureInterpreter.hpp"
+#include "FlatInterpreter.hpp"
+#include "IrInterpreter.hpp"
+#include "Options.hpp"
 #include "RuntimeError.hpp"
+#include "ThreadPool.hpp"
 #include "Token.hpp"
+#include <functional>
 #include <string>
 
 class Loxpp
 {
     // Interpreter for the AST
     static AstInterpreter interpreter;
+    // Interpreter for the flat AST (--flat-ast)
+    static FlatInterpreter flatInterpreter;
+    // Interpreter for the program compiled into closures (--closures)
+    static ClosureInterpreter closureInterpreter;
+    // Interpreter for the SSA IR (--ir)
+    static IrInterpreter irInterpreter;
     // Keep track of errors
     static bool hadError;
     static bool hadRuntimeError;
+    // Set on threads that parse speculatively (see ParallelParser): errors are only counted here, not reported.
+    static thread_local unsigned *suppressedErrors;
+
+    // Workers for the parallel front end options
+    static ThreadPool &threadPool();
+
+    // Native stack the interpreters need besides their calls, and per nested Lox call (generous, a call nests a
+    // dozen or more C++ frames and more for every block or expression nested in the function body).
+    static constexpr size_t BASE_STACK = 8 * 1024 * 1024;
+    static constexpr size_t CALL_STACK = 16 * 1024;
 
   public:
+    static Options options;
+
     /* Run the source code
      * Used by runPrompt() and runFile() */
     static void run(const std::string &source);
 
+    /* Run body on a thread with enough native stack for --max-depth nested calls and return what it returns.
+     * Reports the error and returns 71 if such a thread can't be started. */
+    static int runWithStack(const std::function<int()> &body);
+
     /* Run interactive session, like a shell */
     static void runPrompt();
     /* Read source code from a file and run it
@@ -30,6 +58,12 @@ class Loxpp
     static void error(const Token &token, const std::string &message);
     static void error(int line, const std::string &message);
     static void report(int line, const std::string &where, const std::string &message);
+
+    // Count instead of report errors on this thread while counter is set (nullptr to stop).
+    static void suppressErrors(unsigned *counter)
+    {
+        suppressedErrors = counter;
+    }
 };
 
 #endif // LOXPP_HPP
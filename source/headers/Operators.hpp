@@ -0,0 +1,35 @@
+#ifndef OPERATORS_HPP
+#define OPERATORS_HPP
+
+#include "Value.hpp"
+#include <string>
+
+/*
+ * Semantics of Lox++ operators and values, shared by every execution engine so they all agree on what e.g. "1" + 2
+ * or !0 evaluates to.
+ * Is not meant to be instantiated.
+ */
+class Operators
+{
+  public:
+    // Only nil, false, 0 and "" are falsy.
+    static bool isTruthy(const std::shared_ptr<void> &value, TokenInfo::Type type);
+    static bool isEqual(const std::shared_ptr<void> &left, const std::shared_ptr<void> &right,
+                        TokenInfo::Type leftType, TokenInfo::Type rightType);
+
+    // Text printed by the print statement.
+    static std::string stringify(const std::shared_ptr<void> &value, TokenInfo::Type type);
+
+    // Box a bool into a TRUE / FALSE value.
+    static Value boolean(bool value);
+
+    /*
+     * Apply a binary or unary operator to already evaluated operands and store the outcome in result.
+     * Returns nullptr on success, or the runtime error message (e.g. "Division by zero.") if the operands are not
+     * valid for the operator. The caller throws the RuntimeError since only it knows the operator token.
+     */
+    static const char *binary(TokenInfo::Type op, const Value &left, const Value &right, Value &result);
+    static const char *unary(TokenInfo::Type op, const Value &right, Value &result);
+};
+
+#endif // OPERATORS_HPP
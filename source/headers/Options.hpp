@@ -0,0 +1,61 @@
+#ifndef OPTIONS_HPP
+#define OPTIONS_HPP
+
+#include <string>
+
+/*
+ * Command line options, parsed in run.cpp.
+ */
+struct Options
+{
+    // --flat-ast: lower the parsed program to a FlatAst and run it with the FlatInterpreter.
+    bool flatAst = false;
+    // --closures: compile the parsed program into closures and run them with the ClosureInterpreter.
+    bool closures = false;
+    // --ast-optimize=on|off: fold constants and drop dead code before the AstInterpreter runs (see AstOptimizer).
+    bool astOptimize = true;
+    // --inline-budget=N: the AstOptimizer inlines calls of global functions whose body returns an expression of at
+    // most N nodes, 0 to inline nothing, at most MAX_INLINE_BUDGET.
+    static constexpr unsigned MAX_INLINE_BUDGET = 1000;
+    unsigned inlineBudget = 16;
+    // --inline-report: print every call the AstOptimizer inlined.
+    bool inlineReport = false;
+    // --jit=on|off: compile hot numeric functions of the AstInterpreter to machine code (see JitCompiler).
+    bool jit = true;
+    // --ir: lower the parsed program to the SSA IR and run it with the IrInterpreter.
+    bool ir = false;
+    // --ir-optimize=on|off: run the IrOptimizer passes on the IR before running it.
+    bool irOptimize = true;
+    // --dump-ir: print the IR instead of running it. Implies --ir.
+    bool dumpIr = false;
+    // --traces=on|off: run hot while loops of the AstInterpreter as recorded traces (see LoopTrace).
+    bool traces = true;
+    // --emit-cpp=FILE (or --emit-cpp FILE): write the script as a C++ program to FILE instead of running it (see
+    // CppEmitter).
+    std::string emitCpp;
+    // --parallel-scan: scan the source in chunks on a thread pool (see ParallelScanner).
+    bool parallelScan = false;
+    // --parallel-parse: parse runs of top-level declarations on the thread pool (see ParallelParser).
+    bool parallelParse = false;
+    // --lazy-parse: check function bodies with the PreParser and only parse them when first called.
+    bool lazyParse = false;
+    // --cache-dir=DIR: keep lowered programs in DIR and reuse them when the same script runs again (see FlatCache).
+    // Implies --flat-ast.
+    std::string cacheDir;
+    // --snapshot-out=FILE: after running the script, save the interpreter state to FILE (see FlatSnapshot).
+    // --snapshot-in=FILE: restore the state saved in FILE before running the script. Both imply --flat-ast.
+    std::string snapshotOut;
+    std::string snapshotIn;
+    // --tail-calls=on|off: run return f(x); in a function of the AstInterpreter as a tail call, reusing the frame of
+    // the function returning (see LoxFunction::call).
+    bool tailCalls = true;
+    // --max-depth=N: how many Lox calls can be nested before a call fails with "Stack overflow.", at most
+    // MAX_DEPTH_LIMIT (the interpreter's thread gets native stack for that many, see Loxpp::runWithStack).
+    static constexpr unsigned MAX_DEPTH_LIMIT = 100000;
+    unsigned maxDepth = 10000;
+    // --threads=N: size of the thread pool, 0 for one thread per core, at most MAX_THREADS.
+    static constexpr unsigned MAX_THREADS = 256;
+    unsigned threads = 0;
+};
+
+#endif // OPTIONS_HPP
@@ -0,0 +1,30 @@
+#ifndef PARALLELPARSER_HPP
+#define PARALLELPARSER_HPP
+
+#include "Stmt.hpp"
+#include "ThreadPool.hpp"
+#include "Token.hpp"
+#include <memory>
+#include <vector>
+
+/*
+ * Parses runs of top-level declarations on a ThreadPool (--parallel-parse).
+ * A quick pass over the tokens finds where top-level declarations start: a "fun" or "var" outside any braces or
+ * parentheses, right after a ';' or '}'. The tokens are cut into ranges there and every range is parsed by its own
+ * Parser at the same time, with errors counted instead of reported. A range that parses without errors gives exactly
+ * the statements the sequential parser would. From the first range with an error on, the tokens are parsed again
+ * sequentially so that the errors (and the recovery after them) are reported as usual, in source order.
+ * Is not meant to be instantiated.
+ */
+class ParallelParser
+{
+    // Ranges smaller than this (in tokens) are not worth a task.
+    static constexpr size_t MIN_RANGE = 16 * 1024;
+
+  public:
+    // lazyTokens is set (to the same tokens) in lazy mode, see Parser.
+    static std::vector<std::unique_ptr<Stmt>> parse(const std::vector<Token> &tokens, ThreadPool &pool,
+                                                    std::shared_ptr<const std::vector<Token>> lazyTokens = nullptr);
+};
+
+#endif // PARALLELPARSER_HPP
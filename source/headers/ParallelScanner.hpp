@@ -0,0 +1,28 @@
+#ifndef PARALLELSCANNER_HPP
+#define PARALLELSCANNER_HPP
+
+#include "Scanner.hpp"
+#include "ThreadPool.hpp"
+#include <string>
+#include <vector>
+
+/*
+ * Scans a large source on a ThreadPool (--parallel-scan).
+ * The source is split into chunks at newlines and every chunk is scanned at the same time on the guess that it starts
+ * in normal code. The chunks are then stitched together in order: a chunk that really starts inside a string or
+ * comment left open by the one before it is scanned again from that state. Errors are held back until their chunk is
+ * stitched, so the tokens and error messages are exactly those of Scanner::scanTokens. Line numbers come from Source,
+ * which already has the line table of the whole source.
+ * Is not meant to be instantiated.
+ */
+class ParallelScanner
+{
+    // Sources smaller than this are not worth splitting.
+    static constexpr size_t MIN_CHUNK = 64 * 1024;
+
+  public:
+    // Scan the source added to Source at base.
+    static std::vector<Token> scanTokens(uint32_t base, ThreadPool &pool);
+};
+
+#endif // PARALLELSCANNER_HPP
@@ -4,6 +4,8 @@
 #include "Expr.hpp"
 #include "Stmt.hpp"
 #include "Token.hpp"
+#include <memory>
+#include <vector>
 
 /* Grammar:
  *
@@ -49,14 +51,20 @@
 class Parser
 {
 
-    const std::vector<Token> tokens;
+    const std::vector<Token> &tokens;
     int current = 0;
+    // Index of the token parsing stops at: the END_OF_FILE token, or the end of the range given to the constructor.
+    int end;
+    // Set in lazy mode (--lazy-parse): the same tokens, shared with the function bodies left for later.
+    std::shared_ptr<const std::vector<Token>> lazyTokens;
     int loopDepth = 0; // Track nested loops for break statements.
 
     /* Match current token with any given types. If true, consume (move to next token) and return true. Otherwise,
      * return false.
+     * The sets are built at compile time (see the operator sets in Parser.cpp) so matching never allocates.
      */
-    bool match(const std::vector<TokenInfo::Type> &types);
+    bool match(TokenSet types);
+    bool match(TokenInfo::Type type);
     /* Check if the current token is of the given type.
      * Does not consume, only looks at it.
      */
@@ -64,31 +72,24 @@ class Parser
     /* Check if next token is EOF (end of source code) */
     bool isAtEnd() const;
     /* Consumes the current token and returns it */
-    Token advance();
+    const Token &advance();
     /* Returns the current token without consuming it */
-    Token peek() const;
+    const Token &peek() const;
     /* Returns the previous token (current - 1) */
-    Token previous() const;
+    const Token &previous() const;
 
-    Token consume(TokenInfo::Type type, const std::string &message);
-
-    std::unique_ptr<Expr> finishCall(std::unique_ptr<Expr> &callee);
+    // Consume the current token if it is of the given type, otherwise report message and throw a ParserError.
+    // The message is only turned into a std::string on error.
+    const Token &consume(TokenInfo::Type type, const char *message);
+    const Token &consume(TokenInfo::Type type, const std::string &message);
 
     /*
      * Expression parsing.
-     * Consume tokens to form AST nodes of expressions.
+     * Consume tokens to form AST nodes of expressions. expression() handles every rule from assignment down to call
+     * with a precedence table and explicit stacks (see Parser.cpp), calling primary() for the operands.
      */
 
     std::unique_ptr<Expr> expression();
-    std::unique_ptr<Expr> assignment();
-    std::unique_ptr<Expr> logicalOr();
-    std::unique_ptr<Expr> logicalAnd();
-    std::unique_ptr<Expr> equality();
-    std::unique_ptr<Expr> comparison();
-    std::unique_ptr<Expr> term();
-    std::unique_ptr<Expr> factor();
-    std::unique_ptr<Expr> unary();
-    std::unique_ptr<Expr> call();
     std::unique_ptr<Expr> primary();
 
     // Syncronize the parser after an error
@@ -113,8 +114,20 @@ class Parser
     std::unique_ptr<Stmt> expressionStatement();
 
   public:
-    // Constructor. Takes (a reference to but does not modify) a vector of tokens to parse.
-    Parser(const std::vector<Token> &tokens) : tokens(tokens)
+    // Constructor. Takes (a reference to but does not modify) a vector of tokens to parse. The tokens must outlive the
+    // parser.
+    Parser(const std::vector<Token> &tokens) : tokens(tokens), end(static_cast<int>(tokens.size()) - 1)
+    {
+    }
+
+    // Parse only the tokens in [begin, end), which must be a run of whole declarations (see ParallelParser).
+    Parser(const std::vector<Token> &tokens, int begin, int end) : tokens(tokens), current(begin), end(end)
+    {
+    }
+
+    // Lazy mode: function bodies that the PreParser finds valid are only parsed when first called (see LazyBody).
+    Parser(std::shared_ptr<const std::vector<Token>> tokens, int begin, int end, int loopDepth = 0)
+        : tokens(*tokens), current(begin), end(end), lazyTokens(std::move(tokens)), loopDepth(loopDepth)
     {
     }
 
@@ -0,0 +1,44 @@
+#ifndef PARSERTABLES_HPP
+#define PARSERTABLES_HPP
+
+#include "TokenInfo.hpp"
+#include <array>
+#include <cstdint>
+
+/*
+ * Token tables for the expression grammar, shared by the Parser and the PreParser so the two always agree on it.
+ */
+
+// Prefix operators and literal tokens
+static constexpr TokenSet UNARY_OPS = {TokenInfo::Type::BANG, TokenInfo::Type::MINUS};
+static constexpr TokenSet LITERALS = {TokenInfo::Type::NUMBER, TokenInfo::Type::STRING};
+
+// Binding power of the infix operators, lowest to highest, following the grammar rules in Parser.hpp
+enum class Precedence : uint8_t
+{
+    NONE,
+    ASSIGNMENT,
+    OR,
+    AND,
+    EQUALITY,
+    COMPARISON,
+    TERM,
+    FACTOR,
+    UNARY
+};
+
+// Precedence of every token type when it follows an operand. NONE means the token ends the expression.
+static constexpr std::array<Precedence, TokenInfo::Type::END_OF_FILE + 1> INFIX_PRECEDENCE = [] {
+    std::array<Precedence, TokenInfo::Type::END_OF_FILE + 1> table{};
+    table[TokenInfo::Type::EQUAL] = Precedence::ASSIGNMENT;
+    table[TokenInfo::Type::OR] = Precedence::OR;
+    table[TokenInfo::Type::AND] = Precedence::AND;
+    table[TokenInfo::Type::BANG_EQUAL] = table[TokenInfo::Type::EQUAL_EQUAL] = Precedence::EQUALITY;
+    table[TokenInfo::Type::GREATER] = table[TokenInfo::Type::GREATER_EQUAL] = Precedence::COMPARISON;
+    table[TokenInfo::Type::LESS] = table[TokenInfo::Type::LESS_EQUAL] = Precedence::COMPARISON;
+    table[TokenInfo::Type::MINUS] = table[TokenInfo::Type::PLUS] = Precedence::TERM;
+    table[TokenInfo::Type::SLASH] = table[TokenInfo::Type::STAR] = Precedence::FACTOR;
+    return table;
+}();
+
+#endif // PARSERTABLES_HPP
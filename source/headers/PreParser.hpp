@@ -0,0 +1,72 @@
+#ifndef PREPARSER_HPP
+#define PREPARSER_HPP
+
+#include "Token.hpp"
+#include <vector>
+
+/*
+ * Cheap check of a function body for --lazy-parse. Walks the same grammar as the Parser (see Parser.hpp) but builds
+ * no nodes and reports nothing: it only finds out whether the Parser would get through the body without a single
+ * error, and where the body ends. Bodies that pass are parsed on their first call, the others are parsed right away
+ * so their errors are reported exactly as before.
+ */
+class PreParser
+{
+    // Thrown at the first thing the Parser would report.
+    struct Invalid
+    {
+    };
+
+    const std::vector<Token> &tokens;
+    int current;
+    int end;
+    int loopDepth;
+
+    bool isAtEnd() const
+    {
+        return current >= end;
+    }
+    bool check(TokenInfo::Type type) const
+    {
+        return !isAtEnd() && tokens[current].getType() == type;
+    }
+    bool match(TokenInfo::Type type)
+    {
+        if (!check(type))
+            return false;
+        current++;
+        return true;
+    }
+    bool match(TokenSet types)
+    {
+        if (isAtEnd() || !types.contains(tokens[current].getType()))
+            return false;
+        current++;
+        return true;
+    }
+    void consume(TokenInfo::Type type)
+    {
+        if (!match(type))
+            throw Invalid();
+    }
+
+    void declaration();
+    void function();
+    void varDeclaration();
+    void statement();
+    void block();
+    void expression();
+
+  public:
+    // Same range and loop depth as the Parser that meets the body.
+    PreParser(const std::vector<Token> &tokens, int begin, int end, int loopDepth)
+        : tokens(tokens), current(begin), end(end), loopDepth(loopDepth)
+    {
+    }
+
+    // Check the body of a function, starting just after its '{'. Returns the index of the closing '}' if the body
+    // parses without errors, -1 otherwise.
+    int skipBody();
+};
+
+#endif // PREPARSER_HPP
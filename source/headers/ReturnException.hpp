@@ -5,6 +5,8 @@
 #include <memory>
 #include <stdexcept>
 
+class Environment;
+class LoxFunction;
 
 class ReturnException : public std::runtime_error
 {
@@ -14,8 +16,18 @@ class ReturnException : public std::runtime_error
     {
     }
 
+    // A tail call (return f(x); in a function) doesn't return a value, it hands the function and its environment,
+    // arguments in place, to LoxFunction::call, which runs it instead of the function returning
+    ReturnException(std::shared_ptr<LoxFunction> &callee, std::shared_ptr<Environment> &environment)
+        : std::runtime_error("Return statement"), type(TokenInfo::Type::NIL), tailCallee(callee),
+          tailEnvironment(environment)
+    {
+    }
+
     std::shared_ptr<void> value;
     TokenInfo::Type type;
+    std::shared_ptr<LoxFunction> tailCallee;
+    std::shared_ptr<Environment> tailEnvironment;
 };
 
 #endif // !RETURN_HPP
@@ -0,0 +1,28 @@
+#ifndef SCANKERNELS_HPP
+#define SCANKERNELS_HPP
+
+#include <cstddef>
+
+/*
+ * Block-at-a-time helpers for the Scanner's inner loops (whitespace, comments, strings, identifiers and numbers).
+ * Each one starts at text[pos] and returns the position of the first character that stops it, or end if there is
+ * none. They look at 32 bytes per step when built with AVX2 (e.g. make OPTFLAGS="-O2 -mavx2"), 16 with SSE2 (always
+ * available on x86-64) and fall back to a plain loop elsewhere and for the last few bytes.
+ * Is not meant to be instantiated.
+ */
+class ScanKernels
+{
+  public:
+    // Past ' ', '\r', '\t' and '\n'.
+    static size_t skipWhitespace(const char *text, size_t pos, size_t end);
+    // Past letters, digits and '_'.
+    static size_t skipIdentifier(const char *text, size_t pos, size_t end);
+    // Past '0' to '9'.
+    static size_t skipDigits(const char *text, size_t pos, size_t end);
+    // To the next c (a closing '"', or the '\n' ending a line comment).
+    static size_t find(const char *text, size_t pos, size_t end, char c);
+    // To the next "*/" or "/*" inside a multi-line comment.
+    static size_t findCommentDelimiter(const char *text, size_t pos, size_t end);
+};
+
+#endif // SCANKERNELS_HPP
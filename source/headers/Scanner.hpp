@@ -1,25 +1,56 @@
 #ifndef SCANNER_HPP
 #define SCANNER_HPP
 
+#include "Source.hpp"
 #include "Token.hpp"
+#include <string>
+#include <utility>
+#include <vector>
 
 class Scanner
 {
 
-    // The source code string
-    const std::string source;
+    // Global offset of the source code in Source. Token offsets are base + their position in source.
+    const uint32_t base;
+    // The source code string (owned by Source)
+    const std::string &source;
 
     // Collection of tokens from the source code.
     std::vector<Token> tokens;
 
+  public:
+    /*
+     * What a chunk of source ends in when the source is scanned in pieces (see ParallelScanner): normal code, or a
+     * string literal / multi-line comment that carries on in the next chunk.
+     */
+    struct ChunkState
+    {
+        enum Kind
+        {
+            NORMAL,
+            STRING,
+            COMMENT
+        } kind = NORMAL;
+        // STRING: position of the opening quote in source
+        uint32_t start = 0;
+        // COMMENT: how many comments are open
+        int nesting = 0;
+    };
+
+  private:
+    // End of what is being scanned: source.length(), or the end of the chunk.
+    uint32_t limit = 0;
+    // State at limit if a string or comment was cut off by the end of the chunk.
+    ChunkState pending;
+    // When set, errors are collected here with their global offset instead of being reported.
+    std::vector<std::pair<uint32_t, std::string>> *deferredErrors = nullptr;
+
     // Pointers to keep track of where we are in the source code.
 
     // Pointer to track beginning of lexeme being scanned.
-    int start = 0;
+    uint32_t start = 0;
     // Pointer to track current character being scanned.
-    int current = 0;
-    // Pointer to track current line number, useful for telling user error location
-    int line = 1;
+    uint32_t current = 0;
     /*
      * To recognize lexemes and convert them into tokens.
      */
@@ -43,10 +74,9 @@ class Scanner
      */
     void addToken(TokenInfo::Type type);
     /*
-     * Add token to vector of tokens. To be used when token has a literal value.
-     * For output.
+     * Report an error at the current position. Line numbers come from Source.
      */
-    void addToken(TokenInfo::Type type, std::shared_ptr<void> &literal);
+    void error(const std::string &message);
 
     /*
      * Check if next char matches expected char.
@@ -69,10 +99,13 @@ class Scanner
     /*
      * Recognize string literals. Similar to how characters in a comment are continuously being consumed without being
      * saved anywhere to reach end of comment.
+     * The long runs (string bodies, comments, whitespace, identifier and number characters) are skipped with
+     * ScanKernels, a block of characters at a time.
      */
     void string();
 
-    void multiLineComment();
+    // Skip a multi-line comment, nesting is the number of comments open at current.
+    void multiLineComment(int nesting = 1);
 
     /*
      * Recognize numbers. Similar to string and comment.
@@ -85,11 +118,16 @@ class Scanner
     void identifier();
     // Letters or underscores
     bool isAlpha(char c);
-    // Letters, underscores, or digits
-    bool isAlphaNumeric(char c);
 
   public:
-    Scanner(const std::string &source) : source(source)
+    // Adds the source code to Source and prepares to scan it.
+    Scanner(const std::string &source) : base(Source::add(source)), source(Source::text(base))
+    {
+    }
+
+    // Scan (part of) a source that was already added to Source at base.
+    Scanner(uint32_t base, std::vector<std::pair<uint32_t, std::string>> *deferredErrors = nullptr)
+        : base(base), source(Source::text(base)), deferredErrors(deferredErrors)
     {
     }
 
@@ -97,6 +135,16 @@ class Scanner
      * Scan source code char-by-char and return a vector of tokens.
      */
     std::vector<Token> &scanTokens();
+
+    /*
+     * Scan source[begin, end) into tokens, starting in the given state, and return the state at end. end has to be
+     * just after a newline (no other token can be cut in two there) or the end of the source.
+     */
+    ChunkState scanChunk(uint32_t begin, uint32_t end, ChunkState entry);
+    std::vector<Token> &getTokens()
+    {
+        return tokens;
+    }
 };
 
 #endif // !SCANNER_HPP
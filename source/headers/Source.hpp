@@ -0,0 +1,54 @@
+#ifndef SOURCE_HPP
+#define SOURCE_HPP
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+/*
+ * All source code seen by this run of Lox++ (the script file, or every line typed in the REPL).
+ * Sources are appended, never removed or moved, so tokens can refer to their text with a global offset and AST nodes
+ * built from one REPL line stay valid while later lines run.
+ * Is not meant to be instantiated.
+ */
+class Source
+{
+    // One chunk per added source. Chunks never reallocate, so views into them stay valid.
+    static std::vector<std::unique_ptr<std::string>> chunks;
+    // Global offset of the first character of every chunk.
+    static std::vector<uint32_t> chunkStarts;
+    // Total number of characters added so far (the offset the next chunk starts at).
+    static uint32_t size;
+
+    // (offset, line) pairs sorted by offset. An offset is on the line of the last entry at or before it.
+    static std::vector<std::pair<uint32_t, int>> lines;
+
+    static uint32_t append(const std::string &text);
+
+    // The chunk containing a global offset and the offset its first character has.
+    static const std::string &chunkAt(uint32_t offset, uint32_t &chunkStart);
+
+    // Saves and restores all sources with the interpreter state
+    friend class FlatSnapshot;
+
+  public:
+    // Add a script or REPL line. Its first line is line 1. Returns the global offset of its first character.
+    static uint32_t add(const std::string &source);
+
+    // Add text that is not part of any source, e.g. a name made up by a compiler pass. All of it is reported as being
+    // on the given line.
+    static uint32_t addSynthetic(const std::string &text, int line);
+
+    // The text of a source added at the given offset.
+    static const std::string &text(uint32_t start);
+
+    static std::string_view view(uint32_t offset, uint32_t length);
+
+    // Line number of the character at a global offset.
+    static int lineAt(uint32_t offset);
+};
+
+#endif // SOURCE_HPP
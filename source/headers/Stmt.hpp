@@ -4,37 +4,20 @@
 #include "Expr.hpp"
 #include "Token.hpp"
 #include <memory>
+#include <vector>
 
-class If;
-class While;
-class Block;
-class Break;
-class Expression;
-class Print;
-class Var;
-class Function;
-class Return;
-
-class StmtVisitor
-
-{
-  public:
-    virtual void visitIfStmt(const If &Stmt) = 0;
-    virtual void visitWhileStmt(const While &Stmt) = 0;
-    virtual void visitBlockStmt(const Block &Stmt) = 0;
-    virtual void visitBreakStmt(const Break &Stmt) = 0;
-    virtual void visitExpressionStmt(const Expression &Stmt) = 0;
-    virtual void visitPrintStmt(const Print &Stmt) = 0;
-    virtual void visitVarStmt(const Var &Stmt) = 0;
-    virtual void visitFunctionStmt(const Function &Stmt) = 0;
-    virtual void visitReturnStmt(const Return &Stmt) = 0;
-};
+class LoopTrace;
 
 class Stmt
 {
   public:
+    const StmtKind kind;
+
+    explicit Stmt(StmtKind kind) : kind(kind)
+    {
+    }
     virtual ~Stmt() = default;
-    virtual void accept(StmtVisitor &visitor) = 0;
+    template <typename Visitor> typename Visitor::StmtResult accept(Visitor &visitor) const;
     virtual std::unique_ptr<Stmt> clone() const = 0;
 };
 
@@ -44,17 +27,14 @@ class Return : public Stmt
     Token keyword;
     std::unique_ptr<Expr> value; // can be nullptr
 
-    Return(Token keyword, std::unique_ptr<Expr> &value) : keyword(keyword), value(std::move(value))
-    {
-    }
-
-    Return(Token keyword, std::unique_ptr<Expr> &&value) : keyword(keyword), value(std::move(value))
+    Return(Token keyword, std::unique_ptr<Expr> &value)
+        : Stmt(StmtKind::Return), keyword(keyword), value(std::move(value))
     {
     }
 
-    void accept(StmtVisitor &visitor) override
+    Return(Token keyword, std::unique_ptr<Expr> &&value)
+        : Stmt(StmtKind::Return), keyword(keyword), value(std::move(value))
     {
-        visitor.visitReturnStmt(*this);
     }
 
     std::unique_ptr<Stmt> clone() const override
@@ -71,20 +51,17 @@ class If : public Stmt
     std::unique_ptr<Stmt> elseBranch; // can be nullptr
 
     If(std::unique_ptr<Expr> &condition, std::unique_ptr<Stmt> &thenBranch, std::unique_ptr<Stmt> &elseBranch)
-        : condition(std::move(condition)), thenBranch(std::move(thenBranch)), elseBranch(std::move(elseBranch))
+        : Stmt(StmtKind::If), condition(std::move(condition)), thenBranch(std::move(thenBranch)),
+          elseBranch(std::move(elseBranch))
     {
     }
 
     If(std::unique_ptr<Expr> &&condition, std::unique_ptr<Stmt> &&thenBranch, std::unique_ptr<Stmt> &&elseBranch)
-        : condition(std::move(condition)), thenBranch(std::move(thenBranch)), elseBranch(std::move(elseBranch))
+        : Stmt(StmtKind::If), condition(std::move(condition)), thenBranch(std::move(thenBranch)),
+          elseBranch(std::move(elseBranch))
     {
     }
 
-    void accept(StmtVisitor &visitor) override
-    {
-        visitor.visitIfStmt(*this);
-    }
-
     std::unique_ptr<Stmt> clone() const override
     {
         return std::make_unique<If>(condition->clone(), thenBranch->clone(),
@@ -94,10 +71,8 @@ class If : public Stmt
 class Break : public Stmt
 {
   public:
-    // No ctor because no params
-    void accept(StmtVisitor &visitor) override
+    Break() : Stmt(StmtKind::Break)
     {
-        visitor.visitBreakStmt(*this);
     }
 
     std::unique_ptr<Stmt> clone() const override
@@ -111,23 +86,28 @@ class While : public Stmt
     std::unique_ptr<Expr> condition;
     std::unique_ptr<Stmt> body;
 
+    // How often the AstInterpreter ran the loop and its trace once it is hot (see LoopTrace). Not cloned.
+    mutable std::shared_ptr<LoopTrace> trace;
+
+    // Temporaries of the loop-invariant expressions the AstOptimizer hoisted (see Grouping::Temporary::REUSE). The
+    // AstInterpreter makes them uninitialized every time the loop starts, so they are computed once per run of it.
+    std::vector<Token> temporaries;
+
     While(std::unique_ptr<Expr> &condition, std::unique_ptr<Stmt> &body)
-        : condition(std::move(condition)), body(std::move(body))
+        : Stmt(StmtKind::While), condition(std::move(condition)), body(std::move(body))
     {
     }
 
     While(std::unique_ptr<Expr> &&condition, std::unique_ptr<Stmt> &&body)
-        : condition(std::move(condition)), body(std::move(body))
-    {
-    }
-    void accept(StmtVisitor &visitor) override
+        : Stmt(StmtKind::While), condition(std::move(condition)), body(std::move(body))
     {
-        visitor.visitWhileStmt(*this);
     }
 
     std::unique_ptr<Stmt> clone() const override
     {
-        return std::make_unique<While>(condition->clone(), body->clone());
+        auto cloned = std::make_unique<While>(condition->clone(), body->clone());
+        cloned->temporaries = temporaries;
+        return cloned;
     }
 };
 class Block : public Stmt
@@ -135,15 +115,11 @@ class Block : public Stmt
   public:
     std::vector<std::unique_ptr<Stmt>> statements;
 
-    Block(std::vector<std::unique_ptr<Stmt>> &statements) : statements(std::move(statements))
-    {
-    }
-    Block(std::vector<std::unique_ptr<Stmt>> &&statements) : statements(std::move(statements))
+    Block(std::vector<std::unique_ptr<Stmt>> &statements) : Stmt(StmtKind::Block), statements(std::move(statements))
     {
     }
-    void accept(StmtVisitor &visitor) override
+    Block(std::vector<std::unique_ptr<Stmt>> &&statements) : Stmt(StmtKind::Block), statements(std::move(statements))
     {
-        visitor.visitBlockStmt(*this);
     }
 
     std::unique_ptr<Stmt> clone() const override
@@ -161,17 +137,13 @@ class Expression : public Stmt
   public:
     std::unique_ptr<Expr> expression;
 
-    Expression(std::unique_ptr<Expr> &expression) : expression(std::move(expression))
+    Expression(std::unique_ptr<Expr> &expression) : Stmt(StmtKind::Expression), expression(std::move(expression))
     {
     }
 
-    Expression(std::unique_ptr<Expr> &&expression) : expression(std::move(expression))
+    Expression(std::unique_ptr<Expr> &&expression) : Stmt(StmtKind::Expression), expression(std::move(expression))
     {
     }
-    void accept(StmtVisitor &visitor) override
-    {
-        visitor.visitExpressionStmt(*this);
-    }
 
     std::unique_ptr<Stmt> clone() const override
     {
@@ -183,17 +155,13 @@ class Print : public Stmt
   public:
     std::unique_ptr<Expr> expression;
 
-    Print(std::unique_ptr<Expr> &expression) : expression(std::move(expression))
+    Print(std::unique_ptr<Expr> &expression) : Stmt(StmtKind::Print), expression(std::move(expression))
     {
     }
 
-    Print(std::unique_ptr<Expr> &&expression) : expression(std::move(expression))
+    Print(std::unique_ptr<Expr> &&expression) : Stmt(StmtKind::Print), expression(std::move(expression))
     {
     }
-    void accept(StmtVisitor &visitor) override
-    {
-        visitor.visitPrintStmt(*this);
-    }
 
     std::unique_ptr<Stmt> clone() const override
     {
@@ -206,43 +174,81 @@ class Var : public Stmt
     Token name;
     std::unique_ptr<Expr> initializer;
 
-    Var(Token name, std::unique_ptr<Expr> &initializer) : name(name), initializer(std::move(initializer))
+    Var(Token name, std::unique_ptr<Expr> &initializer)
+        : Stmt(StmtKind::Var), name(name), initializer(std::move(initializer))
     {
     }
 
-    Var(Token name, std::unique_ptr<Expr> &&initializer) : name(name), initializer(std::move(initializer))
+    Var(Token name, std::unique_ptr<Expr> &&initializer)
+        : Stmt(StmtKind::Var), name(name), initializer(std::move(initializer))
     {
     }
-    void accept(StmtVisitor &visitor) override
+
+    std::unique_ptr<Stmt> clone() const override
     {
-        visitor.visitVarStmt(*this);
+        return std::make_unique<Var>(name, initializer == nullptr ? nullptr : initializer->clone());
     }
+};
+/*
+ * Body of a function whose parsing is put off until it is first called (--lazy-parse). The PreParser has already
+ * checked that it parses without errors. Shared by every clone of the Function node, so it is parsed at most once.
+ */
+class LazyBody
+{
+    // Kept alive until the body is parsed, then released.
+    std::shared_ptr<const std::vector<Token>> tokens;
+    // The tokens between the braces: begin is just after '{', end is the '}'.
+    int begin;
+    int end;
+    // Loops around the declaration, so a break in the body is checked like it would be when parsed right away.
+    int loopDepth;
+    std::vector<std::unique_ptr<Stmt>> statements;
 
-    std::unique_ptr<Stmt> clone() const override
+  public:
+    LazyBody(std::shared_ptr<const std::vector<Token>> tokens, int begin, int end, int loopDepth)
+        : tokens(std::move(tokens)), begin(begin), end(end), loopDepth(loopDepth)
     {
-        return std::make_unique<Var>(name, initializer->clone());
     }
+
+    // The statements of the body, parsed the first time they are asked for (see Parser.cpp).
+    const std::vector<std::unique_ptr<Stmt>> &get();
 };
+
 class Function : public Stmt
 {
   public:
     Token name;                              // Name of the function
     std::vector<Token> params;               // Parameters (names)
     std::vector<std::unique_ptr<Stmt>> body; // Body of the function
+    std::shared_ptr<LazyBody> lazyBody;      // Set instead of body when the body is parsed on first call
+
+    // Set by the AstOptimizer on a function declared in a global one that doesn't need a closure of its own: it uses
+    // none of the enclosing function's variables, or only ones it now gets as extra parameters. The AstInterpreter
+    // makes its LoxFunction the first time the declaration runs and reuses it every time after. bindsName is false
+    // when every use of the name is a call finding the function without it (Call::liftedFunction), then running the
+    // declaration does nothing else.
+    bool lifted = false;
+    bool bindsName = true;
 
     Function(Token name, std::vector<Token> &params, std::vector<std::unique_ptr<Stmt>> &body)
-        : name(name), params(std::move(params)), body(std::move(body))
+        : Stmt(StmtKind::Function), name(name), params(std::move(params)), body(std::move(body))
     {
     }
 
     Function(Token name, std::vector<Token> &&params, std::vector<std::unique_ptr<Stmt>> &&body)
-        : name(name), params(std::move(params)), body(std::move(body))
+        : Stmt(StmtKind::Function), name(name), params(std::move(params)), body(std::move(body))
+    {
+    }
+
+    Function(Token name, std::vector<Token> &params, std::shared_ptr<LazyBody> lazyBody)
+        : Stmt(StmtKind::Function), name(name), params(std::move(params)), lazyBody(std::move(lazyBody))
     {
     }
 
-    void accept(StmtVisitor &visitor) override
+    // The body, whether it was parsed with the declaration or is parsed now
+    const std::vector<std::unique_ptr<Stmt>> &getBody() const
     {
-        visitor.visitFunctionStmt(*this);
+        return lazyBody != nullptr ? lazyBody->get() : body;
     }
 
     std::unique_ptr<Stmt> clone() const override
@@ -257,7 +263,42 @@ class Function : public Stmt
         {
             clonedBody.push_back(stmt->clone());
         }
-        return std::make_unique<Function>(name, std::move(clonedParams), std::move(clonedBody));
+        std::unique_ptr<Function> cloned =
+            std::make_unique<Function>(name, std::move(clonedParams), std::move(clonedBody));
+        cloned->lazyBody = lazyBody;
+        cloned->lifted = lifted;
+        cloned->bindsName = bindsName;
+        return cloned;
     }
 };
+
+// Calls the visit method for this node's kind. Visitor is the concrete visitor class, so when it is final the
+// call can be made directly (or inlined) instead of through the vtable.
+template <typename Visitor> typename Visitor::StmtResult Stmt::accept(Visitor &visitor) const
+{
+    switch (kind)
+    {
+    case StmtKind::Block:
+        return visitor.visitBlockStmt(static_cast<const Block &>(*this));
+    case StmtKind::Break:
+        return visitor.visitBreakStmt(static_cast<const Break &>(*this));
+    case StmtKind::Expression:
+        return visitor.visitExpressionStmt(static_cast<const Expression &>(*this));
+    case StmtKind::Function:
+        return visitor.visitFunctionStmt(static_cast<const Function &>(*this));
+    case StmtKind::If:
+        return visitor.visitIfStmt(static_cast<const If &>(*this));
+    case StmtKind::Print:
+        return visitor.visitPrintStmt(static_cast<const Print &>(*this));
+    case StmtKind::Return:
+        return visitor.visitReturnStmt(static_cast<const Return &>(*this));
+    case StmtKind::Var:
+        return visitor.visitVarStmt(static_cast<const Var &>(*this));
+    case StmtKind::While:
+        return visitor.visitWhileStmt(static_cast<const While &>(*this));
+    }
+    // Every kind is handled above
+    __builtin_unreachable();
+}
+
 #endif
@@ -0,0 +1,57 @@
+#ifndef THREADPOOL_HPP
+#define THREADPOOL_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*
+ * Fixed set of worker threads for the parallel front end (--parallel-scan). Work is handed out as a batch of numbered
+ * tasks which the workers, and the thread waiting on the batch, take one at a time.
+ */
+class ThreadPool
+{
+    std::vector<std::thread> workers;
+
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable done;
+
+    // The current batch. Only changed while no worker is busy.
+    const std::function<void(size_t)> *task = nullptr;
+    size_t count = 0;
+    std::atomic<size_t> next{0};
+
+    // Guarded by mutex
+    size_t finished = 0;
+    unsigned busy = 0;
+    unsigned long batch = 0;
+    bool stopping = false;
+
+    // Run tasks of the current batch until there are none left.
+    void runTasks();
+    void work();
+
+  public:
+    // threads is the total number of threads working on a batch, including the one calling forEach. 0 means one per
+    // hardware thread.
+    explicit ThreadPool(unsigned threads = 0);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    unsigned size() const
+    {
+        return static_cast<unsigned>(workers.size()) + 1;
+    }
+
+    // Run task(0) to task(count - 1) and return once all of them are done. Tasks must not throw.
+    void forEach(size_t count, const std::function<void(size_t)> &task);
+};
+
+#endif // THREADPOOL_HPP
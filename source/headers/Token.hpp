@@ -2,21 +2,25 @@
 #define TOKEN_HPP
 
 #include "TokenInfo.hpp"
+#include <cstdint>
 #include <memory>
 #include <string>
+#include <string_view>
+#include <type_traits>
 
+/*
+ * A token only records where it is in the Source: its type, global offset and length. The lexeme, literal value and
+ * line number are worked out from the source text when asked for, which keeps tokens small and trivially copyable
+ * (they are copied into every AST node that needs one).
+ */
 class Token
 {
     // The actual type of token like keyword, identifier, literal like number or string, etc.
-    const TokenInfo::Type type;
-    // The actual string in the code that represents the token.
-    const std::string lexeme;
-    // The value held by the token. Keywords do not have a literal value.
-    // The only way to dereference a void pointer is to cast it to another type first.
-    std::shared_ptr<void> literal;
-
-    // The line number where the token is present.
-    const int line;
+    TokenInfo::Type type;
+    // Global offset (see Source) of the first character of the lexeme.
+    uint32_t offset;
+    // Length of the lexeme.
+    uint32_t length;
 
     /* E.g. " var numb = 5 ; "
      * (var) type = KEYWORD, lexeme = "var", literal = nullptr, line = 1
@@ -27,8 +31,7 @@ class Token
      */
 
   public:
-    Token(TokenInfo::Type type, const std::string &lexeme, std::shared_ptr<void> &literal, int line)
-        : type(type), lexeme(lexeme), literal(literal), line(line)
+    Token(TokenInfo::Type type, uint32_t offset, uint32_t length) : type(type), offset(offset), length(length)
     {
     }
 
@@ -41,18 +44,28 @@ class Token
     {
         return type;
     }
-    const std::string &getLexeme() const
-    {
-        return lexeme;
-    }
-    std::shared_ptr<void> getLiteral() const
+    uint32_t getOffset() const
     {
-        return literal;
+        return offset;
     }
-    const int getLine() const
+    uint32_t getLength() const
     {
-        return line;
+        return length;
     }
+
+    // The actual string in the code that represents the token. Stays valid for the whole run (see Source).
+    std::string_view getLexeme() const;
+    // The value held by the token: a double for NUMBER, the unquoted std::string for STRING, nullptr otherwise.
+    // The only way to dereference a void pointer is to cast it to another type first.
+    std::shared_ptr<void> getLiteral() const;
+    // The line number where the token is present (where it ends, for a string spanning lines).
+    int getLine() const;
+
+    // The value of a NUMBER lexeme. Doesn't allocate or depend on the locale.
+    static double parseNumber(std::string_view lexeme);
 };
 
+static_assert(sizeof(Token) <= 16, "Tokens are copied into AST nodes, keep them small");
+static_assert(std::is_trivially_copyable<Token>::value, "Tokens are copied by value everywhere");
+
 #endif // !TOKEN_HPP
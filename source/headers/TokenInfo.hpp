@@ -1,7 +1,10 @@
 #ifndef TOKENINFO_HPP
 #define TOKENINFO_HPP
 
+#include <cstdint>
+#include <initializer_list>
 #include <string>
+#include <string_view>
 #include <vector>
 
 /*
@@ -69,7 +72,30 @@ class TokenInfo
 
     static std::string getTypeString(Type type);
 
-    static TokenInfo::Type getKeywordOrIdentifier(std::string &text);
+    static TokenInfo::Type getKeywordOrIdentifier(std::string_view text);
 };
 
+/*
+ * Set of token types stored as a bitmask, so that checking if a token is one of several types is a single AND.
+ * Meant to be built at compile time, e.g. constexpr TokenSet ops = {TokenInfo::Type::PLUS, TokenInfo::Type::MINUS};
+ */
+class TokenSet
+{
+    uint64_t bits = 0;
+
+  public:
+    constexpr TokenSet(std::initializer_list<TokenInfo::Type> types)
+    {
+        for (TokenInfo::Type type : types)
+            bits |= uint64_t(1) << type;
+    }
+
+    constexpr bool contains(TokenInfo::Type type) const
+    {
+        return (bits >> type) & 1;
+    }
+};
+
+static_assert(TokenInfo::Type::END_OF_FILE < 64, "TokenSet holds one bit per token type");
+
 #endif // TOKENINFO_HPP
@@ -0,0 +1,102 @@
+#ifndef TRACE_HPP
+#define TRACE_HPP
+
+#include "Environment.hpp"
+#include "Stmt.hpp"
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+// One operation of a Trace on its registers (unboxed doubles, booleans are 1.0 / 0.0)
+struct TraceInstruction
+{
+    enum Op : uint8_t
+    {
+        CONSTANT, // target = constant
+        MOVE,     // target = left
+        ADD,
+        SUBTRACT,
+        MULTIPLY,
+        DIVIDE, // Guards against division by zero
+        GREATER,
+        GREATER_EQUAL,
+        LESS,
+        LESS_EQUAL,
+        EQUAL,
+        NOT_EQUAL,
+        NOT,
+        GUARD_TRUTHY, // Leave the trace unless left is truthy
+        GUARD_FALSY,
+        PRINT_NUMBER,
+        PRINT_BOOLEAN,
+        PRINT_STRING, // Prints Trace::strings[left]
+        LOOP,         // End of an iteration: start the next one if left (the loop condition) is truthy
+    };
+
+    Op op;
+    uint16_t target;
+    uint16_t left;
+    uint16_t right;
+    double constant;
+};
+
+/*
+ * One iteration of a hot while loop (its body, then its condition) as recorded by the TraceRecorder: a straight line
+ * of instructions on numbers and booleans, with a guard wherever the recorded iteration took a branch or could have
+ * failed. Variables from outside the loop are loaded into registers when the trace is entered, locals of the body
+ * only ever live in registers.
+ * Iterations are all or nothing: if a guard fails, the registers and output of that iteration are thrown away and the
+ * interpreter runs the iteration again from the start, so leaving the trace never has to rebuild a half finished
+ * iteration.
+ */
+class Trace
+{
+  public:
+    std::vector<TraceInstruction> code;
+    std::vector<std::string> strings;
+
+    // A variable from outside the loop: loaded when the trace is entered, stored back when it is left if written
+    struct Input
+    {
+        std::string name;
+        uint16_t reg;
+        bool written;
+    };
+    std::vector<Input> inputs;
+    uint16_t registers = 0;
+
+    enum class Exit
+    {
+        FINISHED,    // The loop condition became falsy
+        DEOPTIMIZED, // A guard failed, the interpreter continues with the iteration that failed
+    };
+
+    // Run iterations of the loop in env, starting with its body (its condition was just found truthy)
+    Exit run(Environment &env) const;
+};
+
+/*
+ * Tracing tier of AstInterpreter::visitWhileStmt, kept on the While node. Iterations are counted until the loop is
+ * hot, then one iteration is recorded and the loop runs as a Trace. A trace that keeps leaving through its guards (e.g.
+ * because the loop took another branch) is dropped to be recorded again, and after a few recordings the loop stays
+ * with the interpreter.
+ */
+class LoopTrace
+{
+    unsigned iterations = 0;
+    unsigned deoptimizations = 0;
+    unsigned recordings = 0;
+    std::unique_ptr<Trace> trace;
+
+  public:
+    static constexpr unsigned THRESHOLD = 50;
+    static constexpr unsigned MAX_DEOPTIMIZATIONS = 16;
+    static constexpr unsigned MAX_RECORDINGS = 4;
+
+    // Called before each iteration of the body of loop in env. Returns true if the rest of the loop ran as a trace,
+    // false if the interpreter has to run the next iteration.
+    bool run(const While &loop, Environment &env);
+};
+
+#endif // TRACE_HPP
@@ -0,0 +1,83 @@
+#ifndef TRACERECORDER_HPP
+#define TRACERECORDER_HPP
+
+#include "Environment.hpp"
+#include "Expr.hpp"
+#include "Stmt.hpp"
+#include "Trace.hpp"
+#include <cstdint>
+#include <memory>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+/*
+ * Records one iteration of a while loop into a Trace. The iteration is simulated on the current values of the
+ * variables, without changing any of them or printing anything: every operation is appended to the trace together with
+ * the type its operands had, and every branch taken becomes a guard. Expression visits return the register holding
+ * the value.
+ * Only loops computing with numbers and booleans are recorded. Anything else (calls, strings, nil, nested loops,
+ * break, a runtime error in the recorded iteration) gives up on the recording.
+ */
+class TraceRecorder final : public ExprVisitor<uint16_t>, public StmtVisitor<void>
+{
+    enum class Type : uint8_t
+    {
+        NUMBER,
+        BOOLEAN
+    };
+
+    Trace &trace;
+    Environment &env;
+
+    // Value and type of every register at this point of the recorded iteration
+    std::vector<double> values;
+    std::vector<Type> types;
+
+    // Locals of the loop body by scope, innermost last
+    std::vector<std::vector<std::pair<std::string_view, uint16_t>>> scopes;
+
+    TraceRecorder(Trace &trace, Environment &env) : trace(trace), env(env)
+    {
+    }
+
+    uint16_t allocate(Type type, double value);
+    void emit(TraceInstruction::Op op, uint16_t target, uint16_t left = 0, uint16_t right = 0, double constant = 0);
+    // Register of a variable, loaded from outside the loop if it is no local
+    uint16_t variable(const Token &name, bool write);
+    uint16_t evaluate(const std::unique_ptr<Expr> &expr);
+    uint16_t evaluateNumber(const std::unique_ptr<Expr> &expr);
+    void execute(const std::unique_ptr<Stmt> &stmt);
+    // Guard on the truthiness reg has now and return it
+    bool guard(uint16_t reg);
+
+  public:
+    // Trace of the next iteration of loop, whose condition was just found truthy in env. nullptr if the iteration
+    // can't be traced.
+    static std::unique_ptr<Trace> record(const While &loop, Environment &env);
+
+    /* -------------------- EXPRESSIONS -------------------- */
+    uint16_t visitAssignExpr(const Assign &expr) override;
+    uint16_t visitBinaryExpr(const Binary &expr) override;
+    uint16_t visitCallExpr(const Call &expr) override;
+    uint16_t visitGroupingExpr(const Grouping &expr) override;
+    uint16_t visitLiteralExpr(const Literal &expr) override;
+    uint16_t visitLogicalExpr(const Logical &expr) override;
+    uint16_t visitUnaryExpr(const Unary &expr) override;
+    uint16_t visitVariableExpr(const Variable &expr) override;
+    /* ---------------------------------------------------- */
+
+    /* -------------------- STATEMENTS -------------------- */
+    void visitBlockStmt(const Block &stmt) override;
+    void visitBreakStmt(const Break &stmt) override;
+    void visitExpressionStmt(const Expression &stmt) override;
+    void visitFunctionStmt(const Function &stmt) override;
+    void visitIfStmt(const If &stmt) override;
+    void visitPrintStmt(const Print &stmt) override;
+    void visitReturnStmt(const Return &stmt) override;
+    void visitVarStmt(const Var &stmt) override;
+    void visitWhileStmt(const While &stmt) override;
+    /* ---------------------------------------------------- */
+};
+
+#endif // TRACERECORDER_HPP
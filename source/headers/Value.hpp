@@ -0,0 +1,14 @@
+#ifndef VALUE_HPP
+#define VALUE_HPP
+
+#include "TokenInfo.hpp"
+#include <memory>
+#include <utility>
+
+/*
+ * A runtime value: the (type-erased) data and the type needed to cast it back.
+ * E.g. { shared_ptr<double>(2), NUMBER }, { shared_ptr<std::string>("hi"), STRING }, { nullptr, NIL }
+ */
+using Value = std::pair<std::shared_ptr<void>, TokenInfo::Type>;
+
+#endif // VALUE_HPP
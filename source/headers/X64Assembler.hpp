@@ -0,0 +1,274 @@
+#ifndef X64ASSEMBLER_HPP
+#define X64ASSEMBLER_HPP
+
+#include <cstdint>
+#include <cstring>
+#include <initializer_list>
+#include <vector>
+
+/*
+ * Emits the few x86-64 instructions the JitCompiler needs into a byte buffer.
+ * Doubles live in xmm0 / xmm1 / xmm2, frame slots are addressed off rbp, r12 holds the call depth budget.
+ * Jumps are emitted with 32-bit displacements and patched when their label is bound.
+ */
+class X64Assembler
+{
+    std::vector<uint8_t> code;
+
+    struct Label
+    {
+        int32_t position = -1;          // Bound position, -1 until bind()
+        std::vector<size_t> references; // Displacements to patch once bound
+    };
+    std::vector<Label> labels;
+
+    void emit(std::initializer_list<uint8_t> values)
+    {
+        code.insert(code.end(), values);
+    }
+    void int32(int32_t value)
+    {
+        uint8_t raw[4];
+        std::memcpy(raw, &value, 4);
+        code.insert(code.end(), raw, raw + 4);
+    }
+    void reference(int label)
+    {
+        Label &target = labels[label];
+        if (target.position >= 0)
+            int32(target.position - static_cast<int32_t>(code.size() + 4));
+        else
+        {
+            target.references.push_back(code.size());
+            int32(0);
+        }
+    }
+
+  public:
+    // Condition codes of jcc / setcc (the low nibble of their opcode)
+    enum Condition : uint8_t
+    {
+        ABOVE = 0x7,
+        ABOVE_EQUAL = 0x3,
+        EQUAL = 0x4,
+        NOT_EQUAL = 0x5,
+        PARITY = 0xA,
+        NO_PARITY = 0xB,
+        LESS_EQUAL = 0xE,
+    };
+
+    const std::vector<uint8_t> &bytes() const
+    {
+        return code;
+    }
+    size_t size() const
+    {
+        return code.size();
+    }
+
+    int newLabel()
+    {
+        labels.emplace_back();
+        return static_cast<int>(labels.size() - 1);
+    }
+    void bind(int label)
+    {
+        Label &target = labels[label];
+        target.position = static_cast<int32_t>(code.size());
+        for (size_t at : target.references)
+        {
+            int32_t displacement = target.position - static_cast<int32_t>(at + 4);
+            std::memcpy(&code[at], &displacement, 4);
+        }
+        target.references.clear();
+    }
+
+    /* -------------------- FRAME -------------------- */
+    // push rbp; mov rbp, rsp; push r12; mov r12, rsi; sub rsp, <frame size>. Returns where the frame size goes, see
+    // patch(), as it is only known once the body is compiled.
+    size_t prologue()
+    {
+        emit({0x55, 0x48, 0x89, 0xE5, 0x41, 0x54, 0x49, 0x89, 0xF4});
+        subRsp(0);
+        return code.size() - 4;
+    }
+    void patch(size_t at, int32_t value)
+    {
+        std::memcpy(&code[at], &value, 4);
+    }
+    // lea rsp, [rbp - 8]; pop r12; pop rbp; ret
+    void epilogue()
+    {
+        emit({0x48, 0x8D, 0x65, 0xF8, 0x41, 0x5C, 0x5D, 0xC3});
+    }
+    void subRsp(int32_t amount)
+    {
+        emit({0x48, 0x81, 0xEC});
+        int32(amount);
+    }
+    void addRsp(int32_t amount)
+    {
+        emit({0x48, 0x81, 0xC4});
+        int32(amount);
+    }
+
+    /* -------------------- DOUBLES -------------------- */
+    // movsd xmm0, [rbp + offset]
+    void loadSlot(int32_t offset)
+    {
+        emit({0xF2, 0x0F, 0x10, 0x85});
+        int32(offset);
+    }
+    // movsd [rbp + offset], xmm0
+    void storeSlot(int32_t offset)
+    {
+        emit({0xF2, 0x0F, 0x11, 0x85});
+        int32(offset);
+    }
+    // movsd xmm0, [rdi + offset]
+    void loadArgument(int32_t offset)
+    {
+        emit({0xF2, 0x0F, 0x10, 0x87});
+        int32(offset);
+    }
+    // mov rax, bits; movq xmm0, rax
+    void loadConstant(double value)
+    {
+        uint64_t bits;
+        std::memcpy(&bits, &value, 8);
+        emit({0x48, 0xB8});
+        for (int i = 0; i < 8; i++)
+            code.push_back(static_cast<uint8_t>(bits >> (i * 8)));
+        emit({0x66, 0x48, 0x0F, 0x6E, 0xC0});
+    }
+    // sub rsp, 8; movsd [rsp], xmm0
+    void pushValue()
+    {
+        subRsp(8);
+        emit({0xF2, 0x0F, 0x11, 0x04, 0x24});
+    }
+    // movapd xmm1, xmm0; movsd xmm0, [rsp]; add rsp, 8 (left operand in xmm0, right in xmm1)
+    void popLeft()
+    {
+        emit({0x66, 0x0F, 0x28, 0xC8, 0xF2, 0x0F, 0x10, 0x04, 0x24});
+        addRsp(8);
+    }
+    void addsd()
+    {
+        emit({0xF2, 0x0F, 0x58, 0xC1});
+    }
+    void subsd()
+    {
+        emit({0xF2, 0x0F, 0x5C, 0xC1});
+    }
+    void mulsd()
+    {
+        emit({0xF2, 0x0F, 0x59, 0xC1});
+    }
+    void divsd()
+    {
+        emit({0xF2, 0x0F, 0x5E, 0xC1});
+    }
+    // ucomisd xmm0, xmm1 (or xmm1, xmm0 when swapped)
+    void compare(bool swapped)
+    {
+        emit({0x66, 0x0F, 0x2E, static_cast<uint8_t>(swapped ? 0xC8 : 0xC1)});
+    }
+    // xorpd xmm2, xmm2; ucomisd xmm<reg>, xmm2 (reg is 0 or 1)
+    void compareZero(int reg)
+    {
+        emit({0x66, 0x0F, 0x57, 0xD2, 0x66, 0x0F, 0x2E, static_cast<uint8_t>(0xC2 | (reg << 3))});
+    }
+    // set<condition> al
+    void setAl(Condition condition)
+    {
+        emit({0x0F, static_cast<uint8_t>(0x90 | condition), 0xC0});
+    }
+    // set<condition> cl
+    void setCl(Condition condition)
+    {
+        emit({0x0F, static_cast<uint8_t>(0x90 | condition), 0xC1});
+    }
+    // and al, cl / or al, cl
+    void andAlCl()
+    {
+        emit({0x20, 0xC8});
+    }
+    void orAlCl()
+    {
+        emit({0x08, 0xC8});
+    }
+    // movzx eax, al; cvtsi2sd xmm0, eax (a flag as 0.0 / 1.0)
+    void alToDouble()
+    {
+        emit({0x0F, 0xB6, 0xC0, 0xF2, 0x0F, 0x2A, 0xC0});
+    }
+
+    /* -------------------- CONTROL -------------------- */
+    void jump(int label)
+    {
+        emit({0xE9});
+        reference(label);
+    }
+    void jumpIf(Condition condition, int label)
+    {
+        emit({0x0F, static_cast<uint8_t>(0x80 | condition)});
+        reference(label);
+    }
+    // Jump if xmm0 is falsy: equal to zero (NaN is truthy, like in Operators::isTruthy)
+    void jumpIfFalsy(int label)
+    {
+        compareZero(0);
+        emit({0x7A, 0x06}); // jp over the je below
+        jumpIf(EQUAL, label);
+    }
+    // Jump if xmm0 is truthy
+    void jumpIfTruthy(int label)
+    {
+        compareZero(0);
+        jumpIf(PARITY, label);
+        jumpIf(NOT_EQUAL, label);
+    }
+    // call label
+    void call(int label)
+    {
+        emit({0xE8});
+        reference(label);
+    }
+    // mov eax, value
+    void status(int32_t value)
+    {
+        emit({0xB8});
+        int32(value);
+    }
+    // test eax, eax
+    void testStatus()
+    {
+        emit({0x85, 0xC0});
+    }
+
+    /* -------------------- CALLS -------------------- */
+    // mov rax, [r12]; test rax, rax (compare the depth budget with 0)
+    void testBudget()
+    {
+        emit({0x49, 0x8B, 0x04, 0x24, 0x48, 0x85, 0xC0});
+    }
+    // dec qword [r12] / inc qword [r12]
+    void decrementBudget()
+    {
+        emit({0x49, 0xFF, 0x0C, 0x24});
+    }
+    void incrementBudget()
+    {
+        emit({0x49, 0xFF, 0x04, 0x24});
+    }
+    // lea rdi, [rbp + offset]; mov rsi, r12 (arguments of a call)
+    void callArguments(int32_t offset)
+    {
+        emit({0x48, 0x8D, 0xBD});
+        int32(offset);
+        emit({0x4C, 0x89, 0xE6});
+    }
+};
+
+#endif // X64ASSEMBLER_HPP
@@ -1,5 +1,25 @@
 #include "headers/Loxpp.hpp"
+#include <charconv>
 #include <iostream>
+#include <string>
+#include <vector>
+
+// The value of an option like --name=N: false unless all of arg after prefix is a whole number from min to max
+static bool parseCount(const std::string &arg, size_t prefix, unsigned min, unsigned max, unsigned &value)
+{
+    const char *first = arg.data() + prefix;
+    const char *last = arg.data() + arg.size();
+    unsigned long parsed = 0;
+    auto [end, error] = std::from_chars(first, last, parsed);
+    if (first == last || end != last || error != std::errc() || parsed < min || parsed > max)
+    {
+        std::cout << "Invalid value for " << arg.substr(0, prefix - 1) << ": '" << arg.substr(prefix)
+                  << "' (expected a whole number from " << min << " to " << max << ")\n";
+        return false;
+    }
+    value = static_cast<unsigned>(parsed);
+    return true;
+}
 
 int main(int argc, char *argv[])
 {
@@ -7,23 +27,115 @@ int main(int argc, char *argv[])
     // TODO: Fix the AST generation script
     // TODO: Understand string literal lifetimes (esp. from local return values)
 
+    // Separate options (--name) from the script path
+    std::vector<std::string> args;
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+
+        if (arg == "--flat-ast")
+            Loxpp::options.flatAst = true;
+        else if (arg == "--closures")
+            Loxpp::options.closures = true;
+        else if (arg == "--ir")
+            Loxpp::options.ir = true;
+        else if (arg == "--ir-optimize=on" || arg == "--ir-optimize=off")
+            Loxpp::options.irOptimize = arg == "--ir-optimize=on";
+        else if (arg == "--dump-ir")
+            Loxpp::options.ir = Loxpp::options.dumpIr = true;
+        else if (arg == "--ast-optimize=on" || arg == "--ast-optimize=off")
+            Loxpp::options.astOptimize = arg == "--ast-optimize=on";
+        else if (arg.rfind("--inline-budget=", 0) == 0)
+        {
+            if (!parseCount(arg, 16, 0, Options::MAX_INLINE_BUDGET, Loxpp::options.inlineBudget))
+                return 64;
+        }
+        else if (arg == "--inline-report")
+            Loxpp::options.inlineReport = true;
+        else if (arg == "--jit=on" || arg == "--jit=off")
+            Loxpp::options.jit = arg == "--jit=on";
+        else if (arg == "--traces=on" || arg == "--traces=off")
+            Loxpp::options.traces = arg == "--traces=on";
+        else if (arg == "--tail-calls=on" || arg == "--tail-calls=off")
+            Loxpp::options.tailCalls = arg == "--tail-calls=on";
+        else if (arg.rfind("--emit-cpp=", 0) == 0)
+            Loxpp::options.emitCpp = arg.substr(11);
+        else if (arg == "--emit-cpp" && i + 1 < argc)
+            Loxpp::options.emitCpp = argv[++i];
+        else if (arg == "--parallel-scan")
+            Loxpp::options.parallelScan = true;
+        else if (arg == "--parallel-parse")
+            Loxpp::options.parallelParse = true;
+        else if (arg == "--lazy-parse")
+            Loxpp::options.lazyParse = true;
+        else if (arg.rfind("--cache-dir=", 0) == 0)
+        {
+            Loxpp::options.cacheDir = arg.substr(12);
+            Loxpp::options.flatAst = true;
+        }
+        else if (arg.rfind("--snapshot-out=", 0) == 0)
+        {
+            Loxpp::options.snapshotOut = arg.substr(15);
+            Loxpp::options.flatAst = true;
+        }
+        else if (arg.rfind("--snapshot-in=", 0) == 0)
+        {
+            Loxpp::options.snapshotIn = arg.substr(14);
+            Loxpp::options.flatAst = true;
+        }
+        else if (arg.rfind("--max-depth=", 0) == 0)
+        {
+            if (!parseCount(arg, 12, 0, Options::MAX_DEPTH_LIMIT, Loxpp::options.maxDepth))
+                return 64;
+        }
+        else if (arg.rfind("--threads=", 0) == 0)
+        {
+            if (!parseCount(arg, 10, 0, Options::MAX_THREADS, Loxpp::options.threads))
+                return 64;
+        }
+        else if (arg.rfind("--", 0) == 0)
+        {
+            std::cout << "Unknown option: " << arg << "\n";
+            return 64;
+        }
+        else
+            args.push_back(arg);
+    }
+
+    // Cached programs and snapshots are flat ASTs, which only the flat AST interpreter runs
+    const Options &options = Loxpp::options;
+    if ((!options.cacheDir.empty() || !options.snapshotIn.empty() || !options.snapshotOut.empty()) &&
+        (options.closures || options.ir || !options.emitCpp.empty()))
+    {
+        std::cout << "--cache-dir, --snapshot-in and --snapshot-out can't be combined with --closures, --ir or "
+                     "--emit-cpp\n";
+        return 64;
+    }
+
     // Check if we are running a script or an interactive session
-    if (argc > 2)
+    if (args.size() > 1)
     {
-        std::cout << "Usage: loxpp [script]"
+        std::cout << "Usage: loxpp [--flat-ast] [--closures] [--ir] [--ir-optimize=on|off] [--dump-ir] "
+                     "[--ast-optimize=on|off] [--inline-budget=N] [--inline-report] [--jit=on|off] [--traces=on|off] "
+                     "[--tail-calls=on|off] [--emit-cpp FILE] [--parallel-scan] [--parallel-parse] [--lazy-parse] "
+                     "[--cache-dir=DIR] [--snapshot-out=FILE] [--snapshot-in=FILE] [--max-depth=N] [--threads=N] "
+                     "[script]"
                   << "\n";
         return 64;
     }
-    // Script
-    else if (argc == 2)
+    // Script (on a thread with room for --max-depth nested calls)
+    else if (args.size() == 1)
     {
-        int result = Loxpp::runFile(argv[1]);
+        int result = Loxpp::runWithStack([&args]() { return Loxpp::runFile(args[0]); });
         return result;
     }
     // Interactive session
     else
     {
-        Loxpp::runPrompt();
+        Loxpp::runWithStack([]() {
+            Loxpp::runPrompt();
+            return 0;
+        });
         // Will not go beyond this point because in interactive session, we are in a loop
         // and the only way to exit is to break the loop with ctrl-c or d, which will
         // terminate the program.
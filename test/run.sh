@@ -0,0 +1,110 @@
+#!/usr/bin/env bash
+# Runs every script in test/ that has expectations and compares what it prints with them (make test):
+#   // expect: TEXT          a line the script prints, in order
+#   // expect error: TEXT    a line it reports on stderr (runtime and parse errors), in order
+#   // flags: OPTIONS        run it with these options only, once per such line, instead of under every engine
+#   // before: COMMAND       a shell command to run before each run of it, in order with the other such lines ($LOX
+#                            is the interpreter), e.g. to write the snapshot it loads
+#   // emit-cpp: off          leave it out of the --emit-cpp runs below
+# Scripts without expectations (the older demos) are skipped.
+# Given the runtime library (make runtime), each script is also translated with --emit-cpp, compiled against it and
+# the program's output compared the same way. The program only keeps --max-depth of the options, which comes from the
+# first flags line.
+# Usage: test/run.sh [interpreter [runtime library]], from the root.
+
+LOX=${1:-build/bin/run}
+RUNTIME=$2
+DIR=$(dirname "$0")
+
+# Every engine and optimization switch that should print the same thing
+ENGINES=(
+    ""
+    "--ast-optimize=off"
+    "--jit=off --traces=off --tail-calls=off --inline-budget=0"
+    "--lazy-parse"
+    "--parallel-parse"
+    "--flat-ast"
+    "--closures"
+    "--ir"
+    "--ir --ir-optimize=off"
+)
+
+tmp=$(mktemp -d)
+trap 'rm -rf "$tmp"' EXIT
+stderr="$tmp/stderr"
+program="$tmp/program"
+
+passed=0
+failed=0
+
+# Compares actual and actualErrors with the expectations of the script, $1 says which run it was
+check() {
+    if [ "$actual" == "$expected" ] && [ "$actualErrors" == "$expectedErrors" ]; then
+        passed=$((passed + 1))
+    else
+        failed=$((failed + 1))
+        echo "FAIL: $script $1"
+        diff <(echo "$expected"; echo "$expectedErrors") <(echo "$actual"; echo "$actualErrors") | head -20
+    fi
+}
+
+for script in "$DIR"/*.lox; do
+    expected=$(sed -n 's|.*// expect: ||p' "$script")
+    expectedErrors=$(sed -n 's|.*// expect error: ||p' "$script")
+    if [ -z "$expected" ] && [ -z "$expectedErrors" ]; then
+        continue
+    fi
+
+    runs=()
+    while IFS= read -r flags; do
+        runs+=("$flags")
+    done < <(sed -n 's|.*// flags: *||p' "$script")
+    if [ ${#runs[@]} -eq 0 ]; then
+        runs=("${ENGINES[@]}")
+    fi
+
+    before=()
+    while IFS= read -r command; do
+        before+=("$command")
+    done < <(sed -n 's|.*// before: ||p' "$script")
+
+    for flags in "${runs[@]}"; do
+        # A failed command fails the run with its errors
+        ready=true
+        for command in "${before[@]}"; do
+            if ! eval "$command" </dev/null >/dev/null 2>"$stderr"; then
+                ready=false
+                break
+            fi
+        done
+        if [ $ready == false ]; then
+            actual=
+            actualErrors=$(cat "$stderr")
+            check "${flags:-(default)}"
+            continue
+        fi
+
+        # Word splitting of the options is intended
+        # shellcheck disable=SC2086
+        actual=$(timeout 60 "$LOX" $flags "$script" 2>"$stderr")
+        actualErrors=$(cat "$stderr")
+        check "${flags:-(default)}"
+    done
+
+    if [ -n "$RUNTIME" ] && ! grep -q '// emit-cpp: off' "$script"; then
+        maxDepth=$(sed -n 's|.*// flags:.*\(--max-depth=[0-9]*\).*|\1|p' "$script" | head -1)
+        # A failed translation or compilation fails the run with its errors
+        actual=
+        # shellcheck disable=SC2086
+        if timeout 60 "$LOX" $maxDepth --emit-cpp "$program.cpp" "$script" 2>"$stderr" &&
+            ${CXX:-g++} -O2 -std=c++17 -I "$DIR/../source/headers" "$program.cpp" "$RUNTIME" -pthread -o "$program" \
+                2>"$stderr"; then
+            actual=$(timeout 60 "$program" 2>"$stderr")
+        fi
+        actualErrors=$(cat "$stderr")
+        check "--emit-cpp${maxDepth:+ $maxDepth}"
+    fi
+done
+
+echo "$passed passed, $failed failed"
+[ $failed -eq 0 ]
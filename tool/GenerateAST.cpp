@@ -1,11 +1,18 @@
 #include <fstream>
 #include <iostream>
 #include <sstream>
+#include <string>
 #include <vector>
 
 void defineAst(std::string &outputDir, const char *baseName, const std::vector<std::string> &types);
 void defineType(std::ofstream &headerFile, const char *baseName, const std::string &className,
                 const std::string &fieldList);
+void defineFlatAst(std::string &outputDir, const std::vector<std::string> &exprTypes,
+                   const std::vector<std::string> &stmtTypes);
+void defineFlatType(std::ofstream &headerFile, const char *baseName, const std::string &className,
+                    const std::string &fieldList);
+void defineVisitors(std::string &outputDir, const std::vector<std::string> &exprTypes,
+                    const std::vector<std::string> &stmtTypes);
 
 /*
  * It is tedious to write all the Expr subclasses that represent the AST nodes.
@@ -16,6 +23,46 @@ int main(int argc, char *argv[])
 {
 
     std::string outputDir = "source/headers";
+
+    // Fields use flat types instead of pointers and tokens (only "GenerateAST flat" uses them):
+    // ExprRef / StmtRef -> 32-bit node reference, ExprList / StmtList / NameList -> range in a shared list column,
+    // Name -> interned identifier, Src -> global source offset of a token, Op -> token type, Const -> constant table index.
+    const std::vector<std::string> exprTypes = {
+        "Assign   : Name name, Src namePos, ExprRef value",
+        "Binary   : ExprRef left, Op op, Src opPos, ExprRef right",
+        "Call     : ExprRef callee, Src parenPos, ExprList arguments",
+        "Grouping : ExprRef expression",
+        "Literal  : Op type, Const value",
+        "Logical  : ExprRef left, Op op, ExprRef right",
+        "Unary    : Op op, Src opPos, ExprRef right",
+        "Variable : Name name, Src namePos",
+    };
+    const std::vector<std::string> stmtTypes = {
+        "Block      : StmtList statements",
+        "Break",
+        "Expression : ExprRef expression",
+        "Function   : Name name, Src namePos, NameList params, StmtList body",
+        "If         : ExprRef condition, StmtRef thenBranch, StmtRef elseBranch",
+        "Print      : ExprRef expression",
+        "Return     : Src keywordPos, ExprRef value",
+        "Var        : Name name, Src namePos, ExprRef initializer",
+        "While      : ExprRef condition, StmtRef body",
+    };
+
+    // "GenerateAST flat" generates FlatAst.hpp, the struct-of-arrays form of the same nodes.
+    if (argc > 1 && std::string(argv[1]) == "flat")
+    {
+        defineFlatAst(outputDir, exprTypes, stmtTypes);
+        return 0;
+    }
+
+    // "GenerateAST visitors" generates AstVisitor.hpp, the node kinds and the visitor templates of the Expr / Stmt tree.
+    if (argc > 1 && std::string(argv[1]) == "visitors")
+    {
+        defineVisitors(outputDir, exprTypes, stmtTypes);
+        return 0;
+    }
+
     /* const char *baseName = "Expr"; */
     /* const std::vector<std::string> types = { */
     /*     "Call     : std::unique_ptr<Expr> callee, Token paren, std::vector<std::unique_ptr<Expr>> arguments", */
@@ -217,3 +264,279 @@ void defineType(std::ofstream &headerFile, const char *baseName, const std::stri
     headerFile << "};"
                << "\n";
 }
+
+// Split "Binary : ExprRef left, Op op" into its class name and field list (empty for e.g. "Break").
+static std::pair<std::string, std::string> splitType(const std::string &type)
+{
+    size_t colon = type.find(":");
+    std::string className = type.substr(0, colon);
+    className = className.substr(0, className.find_last_not_of(" ") + 1);
+    std::string fields = colon == std::string::npos ? "" : type.substr(colon + 1);
+    return std::make_pair(className, fields);
+}
+
+// C++ type used to store a flat field type in a column.
+static std::string flatColumnType(const std::string &type)
+{
+    if (type == "ExprRef" || type == "StmtRef")
+        return "FlatRef";
+    if (type == "ExprList" || type == "StmtList" || type == "NameList")
+        return "FlatRange";
+    if (type == "Op")
+        return "uint8_t";
+    // Name, Src, Const
+    return "uint32_t";
+}
+
+void defineFlatAst(std::string &outputDir, const std::vector<std::string> &exprTypes,
+                   const std::vector<std::string> &stmtTypes)
+{
+    std::ofstream headerFile(outputDir + "/FlatAst.hpp");
+    if (!headerFile)
+    {
+        std::cerr << "Could not open file for writing"
+                  << "\n";
+        return;
+    }
+
+    headerFile << "#ifndef FLATAST_HPP\n"
+               << "#define FLATAST_HPP\n\n"
+               << "// Generated by tool/GenerateAST.cpp (\"GenerateAST flat\"), do not edit by hand.\n\n"
+               << "#include \"FlatColumn.hpp\"\n"
+               << "#include <cstdint>\n"
+               << "#include <memory>\n"
+               << "#include <string>\n"
+               << "#include <vector>\n\n";
+
+    headerFile << "/*\n"
+               << " * Flat form of the AST. Instead of a tree of heap allocated Expr / Stmt objects, every node kind is\n"
+               << " * stored as a struct of arrays (one column per field) and nodes refer to each other with 32-bit\n"
+               << " * references. Tokens are replaced by their global source offset (see Source), names are interned and\n"
+               << " * literal values live in constant tables.\n"
+               << " */\n\n";
+
+    headerFile << "// Reference to a node: the node kind in the top 4 bits, its row in the kind's columns in the low 28.\n"
+               << "using FlatRef = uint32_t;\n"
+               << "const FlatRef FLAT_NONE = 0xFFFFFFFF;\n\n"
+               << "// Contiguous run of entries in one of the list columns (e.g. the statements of a block).\n"
+               << "struct FlatRange\n{\n    uint32_t first;\n    uint32_t count;\n};\n\n";
+
+    // Kind enums, e.g. enum class FlatExpr : uint8_t { Assign, Binary, ... };
+    std::vector<std::string> exprNames, stmtNames;
+    for (const std::string &type : exprTypes)
+        exprNames.push_back(splitType(type).first);
+    for (const std::string &type : stmtTypes)
+        stmtNames.push_back(splitType(type).first);
+
+    headerFile << "enum class FlatExpr : uint8_t\n{\n";
+    for (const std::string &name : exprNames)
+        headerFile << "    " << name << ",\n";
+    headerFile << "};\n\n";
+    headerFile << "enum class FlatStmt : uint8_t\n{\n";
+    for (const std::string &name : stmtNames)
+        headerFile << "    " << name << ",\n";
+    headerFile << "};\n\n";
+
+    // Column structs, e.g. struct FlatBinaryExpr { std::vector<FlatRef> left; ... };
+    for (const std::string &type : exprTypes)
+        defineFlatType(headerFile, "Expr", splitType(type).first, splitType(type).second);
+    for (const std::string &type : stmtTypes)
+        defineFlatType(headerFile, "Stmt", splitType(type).first, splitType(type).second);
+
+    // The whole program
+    headerFile << "struct FlatAst\n{\n";
+    for (const std::string &name : exprNames)
+        headerFile << "    Flat" << name << "Expr " << (char)tolower(name[0]) << name.substr(1) << "Exprs;\n";
+    for (const std::string &name : stmtNames)
+        headerFile << "    Flat" << name << "Stmt " << (char)tolower(name[0]) << name.substr(1) << "Stmts;\n";
+
+    headerFile << "\n"
+               << "    // Shared list columns referenced by FlatRange fields.\n"
+               << "    FlatColumn<FlatRef> exprLists;\n"
+               << "    FlatColumn<FlatRef> stmtLists;\n"
+               << "    FlatColumn<uint32_t> nameLists;\n\n"
+               << "    // Constants. Literal values index numbers or strings depending on the literal type.\n"
+               << "    FlatColumn<double> numbers;\n"
+               << "    FlatColumn<FlatRange> strings;\n"
+               << "    // Interned identifiers (Name fields index this table).\n"
+               << "    FlatColumn<FlatRange> names;\n"
+               << "    // Characters of strings and names.\n"
+               << "    FlatColumn<char> chars;\n\n"
+               << "    // Top-level statements of the program (in stmtLists).\n"
+               << "    FlatRange program = {0, 0};\n\n"
+               << "    // Keeps the memory alive that columns were pointed at with view(), e.g. a mapped cache file.\n"
+               << "    std::shared_ptr<const void> storage;\n\n";
+
+    headerFile << "    static FlatRef makeRef(uint8_t kind, uint32_t row)\n    {\n"
+               << "        return (static_cast<FlatRef>(kind) << 28) | row;\n    }\n"
+               << "    static uint32_t row(FlatRef ref)\n    {\n        return ref & 0x0FFFFFFF;\n    }\n"
+               << "    static FlatExpr exprKind(FlatRef ref)\n    {\n"
+               << "        return static_cast<FlatExpr>(ref >> 28);\n    }\n"
+               << "    static FlatStmt stmtKind(FlatRef ref)\n    {\n"
+               << "        return static_cast<FlatStmt>(ref >> 28);\n    }\n\n";
+
+    headerFile << "    std::string text(FlatRange range) const\n    {\n"
+               << "        return std::string(chars.data() + range.first, range.count);\n    }\n";
+
+    // Every column and every plain number of the AST in a fixed order, so it can be saved and loaded generically
+    std::string columns, scalars;
+    for (int i = 0; i < 2; i++)
+    {
+        const std::vector<std::string> &types = i == 0 ? exprTypes : stmtTypes;
+        const char *baseName = i == 0 ? "Expr" : "Stmt";
+        for (const std::string &type : types)
+        {
+            auto [className, fieldList] = splitType(type);
+            std::string table = std::string(1, (char)tolower(className[0])) + className.substr(1) + baseName + "s";
+            scalars += "        f(" + table + ".count);\n";
+
+            std::istringstream iss(fieldList);
+            std::string field;
+            while (std::getline(iss, field, ','))
+            {
+                field = field.substr(field.find_first_not_of(" "));
+                field = field.substr(0, field.find_last_not_of(" ") + 1);
+                columns += "        f(" + table + "." + field.substr(field.find(" ") + 1) + ");\n";
+            }
+        }
+    }
+    for (const char *list : {"exprLists", "stmtLists", "nameLists", "numbers", "strings", "names", "chars"})
+        columns += std::string("        f(") + list + ");\n";
+    scalars += "        f(program.first);\n        f(program.count);\n";
+
+    headerFile << "\n    // Call f on every column, always in the same order (see FlatCache).\n"
+               << "    template <typename F> void forEachColumn(F &&f)\n    {\n"
+               << columns << "    }\n"
+               << "    // Call f on every row count and on the program range, always in the same order.\n"
+               << "    template <typename F> void forEachScalar(F &&f)\n    {\n"
+               << scalars << "    }\n";
+
+    // Constructors, e.g. FlatRef addBinary(FlatRef left, uint8_t op, uint32_t opPos, FlatRef right)
+    for (int i = 0; i < 2; i++)
+    {
+        const std::vector<std::string> &types = i == 0 ? exprTypes : stmtTypes;
+        const char *baseName = i == 0 ? "Expr" : "Stmt";
+        for (const std::string &type : types)
+        {
+            auto [className, fieldList] = splitType(type);
+            std::string params, args;
+            std::istringstream iss(fieldList);
+            std::string field;
+            while (std::getline(iss, field, ','))
+            {
+                field = field.substr(field.find_first_not_of(" "));
+                field = field.substr(0, field.find_last_not_of(" ") + 1);
+                std::string fieldType = field.substr(0, field.find(" "));
+                std::string name = field.substr(field.find(" ") + 1);
+                params += (params.empty() ? "" : ", ") + flatColumnType(fieldType) + " " + name;
+                args += (args.empty() ? "" : ", ") + name;
+            }
+            std::string column = std::string(1, (char)tolower(className[0])) + className.substr(1) + baseName + "s";
+            headerFile << "\n    FlatRef add" << className << "(" << params << ")\n    {\n"
+                       << "        return makeRef(static_cast<uint8_t>(Flat" << baseName << "::" << className << "), "
+                       << column << ".push(" << args << "));\n    }";
+        }
+    }
+    headerFile << "\n};\n\n";
+
+    headerFile << "#endif // FLATAST_HPP\n";
+    headerFile.close();
+}
+
+void defineFlatType(std::ofstream &headerFile, const char *baseName, const std::string &className,
+                    const std::string &fieldList)
+{
+    // Vector of <column type, name>, e.g. {FlatRef, left}, {uint8_t, op}, {FlatRef, right}
+    std::vector<std::pair<std::string, std::string>> fields;
+    std::istringstream iss(fieldList);
+    std::string field;
+    while (std::getline(iss, field, ','))
+    {
+        field = field.substr(field.find_first_not_of(" "));
+        field = field.substr(0, field.find_last_not_of(" ") + 1);
+        fields.push_back(std::make_pair(flatColumnType(field.substr(0, field.find(" "))),
+                                        field.substr(field.find(" ") + 1)));
+    }
+
+    headerFile << "// Columns of " << className << " " << baseName << " nodes, row i of each column is the i-th node.\n";
+    headerFile << "struct Flat" << className << baseName << "\n{\n";
+    headerFile << "    uint32_t count = 0;\n";
+    for (const auto &[type, name] : fields)
+        headerFile << "    FlatColumn<" << type << "> " << name << ";\n";
+
+    // Append a row and return its index
+    std::string params;
+    for (const auto &[type, name] : fields)
+        params += (params.empty() ? "" : ", ") + type + " " + name + "_";
+    headerFile << "\n    uint32_t push(" << params << ")\n    {\n";
+    for (const auto &[type, name] : fields)
+        headerFile << "        " << name << ".push_back(" << name << "_);\n";
+    headerFile << "        return count++;\n    }\n";
+    headerFile << "};\n\n";
+}
+
+// Visitor template of one base class, e.g. template <typename R> class ExprVisitor { virtual R visitBinaryExpr(...) };
+static void defineVisitor(std::ofstream &headerFile, const std::string &baseName, const std::vector<std::string> &names)
+{
+    std::string parameter = baseName == "Expr" ? "expr" : "stmt";
+
+    headerFile << "template <typename R> class " << baseName << "Visitor\n{\n"
+               << "  public:\n"
+               << "    // What the visit methods return, accept() returns the same\n"
+               << "    using " << baseName << "Result = R;\n\n"
+               << "    virtual ~" << baseName << "Visitor() = default;\n\n";
+    for (const std::string &name : names)
+        headerFile << "    virtual R visit" << name << baseName << "(const " << name << " &" << parameter << ") = 0;\n";
+    headerFile << "};\n\n";
+}
+
+void defineVisitors(std::string &outputDir, const std::vector<std::string> &exprTypes,
+                    const std::vector<std::string> &stmtTypes)
+{
+    std::ofstream headerFile(outputDir + "/AstVisitor.hpp");
+    if (!headerFile)
+    {
+        std::cerr << "Could not open file for writing"
+                  << "\n";
+        return;
+    }
+
+    std::vector<std::string> exprNames, stmtNames;
+    for (const std::string &type : exprTypes)
+        exprNames.push_back(splitType(type).first);
+    for (const std::string &type : stmtTypes)
+        stmtNames.push_back(splitType(type).first);
+
+    headerFile << "#ifndef ASTVISITOR_HPP\n"
+               << "#define ASTVISITOR_HPP\n\n"
+               << "// Generated by tool/GenerateAST.cpp (\"GenerateAST visitors\"), do not edit by hand.\n\n"
+               << "#include <cstdint>\n\n";
+
+    // Forward declarations, e.g. class Binary;
+    for (const std::string &name : exprNames)
+        headerFile << "class " << name << ";\n";
+    for (const std::string &name : stmtNames)
+        headerFile << "class " << name << ";\n";
+    headerFile << "\n";
+
+    // Kind enums, e.g. enum class ExprKind : uint8_t { Assign, Binary, ... };
+    headerFile << "// Kind of a node, stored in it so accept() can switch on it instead of making a virtual call.\n";
+    headerFile << "enum class ExprKind : uint8_t\n{\n";
+    for (const std::string &name : exprNames)
+        headerFile << "    " << name << ",\n";
+    headerFile << "};\n\n";
+    headerFile << "enum class StmtKind : uint8_t\n{\n";
+    for (const std::string &name : stmtNames)
+        headerFile << "    " << name << ",\n";
+    headerFile << "};\n\n";
+
+    headerFile << "/*\n"
+               << " * Visitors of the Expr / Stmt tree. R is what the visit methods return, e.g. the value of an expression\n"
+               << " * for the AstInterpreter. node.accept(visitor) calls the visit method for the node's kind.\n"
+               << " */\n";
+    defineVisitor(headerFile, "Expr", exprNames);
+    defineVisitor(headerFile, "Stmt", stmtNames);
+
+    headerFile << "#endif // ASTVISITOR_HPP\n";
+    headerFile.close();
+}
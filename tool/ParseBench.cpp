@@ -0,0 +1,78 @@
+#include "../source/headers/Parser.hpp"
+#include "../source/headers/Scanner.hpp"
+#include <chrono>
+#include <iostream>
+#include <string>
+
+/*
+ * Parse throughput benchmark.
+ * Generates a large Lox program (thousands of function and variable declarations using every kind of statement and
+ * expression) and reports how many megabytes of source per second the Scanner and the Parser get through.
+ *
+ * Build: make bench OPTFLAGS=-O2
+ * Run:   build/bin/parse_bench [megabytes] (default 16)
+ */
+
+static std::string generateProgram(size_t bytes)
+{
+    std::string program;
+    program.reserve(bytes + 1024);
+
+    for (int i = 0; program.length() < bytes; i++)
+    {
+        std::string n = std::to_string(i);
+        std::string prev = std::to_string(i > 0 ? i - 1 : 0);
+
+        program += "// helper number " + n + "\n";
+        program += "fun helper_" + n + "(a, b) {\n";
+        program += "    var total = a * 3 + b / 2 - (a - b) * 1.5 + " + n + ";\n";
+        program += "    if (total > 100 and a != b or !(total <= -2)) {\n";
+        program += "        total = total - 100;\n";
+        program += "    } else {\n";
+        program += "        total = \"label " + n + "\" + total;\n";
+        program += "    }\n";
+        program += "    /* loop over a few values */\n";
+        program += "    for (var k = 0; k < 10; k = k + 1) { total = total + k * k; }\n";
+        program += "    while (total >= 0) { total = total - 7; if (total == 3) break; }\n";
+        program += "    return helper_" + prev + "(total, nil) or false;\n";
+        program += "}\n";
+        program += "var value_" + n + " = helper_" + n + "(" + n + ", " + n + ".25);\n";
+        program += "print value_" + n + " == true;\n";
+    }
+
+    return program;
+}
+
+int main(int argc, char *argv[])
+{
+    double megabytes = argc > 1 ? std::stod(argv[1]) : 16;
+    std::string program = generateProgram(static_cast<size_t>(megabytes * 1024 * 1024));
+    double size = program.length() / (1024.0 * 1024.0);
+
+    std::cout << "Source: " << size << " MB\n";
+
+    double bestScan = 0, bestParse = 0;
+    for (int run = 0; run < 3; run++)
+    {
+        auto start = std::chrono::steady_clock::now();
+        Scanner scanner(program);
+        const std::vector<Token> &tokens = scanner.scanTokens();
+        auto scanned = std::chrono::steady_clock::now();
+
+        Parser parser(tokens);
+        std::vector<std::unique_ptr<Stmt>> statements = parser.parse();
+        auto parsed = std::chrono::steady_clock::now();
+
+        double scanSeconds = std::chrono::duration<double>(scanned - start).count();
+        double parseSeconds = std::chrono::duration<double>(parsed - scanned).count();
+        bestScan = std::max(bestScan, size / scanSeconds);
+        bestParse = std::max(bestParse, size / parseSeconds);
+
+        std::cout << "Run " << run + 1 << ": " << tokens.size() << " tokens, " << statements.size()
+                  << " declarations, scan " << size / scanSeconds << " MB/s, parse " << size / parseSeconds
+                  << " MB/s\n";
+    }
+
+    std::cout << "Best: scan " << bestScan << " MB/s, parse " << bestParse << " MB/s\n";
+    return 0;
+}